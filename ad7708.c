@@ -1,41 +1,57 @@
 #include "ad7708.h"
+#include "ad7708_instr.h"
+#include "ad7708_stats.h"
+
+#include <stddef.h>
+
+#define AD7708_RECOVER_MAX_BYTES (2 + 16 * 8 + 4 * 2) // Idle, every calibration bank, filter/IO/control/mode
 
 /********************** Static function declarations ************************/
 
+/*!
+ * @brief Pass a result read by the driver to the per-result hook
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] code - Conversion result
+ * @param[in] flags - Extra sample flags, AD7708_SAMPLE_CLAMPED
+ * @return void
+ */
+static void feedSample(ad7708_dev* dev, uint16_t code, uint8_t flags);
+
 /*!
  * @brief Set the CS pin to the desired state
+ * @param[in] dev - Pointer to the device structure
  * @param[in] state - Desired state of the CS pin
  * @return void
  */
-static void setCS(uint8_t state);
+static void setCS(ad7708_dev* dev, uint8_t state);
 
 /*!
- * @brief Transmit data to the AD7708
+ * @brief Full-duplex transfer with the AD7708, CS is handled by the caller
  * @param[in] dev - Pointer to the device structure
- * @param[in] data - Pointer to the data to be transmitted
+ * @param[in] tx - Bytes to clock out
+ * @param[out] rx - Bytes clocked in
+ * @param[in] len - Frame length
  * @return 0: case of success, error code otherwise.
  */
-static StatusTypeDef spiTransmit(ad7708_dev* dev, uint8_t* data, uint16_t len);
+static StatusTypeDef spiTransfer(ad7708_dev* dev, uint8_t* tx, uint8_t* rx, uint16_t len);
 
 /*!
- * @brief Set the next operation to be performed by the AD7708
- *
+ * @brief Access a register in a single CS-asserted frame: comm byte + payload
  * @param[in] dev - Pointer to the device structure
  * @param[in] reg - Register to be accessed
  * @param[in] rw - Read or Write operation
- * @param[in] len - Length of the data to be transmitted or received
- *
- * @return 0: case of success, 1: error code otherwise.
+ * @param[in,out] data - Payload, MSB first
+ * @param[in] len - Payload length, 1 or 2
+ * @return 0: case of success, error code otherwise.
  */
-static StatusTypeDef setNextOperation(ad7708_dev* dev, SelectedReg reg, uint8_t rw, uint16_t len);
+static StatusTypeDef ad7708_access(ad7708_dev* dev, SelectedReg reg, uint8_t rw, uint8_t* data, uint16_t len);
 
 /*!
- * @brief Recieve data from the AD7708
- * @param[in] dev - Pointer to the device structure
- * @param[in] data - Pointer to the data to be recieved
- * @return 0: case of success, error code otherwise.
+ * @brief Width of a register in bytes
+ * @param[in] reg - Register address
+ * @return 1 or 2
  */
-static StatusTypeDef spiRecieve(ad7708_dev* dev, uint16_t* data, uint16_t len);
+static uint8_t regWidth(SelectedReg reg);
 
 /*!
  * @brief Read data from the AD7708 registers
@@ -45,10 +61,164 @@ static StatusTypeDef spiRecieve(ad7708_dev* dev, uint16_t* data, uint16_t len);
  * @param[in] len - Length of the data to be recieved
  * @return 0: case of success, error code otherwise.
  */
-static StatusTypeDef ad7708_readReg(ad7708_dev* dev, SelectedReg reg, uint16_t* data, uint16_t len);
+static StatusTypeDef ad7708_readReg(ad7708_dev* dev, SelectedReg reg, uint8_t* data, uint16_t len);
+
+/*!
+ * @brief Write an 8 bit configuration register through the shadow cache
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] reg - Register to be written
+ * @param[in] value - Register value
+ * @return 0: case of success, error code otherwise.
+ * @note The SPI write is skipped when the shadow is known, clean and equal to value
+ */
+static StatusTypeDef ad7708_writeReg(ad7708_dev* dev, SelectedReg reg, uint8_t value);
+
+/*!
+ * @brief Shadow copy of a configuration register
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] reg - Register address
+ * @return Pointer to the shadow byte, NULL if the register is not cached
+ */
+static uint8_t* shadowOf(ad7708_dev* dev, SelectedReg reg);
+
+/*!
+ * @brief Check whether a write can be served by the shadow cache
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] reg - Register address
+ * @param[in] value - Value about to be written
+ * @return 1: the device already holds value, 0: the write must go out
+ */
+static uint8_t shadowHit(ad7708_dev* dev, SelectedReg reg, uint8_t value);
+
+/*!
+ * @brief Check whether a write starts a conversion or calibration
+ * @param[in] reg - Register address
+ * @param[in] value - Value about to be written
+ * @return 1: the write restarts the modulator and filter even when the register already holds value
+ */
+static uint8_t startsConversion(SelectedReg reg, uint8_t value);
+
+/*!
+ * @brief Record the outcome of a register write in the shadow cache
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] reg - Register address
+ * @param[in] value - Written value
+ * @param[in] status - Result of the SPI transfer
+ * @return void
+ */
+static void shadowCommit(ad7708_dev* dev, SelectedReg reg, uint8_t value, StatusTypeDef status);
+
+/*!
+ * @brief Record an OFFSET_REG/GAIN_REG value of the selected channel for ad7708_recover
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] reg - OFFSET_REG or GAIN_REG, anything else is ignored
+ * @param[in] value - Register value
+ * @return void
+ */
+static void calCommit(ad7708_dev* dev, SelectedReg reg, uint16_t value);
+
+/*!
+ * @brief Wait for the AD7708 to be idle mode
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] timeout_ms - Timeout in ms
+ * @return 0: case of success, error code otherwise.
+ */
+static StatusTypeDef ad7708_waitForIdle(ad7708_dev* dev, uint16_t timeout_ms);
 
 /****************** User Function Definitions *******************************/
 
+/*!
+ * @brief Check that the serial interface is in step, reading ID and status in one frame
+ */
+StatusTypeDef ad7708_checkLink(ad7708_dev* dev)
+{
+    ad7708_op ops[2] = { { ID_REG, AD7708_Read, 0 }, { STATUS_REG, AD7708_Read, 0 } };
+
+    if (ad7708_batch(dev, ops, 2) != AD7708_OK) { return AD7708_ERROR; }
+    if ((ops[0].value >> 4) != AD7708_ID || (ops[1].value & AD7708_STATUS_ZERO_MASK)) { return AD7708_ERROR; }
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Reset the serial interface and replay the driver's register copies
+ */
+StatusTypeDef ad7708_recover(ad7708_dev* dev)
+{
+    static const SelectedReg config[] = { FILTER_REG, IO_CONTROL_REG, CONTROL_REG };
+    uint8_t tx[AD7708_RECOVER_MAX_BYTES];
+    uint8_t rx[AD7708_RECOVER_MAX_BYTES];
+    uint16_t len = 0;
+    StatusTypeDef status;
+    ModeReg idle = dev->modeReg;
+    ModeReg mode = dev->modeReg;
+
+    // 32 ones put the comm state machine back to waiting for a comm write
+    for (len = 0; len < 4; len++) { tx[len] = 0xFFU; }
+    setCS(dev, 0);
+    status = spiTransfer(dev, tx, rx, len);
+    setCS(dev, 1);
+    if (status != AD7708_OK) { return status; }
+
+    // Calibration registers are only written in idle, then banked per channel through the control register
+    len = 0;
+    idle.merged.mode = AD7708_Idle;
+    tx[len++] = MODE_REG;
+    tx[len++] = idle.byte;
+    for (uint8_t ch = 0; ch < 16; ch++)
+    {
+        uint8_t offsetKnown = (dev->calKnown >> ch) & 0x01U;
+        uint8_t gainKnown = (dev->calKnown >> (16U + ch)) & 0x01U;
+
+        if (!offsetKnown && !gainKnown) { continue; }
+        tx[len++] = CONTROL_REG;
+        tx[len++] = (uint8_t)(ch << 4 | (dev->controlReg.byte & 0x0FU));
+        if (offsetKnown)
+        {
+            tx[len++] = OFFSET_REG;
+            tx[len++] = (uint8_t)(dev->calOffset[ch] >> 8);
+            tx[len++] = (uint8_t)dev->calOffset[ch];
+        }
+        if (gainKnown)
+        {
+            tx[len++] = GAIN_REG;
+            tx[len++] = (uint8_t)(dev->calGain[ch] >> 8);
+            tx[len++] = (uint8_t)dev->calGain[ch];
+        }
+    }
+    for (uint8_t i = 0; i < sizeof(config) / sizeof(config[0]); i++)
+    {
+        if (!((dev->regKnown | dev->regDirty) & (1U << config[i]))) { continue; } // Never written, the power-on value stands
+        tx[len++] = config[i];
+        tx[len++] = *shadowOf(dev, config[i]);
+    }
+
+    // A single conversion or calibration in flight cannot be resumed
+    if (mode.merged.mode != AD7708_PowerDown && mode.merged.mode != AD7708_ContinuousConversion) { mode.merged.mode = AD7708_Idle; }
+    tx[len++] = MODE_REG;
+    tx[len++] = mode.byte;
+
+    setCS(dev, 0);
+    status = spiTransfer(dev, tx, rx, len);
+    setCS(dev, 1);
+
+    if (status == AD7708_OK)
+    {
+        dev->modeReg = mode;
+        dev->regKnown |= (uint16_t)(1U << MODE_REG);
+        for (uint8_t i = 0; i < sizeof(config) / sizeof(config[0]); i++)
+        {
+            if ((dev->regKnown | dev->regDirty) & (1U << config[i])) { dev->regKnown |= (uint16_t)(1U << config[i]); }
+        }
+        dev->regDirty = 0;
+        status = ad7708_checkLink(dev);
+    }
+    if (status == AD7708_OK) { dev->recoveries++; }
+    AD7708_INSTR_TRACE(dev, AD7708_TRACE_RECOVER, status);
+
+    return status;
+}
+
 /*!
  * @brief Are you there AD7708?
  */
@@ -58,22 +228,45 @@ uint8_t ad7708_areYouThere(ad7708_dev* dev) {
 
     status = ad7708_readReg(dev, ID_REG, &id, 1);
 
-    if ((id >> 4) == AD7708_ID) { return 0; }
+    if (status == AD7708_OK && (id >> 4) == AD7708_ID) { return 0; }
     else { return 1; }
 }
 
+/*!
+ * @brief Transport us tick shared by the acquisition modules
+ */
+uint32_t ad7708_nowUs(const ad7708_dev* dev)
+{
+    if (dev->transport->getTickUs != NULL) { return dev->transport->getTickUs(dev->intf); }
+
+    return dev->transport->getTick(dev->intf) * 1000U;
+}
 
-StatusTypeDef ad7780_init(ad7708_dev* dev)
+
+/*!
+ * @brief Initialize the AD7708 with the default configuration
+ */
+StatusTypeDef ad7708_init(ad7708_dev* dev)
 {
     StatusTypeDef status = AD7708_OK;
     dev->id = AD7708_ID;
-    dev->intf = AD7708_INTF;
-    dev->delay_ms = HAL_Delay; // delayOS if used in freeRTOS
 
-    status = ioConfig(dev, AD7708_IOPIN_Input, AD7708_IOPIN_Output);
-    status = sfRateConfig(dev, AD7708_SF_Rate);
-    status = channelConfig(dev, AD7708_Channel_2, AD7708_Range_20mV, AD7708_Unipolar);
-    status = modeConfig(dev, AD7708_SingleConversion);
+    if (dev->transport == NULL) { return AD7708_ERROR; } // Attach a transport (HAL, simulator) first
+
+    status |= ad7708_ioConfig(dev, AD7708_IOPIN_Input, AD7708_IOPIN_Output);
+    status |= ad7708_sfRateConfig(dev, AD7708_SF_Rate);
+    status |= ad7708_channelConfig(dev, AD7708_Channel_2, AD7708_Range_20mV, AD7708_Unipolar);
+    status |= ad7708_modeConfig(dev, AD7708_SingleConversion, AD7708_CHCON, AD7708_REFSEL, AD7708_CHOP, AD7708_NEGBUF, AD7708_OSCPD);
+
+    return status ? AD7708_ERROR : AD7708_OK;
+}
+
+/*!
+ * @brief Former name of ad7708_init, kept for existing callers
+ */
+StatusTypeDef ad7780_init(ad7708_dev* dev)
+{
+    return ad7708_init(dev);
 }
 
 /*!
@@ -82,41 +275,44 @@ StatusTypeDef ad7780_init(ad7708_dev* dev)
 StatusTypeDef ad7708_modeConfig(ad7708_dev* dev, AD7708_Mode mode, uint8_t chcon, uint8_t refsel, uint8_t chop, uint8_t negbuf, uint8_t oscpd)
 {
     StatusTypeDef status = AD7708_OK;
+    ModeReg reg;
 
-    dev->modeReg.merged.mode = mode;
-    dev->modeReg.bits.chcon = chcon;
-    dev->modeReg.bits.refsel = refsel;
-    dev->modeReg.bits.chop = chop;
-    dev->modeReg.bits.negbuf = negbuf;
-    dev->modeReg.bits.oscpd = oscpd;
+    reg.merged.mode = mode;
+    reg.bits.chcon = chcon;
+    reg.bits.refsel = refsel;
+    reg.bits.chop = chop;
+    reg.bits.negbuf = negbuf;
+    reg.bits.oscpd = oscpd;
 
-    status = setNextOperation(dev, CONTROL_REG, AD7708_Write, 1);
-
-    setCS(0);
-    status = spiTransmit(dev, &dev->controlReg.byte, 1);
-    setCS(1);
+    status = ad7708_writeReg(dev, MODE_REG, reg.byte);
 
     return status;
 }
 
 /*!
- * @brief Configure the AD7708 channel, range and polarity
+ * @brief Change the operating mode, keeping the configuration bits of the mode register
  */
-StatusTypeDef ad7708_channelConfig(ad7708_dev* dev, AD7708_Channel channel, AD7708_Range range, AD7708_Polarity polarity)
+StatusTypeDef ad7708_setMode(ad7708_dev* dev, AD7708_Mode mode)
 {
-    StatusTypeDef status = AD7708_OK;
+    ModeReg reg = dev->modeReg;
 
-    dev->controlReg.merged.channelConfig = channel;
-    dev->controlReg.merged.range = range;
-    dev->controlReg.bits.ub = polarity;
+    reg.merged.mode = mode;
 
-    status = setNextOperation(dev, CONTROL_REG, AD7708_Write, 1);
+    return ad7708_writeReg(dev, MODE_REG, reg.byte);
+}
 
-    setCS(0);
-    status = spiTransmit(dev, &dev->controlReg.byte, 1);
-    setCS(1);
+/*!
+ * @brief Configure the AD7708 channel, range and polarity
+ */
+StatusTypeDef ad7708_channelConfig(ad7708_dev* dev, AD7708_Channel channel, AD7708_Range range, AD7708_Polarity polarity)
+{
+    ControlReg reg;
 
-    return status;
+    reg.merged.channelConfig = channel;
+    reg.merged.range = range;
+    reg.bits.ub = polarity;
+
+    return ad7708_writeReg(dev, CONTROL_REG, reg.byte);
 }
 
 /*!
@@ -124,38 +320,55 @@ StatusTypeDef ad7708_channelConfig(ad7708_dev* dev, AD7708_Channel channel, AD77
  */
 StatusTypeDef ad7708_sfRateConfig(ad7708_dev* dev, uint8_t sfRate)
 {
-    StatusTypeDef status = AD7708_OK;
-
-    dev->filterReg.byte = sfRate;
+    return ad7708_writeReg(dev, FILTER_REG, sfRate);
+}
 
-    status = setNextOperation(dev, FILTER_REG, AD7708_Write, 1);
+/*!
+ * @brief Configure the AD7708 IO pins
+ */
+StatusTypeDef ad7708_ioConfig(ad7708_dev* dev, uint8_t pin1State, uint8_t pin2State)
+{
+    IOControlReg reg = dev->ioControlReg;
 
-    setCS(0);
-    status = spiTransmit(dev, &dev->filterReg.byte, 1);
-    setCS(1);
+    reg.bits.p1dir = pin1State;
+    reg.bits.p2dir = pin2State;
+    reg.merged.zeros1 = 0;      // Must be written as 0
+    reg.merged.zeros2 = 0;
 
-    return status;
+    return ad7708_writeReg(dev, IO_CONTROL_REG, reg.byte);
 }
 
 /*!
- * @brief Configure the AD7708 IO pins
+ * @brief Drive the IO pins configured as outputs
  */
-StatusTypeDef ad7708_ioConfig(ad7708_dev* dev, uint8_t pin1State, uint8_t pin2State)
+StatusTypeDef ad7708_ioWrite(ad7708_dev* dev, uint8_t pin1Level, uint8_t pin2Level)
 {
-    StatusTypeDef status = AD7708_OK;
+    IOControlReg reg = dev->ioControlReg;
 
-    dev->ioControlReg.bits.p1dir = pin1State;
-    dev->ioControlReg.bits.p2dir = pin2State; // TODO: Define io read and write functions
-    dev->ioControlReg.merged.zeros1 = 0;      // TODO: These bits are default 0, but should be set to 0 anyway?????
-    dev->ioControlReg.merged.zeros2 = 0;
+    reg.bits.p1dat = pin1Level ? 1 : 0;
+    reg.bits.p2dat = pin2Level ? 1 : 0;
+    reg.merged.zeros1 = 0;
+    reg.merged.zeros2 = 0;
 
-    status = setNextOperation(dev, IO_CONTROL_REG, AD7708_Write, 1);
+    return ad7708_writeReg(dev, IO_CONTROL_REG, reg.byte);
+}
 
-    setCS(0);
-    status = spiTransmit(dev, &dev->ioControlReg.byte, 1); // 1 byte ???
-    setCS(1);
+/*!
+ * @brief Read the level of the IO pins
+ */
+StatusTypeDef ad7708_ioRead(ad7708_dev* dev, uint8_t* pin1Level, uint8_t* pin2Level)
+{
+    IOControlReg reg;
+    StatusTypeDef status;
 
-    return status;
+    // Input pins read back their external level, keep that out of the shadow copy of what was written
+    status = ad7708_readReg(dev, IO_CONTROL_REG, &reg.byte, 1);
+    if (status != AD7708_OK) { return status; }
+
+    *pin1Level = reg.bits.p1dat;
+    *pin2Level = reg.bits.p2dat;
+
+    return AD7708_OK;
 }
 
 /*!
@@ -163,31 +376,48 @@ StatusTypeDef ad7708_ioConfig(ad7708_dev* dev, uint8_t pin1State, uint8_t pin2St
  */
 StatusTypeDef ad7708_calibrate(ad7708_dev* dev, AD7708_Channel channel)
 {
-    StatusTypeDef status = AD7708_OK;
-    status = ad7708_channelConfig(dev, channel, AD7708_Range_20mV, AD7708_Unipolar);
-    status = ad7708_modeConfig(dev, AD7708_InternalZeroCalibration); // TODO: Sytem or Internal calibration??
+    return ad7708_calibrateRange(dev, channel, AD7708_Range_20mV, AD7708_Unipolar);
+}
 
-    if (ad7708_waitForIdle(dev, 200) == AD7708_OK)
-    {
-        status = ad7708_modeConfig(dev, AD7708_InternalFullCalibration);
-        if (ad7708_waitForIdle(dev, 200) == AD7708_OK) { return AD7708_OK; }
-        else { return AD7708_TIMEOUT; }
+/*!
+ * @brief Calibrate the ad7708 selected channel in a given range and polarity
+ */
+StatusTypeDef ad7708_calibrateRange(ad7708_dev* dev, AD7708_Channel channel, AD7708_Range range, AD7708_Polarity polarity)
+{
+    StatusTypeDef status;
+    uint16_t offset;
+    uint16_t gain;
+    AD7708_INSTR_START(dev, start);
 
-    }
-    else
+    status = ad7708_channelConfig(dev, channel, range, polarity);
+    if (status != AD7708_OK) { return status; }
+
+    // Each step only runs once the previous one reached the part and finished
+    AD7708_INSTR_TRACE(dev, AD7708_TRACE_CAL_START, AD7708_InternalZeroCalibration);
+    status = ad7708_setMode(dev, AD7708_InternalZeroCalibration);
+    if (status == AD7708_OK) { status = ad7708_waitForIdle(dev, 200); }
+
+    if (status == AD7708_OK)
     {
-        return AD7708_TIMEOUT;
+        AD7708_INSTR_TRACE(dev, AD7708_TRACE_CAL_START, AD7708_InternalFullCalibration);
+        status = ad7708_setMode(dev, AD7708_InternalFullCalibration);
+        if (status == AD7708_OK) { status = ad7708_waitForIdle(dev, 200); }
     }
 
-    return status;
+    AD7708_INSTR_LATENCY(dev, calibration, start);
+    AD7708_INSTR_TRACE(dev, AD7708_TRACE_CAL_DONE, status);
+    if (status != AD7708_OK) { return status; }
+
+    // Read the new pair back so ad7708_recover can restore it
+    return ad7708_readCalibration(dev, &offset, &gain);
 }
 
 /*!
 * @brief AD7708 start continuous conversion mode
 */
 StatusTypeDef ad7708_startContinuousConversion(ad7708_dev* dev) {
-    uint8_t status;
-    status = ad7708_modeConfig(dev, AD7708_ContinuousConversion, AD7708_CHCON, AD7708_REFSEL, AD7708_CHOP, AD7708_NEGBUF, AD7708_OSCPD);
+    StatusTypeDef status;
+    status = ad7708_setMode(dev, AD7708_ContinuousConversion);
     //status = ad7708_channelConfig(dev, channel, AD7708_Range_20mV, AD7708_Unipolar); --->> channel config should be done before mode config ??
 
     return status;
@@ -196,68 +426,285 @@ StatusTypeDef ad7708_startContinuousConversion(ad7708_dev* dev) {
 /*!
 * @brief Read 16 bit data from the AD7708 data register
 */
-uint16_t ad7708_readData(ad7708_dev* dev, uint16_t* data) {
-    uint8_t status;
-    status = setNextOperation(dev, DATA_REG, AD7708_Read, 1);
+StatusTypeDef ad7708_readData(ad7708_dev* dev, uint16_t* data) {
+    StatusTypeDef status;
+    uint8_t raw[2];
+    AD7708_INSTR_START(dev, start);
+
+    status = ad7708_access(dev, DATA_REG, AD7708_Read, raw, 2);
 
-    setCS(0);
-    status = spiRecieve(dev, data, 2);
-    setCS(1);
+    *data = (uint16_t)((raw[0] << 8) | raw[1]); // MSB first on the wire
 
-    return data;
+    AD7708_INSTR_LATENCY(dev, dataRead, start);
+    AD7708_INSTR_CODE(dev, *data);
+    AD7708_INSTR_TRACE(dev, AD7708_TRACE_DATA_READ, *data);
+    if (status == AD7708_OK) { feedSample(dev, *data, 0); }
+
+    return status;
 }
-/****************** Static Function Definitions *******************************/
 
 /*!
- * @brief Set the next operation to be performed by the AD7708
+ * @brief Read the offset and gain calibration registers of the selected channel
  */
-static StatusTypeDef setNextOperation(ad7708_dev* dev, SelectedReg reg, uint8_t rw, uint16_t len)
+StatusTypeDef ad7708_readCalibration(ad7708_dev* dev, uint16_t* offset, uint16_t* gain)
 {
     StatusTypeDef status;
-    dev->commReg.bits.WEN = 0;
-    dev->commReg.bits.RW = rw;
-    dev->commReg.merged.zeros = 0; // must be 0 !!!!!!!!
-    dev->commReg.merged.addr = reg;
+    ad7708_op ops[2] = { { OFFSET_REG, AD7708_Read, 0 }, { GAIN_REG, AD7708_Read, 0 } };
 
-    setCS(0);
-    status = spiTransmit(dev, &dev->commReg.byte, len);
-    setCS(1);
-    dev->commReg.bits.WEN = 1;
+    status = ad7708_batch(dev, ops, 2);
+    *offset = ops[0].value;
+    *gain = ops[1].value;
 
     return status;
 }
 
 /*!
- * @brief Set the CS pin to the desired state
+ * @brief Write the offset and gain calibration registers of the selected channel
+ */
+StatusTypeDef ad7708_writeCalibration(ad7708_dev* dev, uint16_t offset, uint16_t gain)
+{
+    ad7708_op ops[2] = { { OFFSET_REG, AD7708_Write, offset }, { GAIN_REG, AD7708_Write, gain } };
+
+    return ad7708_batch(dev, ops, 2);
+}
+
+/*!
+ * @brief Read the status register
+ */
+StatusTypeDef ad7708_readStatus(ad7708_dev* dev, statusReg* status)
+{
+    StatusTypeDef result = ad7708_access(dev, STATUS_REG, AD7708_Read, &status->byte, 1);
+
+    if (result == AD7708_OK && (status->byte & AD7708_STATUS_ZERO_MASK)) { return AD7708_ERROR; }
+    if (result == AD7708_OK && status->bits.err)
+    {
+        AD7708_INSTR_ADD(dev, errFlags, 1);
+        AD7708_INSTR_TRACE(dev, AD7708_TRACE_ERR, status->byte);
+    }
+
+    return result;
+}
+
+/*!
+ * @brief Read the status register and, if RDY is set, the data register in the same CS-asserted frame
  */
-static void setCS(uint8_t state)
+StatusTypeDef ad7708_readStatusData(ad7708_dev* dev, statusReg* status, uint16_t* data)
 {
-    HAL_GPIO_WritePin(AD7708_CS_GPIO_Port, AD7708_CS_Pin, state);
+    StatusTypeDef result;
+    uint8_t tx[3] = { (uint8_t)(0x40U | STATUS_REG), 0x00U, 0x00U };
+    uint8_t rx[3];
+
+    setCS(dev, 0);
+    result = spiTransfer(dev, tx, rx, 2);
+    status->byte = rx[1];
+    if (result == AD7708_OK && (status->byte & AD7708_STATUS_ZERO_MASK)) { result = AD7708_ERROR; }
+
+    // CS stays asserted, the data read is only clocked when there is something to read
+    if (result == AD7708_OK && status->bits.rdy)
+    {
+        AD7708_INSTR_START(dev, start);
+        tx[0] = (uint8_t)(0x40U | DATA_REG);
+        result = spiTransfer(dev, tx, rx, 3);
+        if (result == AD7708_OK)
+        {
+            *data = (uint16_t)((rx[1] << 8) | rx[2]);
+            AD7708_INSTR_LATENCY(dev, dataRead, start);
+            AD7708_INSTR_CODE(dev, *data);
+            AD7708_INSTR_TRACE(dev, AD7708_TRACE_DATA_READ, *data);
+        }
+    }
+    setCS(dev, 1);
+
+    if (result != AD7708_OK) { return result; }
+    if (status->bits.err)
+    {
+        AD7708_INSTR_ADD(dev, errFlags, 1);
+        AD7708_INSTR_TRACE(dev, AD7708_TRACE_ERR, status->byte);
+    }
+    if (status->bits.rdy) { feedSample(dev, *data, status->bits.err ? AD7708_SAMPLE_CLAMPED : 0); }
+
+    return status->bits.rdy ? AD7708_OK : AD7708_BUSY;
 }
 
 /*!
- * @brief Transmit data to the AD7708
+ * @brief Read a configuration register, from the shadow cache when possible
  */
-static StatusTypeDef spiTransmit(ad7708_dev* dev, uint8_t* data, uint16_t len)
+StatusTypeDef ad7708_readConfig(ad7708_dev* dev, SelectedReg reg, uint8_t* value, uint8_t refresh)
 {
+    StatusTypeDef status;
+    uint8_t* shadow = shadowOf(dev, reg);
+    uint16_t bit = (uint16_t)(1U << reg);
+
+    if (shadow == NULL) { return AD7708_ERROR; }
+
+    // A pending write is what the caller asked the device to hold, get it there before reading
+    if (dev->regDirty & bit)
+    {
+        status = ad7708_writeReg(dev, reg, *shadow);
+        if (status != AD7708_OK) { return status; }
+    }
+
+    if (!refresh && (dev->regKnown & bit) && !(dev->regDirty & bit))
+    {
+        *value = *shadow;
+        dev->readsCached++;
+        return AD7708_OK;
+    }
+
+    status = ad7708_readReg(dev, reg, value, 1);
+    if (status == AD7708_OK)
+    {
+        uint8_t keep = 0;
+
+        if (reg == IO_CONTROL_REG)
+        {
+            // Input pins read back their external level, the shadow keeps what was written
+            IOControlReg io;
+
+            io.byte = *value;
+            if (!io.bits.p1dir) { keep |= 0x01U; }
+            if (!io.bits.p2dir) { keep |= 0x02U; }
+            if (!(dev->regKnown & bit)) { *shadow &= (uint8_t)~keep; }
+        }
+        *shadow = (uint8_t)((*value & ~keep) | (*shadow & keep));
+        dev->regKnown |= bit;
+        dev->regDirty &= (uint16_t)~bit;
+    }
+
+    return status;
+}
+
+/*!
+ * @brief Write every dirty shadow register to the device
+ */
+StatusTypeDef ad7708_flushShadow(ad7708_dev* dev)
+{
+    static const SelectedReg order[] = { IO_CONTROL_REG, FILTER_REG, CONTROL_REG, MODE_REG };
     StatusTypeDef status = AD7708_OK;
 
-    if (HAL_SPI_Transmit(&dev->intf, data, len, AD7708_TIMEOUT) != AD7708_OK)
+    for (uint8_t i = 0; i < sizeof(order) / sizeof(order[0]); i++)
     {
-        status = AD7708_ERROR;
+        if (dev->regDirty & (1U << order[i]))
+        {
+            status |= ad7708_writeReg(dev, order[i], *shadowOf(dev, order[i]));
+        }
+    }
+
+    return status ? AD7708_ERROR : AD7708_OK;
+}
+
+/*!
+ * @brief Forget everything the shadow cache knows about the device
+ */
+void ad7708_invalidateShadow(ad7708_dev* dev)
+{
+    dev->regKnown = 0;
+}
+
+/*!
+ * @brief Run a list of register operations back-to-back in one CS-asserted frame
+ */
+StatusTypeDef ad7708_batch(ad7708_dev* dev, ad7708_op* ops, uint8_t count)
+{
+    StatusTypeDef status;
+    uint8_t tx[AD7708_BATCH_MAX_BYTES];
+    uint8_t rx[AD7708_BATCH_MAX_BYTES];
+    uint8_t offset[AD7708_BATCH_MAX_OPS]; // Frame position of each op's payload, 0: skipped
+    uint8_t shadow[16];                    // Configuration registers as the frame leaves them
+    uint16_t known = dev->regKnown & (uint16_t)~dev->regDirty;
+    uint16_t len = 0;
+    uint8_t skipped = 0;
+
+    if (count > AD7708_BATCH_MAX_OPS) { return AD7708_ERROR; }
+
+    for (uint8_t reg = 0; reg < 16; reg++)
+    {
+        uint8_t* cached = shadowOf(dev, (SelectedReg)reg);
+        shadow[reg] = cached != NULL ? *cached : 0;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint8_t width = regWidth(ops[i].reg);
+        uint16_t bit = (uint16_t)(1U << ops[i].reg);
+        CommReg comm = { 0 };
+
+        offset[i] = 0;
+        if (ops[i].rw == AD7708_Write && shadowOf(dev, ops[i].reg) != NULL)
+        {
+            // Compare against earlier writes of this frame, not just the pre-batch shadow
+            if ((known & bit) && shadow[ops[i].reg] == (uint8_t)ops[i].value && !startsConversion(ops[i].reg, (uint8_t)ops[i].value))
+            {
+                skipped++;
+                continue;
+            }
+            shadow[ops[i].reg] = (uint8_t)ops[i].value;
+            known |= bit;
+
+            // Single conversion and calibrations fall back to idle on their own
+            if (ops[i].reg == MODE_REG && (ops[i].value & 0x07U) != AD7708_PowerDown && (ops[i].value & 0x07U) != AD7708_Idle
+                && (ops[i].value & 0x07U) != AD7708_ContinuousConversion)
+            {
+                known &= (uint16_t)~bit;
+            }
+        }
+        if (len + 1 + width > AD7708_BATCH_MAX_BYTES) { return AD7708_ERROR; }
+
+        comm.bits.RW = ops[i].rw;
+        comm.merged.addr = ops[i].reg;
+        tx[len++] = comm.byte;
+        offset[i] = (uint8_t)len;
+        if (width == 2) { tx[len++] = (ops[i].rw == AD7708_Write) ? (uint8_t)(ops[i].value >> 8) : 0x00U; }
+        tx[len++] = (ops[i].rw == AD7708_Write) ? (uint8_t)ops[i].value : 0x00U;
+    }
+
+    // The frame is accepted from here on, only now do the skipped writes count
+    dev->writesSkipped += skipped;
+    if (len == 0) { return AD7708_OK; }
+
+    setCS(dev, 0);
+    status = spiTransfer(dev, tx, rx, len);
+    setCS(dev, 1);
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (offset[i] == 0) { continue; }
+        if (ops[i].rw == AD7708_Read)
+        {
+            ops[i].value = (regWidth(ops[i].reg) == 2) ? (uint16_t)((rx[offset[i]] << 8) | rx[offset[i] + 1]) : rx[offset[i]];
+            if (status == AD7708_OK) { calCommit(dev, ops[i].reg, ops[i].value); }
+        }
+        else
+        {
+            shadowCommit(dev, ops[i].reg, (uint8_t)ops[i].value, status);
+            if (status == AD7708_OK) { calCommit(dev, ops[i].reg, ops[i].value); }
+            AD7708_INSTR_TRACE(dev, AD7708_TRACE_REG_WRITE, (uint32_t)ops[i].reg << 8 | (ops[i].value & 0xFFU));
+        }
     }
 
     return status;
 }
 
+/****************** Static Function Definitions *******************************/
+
+/*!
+ * @brief Set the CS pin to the desired state
+ */
+static void setCS(ad7708_dev* dev, uint8_t state)
+{
+    if (!state) { AD7708_INSTR_ADD(dev, csToggles, 1); }
+    dev->transport->setCS(dev->intf, &dev->cs, state);
+}
+
 /*!
- * @brief Recieve data from the AD7708
+ * @brief Full-duplex transfer with the AD7708, CS is handled by the caller
  */
-static StatusTypeDef spiRecieve(ad7708_dev* dev, uint16_t* data, uint16_t len) // is there any problem that i pass 8 bit data to 16 bit pointer?
+static StatusTypeDef spiTransfer(ad7708_dev* dev, uint8_t* tx, uint8_t* rx, uint16_t len)
 {
     StatusTypeDef status = AD7708_OK;
 
-    if (HAL_SPI_Receive(&dev->intf, data, len, AD7708_TIMEOUT) != AD7708_OK)
+    AD7708_INSTR_ADD(dev, spiBytes, len);
+    if (dev->transport->transfer(dev->intf, tx, rx, len) != AD7708_OK)
     {
         status = AD7708_ERROR;
     }
@@ -266,40 +713,213 @@ static StatusTypeDef spiRecieve(ad7708_dev* dev, uint16_t* data, uint16_t len) /
 }
 
 /*!
- * @brief Read data from the AD7708 registers
+ * @brief Access a register in a single CS-asserted frame: comm byte + payload
  */
-static StatusTypeDef ad7708_readReg(ad7708_dev* dev, SelectedReg reg, uint16_t* data, uint16_t len)
+static StatusTypeDef ad7708_access(ad7708_dev* dev, SelectedReg reg, uint8_t rw, uint8_t* data, uint16_t len)
 {
-    StatusTypeDef status = AD7708_OK;
+    StatusTypeDef status;
+    uint8_t tx[3];
+    uint8_t rx[3];
+
+    dev->commReg.byte = 0;
+    dev->commReg.bits.RW = rw;
+    dev->commReg.merged.addr = reg;
 
-    status = setNextOperation(dev, reg, AD7708_Read, 1);
+    tx[0] = dev->commReg.byte;
+    for (uint16_t i = 0; i < len; i++)
+    {
+        tx[1 + i] = (rw == AD7708_Write) ? data[i] : 0x00U;
+    }
 
-    setCS(0);
-    status = spiRecieve(dev, data, len);
-    setCS(1);
+    setCS(dev, 0);
+    status = spiTransfer(dev, tx, rx, (uint16_t)(len + 1));
+    setCS(dev, 1);
+
+    if (rw == AD7708_Read)
+    {
+        for (uint16_t i = 0; i < len; i++)
+        {
+            data[i] = rx[1 + i];
+        }
+    }
 
     return status;
 }
 
+/*!
+ * @brief Width of a register in bytes
+ */
+static uint8_t regWidth(SelectedReg reg)
+{
+    return (reg == DATA_REG || reg == OFFSET_REG || reg == GAIN_REG) ? 2 : 1;
+}
+
+/*!
+ * @brief Read data from the AD7708 registers
+ */
+static StatusTypeDef ad7708_readReg(ad7708_dev* dev, SelectedReg reg, uint8_t* data, uint16_t len)
+{
+    return ad7708_access(dev, reg, AD7708_Read, data, len);
+}
+
 /*!
  * @brief Wait for the AD7708 to be idle mode
  */
 static StatusTypeDef ad7708_waitForIdle(ad7708_dev* dev, uint16_t timeout_ms)
 {
-    uint32_t tickstart = HAL_GetTick();
+    uint32_t tickstart = dev->transport->getTick(dev->intf);
 
     while (1)
     {
-        ad7708_readReg(dev, MODE_REG, &dev->modeReg.byte, 1);
+        uint8_t mode;
+        StatusTypeDef status = ad7708_readConfig(dev, MODE_REG, &mode, 1);
+        AD7708_INSTR_ADD(dev, idleSpins, 1);
+
+        // A part that cannot be read will not be seen going idle either
+        if (status != AD7708_OK) { return status; }
 
         if (dev->modeReg.merged.mode == AD7708_Idle)
         {
             return AD7708_OK;
         }
-        if ((HAL_GetTick() - tickstart) >= timeout_ms || (HAL_GetTick() - tickstart) >= AD7708_MAX_TIMEOUT) // OR kısmını eklemek mantıklı mı??
+        uint32_t elapsed = dev->transport->getTick(dev->intf) - tickstart;
+        if (elapsed >= timeout_ms || elapsed >= AD7708_MAX_TIMEOUT) // OR kısmını eklemek mantıklı mı??
         {
+            AD7708_INSTR_ADD(dev, timeouts, 1);
+            AD7708_INSTR_TRACE(dev, AD7708_TRACE_TIMEOUT, timeout_ms);
             return AD7708_TIMEOUT;
         }
     }
 
-}
\ No newline at end of file
+}
+/*!
+ * @brief Write an 8 bit configuration register through the shadow cache
+ */
+static StatusTypeDef ad7708_writeReg(ad7708_dev* dev, SelectedReg reg, uint8_t value)
+{
+    StatusTypeDef status;
+
+    if (shadowHit(dev, reg, value))
+    {
+        dev->writesSkipped++;
+        return AD7708_OK;
+    }
+
+    AD7708_INSTR_START(dev, start);
+    status = ad7708_access(dev, reg, AD7708_Write, &value, 1);
+    shadowCommit(dev, reg, value, status);
+    AD7708_INSTR_LATENCY(dev, regWrite, start);
+    AD7708_INSTR_TRACE(dev, AD7708_TRACE_REG_WRITE, (uint32_t)reg << 8 | value);
+
+    return status;
+}
+
+/*!
+ * @brief Shadow copy of a configuration register
+ */
+static uint8_t* shadowOf(ad7708_dev* dev, SelectedReg reg)
+{
+    switch (reg)
+    {
+    case MODE_REG: return &dev->modeReg.byte;
+    case CONTROL_REG: return &dev->controlReg.byte;
+    case FILTER_REG: return &dev->filterReg.byte;
+    case IO_CONTROL_REG: return &dev->ioControlReg.byte;
+    default: return NULL;
+    }
+}
+
+/*!
+ * @brief Check whether a write can be served by the shadow cache
+ */
+static uint8_t startsConversion(SelectedReg reg, uint8_t value)
+{
+    return reg == MODE_REG && (value & 0x07U) != AD7708_PowerDown && (value & 0x07U) != AD7708_Idle;
+}
+
+static uint8_t shadowHit(ad7708_dev* dev, SelectedReg reg, uint8_t value)
+{
+    uint8_t* shadow = shadowOf(dev, reg);
+    uint16_t bit = (uint16_t)(1U << reg);
+
+    if (startsConversion(reg, value)) { return 0; }
+
+    return shadow != NULL && (dev->regKnown & bit) && !(dev->regDirty & bit) && *shadow == value;
+}
+
+/*!
+ * @brief Record an OFFSET_REG/GAIN_REG value of the selected channel for ad7708_recover
+ */
+static void calCommit(ad7708_dev* dev, SelectedReg reg, uint16_t value)
+{
+    uint8_t ch = dev->controlReg.merged.channelConfig;
+
+    if (reg == OFFSET_REG)
+    {
+        dev->calOffset[ch] = value;
+        dev->calKnown |= 1UL << ch;
+    }
+    else if (reg == GAIN_REG)
+    {
+        dev->calGain[ch] = value;
+        dev->calKnown |= 1UL << (16U + ch);
+    }
+}
+
+/*!
+ * @brief Record the outcome of a register write in the shadow cache
+ */
+static void shadowCommit(ad7708_dev* dev, SelectedReg reg, uint8_t value, StatusTypeDef status)
+{
+    uint8_t* shadow = shadowOf(dev, reg);
+    uint16_t bit = (uint16_t)(1U << reg);
+
+    if (shadow == NULL) { return; }
+
+    *shadow = value;
+    if (status == AD7708_OK)
+    {
+        dev->regKnown |= bit;
+        dev->regDirty &= (uint16_t)~bit;
+    }
+    else
+    {
+        dev->regDirty |= bit; // Device state unknown, force the next write out
+    }
+
+    // A calibration replaces the stored pair of the selected channel until it is read back
+    if (reg == MODE_REG && (dev->modeReg.merged.mode == AD7708_InternalZeroCalibration || dev->modeReg.merged.mode == AD7708_SystemZeroCalibration))
+    {
+        dev->calKnown &= (uint32_t)~(1UL << dev->controlReg.merged.channelConfig);
+    }
+    if (reg == MODE_REG && (dev->modeReg.merged.mode == AD7708_InternalFullCalibration || dev->modeReg.merged.mode == AD7708_SystemFullCalibration))
+    {
+        dev->calKnown &= (uint32_t)~(1UL << (16U + dev->controlReg.merged.channelConfig));
+    }
+
+    // Single conversion and calibrations fall back to idle on their own
+    if (reg == MODE_REG && dev->modeReg.merged.mode != AD7708_PowerDown && dev->modeReg.merged.mode != AD7708_Idle
+        && dev->modeReg.merged.mode != AD7708_ContinuousConversion)
+    {
+        dev->regKnown &= (uint16_t)~bit;
+    }
+}
+
+static void feedSample(ad7708_dev* dev, uint16_t code, uint8_t flags)
+{
+#if AD7708_STATS
+    ad7708_sample sample;
+
+    if (dev->onSample == NULL) { return; }
+
+    // The shadow holds the channel the result was converted on
+    sample.code = code;
+    sample.channel = dev->controlReg.byte >> 4;
+    sample.flags = (uint8_t)((dev->controlReg.byte & 0x0FU) | flags);
+    dev->onSample(dev->onSampleArg, &sample);
+#else
+    (void)dev;
+    (void)code;
+    (void)flags;
+#endif
+}
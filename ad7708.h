@@ -3,9 +3,22 @@
 
 #include "ad7708_defs.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /*!
-*
-*/
+ * @brief Initialize the AD7708 with the default configuration
+ * @param[in] dev - Pointer to the device structure, transport and intf must already be set
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_init(ad7708_dev* dev);
+
+/*!
+ * @brief Former name of ad7708_init, kept for existing callers
+ * @param[in] dev - Pointer to the device structure, transport and intf must already be set
+ * @return 0: case of success, error code otherwise.
+ */
 StatusTypeDef ad7780_init(ad7708_dev* dev);
 
 /*!
@@ -21,6 +34,15 @@ StatusTypeDef ad7780_init(ad7708_dev* dev);
  */
 StatusTypeDef ad7708_modeConfig(ad7708_dev* dev, AD7708_Mode mode, uint8_t chcon, uint8_t refsel, uint8_t chop, uint8_t negbuf, uint8_t oscpd);
 
+/*!
+ * @brief Change the operating mode, keeping the configuration bits of the mode register
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] mode - Desired mode
+ * @return 0: case of success, error code otherwise.
+ * @note chcon/refsel/chop/negbuf/oscpd come from the last ad7708_modeConfig
+ */
+StatusTypeDef ad7708_setMode(ad7708_dev* dev, AD7708_Mode mode);
+
 /*!
  * @brief Configure the AD7708 channel, range and polarity
  * @param[in] dev - Pointer to the device structure
@@ -34,7 +56,7 @@ StatusTypeDef ad7708_channelConfig(ad7708_dev* dev, AD7708_Channel channel, AD77
 /*!
  * @brief Configure the AD7708 SF rate
  * @param[in] dev - Pointer to the device structure
- * @param[in] sfRate - Desired SF rate
+ * @param[in] sfRate - Filter SF word, not a rate in Hz, ad7708_plan_compute derives it from a target rate
  * @return 0: case of success, error code otherwise.
  */
 StatusTypeDef ad7708_sfRateConfig(ad7708_dev* dev, uint8_t sfRate);
@@ -48,6 +70,25 @@ StatusTypeDef ad7708_sfRateConfig(ad7708_dev* dev, uint8_t sfRate);
  */
 StatusTypeDef ad7708_ioConfig(ad7708_dev* dev, uint8_t pin1State, uint8_t pin2State);
 
+/*!
+ * @brief Drive the IO pins configured as outputs
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] pin1Level - Level of P1, ignored by the device while P1 is an input
+ * @param[in] pin2Level - Level of P2, ignored by the device while P2 is an input
+ * @return 0: case of success, error code otherwise.
+ * @note The write is dropped when the shadow cache already holds these levels
+ */
+StatusTypeDef ad7708_ioWrite(ad7708_dev* dev, uint8_t pin1Level, uint8_t pin2Level);
+
+/*!
+ * @brief Read the level of the IO pins
+ * @param[in] dev - Pointer to the device structure
+ * @param[out] pin1Level - External level of P1 as an input, driven level as an output
+ * @param[out] pin2Level - External level of P2 as an input, driven level as an output
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_ioRead(ad7708_dev* dev, uint8_t* pin1Level, uint8_t* pin2Level);
+
 /*!
 * @brief Calibrate the ad7708 selected channel
 * @param[in] dev - Pointer to the device structure
@@ -57,6 +98,17 @@ StatusTypeDef ad7708_ioConfig(ad7708_dev* dev, uint8_t pin1State, uint8_t pin2St
 */
 StatusTypeDef ad7708_calibrate(ad7708_dev* dev, AD7708_Channel channel);
 
+/*!
+* @brief Calibrate the ad7708 selected channel in a given range and polarity
+* @param[in] dev - Pointer to the device structure
+* @param[in] channel - Desired channel
+* @param[in] range - Range the coefficients are meant for
+* @param[in] polarity - Desired polarity
+* @return 0: case of success, error code otherwise.
+* @note The device is left idle with the channel selected, ready for ad7708_calstore_capture
+*/
+StatusTypeDef ad7708_calibrateRange(ad7708_dev* dev, AD7708_Channel channel, AD7708_Range range, AD7708_Polarity polarity);
+
 /*!
 * @brief AD7708 start continuous conversion mode
 * @param[in] dev - Pointer to the device structure
@@ -70,7 +122,104 @@ StatusTypeDef ad7708_startContinuousConversion(ad7708_dev* dev);
 * @param[out] data - Pointer to the data buffer
 * @return 0: case of success, error code otherwise.
 */
-uint16_t ad7708_readData(ad7708_dev* dev, uint16_t* data);
+StatusTypeDef ad7708_readData(ad7708_dev* dev, uint16_t* data);
+
+/*!
+ * @brief Run a list of register operations back-to-back in one CS-asserted frame
+ * @param[in] dev - Pointer to the device structure
+ * @param[in,out] ops - Operations in execution order, read results are stored in value
+ * @param[in] count - Number of operations, at most AD7708_BATCH_MAX_OPS
+ * @return 0: case of success, error code otherwise.
+ * @note Writes already held by the shadow cache are dropped from the frame
+ */
+StatusTypeDef ad7708_batch(ad7708_dev* dev, ad7708_op* ops, uint8_t count);
+
+/*!
+ * @brief Read a configuration register, from the shadow cache when possible
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] reg - MODE_REG, CONTROL_REG, FILTER_REG or IO_CONTROL_REG
+ * @param[out] value - Register value
+ * @param[in] refresh - 1: always read the device and update the cache
+ * @return 0: case of success, error code otherwise.
+ * @note A dirty register is written from the shadow first, so a pending value is never lost
+ * @note The shadow of IO_CONTROL_REG keeps the written data bits of input pins, value holds their levels
+ */
+StatusTypeDef ad7708_readConfig(ad7708_dev* dev, SelectedReg reg, uint8_t* value, uint8_t refresh);
+
+/*!
+ * @brief Write every dirty shadow register to the device
+ * @param[in] dev - Pointer to the device structure
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_flushShadow(ad7708_dev* dev);
+
+/*!
+ * @brief Forget everything the shadow cache knows about the device
+ * @param[in] dev - Pointer to the device structure
+ * @return void
+ * @note Call after a reset or anything else that changes registers behind the driver
+ */
+void ad7708_invalidateShadow(ad7708_dev* dev);
+
+/*!
+ * @brief Read the offset and gain calibration registers of the selected channel
+ * @param[in] dev - Pointer to the device structure
+ * @param[out] offset - OFFSET_REG value
+ * @param[out] gain - GAIN_REG value
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_readCalibration(ad7708_dev* dev, uint16_t* offset, uint16_t* gain);
+
+/*!
+ * @brief Write the offset and gain calibration registers of the selected channel
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] offset - OFFSET_REG value
+ * @param[in] gain - GAIN_REG value
+ * @return 0: case of success, error code otherwise.
+ * @note The device must be in idle or power-down mode
+ */
+StatusTypeDef ad7708_writeCalibration(ad7708_dev* dev, uint16_t offset, uint16_t gain);
+
+/*!
+ * @brief Read the status register
+ * @param[in] dev - Pointer to the device structure
+ * @param[out] status - Status register value (rdy, cal, err, lock)
+ * @return 0: case of success, AD7708_ERROR also when bits that always read 0 are set.
+ */
+StatusTypeDef ad7708_readStatus(ad7708_dev* dev, statusReg* status);
+
+/*!
+ * @brief Read the status register and, if RDY is set, the data register in the same CS-asserted frame
+ * @param[in] dev - Pointer to the device structure
+ * @param[out] status - Status register value
+ * @param[out] data - Conversion result, only written when RDY was set
+ * @return 0: a new result was read, AD7708_BUSY: RDY clear, error code otherwise, also for an impossible status.
+ * @note 2 bytes when nothing is ready, 5 bytes with data, one CS assertion either way
+ */
+StatusTypeDef ad7708_readStatusData(ad7708_dev* dev, statusReg* status, uint16_t* data);
+
+/*!
+ * @brief Check that the serial interface is in step, reading ID and status in one frame
+ * @param[in] dev - Pointer to the device structure
+ * @return 0: in step, AD7708_ERROR: unexpected ID or impossible status, call ad7708_recover
+ */
+StatusTypeDef ad7708_checkLink(ad7708_dev* dev);
+
+/*!
+ * @brief Reset the serial interface and replay the driver's register copies
+ * @param[in] dev - Pointer to the device structure
+ * @return 0: case of success, error code otherwise.
+ * @note Two frames: 32 ones, then mode/offset/gain per known channel/filter/IO/control/mode.
+ *       A single conversion or calibration in flight is lost, the part is left idle in that case.
+ */
+StatusTypeDef ad7708_recover(ad7708_dev* dev);
+
+/*!
+ * @brief Transport us tick shared by the acquisition modules
+ * @param[in] dev - Pointer to the device structure
+ * @return Time in us, wraps; ms tick x 1000 when the transport has no us tick
+ */
+uint32_t ad7708_nowUs(const ad7708_dev* dev);
 
 /*!
 * @brief Are you there AD7708?
@@ -79,4 +228,8 @@ uint16_t ad7708_readData(ad7708_dev* dev, uint16_t* data);
 */
 uint8_t ad7708_areYouThere(ad7708_dev* dev);
 
-#endif
\ No newline at end of file
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,230 @@
+#include "ad7708_bus.h"
+#include "ad7708.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/********************** Static function declarations ************************/
+
+/*!
+ * @brief Bus time base, us tick when the transport has one
+ * @param[in] bus - Pointer to the scheduler state
+ * @return Time in us, wraps
+ */
+static uint32_t busNowUs(const ad7708_bus* bus);
+
+/*!
+ * @brief Start frames for pending devices until the bus is busy or nothing is left
+ * @param[in] bus - Pointer to the scheduler state
+ * @return void
+ */
+static void kick(ad7708_bus* bus);
+
+/*!
+ * @brief Account the frame of the active device and release the bus
+ * @param[in] bus - Pointer to the scheduler state
+ * @return void
+ */
+static void finish(ad7708_bus* bus);
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Reset the scheduler with no devices
+ */
+void ad7708_bus_init(ad7708_bus* bus)
+{
+    memset(bus, 0, sizeof(*bus));
+    bus->active = AD7708_BUS_IDLE;
+}
+
+/*!
+ * @brief Add a device and its scan list
+ */
+StatusTypeDef ad7708_bus_add(ad7708_bus* bus, ad7708_dev* dev, const ad7708_scan_entry* entries, uint8_t count, ad7708_ring* ring)
+{
+    ad7708_bus_slot* slot;
+    StatusTypeDef status;
+
+    if (bus->count >= AD7708_BUS_MAX || dev->transport == NULL) { return AD7708_ERROR; }
+    if (bus->count != 0)
+    {
+        const ad7708_dev* first = bus->slot[0].scan.dev;
+        if (dev->transport != first->transport || dev->intf != first->intf) { return AD7708_ERROR; }
+    }
+
+    slot = &bus->slot[bus->count];
+    memset(slot, 0, sizeof(*slot));
+    status = ad7708_scan_init(&slot->scan, dev, entries, count, ring);
+    if (status != AD7708_OK) { return status; }
+
+    slot->bus = bus;
+    slot->index = bus->count++;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Start every device converting and open the measurement window
+ */
+StatusTypeDef ad7708_bus_start(ad7708_bus* bus)
+{
+    if (bus->count == 0) { return AD7708_ERROR; }
+
+    for (uint8_t i = 0; i < bus->count; i++)
+    {
+        StatusTypeDef status = ad7708_scan_start(&bus->slot[i].scan);
+        if (status != AD7708_OK) { return status; }
+    }
+
+    bus->pending = 0;
+    bus->active = AD7708_BUS_IDLE;
+    bus->busyUs = 0;
+    bus->startUs = busNowUs(bus);
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Stop serving RDY edges, the devices are left converting
+ */
+void ad7708_bus_stop(ad7708_bus* bus)
+{
+    for (uint8_t i = 0; i < bus->count; i++) { ad7708_scan_stop(&bus->slot[i].scan); }
+    bus->pending = 0;
+}
+
+/*!
+ * @brief RDY falling edge of one device, call from its EXTI interrupt
+ */
+void ad7708_bus_onRdy(ad7708_bus_slot* slot)
+{
+    ad7708_bus* bus = slot->bus;
+    uint32_t bit = 1UL << slot->index;
+
+    if (!slot->scan.running) { return; }
+
+    if (bus->pending & bit) { slot->missed++; } // Overwritten before the bus got to it, keep the first edge time
+    else
+    {
+        slot->rdyUs = busNowUs(bus);
+        bus->pending |= bit;
+    }
+
+    kick(bus);
+}
+
+/*!
+ * @brief DMA transfer complete handler, call from the SPI DMA interrupt
+ */
+void ad7708_bus_dmaComplete(ad7708_bus* bus)
+{
+    if (bus->active == AD7708_BUS_IDLE) { return; }
+
+    ad7708_scan_dmaComplete(&bus->slot[bus->active].scan);
+    finish(bus);
+    kick(bus);
+}
+
+/*!
+ * @brief Sample the RDY pins and serve the devices that have data
+ */
+void ad7708_bus_poll(ad7708_bus* bus)
+{
+    for (uint8_t i = 0; i < bus->count; i++)
+    {
+        ad7708_bus_slot* slot = &bus->slot[i];
+        ad7708_dev* dev = slot->scan.dev;
+
+        // RDY stays low until the data register is read, skip devices already queued
+        if (i == bus->active || (bus->pending & (1UL << i))) { continue; }
+        if (dev->transport->readPin(dev->intf, &dev->rdy) == 0) { ad7708_bus_onRdy(slot); }
+    }
+}
+
+/*!
+ * @brief Fraction of the window since ad7708_bus_start() the bus spent in frames
+ */
+uint16_t ad7708_bus_utilization(const ad7708_bus* bus)
+{
+    uint32_t elapsed;
+
+    if (bus->count == 0) { return 0; }
+
+    elapsed = busNowUs(bus) - bus->startUs;
+    if (elapsed == 0) { return 0; }
+    if (bus->busyUs >= elapsed) { return 1000; }
+
+    return (uint16_t)(bus->busyUs * 1000U / elapsed);
+}
+
+/*!
+ * @brief Mean RDY to end of frame latency of one device
+ */
+uint32_t ad7708_bus_latencyAvg(const ad7708_bus* bus, uint8_t index)
+{
+    const ad7708_bus_slot* slot;
+
+    if (index >= bus->count) { return 0; }
+
+    slot = &bus->slot[index];
+    if (slot->frames == 0) { return 0; }
+
+    return (uint32_t)(slot->latencySumUs / slot->frames);
+}
+
+/****************** Static Function Definitions *******************************/
+
+static uint32_t busNowUs(const ad7708_bus* bus)
+{
+    // An empty bus has no clock to read
+    if (bus->count == 0) { return 0; }
+
+    return ad7708_nowUs(bus->slot[0].scan.dev);
+}
+
+static void kick(ad7708_bus* bus)
+{
+    // Completions of inline or instant transfers re-enter here, the outer loop serves the next device
+    if (bus->inKick) { return; }
+    bus->inKick = 1;
+
+    while (bus->active == AD7708_BUS_IDLE && bus->pending != 0)
+    {
+        ad7708_bus_slot* slot;
+        uint8_t index = bus->cursor;
+
+        do
+        {
+            index = (uint8_t)(index + 1 == bus->count ? 0 : index + 1);
+        } while (!(bus->pending & (1UL << index)));
+
+        bus->pending &= ~(1UL << index);
+        bus->cursor = index;
+        bus->active = index;
+        bus->frameStartUs = busNowUs(bus);
+
+        slot = &bus->slot[index];
+        ad7708_scan_onRdyAt(&slot->scan, slot->rdyUs); // Stamp with the edge, not the bus grant
+
+        // Without DMA the scan completed the frame inline, a failed DMA start never began one
+        if (bus->active == index && !slot->scan.dmaBusy) { finish(bus); }
+    }
+
+    bus->inKick = 0;
+}
+
+static void finish(ad7708_bus* bus)
+{
+    ad7708_bus_slot* slot = &bus->slot[bus->active];
+    uint32_t now = busNowUs(bus);
+    uint32_t latency = now - slot->rdyUs;
+
+    bus->busyUs += now - bus->frameStartUs;
+
+    slot->frames++;
+    slot->latencySumUs += latency;
+    if (latency > slot->latencyMaxUs) { slot->latencyMaxUs = latency; }
+
+    bus->active = AD7708_BUS_IDLE;
+}
@@ -0,0 +1,133 @@
+#ifndef __AD7708_BUS_H__
+#define __AD7708_BUS_H__
+
+#include "ad7708_defs.h"
+#include "ad7708_ring.h"
+#include "ad7708_scan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Several AD7708s sharing one SPI bus, each running its own scan list.
+ *
+ * The devices convert in parallel, only their frames share the bus. RDY edges
+ * are queued as a pending bitmask and served round robin, one CS-asserted
+ * frame at a time, so while one device is converting the bus reads and
+ * reprograms the others. Aggregate throughput scales with the device count
+ * until the bus saturates.
+ *
+ * Port glue on STM32, with EXTI and DMA interrupts at the same priority:
+ *   HAL_GPIO_EXTI_Callback(rdy pin of device i) -> ad7708_bus_onRdy(&bus.slot[i])
+ *   HAL_SPI_TxRxCpltCallback(hspi)              -> ad7708_bus_dmaComplete(&bus)
+ * Boards without RDY interrupts call ad7708_bus_poll() instead.
+ */
+
+#define AD7708_BUS_MAX 8
+#define AD7708_BUS_IDLE 0xFFU
+
+struct ad7708_bus;
+
+/*! @name One device on the bus */
+typedef struct
+{
+    struct ad7708_bus* bus;
+    uint8_t index;
+    ad7708_scan scan;              // Frames are issued by the bus, never directly
+    uint32_t rdyUs;                // When the pending RDY edge was seen
+    volatile uint32_t frames;
+    volatile uint32_t missed;      // RDY edges on a device that was still pending, one result lost
+    uint32_t latencyMaxUs;         // RDY edge to end of its frame
+    uint64_t latencySumUs;
+} ad7708_bus_slot;
+
+/*! @name Bus scheduler state */
+typedef struct ad7708_bus
+{
+    ad7708_bus_slot slot[AD7708_BUS_MAX];
+    uint8_t count;
+    volatile uint32_t pending;     // One bit per device with an unread result
+    volatile uint8_t active;       // Device owning the bus, AD7708_BUS_IDLE if none
+    uint8_t cursor;                // Last device served, round robin origin
+    volatile uint8_t inKick;
+    uint32_t startUs;              // Start of the measurement window
+    uint32_t frameStartUs;
+    uint64_t busyUs;               // Accumulated frame time
+} ad7708_bus;
+
+/*!
+ * @brief Reset the scheduler with no devices
+ * @param[in] bus - Pointer to the scheduler state
+ * @return void
+ */
+void ad7708_bus_init(ad7708_bus* bus);
+
+/*!
+ * @brief Add a device and its scan list
+ * @param[in] bus - Pointer to the scheduler state
+ * @param[in] dev - Device with cs/rdy pins set, must use the same transport and intf as the others
+ * @param[in] entries - Ordered scan list, copied
+ * @param[in] count - Number of entries, 1..AD7708_SCAN_MAX
+ * @param[in] ring - Sample ring of this device
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_bus_add(ad7708_bus* bus, ad7708_dev* dev, const ad7708_scan_entry* entries, uint8_t count, ad7708_ring* ring);
+
+/*!
+ * @brief Start every device converting and open the measurement window
+ * @param[in] bus - Pointer to the scheduler state
+ * @return 0: case of success, error code otherwise.
+ * @note Blocking, call before RDY interrupts are enabled
+ */
+StatusTypeDef ad7708_bus_start(ad7708_bus* bus);
+
+/*!
+ * @brief Stop serving RDY edges, the devices are left converting
+ * @param[in] bus - Pointer to the scheduler state
+ * @return void
+ */
+void ad7708_bus_stop(ad7708_bus* bus);
+
+/*!
+ * @brief RDY falling edge of one device, call from its EXTI interrupt
+ * @param[in] slot - Slot of the device
+ * @return void
+ */
+void ad7708_bus_onRdy(ad7708_bus_slot* slot);
+
+/*!
+ * @brief DMA transfer complete handler, call from the SPI DMA interrupt
+ * @param[in] bus - Pointer to the scheduler state
+ * @return void
+ */
+void ad7708_bus_dmaComplete(ad7708_bus* bus);
+
+/*!
+ * @brief Sample the RDY pins and serve the devices that have data
+ * @param[in] bus - Pointer to the scheduler state
+ * @return void
+ * @note Needs transport->readPin, for boards without RDY interrupts
+ */
+void ad7708_bus_poll(ad7708_bus* bus);
+
+/*!
+ * @brief Fraction of the window since ad7708_bus_start() the bus spent in frames
+ * @param[in] bus - Pointer to the scheduler state
+ * @return Utilization in 0.1 %
+ */
+uint16_t ad7708_bus_utilization(const ad7708_bus* bus);
+
+/*!
+ * @brief Mean RDY to end of frame latency of one device
+ * @param[in] bus - Pointer to the scheduler state
+ * @param[in] index - Device index
+ * @return Latency in us, 0 before the first frame
+ */
+uint32_t ad7708_bus_latencyAvg(const ad7708_bus* bus, uint8_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
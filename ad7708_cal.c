@@ -0,0 +1,148 @@
+#include "ad7708_cal.h"
+#include "ad7708.h"
+#include "ad7708_instr.h"
+
+#include <string.h>
+
+/********************** Static function declarations ************************/
+
+/*!
+ * @brief Select the current entry and start a calibration step in one frame
+ * @param[in] cal - Pointer to the sequencer state
+ * @param[in] mode - AD7708_InternalZeroCalibration or AD7708_InternalFullCalibration
+ * @return 0: case of success, error code otherwise.
+ */
+static StatusTypeDef startStep(ad7708_cal* cal, AD7708_Mode mode);
+
+/*!
+ * @brief Stop the sequence and report the result
+ * @param[in] cal - Pointer to the sequencer state
+ * @param[in] status - Final status
+ * @return status
+ */
+static StatusTypeDef finish(ad7708_cal* cal, StatusTypeDef status);
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Start calibrating a list of channels in the background
+ */
+StatusTypeDef ad7708_calibrateAsync(ad7708_cal* cal, ad7708_dev* dev, const ad7708_cal_entry* entries, uint8_t count, ad7708_cal_cb_t onDone, void* arg)
+{
+    StatusTypeDef status;
+
+    if (count == 0 || count > AD7708_CAL_MAX) { return AD7708_ERROR; }
+
+    memset(cal, 0, sizeof(*cal));
+    cal->dev = dev;
+    memcpy(cal->entries, entries, count * sizeof(entries[0]));
+    cal->count = count;
+    cal->pollIntervalMs = AD7708_CAL_POLL_MS;
+    cal->timeoutMs = AD7708_MAX_TIMEOUT;
+    cal->onDone = onDone;
+    cal->cbArg = arg;
+
+    status = startStep(cal, AD7708_InternalZeroCalibration);
+    if (status != AD7708_OK) { finish(cal, status); }
+
+    return status;
+}
+
+/*!
+ * @brief Advance the calibration sequence
+ */
+StatusTypeDef ad7708_cal_poll(ad7708_cal* cal)
+{
+    ad7708_dev* dev = cal->dev;
+    uint32_t now;
+    statusReg status;
+
+    if (cal->state == AD7708_CAL_DONE) { return AD7708_OK; }
+    if (cal->state != AD7708_CAL_ZERO && cal->state != AD7708_CAL_FULL) { return AD7708_ERROR; }
+
+    now = dev->transport->getTick(dev->intf);
+    if (!cal->rdyPending && (now - cal->lastPoll) < cal->pollIntervalMs) { return AD7708_BUSY; }
+
+    cal->rdyPending = 0;
+    cal->lastPoll = now;
+    cal->polls++;
+    if (ad7708_readStatus(dev, &status) != AD7708_OK) { return finish(cal, AD7708_ERROR); }
+
+    if (!status.bits.cal)
+    {
+        AD7708_INSTR_ADD(dev, idleSpins, 1);
+        if ((now - cal->stepStart) >= cal->timeoutMs) { return finish(cal, AD7708_TIMEOUT); }
+        return AD7708_BUSY;
+    }
+
+    AD7708_INSTR_LATENCY(dev, calibration, cal->stepStartUs);
+    if (cal->state == AD7708_CAL_ZERO)
+    {
+        if (startStep(cal, AD7708_InternalFullCalibration) != AD7708_OK) { return finish(cal, AD7708_ERROR); }
+        return AD7708_BUSY;
+    }
+
+    {
+        // Read the new pair back so ad7708_recover can restore it
+        uint16_t offset;
+        uint16_t gain;
+        if (ad7708_readCalibration(dev, &offset, &gain) != AD7708_OK) { return finish(cal, AD7708_ERROR); }
+    }
+    if (++cal->index == cal->count) { return finish(cal, AD7708_OK); }
+    if (startStep(cal, AD7708_InternalZeroCalibration) != AD7708_OK) { return finish(cal, AD7708_ERROR); }
+
+    return AD7708_BUSY;
+}
+
+/*!
+ * @brief RDY falling edge handler, makes the next poll read the status at once
+ */
+void ad7708_cal_onRdy(ad7708_cal* cal)
+{
+    cal->rdyPending = 1;
+}
+
+/****************** Static Function Definitions *******************************/
+
+static StatusTypeDef startStep(ad7708_cal* cal, AD7708_Mode mode)
+{
+    ad7708_dev* dev = cal->dev;
+    const ad7708_cal_entry* entry = &cal->entries[cal->index];
+    ad7708_op ops[2];
+    ControlReg control = { 0 };
+    ModeReg modeReg = dev->modeReg;
+
+    control.merged.channelConfig = entry->channel;
+    control.merged.range = entry->range;
+    control.bits.ub = entry->polarity;
+
+    modeReg.merged.mode = mode;
+
+    ops[0].reg = CONTROL_REG;
+    ops[0].rw = AD7708_Write;
+    ops[0].value = control.byte;
+    ops[1].reg = MODE_REG;
+    ops[1].rw = AD7708_Write;
+    ops[1].value = modeReg.byte;
+
+    cal->state = (mode == AD7708_InternalZeroCalibration) ? AD7708_CAL_ZERO : AD7708_CAL_FULL;
+    cal->rdyPending = 0;
+    cal->stepStart = dev->transport->getTick(dev->intf);
+    cal->lastPoll = cal->stepStart;
+#if AD7708_INSTRUMENT
+    cal->stepStartUs = ad7708_instr_now(dev);
+#endif
+    AD7708_INSTR_TRACE(dev, AD7708_TRACE_CAL_START, mode);
+
+    return ad7708_batch(dev, ops, 2);
+}
+
+static StatusTypeDef finish(ad7708_cal* cal, StatusTypeDef status)
+{
+    cal->state = (status == AD7708_OK) ? AD7708_CAL_DONE : AD7708_CAL_FAILED;
+    if (status == AD7708_TIMEOUT) { AD7708_INSTR_ADD(cal->dev, timeouts, 1); }
+    AD7708_INSTR_TRACE(cal->dev, AD7708_TRACE_CAL_DONE, status);
+    if (cal->onDone) { cal->onDone(cal->cbArg, status); }
+
+    return status;
+}
@@ -0,0 +1,94 @@
+#ifndef __AD7708_CAL_H__
+#define __AD7708_CAL_H__
+
+#include "ad7708_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Non-blocking calibration sequencer.
+ *
+ * ad7708_calibrateAsync() queues internal zero-scale then full-scale
+ * calibration for every entry and returns at once. The application calls
+ * ad7708_cal_poll() from its main loop or a timer task; the bus is only
+ * touched every pollIntervalMs, or right away after ad7708_cal_onRdy()
+ * reported the RDY edge that ends each calibration step.
+ */
+
+#define AD7708_CAL_MAX 16
+#define AD7708_CAL_POLL_MS 5 // Default status poll interval
+
+/*! @name Calibration target */
+typedef struct
+{
+    AD7708_Channel channel;
+    AD7708_Range range;
+    AD7708_Polarity polarity;
+} ad7708_cal_entry;
+
+typedef enum
+{
+    AD7708_CAL_IDLE = 0x00U,
+    AD7708_CAL_ZERO = 0x01U, // Internal zero-scale step running
+    AD7708_CAL_FULL = 0x02U, // Internal full-scale step running
+    AD7708_CAL_DONE = 0x03U,
+    AD7708_CAL_FAILED = 0x04U
+} AD7708_CalState;
+
+/*! @brief Completion callback, status is AD7708_OK or the failing step's error */
+typedef void (*ad7708_cal_cb_t)(void* arg, StatusTypeDef status);
+
+/*! @name Calibration sequencer state */
+typedef struct
+{
+    ad7708_dev* dev;
+    ad7708_cal_entry entries[AD7708_CAL_MAX];
+    uint8_t count;
+    uint8_t index;            // Entry being calibrated
+    AD7708_CalState state;
+    volatile uint8_t rdyPending;
+    uint16_t pollIntervalMs;
+    uint16_t timeoutMs;       // Per step
+    uint32_t stepStart;
+#if AD7708_INSTRUMENT
+    uint32_t stepStartUs;     // For the calibration latency histogram
+#endif
+    uint32_t lastPoll;
+    uint32_t polls;           // Status reads issued
+    ad7708_cal_cb_t onDone;
+    void* cbArg;
+} ad7708_cal;
+
+/*!
+ * @brief Start calibrating a list of channels in the background
+ * @param[in] cal - Pointer to the sequencer state
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] entries - Channels to calibrate, copied
+ * @param[in] count - Number of entries, 1..AD7708_CAL_MAX
+ * @param[in] onDone - Optional completion callback
+ * @param[in] arg - Argument passed to onDone
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_calibrateAsync(ad7708_cal* cal, ad7708_dev* dev, const ad7708_cal_entry* entries, uint8_t count, ad7708_cal_cb_t onDone, void* arg);
+
+/*!
+ * @brief Advance the calibration sequence
+ * @param[in] cal - Pointer to the sequencer state
+ * @return AD7708_BUSY while running, AD7708_OK once every entry is calibrated, error code otherwise.
+ */
+StatusTypeDef ad7708_cal_poll(ad7708_cal* cal);
+
+/*!
+ * @brief RDY falling edge handler, makes the next poll read the status at once
+ * @param[in] cal - Pointer to the sequencer state
+ * @return void
+ */
+void ad7708_cal_onRdy(ad7708_cal* cal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,182 @@
+#include "ad7708_calstore.h"
+#include "ad7708.h"
+#include "ad7708_crc.h"
+
+#include <stddef.h>
+#include <string.h>
+#ifndef AD7708_CALSTORE_NO_FILE
+#include <stdio.h>
+#endif
+
+/********************** Static function declarations ************************/
+
+/*!
+ * @brief CRC of a table, excluding the crc field itself
+ * @param[in] table - Pointer to the table
+ * @return CRC-16
+ */
+static uint16_t tableCrc(const ad7708_calstore* table);
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Initialize an empty table
+ */
+void ad7708_calstore_init(ad7708_calstore* table)
+{
+    memset(table, 0, sizeof(*table));
+    table->magic = AD7708_CALSTORE_MAGIC;
+    table->version = AD7708_CALSTORE_VERSION;
+}
+
+/*!
+ * @brief Read back the coefficients of the selected channel and store them
+ */
+StatusTypeDef ad7708_calstore_capture(ad7708_calstore* table, ad7708_dev* dev, int16_t tempC10, uint32_t stamp)
+{
+    StatusTypeDef status;
+    ad7708_calstore_entry entry;
+    uint16_t i;
+
+    status = ad7708_readCalibration(dev, &entry.offset, &entry.gain);
+    if (status != AD7708_OK) { return status; }
+
+    entry.key = AD7708_CALSTORE_KEY(dev->controlReg.merged.channelConfig, dev->controlReg.merged.range, dev->controlReg.bits.ub,
+        dev->modeReg.bits.chop);
+    entry.tempC10 = tempC10;
+    entry.stamp = stamp;
+
+    for (i = 0; i < table->count; i++)
+    {
+        if (table->entries[i].key == entry.key) { break; }
+    }
+    if (i == AD7708_CALSTORE_MAX) { return AD7708_ERROR; }
+    if (i == table->count) { table->count++; }
+
+    table->entries[i] = entry;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Select a channel and restore its coefficients in one SPI frame
+ */
+StatusTypeDef ad7708_calstore_restore(const ad7708_calstore* table, ad7708_dev* dev, AD7708_Channel channel, AD7708_Range range,
+    AD7708_Polarity polarity, const ad7708_calstore_limits* limits)
+{
+    const ad7708_calstore_entry* entry;
+    ControlReg control = { 0 };
+    ad7708_op ops[3];
+
+    entry = ad7708_calstore_find(table, AD7708_CALSTORE_KEY(channel, range, polarity, dev->modeReg.bits.chop));
+    if (entry == NULL) { return AD7708_ERROR; }
+
+    if (limits != NULL)
+    {
+        int32_t dt = (int32_t)limits->tempC10 - entry->tempC10;
+        if (dt < 0) { dt = -dt; }
+        if (dt > limits->maxTempDelta) { return AD7708_ERROR; }
+        if (limits->maxAge != 0 && (limits->stamp - entry->stamp) > limits->maxAge) { return AD7708_ERROR; }
+    }
+
+    control.merged.channelConfig = channel;
+    control.merged.range = range;
+    control.bits.ub = polarity;
+
+    // The offset/gain pair is banked per channel, select it first
+    ops[0].reg = CONTROL_REG;
+    ops[0].rw = AD7708_Write;
+    ops[0].value = control.byte;
+    ops[1].reg = OFFSET_REG;
+    ops[1].rw = AD7708_Write;
+    ops[1].value = entry->offset;
+    ops[2].reg = GAIN_REG;
+    ops[2].rw = AD7708_Write;
+    ops[2].value = entry->gain;
+
+    return ad7708_batch(dev, ops, 3);
+}
+
+/*!
+ * @brief Look up an entry
+ */
+const ad7708_calstore_entry* ad7708_calstore_find(const ad7708_calstore* table, uint16_t key)
+{
+    for (uint16_t i = 0; i < table->count; i++)
+    {
+        if (table->entries[i].key == key) { return &table->entries[i]; }
+    }
+
+    return NULL;
+}
+
+/*!
+ * @brief Load and validate a table
+ */
+StatusTypeDef ad7708_calstore_load(ad7708_calstore* table, const ad7708_calstore_backend* backend)
+{
+    if (backend->read(backend->ctx, table, sizeof(*table)) == AD7708_OK && table->magic == AD7708_CALSTORE_MAGIC
+        && table->version == AD7708_CALSTORE_VERSION && table->count <= AD7708_CALSTORE_MAX && table->crc == tableCrc(table))
+    {
+        return AD7708_OK;
+    }
+
+    ad7708_calstore_init(table);
+
+    return AD7708_ERROR;
+}
+
+/*!
+ * @brief Seal and store a table
+ */
+StatusTypeDef ad7708_calstore_save(ad7708_calstore* table, const ad7708_calstore_backend* backend)
+{
+    table->crc = tableCrc(table);
+    table->reserved = 0;
+
+    return backend->write(backend->ctx, table, sizeof(*table));
+}
+
+/****************** Static Function Definitions *******************************/
+
+static uint16_t tableCrc(const ad7708_calstore* table)
+{
+    return ad7708_crc16(AD7708_CRC16_INIT, table, offsetof(ad7708_calstore, crc));
+}
+
+#ifndef AD7708_CALSTORE_NO_FILE
+
+static StatusTypeDef fileRead(void* ctx, void* data, uint32_t len)
+{
+    FILE* f = fopen((const char*)ctx, "rb");
+    size_t n;
+
+    if (f == NULL) { return AD7708_ERROR; }
+    n = fread(data, 1, len, f);
+    fclose(f);
+
+    return (n == len) ? AD7708_OK : AD7708_ERROR;
+}
+
+static StatusTypeDef fileWrite(void* ctx, void* data, uint32_t len)
+{
+    FILE* f = fopen((const char*)ctx, "wb");
+    size_t n;
+
+    if (f == NULL) { return AD7708_ERROR; }
+    n = fwrite(data, 1, len, f);
+
+    return (fclose(f) == 0 && n == len) ? AD7708_OK : AD7708_ERROR;
+}
+
+/*!
+ * @brief File backed storage for host builds
+ */
+void ad7708_calstore_fileBackend(ad7708_calstore_backend* backend, const char* path)
+{
+    backend->read = fileRead;
+    backend->write = fileWrite;
+    backend->ctx = (void*)path;
+}
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef __AD7708_CALSTORE_H__
+#define __AD7708_CALSTORE_H__
+
+#include "ad7708_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Persistent table of calibration coefficients.
+ *
+ * After a calibration the OFFSET_REG/GAIN_REG pair of a channel is captured
+ * with the temperature and a caller defined time stamp (RTC seconds, boot
+ * count...). On the next start the pair is written straight back instead of
+ * recalibrating, unless it is missing or stale. The table is a flat block in
+ * native byte order, protected by a CRC, and is persisted through a small
+ * read/write backend (flash sector on target, file on the host).
+ */
+
+#define AD7708_CALSTORE_MAGIC 0x43374441UL // "AD7C"
+#define AD7708_CALSTORE_VERSION 1
+#define AD7708_CALSTORE_MAX 32
+
+/*! @name Key of a calibration entry: everything the coefficients depend on */
+#define AD7708_CALSTORE_KEY(channel, range, polarity, chop) \
+    ((uint16_t)(((chop) & 0x01U) << 8 | ((channel) & 0x0FU) << 4 | ((polarity) & 0x01U) << 3 | ((range) & 0x07U)))
+
+/*! @name One set of coefficients */
+typedef struct
+{
+    uint16_t key;
+    uint16_t offset;  // OFFSET_REG
+    uint16_t gain;    // GAIN_REG
+    int16_t tempC10;  // Die/board temperature at calibration, 0.1 degC
+    uint32_t stamp;   // Caller defined time of calibration
+} ad7708_calstore_entry;
+
+/*! @name Serialized table */
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    ad7708_calstore_entry entries[AD7708_CALSTORE_MAX];
+    uint16_t crc;     // CRC-16 over everything above
+    uint16_t reserved;
+} ad7708_calstore;
+
+/*! @name Staleness limits used on restore */
+typedef struct
+{
+    int16_t tempC10;      // Current temperature
+    uint32_t stamp;       // Current time
+    uint16_t maxTempDelta; // 0.1 degC
+    uint32_t maxAge;       // Same unit as stamp, 0: never expires
+} ad7708_calstore_limits;
+
+typedef StatusTypeDef (*ad7708_store_fptr_t)(void* ctx, void* data, uint32_t len);
+
+/*! @name Storage backend */
+typedef struct
+{
+    ad7708_store_fptr_t read;
+    ad7708_store_fptr_t write;
+    void* ctx;
+} ad7708_calstore_backend;
+
+/*!
+ * @brief Initialize an empty table
+ * @param[in] table - Pointer to the table
+ * @return void
+ */
+void ad7708_calstore_init(ad7708_calstore* table);
+
+/*!
+ * @brief Read back the coefficients of the selected channel and store them
+ * @param[in] table - Pointer to the table
+ * @param[in] dev - Pointer to the device structure, channel already configured and calibrated
+ * @param[in] tempC10 - Current temperature in 0.1 degC
+ * @param[in] stamp - Current time
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_calstore_capture(ad7708_calstore* table, ad7708_dev* dev, int16_t tempC10, uint32_t stamp);
+
+/*!
+ * @brief Select a channel and restore its coefficients in one SPI frame
+ * @param[in] table - Pointer to the table
+ * @param[in] dev - Pointer to the device structure, in idle or power-down mode
+ * @param[in] channel - Desired channel
+ * @param[in] range - Desired range
+ * @param[in] polarity - Desired polarity
+ * @param[in] limits - Staleness limits, NULL accepts any entry
+ * @return 0: case of success, AD7708_ERROR if the entry is missing or stale and the channel needs calibrating.
+ */
+StatusTypeDef ad7708_calstore_restore(const ad7708_calstore* table, ad7708_dev* dev, AD7708_Channel channel, AD7708_Range range,
+    AD7708_Polarity polarity, const ad7708_calstore_limits* limits);
+
+/*!
+ * @brief Look up an entry
+ * @param[in] table - Pointer to the table
+ * @param[in] key - AD7708_CALSTORE_KEY()
+ * @return Pointer to the entry, NULL if absent
+ */
+const ad7708_calstore_entry* ad7708_calstore_find(const ad7708_calstore* table, uint16_t key);
+
+/*!
+ * @brief Load and validate a table
+ * @param[out] table - Pointer to the table, reinitialized empty if the stored copy is invalid
+ * @param[in] backend - Storage backend
+ * @return 0: case of success, AD7708_ERROR if missing, corrupt or from another version.
+ */
+StatusTypeDef ad7708_calstore_load(ad7708_calstore* table, const ad7708_calstore_backend* backend);
+
+/*!
+ * @brief Seal and store a table
+ * @param[in] table - Pointer to the table
+ * @param[in] backend - Storage backend
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_calstore_save(ad7708_calstore* table, const ad7708_calstore_backend* backend);
+
+/*!
+ * @brief File backed storage for host builds
+ * @param[out] backend - Backend to fill in
+ * @param[in] path - File path, must outlive the backend
+ * @return void
+ */
+void ad7708_calstore_fileBackend(ad7708_calstore_backend* backend, const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
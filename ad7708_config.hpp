@@ -0,0 +1,168 @@
+#ifndef __AD7708_CONFIG_HPP__
+#define __AD7708_CONFIG_HPP__
+
+#include <array>
+#include <cstdint>
+
+#include "ad7708.h"
+
+/*
+ * Compile-time device configuration for C++ builds.
+ *
+ * Register bytes and the init frame are computed by the compiler from
+ * template parameters instead of AD7708_CHCON/AD7708_CHOP/... macros, so
+ * devices with different layouts coexist in one image:
+ *
+ *   using Thermo = ad7708::Config<ad7708::Layout::Ch10, 0x45, true>;
+ *   ad7708::Device<Thermo, ad7708::Input::AIN9, AD7708_Range_20mV, AD7708_Bipolar> tc(&ad7708_halTransport, &spi1, cs0, rdy0);
+ *   tc.init(); // one SPI frame, no register assembly at run time
+ *
+ * Inputs a layout cannot route (AIN9 with 8 channels, REFIN with 10) and
+ * invalid SF/chop/reference combinations fail to compile.
+ *
+ * Requires C++11; test/test_config.cpp is built as C++11.
+ */
+
+namespace ad7708
+{
+    /*! @brief CHCON: 8 channels with two references, or 10 channels with REFIN1 only */
+    enum class Layout : uint8_t
+    {
+        Ch8 = 0,
+        Ch10 = 1
+    };
+
+    /*! @brief Physical input pairs, (+) then (-) */
+    enum class Input : uint8_t
+    {
+        AIN1, AIN2, AIN3, AIN4, AIN5, AIN6, AIN7, AIN8, // Against AINCOM
+        AIN1_AIN2, AIN3_AIN4, AIN5_AIN6, AIN7_AIN8,
+        AIN2_AIN2,  // 8 channel layout only, internal short
+        REFIN,      // 8 channel layout only
+        OPEN,       // 8 channel layout only
+        AIN9_AIN10, // 10 channel layout only
+        AIN9,       // 10 channel layout only, against AINCOM
+        AIN10,      // 10 channel layout only, against AINCOM
+        AINCOM
+    };
+
+    constexpr uint8_t kNoChannel = 0xFF;
+
+    /*! @brief Channel bits of the control register for an input, kNoChannel if the layout cannot route it */
+    constexpr uint8_t channelCode(Layout layout, Input input)
+    {
+        // One return statement per function keeps this a valid C++11 constexpr
+        return input == Input::AIN1_AIN2 ? 0x08
+            : input == Input::AIN3_AIN4 ? 0x09
+            : input == Input::AIN5_AIN6 ? 0x0A
+            : input == Input::AIN7_AIN8 ? 0x0B
+            : input == Input::AINCOM ? 0x0D
+            : input == Input::AIN2_AIN2 ? (layout == Layout::Ch8 ? 0x0C : kNoChannel)
+            : input == Input::REFIN ? (layout == Layout::Ch8 ? 0x0E : kNoChannel)
+            : input == Input::OPEN ? (layout == Layout::Ch8 ? 0x0F : kNoChannel)
+            : input == Input::AIN9_AIN10 ? (layout == Layout::Ch10 ? 0x0C : kNoChannel)
+            : input == Input::AIN9 ? (layout == Layout::Ch10 ? 0x0E : kNoChannel)
+            : input == Input::AIN10 ? (layout == Layout::Ch10 ? 0x0F : kNoChannel)
+            : static_cast<uint8_t>(input); // AIN1..AIN8 map 1:1
+    }
+
+    /*!
+     * @brief Static configuration of one device
+     * @tparam L - Channel layout (CHCON)
+     * @tparam SF - Filter register word
+     * @tparam Chop - Chopping enabled
+     * @tparam RefSel - 0: REFIN1, 1: REFIN2
+     * @tparam NegBuf - Buffer AINCOM
+     * @tparam OscPd - Shut the oscillator off in standby
+     * @tparam P1Dir, P2Dir - AD7708_IOPIN_Input / AD7708_IOPIN_Output
+     */
+    template <Layout L, uint8_t SF, bool Chop = false, uint8_t RefSel = 0, bool NegBuf = false, bool OscPd = false,
+        uint8_t P1Dir = AD7708_IOPIN_Input, uint8_t P2Dir = AD7708_IOPIN_Input>
+    struct Config
+    {
+        static_assert(SF >= (Chop ? 0x0D : 0x03), "SF word below the minimum for this chop setting");
+        static_assert(RefSel <= 1, "RefSel is 0 (REFIN1) or 1 (REFIN2)");
+        static_assert(!(L == Layout::Ch10 && RefSel == 1), "REFIN2 shares pins with AIN9/AIN10 in the 10 channel layout");
+        static_assert(P1Dir <= 1 && P2Dir <= 1, "Pin directions are AD7708_IOPIN_Input or AD7708_IOPIN_Output");
+
+        static constexpr Layout layout = L;
+        static constexpr uint8_t filter = SF;
+        static constexpr uint8_t ioControl = static_cast<uint8_t>(P1Dir << 4 | P2Dir << 5);
+
+        /*! @brief Output data rate in mHz: f_MOD / (8 * SF), x3 with chop */
+        static constexpr uint32_t outputRateMilliHz = 32768UL * 1000UL / ((Chop ? 24UL : 8UL) * SF);
+
+        /*! @brief Mode register byte for a mode */
+        static constexpr uint8_t mode(AD7708_Mode m)
+        {
+            return static_cast<uint8_t>(m | OscPd << 3 | static_cast<uint8_t>(L) << 4 | RefSel << 5 | NegBuf << 6 | Chop << 7);
+        }
+
+        /*! @brief Control register byte, rejects inputs the layout cannot route */
+        template <Input In, AD7708_Range R, AD7708_Polarity P>
+        static constexpr uint8_t control()
+        {
+            static_assert(channelCode(L, In) != kNoChannel, "Input not available with this channel layout");
+            return static_cast<uint8_t>(channelCode(L, In) << 4 | P << 3 | R);
+        }
+
+        /*! @brief Init frame: IO, filter, control, mode in that order */
+        template <Input In, AD7708_Range R, AD7708_Polarity P, AD7708_Mode M = AD7708_Idle>
+        static constexpr std::array<ad7708_op, 4> initSequence()
+        {
+            return { { { IO_CONTROL_REG, AD7708_Write, ioControl },
+                { FILTER_REG, AD7708_Write, filter },
+                { CONTROL_REG, AD7708_Write, control<In, R, P>() },
+                { MODE_REG, AD7708_Write, mode(M) } } };
+        }
+    };
+
+    /*!
+     * @brief Device bound to a static configuration
+     * @tparam Cfg - ad7708::Config instance
+     * @tparam In, R, P - Initial input, range and polarity
+     * @tparam M - Mode entered by init()
+     */
+    template <class Cfg, Input In, AD7708_Range R, AD7708_Polarity P, AD7708_Mode M = AD7708_Idle>
+    class Device
+    {
+    public:
+        static constexpr std::array<ad7708_op, 4> kInit = Cfg::template initSequence<In, R, P, M>();
+
+        Device(const ad7708_transport* transport, void* intf, ad7708_pin cs = {}, ad7708_pin rdy = {})
+        {
+            dev_.id = AD7708_ID;
+            dev_.transport = transport;
+            dev_.intf = intf;
+            dev_.cs = cs;
+            dev_.rdy = rdy;
+        }
+
+        /*! @brief Send the precomputed init frame */
+        StatusTypeDef init()
+        {
+            std::array<ad7708_op, 4> ops = kInit; // batch writes read results back, so work on a copy
+            return ad7708_batch(&dev_, ops.data(), static_cast<uint8_t>(ops.size()));
+        }
+
+        /*! @brief Switch input using a compile-time control byte */
+        template <Input To, AD7708_Range ToR, AD7708_Polarity ToP>
+        StatusTypeDef select()
+        {
+            ad7708_op op = { CONTROL_REG, AD7708_Write, Cfg::template control<To, ToR, ToP>() };
+            return ad7708_batch(&dev_, &op, 1);
+        }
+
+        /*! @brief Underlying C device, for the rest of the driver API */
+        ad7708_dev* raw() { return &dev_; }
+
+    private:
+        ad7708_dev dev_ {};
+    };
+
+    // Out-of-class definition, kInit is odr-used by init() and C++11/14 have no inline variables
+    template <class Cfg, Input In, AD7708_Range R, AD7708_Polarity P, AD7708_Mode M>
+    constexpr std::array<ad7708_op, 4> Device<Cfg, In, R, P, M>::kInit;
+}
+
+#endif
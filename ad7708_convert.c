@@ -0,0 +1,245 @@
+#include "ad7708_convert.h"
+
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+/****************** Compile-time scale tables *******************************/
+
+/* Index: flags & 0x0F, i.e. RN2..RN0 plus the unipolar bit */
+#define FS_V(r) (0.020 * (double)(1U << (r)) * (AD7708_VREF_V) / 2.5)
+#define LSB_V(r, u) (FS_V(r) / ((u) ? 65536.0 : 32768.0))
+#define LSB_Q40(r, u) ((int32_t)(LSB_V(r, u) * 1099511627776.0 + 0.5)) // Q24 output with 16 extra fraction bits
+
+#define ROW(m, u) m(0, u), m(1, u), m(2, u), m(3, u), m(4, u), m(5, u), m(6, u), m(7, u)
+#define LSB_F(r, u) ((float)LSB_V(r, u))
+
+static const float lsbVolts[16] = { ROW(LSB_F, 0), ROW(LSB_F, 1) };
+static const int32_t lsbQ40[16] = { ROW(LSB_Q40, 0), ROW(LSB_Q40, 1) };
+
+#define Q_SHIFT 16
+
+typedef void (*voltsKernel)(const ad7708_sample* in, float* out, uint32_t n);
+typedef void (*q24Kernel)(const ad7708_sample* in, int32_t* out, uint32_t n);
+
+/********************** Static function declarations ************************/
+
+static void voltsScalar(const ad7708_sample* in, float* out, uint32_t n);
+static void q24Scalar(const ad7708_sample* in, int32_t* out, uint32_t n);
+#ifdef CONVERT_X86
+static void voltsSse41(const ad7708_sample* in, float* out, uint32_t n);
+static void q24Sse41(const ad7708_sample* in, int32_t* out, uint32_t n);
+static void voltsAvx2(const ad7708_sample* in, float* out, uint32_t n);
+static void q24Avx2(const ad7708_sample* in, int32_t* out, uint32_t n);
+#endif
+
+static AD7708_Kernel activeKernel = AD7708_KERNEL_AUTO;
+static voltsKernel activeVolts = NULL;
+static q24Kernel activeQ24 = NULL;
+
+typedef char sampleIsOneWord[(sizeof(ad7708_sample) == 4) ? 1 : -1]; // SIMD kernels load samples as 32 bit lanes
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Convert samples to volts
+ */
+void ad7708_convertVolts(const ad7708_sample* in, float* out, uint32_t n)
+{
+    if (activeVolts == NULL) { ad7708_convert_setKernel(AD7708_KERNEL_AUTO); }
+    activeVolts(in, out, n);
+}
+
+/*!
+ * @brief Convert samples to Q8.24 fixed-point volts
+ */
+void ad7708_convertQ24(const ad7708_sample* in, int32_t* out, uint32_t n)
+{
+    if (activeQ24 == NULL) { ad7708_convert_setKernel(AD7708_KERNEL_AUTO); }
+    activeQ24(in, out, n);
+}
+
+/*!
+ * @brief Force a conversion kernel
+ */
+StatusTypeDef ad7708_convert_setKernel(AD7708_Kernel kernel)
+{
+#ifdef CONVERT_X86
+    __builtin_cpu_init();
+    if (kernel == AD7708_KERNEL_AUTO)
+    {
+        kernel = __builtin_cpu_supports("avx2") ? AD7708_KERNEL_AVX2
+            : __builtin_cpu_supports("sse4.1") ? AD7708_KERNEL_SSE41 : AD7708_KERNEL_SCALAR;
+    }
+    if ((kernel == AD7708_KERNEL_AVX2 && !__builtin_cpu_supports("avx2")) || (kernel == AD7708_KERNEL_SSE41 && !__builtin_cpu_supports("sse4.1")))
+    {
+        return AD7708_ERROR;
+    }
+#else
+    if (kernel == AD7708_KERNEL_AUTO) { kernel = AD7708_KERNEL_SCALAR; }
+    if (kernel != AD7708_KERNEL_SCALAR) { return AD7708_ERROR; }
+#endif
+
+    switch (kernel)
+    {
+#ifdef CONVERT_X86
+    case AD7708_KERNEL_AVX2:
+        activeVolts = voltsAvx2;
+        activeQ24 = q24Avx2;
+        break;
+    case AD7708_KERNEL_SSE41:
+        activeVolts = voltsSse41;
+        activeQ24 = q24Sse41;
+        break;
+#endif
+    default:
+        activeVolts = voltsScalar;
+        activeQ24 = q24Scalar;
+        break;
+    }
+    activeKernel = kernel;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Kernel currently in use
+ */
+AD7708_Kernel ad7708_convert_kernel(void)
+{
+    if (activeVolts == NULL) { ad7708_convert_setKernel(AD7708_KERNEL_AUTO); }
+    return activeKernel;
+}
+
+/*!
+ * @brief Volts per LSB for a range/polarity nibble
+ */
+float ad7708_convert_lsb(uint8_t flags)
+{
+    return lsbVolts[flags & 0x0FU];
+}
+
+/****************** Static Function Definitions *******************************/
+
+/*
+ * Every kernel computes exactly
+ *   volts = (float)(code - zero) * lsbVolts[idx]
+ *   q24   = ((int64_t)(code - zero) * lsbQ40[idx] + 2^15) >> 16
+ * so one rounding step each and identical results across kernels.
+ */
+
+static void voltsScalar(const ad7708_sample* in, float* out, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint8_t idx = in[i].flags & 0x0FU;
+        out[i] = (float)((int32_t)in[i].code - AD7708_SAMPLE_ZERO_CODE(idx)) * lsbVolts[idx];
+    }
+}
+
+static void q24Scalar(const ad7708_sample* in, int32_t* out, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint8_t idx = in[i].flags & 0x0FU;
+        int64_t acc = (int64_t)((int32_t)in[i].code - AD7708_SAMPLE_ZERO_CODE(idx)) * lsbQ40[idx] + (1 << (Q_SHIFT - 1));
+        out[i] = (int32_t)(acc >> Q_SHIFT);
+    }
+}
+
+#ifdef CONVERT_X86
+
+/* Lane layout of one sample: code in bits 0..15, channel 16..23, flags 24..31 */
+
+__attribute__((target("sse4.1"))) static void voltsSse41(const ad7708_sample* in, float* out, uint32_t n)
+{
+    const __m128i codeMask = _mm_set1_epi32(0xFFFF);
+    const __m128i uniBit = _mm_set1_epi32((int)((uint32_t)AD7708_SAMPLE_UNIPOLAR << 24));
+    const __m128i mid = _mm_set1_epi32(32768);
+    uint32_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)&in[i]);
+        __m128i code = _mm_and_si128(v, codeMask);
+        __m128i zero = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_and_si128(v, uniBit), uniBit), mid);
+        __m128 lsb = _mm_set_ps(lsbVolts[in[i + 3].flags & 0x0FU], lsbVolts[in[i + 2].flags & 0x0FU], lsbVolts[in[i + 1].flags & 0x0FU],
+            lsbVolts[in[i].flags & 0x0FU]);
+        _mm_storeu_ps(&out[i], _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(code, zero)), lsb));
+    }
+    voltsScalar(&in[i], &out[i], n - i);
+}
+
+__attribute__((target("sse4.1"))) static void q24Sse41(const ad7708_sample* in, int32_t* out, uint32_t n)
+{
+    const __m128i codeMask = _mm_set1_epi32(0xFFFF);
+    const __m128i uniBit = _mm_set1_epi32((int)((uint32_t)AD7708_SAMPLE_UNIPOLAR << 24));
+    const __m128i mid = _mm_set1_epi32(32768);
+    const __m128i round = _mm_set1_epi64x(1 << (Q_SHIFT - 1));
+    uint32_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)&in[i]);
+        __m128i code = _mm_and_si128(v, codeMask);
+        __m128i zero = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_and_si128(v, uniBit), uniBit), mid);
+        __m128i diff = _mm_sub_epi32(code, zero);
+        __m128i mul = _mm_set_epi32(lsbQ40[in[i + 3].flags & 0x0FU], lsbQ40[in[i + 2].flags & 0x0FU], lsbQ40[in[i + 1].flags & 0x0FU],
+            lsbQ40[in[i].flags & 0x0FU]);
+        // Lanes 0/2 and 1/3 as 64 bit products; bits 16..47 are the result whatever the shift fills in
+        __m128i even = _mm_srli_epi64(_mm_add_epi64(_mm_mul_epi32(diff, mul), round), Q_SHIFT);
+        __m128i odd = _mm_srli_epi64(_mm_add_epi64(_mm_mul_epi32(_mm_srli_epi64(diff, 32), _mm_srli_epi64(mul, 32)), round), Q_SHIFT);
+        _mm_storeu_si128((__m128i*)&out[i], _mm_blend_epi16(even, _mm_slli_epi64(odd, 32), 0xCC));
+    }
+    q24Scalar(&in[i], &out[i], n - i);
+}
+
+__attribute__((target("avx2"))) static void voltsAvx2(const ad7708_sample* in, float* out, uint32_t n)
+{
+    const __m256i codeMask = _mm256_set1_epi32(0xFFFF);
+    const __m256i mid = _mm256_set1_epi32(32768);
+    const __m256 bipolar = _mm256_loadu_ps(&lsbVolts[0]);
+    const __m256 unipolar = _mm256_loadu_ps(&lsbVolts[8]);
+    uint32_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)&in[i]);
+        __m256i code = _mm256_and_si256(v, codeMask);
+        __m256i range = _mm256_srli_epi32(v, 24);                  // permutevar only looks at the low 3 bits
+        __m256i uni = _mm256_slli_epi32(_mm256_srli_epi32(v, 27), 31); // Unipolar flag moved to the sign bit
+        __m256 lsb = _mm256_blendv_ps(_mm256_permutevar8x32_ps(bipolar, range), _mm256_permutevar8x32_ps(unipolar, range), _mm256_castsi256_ps(uni));
+        __m256i zero = _mm256_andnot_si256(_mm256_srai_epi32(uni, 31), mid);
+        _mm256_storeu_ps(&out[i], _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(code, zero)), lsb));
+    }
+    voltsScalar(&in[i], &out[i], n - i);
+}
+
+__attribute__((target("avx2"))) static void q24Avx2(const ad7708_sample* in, int32_t* out, uint32_t n)
+{
+    const __m256i codeMask = _mm256_set1_epi32(0xFFFF);
+    const __m256i mid = _mm256_set1_epi32(32768);
+    const __m256i bipolar = _mm256_loadu_si256((const __m256i*)&lsbQ40[0]);
+    const __m256i unipolar = _mm256_loadu_si256((const __m256i*)&lsbQ40[8]);
+    const __m256i round = _mm256_set1_epi64x(1 << (Q_SHIFT - 1));
+    uint32_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)&in[i]);
+        __m256i code = _mm256_and_si256(v, codeMask);
+        __m256i range = _mm256_srli_epi32(v, 24);
+        __m256i uniMask = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_srli_epi32(v, 27), 31), 31);
+        __m256i mul = _mm256_blendv_epi8(_mm256_permutevar8x32_epi32(bipolar, range), _mm256_permutevar8x32_epi32(unipolar, range), uniMask);
+        __m256i diff = _mm256_sub_epi32(code, _mm256_andnot_si256(uniMask, mid));
+        __m256i even = _mm256_srli_epi64(_mm256_add_epi64(_mm256_mul_epi32(diff, mul), round), Q_SHIFT);
+        __m256i odd = _mm256_srli_epi64(_mm256_add_epi64(_mm256_mul_epi32(_mm256_srli_epi64(diff, 32), _mm256_srli_epi64(mul, 32)), round), Q_SHIFT);
+        _mm256_storeu_si256((__m256i*)&out[i], _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA));
+    }
+    q24Scalar(&in[i], &out[i], n - i);
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef __AD7708_CONVERT_H__
+#define __AD7708_CONVERT_H__
+
+#include "ad7708_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Batch conversion of tagged samples to engineering units.
+ *
+ * The scale of every sample comes from the range/polarity nibble in
+ * ad7708_sample.flags, looked up in a table built at compile time from
+ * AD7708_VREF_V. SIMD kernels (SSE4.1, AVX2) are selected at run time on x86
+ * and produce bit-identical results to the scalar kernel.
+ */
+
+#ifndef AD7708_VREF_V
+#define AD7708_VREF_V 2.5 // Reference voltage the range table is scaled to
+#endif
+
+#define AD7708_Q24_ONE (1L << 24) // 1.0 V in ad7708_convertQ24 output
+
+typedef enum
+{
+    AD7708_KERNEL_AUTO = 0x00U, // Best kernel the CPU supports
+    AD7708_KERNEL_SCALAR = 0x01U,
+    AD7708_KERNEL_SSE41 = 0x02U,
+    AD7708_KERNEL_AVX2 = 0x03U
+} AD7708_Kernel;
+
+/*!
+ * @brief Convert samples to volts
+ * @param[in] in - Tagged samples
+ * @param[out] out - Volts, one per sample
+ * @param[in] n - Number of samples
+ * @return void
+ */
+void ad7708_convertVolts(const ad7708_sample* in, float* out, uint32_t n);
+
+/*!
+ * @brief Convert samples to Q8.24 fixed-point volts
+ * @param[in] in - Tagged samples
+ * @param[out] out - Volts scaled by AD7708_Q24_ONE, rounded to nearest
+ * @param[in] n - Number of samples
+ * @return void
+ */
+void ad7708_convertQ24(const ad7708_sample* in, int32_t* out, uint32_t n);
+
+/*!
+ * @brief Force a conversion kernel
+ * @param[in] kernel - Kernel to use, AD7708_KERNEL_AUTO picks the best one
+ * @return 0: case of success, AD7708_ERROR if the CPU or build does not support it
+ */
+StatusTypeDef ad7708_convert_setKernel(AD7708_Kernel kernel);
+
+/*!
+ * @brief Kernel currently in use
+ * @return Active kernel, never AD7708_KERNEL_AUTO
+ */
+AD7708_Kernel ad7708_convert_kernel(void);
+
+/*!
+ * @brief Volts per LSB for a range/polarity nibble
+ * @param[in] flags - ad7708_sample.flags
+ * @return LSB size in volts
+ */
+float ad7708_convert_lsb(uint8_t flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,20 @@
+#include "ad7708_crc.h"
+
+/*!
+ * @brief CRC-16/CCITT-FALSE (poly 0x1021), chainable
+ */
+uint16_t ad7708_crc16(uint16_t crc, const void* data, uint32_t len)
+{
+    const uint8_t* p = (const uint8_t*)data;
+
+    while (len--)
+    {
+        crc ^= (uint16_t)(*p++ << 8);
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            crc = (crc & 0x8000U) ? (uint16_t)((crc << 1) ^ 0x1021U) : (uint16_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
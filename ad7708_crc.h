@@ -0,0 +1,25 @@
+#ifndef __AD7708_CRC_H__
+#define __AD7708_CRC_H__
+
+#include "stdint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AD7708_CRC16_INIT 0xFFFFU
+
+/*!
+ * @brief CRC-16/CCITT-FALSE (poly 0x1021), chainable
+ * @param[in] crc - AD7708_CRC16_INIT or the result of the previous block
+ * @param[in] data - Bytes to checksum
+ * @param[in] len - Number of bytes
+ * @return Updated CRC
+ */
+uint16_t ad7708_crc16(uint16_t crc, const void* data, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
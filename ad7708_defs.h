@@ -5,22 +5,21 @@
 
 /****************** Device Specifications *******************************/
 
-/*! @name Device Pin Configuraiton */
-#define AD7708_CS_Pin GPIO_PIN_4
-#define AD7708_CS_GPIO_Port GPIOC
-#define RDY_Pin GPIO_PIN_5 //EXTI Falling Edge
-#define RDY_GPIO_Port GPIOC
-#define AD7708_INTF SPI1 // SPI'i büyük harfle yazmam problem yaratır mı?
-
 /*! @name Device Limits & Configs*/
 #define AD7708_ID  0x05U // Device ID
 #define AD7708_MAX_TIMEOUT 500  // ms TODO: timeout değerini belirle
-#define AD7708_SF_Rate 150 // Hz TODO: sample rate'i belirle
+#define AD7708_SF_Rate 150 // SF word, not Hz: ODR = 32768 / (8 * SF), see ad7708_plan_compute
 #define AD7708_CHCON 1 // Channel configuration !! IMPORTANT !! 0->8 or 1->10
 #define AD7708_REFSEL 0 // 0: REFIN1 active, 1: REFIN2 active
 #define AD7708_NEGBUF 0 // 0: pseudo-differential mod (connect AINCOM to AGND), 1: Not using AINCOM
 #define AD7708_CHOP 0 // 0: chop disable 1:chop enable
 #define AD7708_OSCPD 0 // 0: Ossilator not shut off in stnadby mode, 1: Ossilator shut off in stnadby mode
+#ifndef AD7708_INSTRUMENT
+#define AD7708_INSTRUMENT 1 // 0: compile out counters, latency histograms and trace hooks
+#endif
+#ifndef AD7708_STATS
+#define AD7708_STATS 1 // 0: compile out the per-result hook that feeds ad7708_stats
+#endif
 
 /****************** Device Commands *******************************/
 #define AD7708_Read 0x01U
@@ -30,8 +29,6 @@
 #define AD7708_IOPIN_Input 0x00U
 #define AD7708_IOPIN_Output 0x01U
 
-typedef void (*ad7708_delay_fptr_t)(uint32_t period);
-
 /****************** Device Enums*******************************/
 
 /*Register Selection Table*/
@@ -83,6 +80,37 @@ typedef enum
     AD7708_TIMEOUT = 0x03U
 } StatusTypeDef;
 
+/****************** Transport Layer *******************************/
+
+/*! @name Board pin descriptor, port is the GPIO block on target and an index on the host */
+typedef struct
+{
+    void* port;
+    uint16_t pin;
+} ad7708_pin;
+
+typedef StatusTypeDef (*ad7708_spi_fptr_t)(void* intf, uint8_t* data, uint16_t len);
+typedef void (*ad7708_cs_fptr_t)(void* intf, const ad7708_pin* pin, uint8_t state);
+typedef uint8_t (*ad7708_pin_fptr_t)(void* intf, const ad7708_pin* pin);
+typedef uint32_t (*ad7708_tick_fptr_t)(void* intf);
+typedef void (*ad7708_delay_fptr_t)(void* intf, uint32_t period);
+typedef StatusTypeDef (*ad7708_xfer_fptr_t)(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len);
+typedef StatusTypeDef (*ad7708_dma_fptr_t)(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len);
+
+/*! @name Transport vtable, one instance per bus implementation (HAL, simulator...); intf is shared by every device on the bus */
+typedef struct
+{
+    ad7708_spi_fptr_t transmit;    // Clock out len bytes, CS is handled by the caller
+    ad7708_spi_fptr_t receive;     // Clock in len bytes, CS is handled by the caller
+    ad7708_xfer_fptr_t transfer;   // Full-duplex len bytes, CS is handled by the caller
+    ad7708_cs_fptr_t setCS;        // 0: asserted (low), 1: released (high)
+    ad7708_pin_fptr_t readPin;     // Level of an input pin (RDY)
+    ad7708_tick_fptr_t getTick;    // Free running ms tick
+    ad7708_tick_fptr_t getTickUs;  // Free running us tick, wraps
+    ad7708_delay_fptr_t delay_ms;
+    ad7708_dma_fptr_t transferDMA; // Optional full-duplex DMA transfer, completion is reported by the port
+} ad7708_transport;
+
 /*ADC Input Range Table
  *
  *RN2 RN1 RN0 ADC Input Range (VREF = 2.5 V)
@@ -249,7 +277,7 @@ typedef union
 typedef union
 {
     uint8_t byte;
-    struct bits
+    struct
     {
         uint8_t lock : 1; // PLL Lock Status Bit
         uint8_t none1 : 1;
@@ -259,9 +287,11 @@ typedef union
         uint8_t cal : 1; // Set to indicate completion of calibration
         uint8_t none4 : 1;
         uint8_t rdy : 1; // Set when data is ready to be read
-    };
+    } bits;
 } statusReg;
 
+#define AD7708_STATUS_ZERO_MASK 0x56U // Status bits that always read 0, set ones mean the interface is out of step
+
 typedef union
 {
     uint8_t byte;
@@ -309,7 +339,7 @@ typedef union
 typedef union
 {
     uint8_t byte;
-    struct bits
+    struct
     {
         uint8_t sf0 : 1;
         uint8_t sf1 : 1;
@@ -319,7 +349,7 @@ typedef union
         uint8_t sf5 : 1;
         uint8_t sf6 : 1;
         uint8_t sf7 : 1;
-    };
+    } bits;
 } FilterReg;
 
 typedef union
@@ -347,18 +377,99 @@ typedef union
 } IOControlReg;
 
 
+/*! @name One entry of a batched register access */
+typedef struct
+{
+    SelectedReg reg;
+    uint8_t rw;     // AD7708_Read / AD7708_Write
+    uint16_t value; // Value to write, or the read result
+} ad7708_op;
+
+#define AD7708_BATCH_MAX_OPS 16
+#define AD7708_BATCH_MAX_BYTES 48
+
+/*! @name Channel tagged conversion result */
+typedef struct
+{
+    uint16_t code;
+    uint8_t channel; // Channel configuration bits of the control register, bits 4-5: external mux address
+    uint8_t flags;   // Low nibble: range and polarity bits of the control register, AD7708_SAMPLE_CLAMPED
+} ad7708_sample;
+
+#define AD7708_SAMPLE_RANGE_MASK 0x07U
+#define AD7708_SAMPLE_UNIPOLAR 0x08U
+#define AD7708_SAMPLE_CLAMPED 0x10U // Status ERR was set, the code is pinned to a rail
+#define AD7708_SAMPLE_MUX_SHIFT 4U // Position of the mux address in channel
+#define AD7708_SAMPLE_TAG_MASK (AD7708_SAMPLE_RANGE_MASK | AD7708_SAMPLE_UNIPOLAR) // Flags that set the code scale
+#define AD7708_SAMPLE_ZERO_CODE(flags) (((flags) & AD7708_SAMPLE_UNIPOLAR) ? 0 : 32768) // Code of a 0 V input
+
+/*! @name Per-result hook, see ad7708_stats.h */
+typedef void (*ad7708_sample_fptr_t)(void* arg, const ad7708_sample* sample);
+
+#if AD7708_INSTRUMENT
+
+#define AD7708_LAT_BUCKETS 12 // Power of 2 us buckets: <1, <2, <4 ... >=1024 us
+
+/*! @name Latency distribution of one operation */
+typedef struct
+{
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint32_t sumUs;
+    uint32_t hist[AD7708_LAT_BUCKETS];
+} ad7708_latency;
+
+/*! @name Trace event, see ad7708_instr.h */
+typedef void (*ad7708_trace_fptr_t)(void* arg, uint8_t event, uint32_t timeUs, uint32_t value);
+
+/*! @name Hot path counters, every field is written with a single word store */
+typedef struct
+{
+    uint32_t spiBytes;
+    uint32_t csToggles;   // CS assertions
+    uint32_t idleSpins;   // Mode register polls in waitForIdle
+    uint32_t timeouts;
+    uint32_t errFlags;    // Status reads with ERR set
+    uint32_t clamped;     // Results at 0x0000/0xFFFF, the values ERR clamps to
+    ad7708_latency regWrite;
+    ad7708_latency dataRead;
+    ad7708_latency calibration;
+    ad7708_trace_fptr_t trace;
+    void* traceArg;
+} ad7708_instr;
+
+#endif
+
 /*! @name API device structure */
 typedef struct
 {
     uint8_t id;
-    uint8_t intf;
+    const ad7708_transport* transport; // Bus implementation
+    void* intf;                        // Bus specific context passed to every transport call
+    ad7708_pin cs;                     // Chip select of this device on the bus
+    ad7708_pin rdy;                    // RDY output of this device
     CommReg commReg;
     IOControlReg ioControlReg;
     FilterReg filterReg;
     ControlReg controlReg;
     ModeReg modeReg;
-    ad7708_delay_fptr_t delay_ms;
+    uint16_t regKnown;      // Bit per register address: shadow matches the device
+    uint16_t regDirty;      // Bit per register address: shadow not yet written successfully
+    uint32_t writesSkipped; // Register writes served by the shadow cache
+    uint32_t readsCached;   // Register reads served by the shadow cache
+    uint16_t calOffset[16]; // Last OFFSET_REG value written or read, per channel code
+    uint16_t calGain[16];   // Last GAIN_REG value written or read, per channel code
+    uint32_t calKnown;      // Bits 0..15: calOffset valid, 16..31: calGain valid
+    uint32_t recoveries;    // Successful ad7708_recover() runs
     uint16_t* dataBuffer; //TO-DO uint16 int16??
+#if AD7708_STATS
+    ad7708_sample_fptr_t onSample; // Every result read, called in the acquisition context, NULL: none
+    void* onSampleArg;
+#endif
+#if AD7708_INSTRUMENT
+    ad7708_instr instr;
+#endif
 
 } ad7708_dev;
 
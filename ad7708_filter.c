@@ -0,0 +1,385 @@
+#include "ad7708_filter.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#define FRAC_BITS 8
+
+/********************** Static function declarations ************************/
+
+/*!
+ * @brief Run one CIC stage over a run of samples in place
+ * @param[in] cfg - Stage configuration
+ * @param[in] st - Stage state
+ * @param[in] x - Samples, overwritten with the decimated output
+ * @param[in] tag - Flags of each sample, overwritten with those of each output
+ * @param[in] n - Number of input samples
+ * @return Number of output samples
+ */
+static uint32_t runCic(const ad7708_filter_stage* cfg, ad7708_filter_state* st, int32_t* x, uint8_t* tag, uint32_t n);
+
+/*!
+ * @brief Run one biquad stage over a run of samples in place
+ * @param[in] cfg - Stage configuration
+ * @param[in] st - Stage state
+ * @param[in] x - Samples, overwritten with the output
+ * @param[in] n - Number of samples
+ * @return n
+ */
+static uint32_t runBiquad(const ad7708_filter_stage* cfg, ad7708_filter_state* st, int32_t* x, uint32_t n);
+
+/*!
+ * @brief Run one median stage over a run of samples in place
+ * @param[in] cfg - Stage configuration
+ * @param[in] st - Stage state
+ * @param[in] x - Samples, overwritten with the output
+ * @param[in] tag - Flags of each sample, overwritten with those of each output
+ * @param[in] n - Number of input samples
+ * @return Number of output samples
+ */
+static uint32_t runMedian(const ad7708_filter_stage* cfg, ad7708_filter_state* st, int32_t* x, uint8_t* tag, uint32_t n);
+
+/*!
+ * @brief Filter up to AD7708_FILTER_BLOCK samples
+ * @param[in] f - Pointer to the pipeline
+ * @param[in] in - Samples in acquisition order
+ * @param[in] n - Number of samples
+ * @param[out] out - Filtered samples
+ * @return Number of samples written to out
+ */
+static uint32_t processBlock(ad7708_filter* f, const ad7708_sample* in, uint32_t n, ad7708_sample* out);
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Reset the pipeline with empty chains
+ */
+void ad7708_filter_init(ad7708_filter* f)
+{
+    memset(f, 0, sizeof(*f));
+    memset(f->index, 0xFF, sizeof(f->index));
+}
+
+/*!
+ * @brief Append a stage to the chain of a channel
+ */
+StatusTypeDef ad7708_filter_addStage(ad7708_filter* f, uint8_t channel, const ad7708_filter_stage* stage)
+{
+    ad7708_filter_chain* chain;
+
+    if (channel >= sizeof(f->index) || stage->type == AD7708_FILTER_NONE || stage->decim == 0) { return AD7708_ERROR; }
+
+    if (f->index[channel] == 0xFFU)
+    {
+        if (f->chains >= AD7708_FILTER_MAX_CHAINS) { return AD7708_ERROR; }
+        f->index[channel] = f->chains;
+        f->chain[f->chains].channel = channel;
+        f->chains++;
+    }
+
+    chain = &f->chain[f->index[channel]];
+    if (chain->count >= AD7708_FILTER_MAX_STAGES) { return AD7708_ERROR; }
+
+    chain->stage[chain->count] = *stage;
+    memset(&chain->state[chain->count], 0, sizeof(chain->state[0]));
+    chain->count++;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Clear the state of a channel's chain, keeping its configuration
+ */
+void ad7708_filter_reset(ad7708_filter* f, uint8_t channel)
+{
+    for (uint8_t c = 0; c < f->chains; c++)
+    {
+        if (channel != 0xFFU && channel != f->chain[c].channel) { continue; }
+        memset(f->chain[c].state, 0, sizeof(f->chain[c].state));
+    }
+}
+
+/*!
+ * @brief Fill a CIC decimator stage
+ */
+StatusTypeDef ad7708_filter_cic(ad7708_filter_stage* stage, uint8_t order, uint16_t decim)
+{
+    if (order == 0 || order > AD7708_FILTER_CIC_MAX_ORDER || decim == 0 || decim > AD7708_FILTER_CIC_MAX_DECIM) { return AD7708_ERROR; }
+
+    memset(stage, 0, sizeof(*stage));
+    stage->type = AD7708_FILTER_CIC;
+    stage->order = order;
+    stage->decim = decim;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Fill a biquad stage from Q2.30 coefficients, a0 normalized to 1
+ */
+void ad7708_filter_biquad(ad7708_filter_stage* stage, int32_t b0, int32_t b1, int32_t b2, int32_t a1, int32_t a2)
+{
+    memset(stage, 0, sizeof(*stage));
+    stage->type = AD7708_FILTER_BIQUAD;
+    stage->decim = 1;
+    stage->b[0] = b0;
+    stage->b[1] = b1;
+    stage->b[2] = b2;
+    stage->a[0] = a1;
+    stage->a[1] = a2;
+}
+
+/*!
+ * @brief Fill a biquad notch stage, e.g. for 50/60 Hz mains
+ */
+StatusTypeDef ad7708_filter_notch(ad7708_filter_stage* stage, uint32_t fsMilliHz, uint32_t f0MilliHz, uint16_t qX100)
+{
+    double w0, alpha, a0, c;
+
+    if (fsMilliHz == 0 || f0MilliHz == 0 || f0MilliHz >= fsMilliHz / 2U || qX100 == 0) { return AD7708_ERROR; }
+
+    // RBJ cookbook notch
+    w0 = 2.0 * 3.14159265358979323846 * (double)f0MilliHz / (double)fsMilliHz;
+    c = cos(w0);
+    alpha = sin(w0) / (2.0 * qX100 / 100.0);
+    a0 = 1.0 + alpha;
+
+#define Q30(v) ((int32_t)lround((v) / a0 * (double)AD7708_FILTER_Q30_ONE))
+    ad7708_filter_biquad(stage, Q30(1.0), Q30(-2.0 * c), Q30(1.0), Q30(-2.0 * c), Q30(1.0 - alpha));
+#undef Q30
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Fill a median-of-N stage
+ */
+StatusTypeDef ad7708_filter_median(ad7708_filter_stage* stage, uint8_t n, uint16_t decim)
+{
+    if (n < 3 || n > AD7708_FILTER_MEDIAN_MAX || !(n & 1U) || decim == 0) { return AD7708_ERROR; }
+
+    memset(stage, 0, sizeof(*stage));
+    stage->type = AD7708_FILTER_MEDIAN;
+    stage->order = n;
+    stage->decim = decim;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Filter a block of interleaved samples
+ */
+uint32_t ad7708_filter_process(ad7708_filter* f, const ad7708_sample* in, uint32_t n, ad7708_sample* out)
+{
+    uint32_t produced = 0;
+
+    for (uint32_t done = 0; done < n; done += AD7708_FILTER_BLOCK)
+    {
+        uint32_t len = n - done < AD7708_FILTER_BLOCK ? n - done : AD7708_FILTER_BLOCK;
+        produced += processBlock(f, in + done, len, out + produced);
+    }
+
+    f->samplesIn += n;
+    f->samplesOut += produced;
+
+    return produced;
+}
+
+/*!
+ * @brief Pop up to max samples from a ring and filter them
+ */
+uint32_t ad7708_filter_drain(ad7708_filter* f, ad7708_ring* ring, ad7708_sample* out, uint32_t max)
+{
+    ad7708_sample block[AD7708_FILTER_BLOCK];
+    uint32_t produced = 0;
+
+    while (max != 0)
+    {
+        uint32_t got = ad7708_ring_pop(ring, block, max < AD7708_FILTER_BLOCK ? max : AD7708_FILTER_BLOCK);
+        if (got == 0) { break; }
+
+        produced += ad7708_filter_process(f, block, got, out + produced);
+        max -= got;
+    }
+
+    return produced;
+}
+
+/****************** Static Function Definitions *******************************/
+
+static uint32_t processBlock(ad7708_filter* f, const ad7708_sample* in, uint32_t n, ad7708_sample* out)
+{
+    int32_t buf[AD7708_FILTER_BLOCK];
+    uint8_t tag[AD7708_FILTER_BLOCK]; // Flags of each bucketed sample, then of each output
+    uint8_t src[AD7708_FILTER_BLOCK]; // Input index of each bucketed sample
+    uint8_t bucket[AD7708_FILTER_BLOCK];
+    uint8_t count[AD7708_FILTER_MAX_CHAINS + 1] = { 0 }; // The last bucket holds the samples passed through
+    uint8_t start[AD7708_FILTER_MAX_CHAINS + 1];
+    uint8_t fill[AD7708_FILTER_MAX_CHAINS + 1];
+    uint32_t produced = 0;
+    uint8_t pos = 0;
+
+    // Bucket by chain so every stage loops over one channel's run with its state in registers
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint8_t c = f->index[in[i].channel & 0x3FU];
+        bucket[i] = c == 0xFFU ? AD7708_FILTER_MAX_CHAINS : c;
+        count[bucket[i]]++;
+    }
+    for (uint8_t c = 0; c <= AD7708_FILTER_MAX_CHAINS; c++)
+    {
+        start[c] = pos;
+        fill[c] = pos;
+        pos = (uint8_t)(pos + count[c]);
+    }
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint8_t c = bucket[i];
+        src[fill[c]] = (uint8_t)i;
+        tag[fill[c]] = in[i].flags;
+        buf[fill[c]++] = ((int32_t)in[i].code - AD7708_SAMPLE_ZERO_CODE(in[i].flags)) * (1 << FRAC_BITS);
+    }
+
+    for (uint8_t c = 0; c < f->chains; c++)
+    {
+        ad7708_filter_chain* chain = &f->chain[c];
+        int32_t* x = &buf[start[c]];
+        uint8_t* t = &tag[start[c]];
+        uint32_t len = count[c];
+
+        for (uint8_t s = 0; s < chain->count && len != 0; s++)
+        {
+            switch (chain->stage[s].type)
+            {
+            case AD7708_FILTER_CIC: len = runCic(&chain->stage[s], &chain->state[s], x, t, len); break;
+            case AD7708_FILTER_BIQUAD: len = runBiquad(&chain->stage[s], &chain->state[s], x, len); break;
+            case AD7708_FILTER_MEDIAN: len = runMedian(&chain->stage[s], &chain->state[s], x, t, len); break;
+            default: break;
+            }
+        }
+
+        for (uint32_t i = 0; i < len; i++)
+        {
+            int32_t code = ((x[i] + (1 << (FRAC_BITS - 1))) >> FRAC_BITS) + AD7708_SAMPLE_ZERO_CODE(t[i]);
+            if (code < 0) { code = 0; }
+            if (code > 0xFFFF) { code = 0xFFFF; }
+
+            out[produced].code = (uint16_t)code;
+            out[produced].channel = chain->channel;
+            out[produced].flags = t[i];
+            produced++;
+        }
+    }
+
+    // Channels without a chain, untouched and in acquisition order
+    for (uint32_t i = 0; i < count[AD7708_FILTER_MAX_CHAINS]; i++) { out[produced++] = in[src[start[AD7708_FILTER_MAX_CHAINS] + i]]; }
+
+    return produced;
+}
+
+static uint32_t runCic(const ad7708_filter_stage* cfg, ad7708_filter_state* st, int32_t* x, uint8_t* tag, uint32_t n)
+{
+    uint8_t order = cfg->order;
+    int64_t gain = 1;
+    uint32_t out = 0;
+
+    for (uint8_t k = 0; k < order; k++) { gain *= cfg->decim; }
+
+    // Integrators overflow on long full-scale runs (order 3: ~19000 samples at 2^23). In modulo 2^64 arithmetic the
+    // combs still recover the exact result as long as it fits, |x| * decim^order < 2^63, so only go signed at the end.
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint64_t v = (uint64_t)(int64_t)x[i];
+        int64_t y;
+
+        for (uint8_t k = 0; k < order; k++)
+        {
+            st->cic.integ[k] += v;
+            v = st->cic.integ[k];
+        }
+
+        st->cic.clamped |= tag[i] & AD7708_SAMPLE_CLAMPED;
+        if (++st->cic.phase < cfg->decim) { continue; }
+        st->cic.phase = 0;
+        tag[out] = (uint8_t)(tag[i] | st->cic.clamped);
+        st->cic.clamped = 0;
+
+        // Combs run at the output rate, differential delay 1
+        for (uint8_t k = 0; k < order; k++)
+        {
+            uint64_t prev = st->cic.comb[k];
+            st->cic.comb[k] = v;
+            v -= prev;
+        }
+
+        y = v <= (uint64_t)INT64_MAX ? (int64_t)v : -(int64_t)(~v) - 1;
+        x[out++] = (int32_t)((y + (y < 0 ? -gain / 2 : gain / 2)) / gain);
+    }
+
+    return out;
+}
+
+static uint32_t runBiquad(const ad7708_filter_stage* cfg, ad7708_filter_state* st, int32_t* x, uint32_t n)
+{
+    int64_t b0 = cfg->b[0], b1 = cfg->b[1], b2 = cfg->b[2], a1 = cfg->a[0], a2 = cfg->a[1];
+    int32_t x1 = st->biquad.x1, x2 = st->biquad.x2, y1 = st->biquad.y1, y2 = st->biquad.y2;
+
+    // Direct form I, 64 bit accumulator, no intermediate rounding
+    for (uint32_t i = 0; i < n; i++)
+    {
+        int64_t acc = b0 * x[i] + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        int32_t y = (int32_t)((acc + (1LL << 29)) >> 30);
+
+        x2 = x1;
+        x1 = x[i];
+        y2 = y1;
+        y1 = y;
+        x[i] = y;
+    }
+
+    st->biquad.x1 = x1;
+    st->biquad.x2 = x2;
+    st->biquad.y1 = y1;
+    st->biquad.y2 = y2;
+
+    return n;
+}
+
+static uint32_t runMedian(const ad7708_filter_stage* cfg, ad7708_filter_state* st, int32_t* x, uint8_t* tag, uint32_t n)
+{
+    uint8_t size = cfg->order;
+    uint32_t out = 0;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        int32_t sorted[AD7708_FILTER_MEDIAN_MAX];
+
+        st->median.window[st->median.pos] = x[i];
+        st->median.pos = (uint8_t)(st->median.pos + 1 == size ? 0 : st->median.pos + 1);
+        if (st->median.fill < size) { st->median.fill++; }
+
+        st->median.clamped |= tag[i] & AD7708_SAMPLE_CLAMPED;
+        if (++st->median.phase < cfg->decim) { continue; }
+        st->median.phase = 0;
+        if (st->median.fill < size) { continue; } // No output until the window is primed
+        tag[out] = (uint8_t)(tag[i] | st->median.clamped);
+        st->median.clamped = 0;
+
+        // Insertion sort, the window is at most 9 samples
+        for (uint8_t a = 0; a < size; a++)
+        {
+            int32_t v = st->median.window[a];
+            int8_t b = (int8_t)(a - 1);
+            while (b >= 0 && sorted[b] > v)
+            {
+                sorted[b + 1] = sorted[b];
+                b--;
+            }
+            sorted[b + 1] = v;
+        }
+        x[out++] = sorted[size / 2];
+    }
+
+    return out;
+}
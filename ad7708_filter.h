@@ -0,0 +1,188 @@
+#ifndef __AD7708_FILTER_H__
+#define __AD7708_FILTER_H__
+
+#include "ad7708_defs.h"
+#include "ad7708_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Block based fixed-point filtering of the sample stream.
+ *
+ * Up to AD7708_FILTER_MAX_CHAINS channels, each a channel code with its
+ * external mux address as in ad7708_sample.channel, own a chain of up to
+ * AD7708_FILTER_MAX_STAGES stages: CIC/boxcar decimators, biquad IIR sections
+ * and median-of-N. Chain configuration and state sit together in one
+ * contiguous block per channel. A block of interleaved samples is first
+ * bucketed per chain, then every stage runs over its chain's run of samples
+ * at once.
+ *
+ * Samples are processed as codes relative to zero input with 8 fraction bits
+ * and rounded back to the 16 bit code space on output, so results feed
+ * ad7708_convert and the rings unchanged. Outputs are grouped per chain in
+ * the order chains were configured, in time order per chain, followed by the
+ * samples of channels without a chain, passed through unchanged in
+ * acquisition order. An output carries the range and polarity of the input
+ * that completed it and is flagged clamped if any input since the previous
+ * output was. A chain assumes a fixed range, call ad7708_filter_reset() after
+ * changing it.
+ */
+
+#define AD7708_FILTER_MAX_STAGES 4
+#define AD7708_FILTER_MAX_CHAINS 16
+#define AD7708_FILTER_BLOCK 64       // Samples bucketed per pass, bounds stack use
+#define AD7708_FILTER_CIC_MAX_ORDER 3
+#define AD7708_FILTER_CIC_MAX_DECIM 256
+#define AD7708_FILTER_MEDIAN_MAX 9
+#define AD7708_FILTER_Q30_ONE (1L << 30) // 1.0 in biquad coefficients
+
+typedef enum
+{
+    AD7708_FILTER_NONE = 0x00U,
+    AD7708_FILTER_CIC = 0x01U,    // Order 1 is a decimating boxcar
+    AD7708_FILTER_BIQUAD = 0x02U,
+    AD7708_FILTER_MEDIAN = 0x03U
+} AD7708_FilterType;
+
+/*! @name Stage configuration */
+typedef struct
+{
+    AD7708_FilterType type;
+    uint8_t order;     // CIC order, median window (odd)
+    uint16_t decim;    // Output one sample per decim inputs, 1: no decimation
+    int32_t b[3];      // Biquad feed-forward, Q2.30
+    int32_t a[2];      // Biquad feedback a1, a2, Q2.30: y = b0 x + b1 x1 + b2 x2 - a1 y1 - a2 y2
+} ad7708_filter_stage;
+
+/*! @name Per stage state, one variant per filter type */
+typedef union
+{
+    struct
+    {
+        uint64_t integ[AD7708_FILTER_CIC_MAX_ORDER]; // Modulo 2^64, wraps by design
+        uint64_t comb[AD7708_FILTER_CIC_MAX_ORDER];
+        uint16_t phase;
+        uint8_t clamped; // AD7708_SAMPLE_CLAMPED if an input since the last output was
+    } cic;
+    struct
+    {
+        int32_t x1, x2, y1, y2;
+    } biquad;
+    struct
+    {
+        int32_t window[AD7708_FILTER_MEDIAN_MAX];
+        uint8_t pos;
+        uint8_t fill;
+        uint16_t phase;
+        uint8_t clamped;
+    } median;
+} ad7708_filter_state;
+
+/*! @name Filter chain of one channel, configuration and state kept adjacent */
+typedef struct
+{
+    uint8_t count;
+    uint8_t channel;   // Channel code and mux address of the samples in the chain
+    ad7708_filter_stage stage[AD7708_FILTER_MAX_STAGES];
+    ad7708_filter_state state[AD7708_FILTER_MAX_STAGES];
+} ad7708_filter_chain;
+
+/*! @name Pipeline state */
+typedef struct
+{
+    ad7708_filter_chain chain[AD7708_FILTER_MAX_CHAINS]; // In the order channels were first configured
+    uint8_t index[64];                                   // Chain of each channel code and mux address, 0xFF: passed through
+    uint8_t chains;
+    uint32_t samplesIn;
+    uint32_t samplesOut;
+} ad7708_filter;
+
+/*!
+ * @brief Reset the pipeline with empty chains
+ * @param[in] f - Pointer to the pipeline
+ * @return void
+ */
+void ad7708_filter_init(ad7708_filter* f);
+
+/*!
+ * @brief Append a stage to the chain of a channel
+ * @param[in] f - Pointer to the pipeline
+ * @param[in] channel - Channel code with the mux address in bits 4-5, a new one takes the next free chain
+ * @param[in] stage - Stage configuration, copied
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_filter_addStage(ad7708_filter* f, uint8_t channel, const ad7708_filter_stage* stage);
+
+/*!
+ * @brief Clear the state of a channel's chain, keeping its configuration
+ * @param[in] f - Pointer to the pipeline
+ * @param[in] channel - Channel code with the mux address, 0xFF for all channels
+ * @return void
+ */
+void ad7708_filter_reset(ad7708_filter* f, uint8_t channel);
+
+/*!
+ * @brief Fill a CIC decimator stage
+ * @param[out] stage - Stage to fill
+ * @param[in] order - 1 (boxcar) to AD7708_FILTER_CIC_MAX_ORDER
+ * @param[in] decim - Decimation ratio and comb length, 1..AD7708_FILTER_CIC_MAX_DECIM
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_filter_cic(ad7708_filter_stage* stage, uint8_t order, uint16_t decim);
+
+/*!
+ * @brief Fill a biquad stage from Q2.30 coefficients, a0 normalized to 1
+ * @param[out] stage - Stage to fill
+ * @param[in] b0, b1, b2 - Feed-forward coefficients
+ * @param[in] a1, a2 - Feedback coefficients
+ * @return void
+ */
+void ad7708_filter_biquad(ad7708_filter_stage* stage, int32_t b0, int32_t b1, int32_t b2, int32_t a1, int32_t a2);
+
+/*!
+ * @brief Fill a biquad notch stage, e.g. for 50/60 Hz mains
+ * @param[out] stage - Stage to fill
+ * @param[in] fsMilliHz - Sample rate of the channel at this point of the chain
+ * @param[in] f0MilliHz - Notch frequency, below fs / 2
+ * @param[in] qX100 - Quality factor x100, f0 / bandwidth
+ * @return 0: case of success, error code otherwise.
+ * @note Uses floating point, meant for configuration time
+ */
+StatusTypeDef ad7708_filter_notch(ad7708_filter_stage* stage, uint32_t fsMilliHz, uint32_t f0MilliHz, uint16_t qX100);
+
+/*!
+ * @brief Fill a median-of-N stage
+ * @param[out] stage - Stage to fill
+ * @param[in] n - Window, odd, 3..AD7708_FILTER_MEDIAN_MAX
+ * @param[in] decim - Output one median per decim inputs, 1: sliding
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_filter_median(ad7708_filter_stage* stage, uint8_t n, uint16_t decim);
+
+/*!
+ * @brief Filter a block of interleaved samples
+ * @param[in] f - Pointer to the pipeline
+ * @param[in] in - Samples in acquisition order
+ * @param[in] n - Number of samples
+ * @param[out] out - Filtered samples, room for n, may not alias in
+ * @return Number of samples written to out
+ */
+uint32_t ad7708_filter_process(ad7708_filter* f, const ad7708_sample* in, uint32_t n, ad7708_sample* out);
+
+/*!
+ * @brief Pop up to max samples from a ring and filter them
+ * @param[in] f - Pointer to the pipeline
+ * @param[in] ring - Sample ring, the pipeline is its consumer
+ * @param[out] out - Filtered samples, room for max
+ * @param[in] max - Samples to take from the ring at most
+ * @return Number of samples written to out
+ */
+uint32_t ad7708_filter_drain(ad7708_filter* f, ad7708_ring* ring, ad7708_sample* out, uint32_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
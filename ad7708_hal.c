@@ -0,0 +1,133 @@
+#include "ad7708_hal.h"
+
+/****************** Static function declarations ************************/
+
+static StatusTypeDef halTransmit(void* intf, uint8_t* data, uint16_t len);
+static StatusTypeDef halReceive(void* intf, uint8_t* data, uint16_t len);
+static StatusTypeDef halTransfer(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len);
+static void halSetCS(void* intf, const ad7708_pin* pin, uint8_t state);
+static uint8_t halReadPin(void* intf, const ad7708_pin* pin);
+static uint32_t halGetTick(void* intf);
+static uint32_t halGetTickUs(void* intf);
+
+static void halDelay(void* intf, uint32_t period);
+static StatusTypeDef halTransferDMA(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len);
+
+const ad7708_transport ad7708_halTransport = {
+    .transmit = halTransmit,
+    .receive = halReceive,
+    .transfer = halTransfer,
+    .setCS = halSetCS,
+    .readPin = halReadPin,
+    .getTick = halGetTick,
+    .getTickUs = halGetTickUs,
+    .delay_ms = halDelay, // delayOS if used in freeRTOS
+    .transferDMA = halTransferDMA, // Completion: HAL_SPI_TxRxCpltCallback
+};
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Bind a device to the STM32 HAL transport
+ */
+void ad7708_hal_attach(ad7708_dev* dev, ad7708_hal_intf* intf, GPIO_TypeDef* csPort, uint16_t csPin, GPIO_TypeDef* rdyPort, uint16_t rdyPin)
+{
+    dev->transport = &ad7708_halTransport;
+    dev->intf = intf;
+    dev->cs.port = csPort;
+    dev->cs.pin = csPin;
+    dev->rdy.port = rdyPort;
+    dev->rdy.pin = rdyPin;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/****************** Static Function Definitions *******************************/
+
+static StatusTypeDef halTransmit(void* intf, uint8_t* data, uint16_t len)
+{
+    ad7708_hal_intf* hal = (ad7708_hal_intf*)intf;
+
+    if (HAL_SPI_Transmit(hal->hspi, data, len, AD7708_SPI_TIMEOUT) != HAL_OK) { return AD7708_ERROR; }
+
+    return AD7708_OK;
+}
+
+static StatusTypeDef halReceive(void* intf, uint8_t* data, uint16_t len)
+{
+    ad7708_hal_intf* hal = (ad7708_hal_intf*)intf;
+
+    if (HAL_SPI_Receive(hal->hspi, data, len, AD7708_SPI_TIMEOUT) != HAL_OK) { return AD7708_ERROR; }
+
+    return AD7708_OK;
+}
+
+static StatusTypeDef halTransfer(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len)
+{
+    ad7708_hal_intf* hal = (ad7708_hal_intf*)intf;
+
+    if (HAL_SPI_TransmitReceive(hal->hspi, tx, rx, len, AD7708_SPI_TIMEOUT) != HAL_OK) { return AD7708_ERROR; }
+
+    return AD7708_OK;
+}
+
+static void halSetCS(void* intf, const ad7708_pin* pin, uint8_t state)
+{
+    (void)intf;
+    HAL_GPIO_WritePin((GPIO_TypeDef*)pin->port, pin->pin, state ? GPIO_PIN_SET : GPIO_PIN_RESET);
+}
+
+static uint8_t halReadPin(void* intf, const ad7708_pin* pin)
+{
+    (void)intf;
+    return HAL_GPIO_ReadPin((GPIO_TypeDef*)pin->port, pin->pin) == GPIO_PIN_SET ? 1 : 0;
+}
+
+static uint32_t halGetTick(void* intf)
+{
+    (void)intf;
+    return HAL_GetTick();
+}
+
+/*!
+ * @brief Microsecond tick extended from DWT->CYCCNT
+ * @note Dividing the raw counter would wrap at 2^32 / SystemCoreClock (~25 s at 168 MHz), not at 2^32 us, and break
+ * the (int32_t)(now - next) comparisons of the callers. The elapsed cycles are accumulated instead so the result
+ * wraps modulo 2^32 us; this holds as long as the tick is read at least once per counter period, which any
+ * running stream, scan or poll loop does.
+ */
+static uint32_t halGetTickUs(void* intf)
+{
+    static uint32_t lastCycles, remCycles, us;
+    uint32_t cyclesPerUs = SystemCoreClock / 1000000U;
+    uint32_t primask = __get_PRIMASK();
+    uint32_t now;
+
+    (void)intf;
+    __disable_irq(); // Called from both thread and RDY/DMA interrupt context
+    now = DWT->CYCCNT;
+    remCycles += now - lastCycles;
+    lastCycles = now;
+    us += remCycles / cyclesPerUs;
+    remCycles %= cyclesPerUs;
+    now = us;
+    __set_PRIMASK(primask);
+
+    return now;
+}
+
+static void halDelay(void* intf, uint32_t period)
+{
+    (void)intf;
+    HAL_Delay(period);
+}
+
+static StatusTypeDef halTransferDMA(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len)
+{
+    ad7708_hal_intf* hal = (ad7708_hal_intf*)intf;
+
+    if (HAL_SPI_TransmitReceive_DMA(hal->hspi, tx, rx, len) != HAL_OK) { return AD7708_ERROR; }
+
+    return AD7708_OK;
+}
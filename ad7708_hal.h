@@ -0,0 +1,37 @@
+#ifndef __AD7708_HAL_H__
+#define __AD7708_HAL_H__
+
+#include "main.h" // STM32Cube HAL and CubeMX pin labels
+#include "ad7708_defs.h"
+
+/****************** Device Specifications *******************************/
+
+/*! @name Device Pin Configuraiton */
+#define AD7708_CS_Pin GPIO_PIN_4
+#define AD7708_CS_GPIO_Port GPIOC
+#define RDY_Pin GPIO_PIN_5 //EXTI Falling Edge
+#define RDY_GPIO_Port GPIOC
+#define AD7708_INTF hspi1
+#define AD7708_SPI_TIMEOUT 10 // ms, per HAL call
+
+/*! @name STM32 HAL bus context, pointed to by ad7708_dev.intf and shared by every device on the bus */
+typedef struct
+{
+    SPI_HandleTypeDef* hspi;
+} ad7708_hal_intf;
+
+/*! @name Transport implementation on top of HAL_SPI / HAL_GPIO */
+extern const ad7708_transport ad7708_halTransport;
+
+/*!
+ * @brief Bind a device to the STM32 HAL transport
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] intf - Pointer to the HAL bus context, must outlive the device
+ * @param[in] csPort, csPin - Chip select of this device, e.g. AD7708_CS_GPIO_Port, AD7708_CS_Pin
+ * @param[in] rdyPort, rdyPin - RDY output of this device, e.g. RDY_GPIO_Port, RDY_Pin
+ * @return void
+ * @note Also starts the DWT cycle counter behind getTickUs
+ */
+void ad7708_hal_attach(ad7708_dev* dev, ad7708_hal_intf* intf, GPIO_TypeDef* csPort, uint16_t csPin, GPIO_TypeDef* rdyPort, uint16_t rdyPin);
+
+#endif
@@ -0,0 +1,528 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime, nanosleep
+
+#include "ad7708_ingest.h"
+#include "ad7708_convert.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define LOAD_ACQ(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_REL(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+typedef enum
+{
+    SERVICE_PROGRESS = 0x00U,
+    SERVICE_IDLE = 0x01U,    // Nothing to read, or every waiting sample blocked
+    SERVICE_DONE = 0x02U
+} ServiceResult;
+
+/********************** Static function declarations ************************/
+
+/*!
+ * @brief Worker thread body
+ * @param[in] arg - Pointer to the worker
+ * @return NULL
+ */
+static void* workerMain(void* arg);
+
+/*!
+ * @brief Take a stream: the newest of the own deque, else the oldest of another worker
+ * @param[in] eng - Pointer to the engine
+ * @param[in] self - Index of the calling worker
+ * @param[out] id - Stream id
+ * @return 1: got one, 0: every deque empty
+ */
+static uint8_t takeStream(ad7708_ingest* eng, uint8_t self, uint16_t* id);
+
+/*!
+ * @brief Give a stream back to a deque
+ * @param[in] w - Worker owning the deque
+ * @param[in] id - Stream id
+ * @param[in] newest - 1: where the owner works next, 0: where thieves look first
+ * @return void
+ */
+static void putStream(ad7708_ingest_worker* w, uint16_t id, uint8_t newest);
+
+/*!
+ * @brief Read, decode, scale and merge one chunk of a stream
+ * @param[in] eng - Pointer to the engine
+ * @param[in] id - Stream id
+ * @return What came of it
+ */
+static ServiceResult service(ad7708_ingest* eng, uint16_t id);
+
+/*!
+ * @brief Append the blocked channel groups of a stream's slice to their columns
+ * @param[in] eng - Pointer to the engine
+ * @param[in] id - Stream id
+ * @return 1: the slice is fully merged, 0: some column is still full
+ */
+static uint8_t merge(ad7708_ingest* eng, uint16_t id);
+
+/*!
+ * @brief Wire decoder callback, appends a frame to the stream's slice
+ */
+static void onSamples(void* arg, const ad7708_wire_config* config, uint32_t first, const ad7708_sample* samples, uint8_t count);
+
+/*!
+ * @brief Monotonic time
+ * @return Time in ns
+ */
+static uint64_t nowNs(void);
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Allocate an engine
+ */
+StatusTypeDef ad7708_ingest_create(ad7708_ingest* eng, uint16_t maxStreams, uint32_t columnCapacity, uint8_t threads)
+{
+    if (maxStreams == 0 || columnCapacity == 0 || (columnCapacity & (columnCapacity - 1)) != 0) { return AD7708_ERROR; }
+
+    if (threads == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (uint8_t)(cpus < 1 ? 1 : cpus > 255 ? 255 : cpus);
+    }
+
+    memset(eng, 0, sizeof(*eng));
+    eng->maxStreams = maxStreams;
+    eng->columnMask = columnCapacity - 1;
+    eng->threads = threads;
+    eng->streams = calloc(maxStreams, sizeof(ad7708_ingest_stream));
+    eng->workers = calloc(threads, sizeof(ad7708_ingest_worker));
+    if (eng->streams == NULL || eng->workers == NULL)
+    {
+        ad7708_ingest_destroy(eng);
+        return AD7708_ERROR;
+    }
+
+    for (uint8_t c = 0; c < 16; c++)
+    {
+        ad7708_ingest_column* col = &eng->columns[c];
+        pthread_mutex_init(&col->lock, NULL);
+        col->volts = malloc(columnCapacity * sizeof(float));
+        col->stream = malloc(columnCapacity * sizeof(uint16_t));
+        col->index = malloc(columnCapacity * sizeof(uint32_t));
+        col->mux = malloc(columnCapacity);
+        col->flags = malloc(columnCapacity);
+        if (col->volts == NULL || col->stream == NULL || col->index == NULL || col->mux == NULL || col->flags == NULL)
+        {
+            ad7708_ingest_destroy(eng);
+            return AD7708_ERROR;
+        }
+    }
+
+    for (uint8_t t = 0; t < threads; t++)
+    {
+        ad7708_ingest_worker* w = &eng->workers[t];
+        pthread_mutex_init(&w->lock, NULL);
+        w->eng = eng;
+        // Every deque can hold every stream, so a put never fails
+        w->ids = malloc((uint32_t)maxStreams * sizeof(uint16_t));
+        if (w->ids == NULL)
+        {
+            ad7708_ingest_destroy(eng);
+            return AD7708_ERROR;
+        }
+    }
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Add a stream before the engine starts
+ */
+StatusTypeDef ad7708_ingest_addFd(ad7708_ingest* eng, int fd, uint32_t tag, uint16_t* id)
+{
+    ad7708_ingest_stream* s;
+    int flags = fcntl(fd, F_GETFL);
+
+    if (eng->running || eng->streamCount == eng->maxStreams || flags < 0) { return AD7708_ERROR; }
+    if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) { return AD7708_ERROR; }
+
+    s = &eng->streams[eng->streamCount];
+    s->fd = fd;
+    s->tag = tag;
+    ad7708_wire_decoder_init(&s->dec, onSamples, s);
+    *id = eng->streamCount++;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Deal the streams to the workers and start them
+ */
+StatusTypeDef ad7708_ingest_start(ad7708_ingest* eng)
+{
+    uint64_t now = nowNs();
+
+    if (eng->running) { return AD7708_ERROR; }
+
+    // Pick the conversion kernel once, before any worker races to
+    (void)ad7708_convert_kernel();
+
+    for (uint16_t i = 0; i < eng->streamCount; i++)
+    {
+        eng->streams[i].lastServiceNs = now;
+        putStream(&eng->workers[i % eng->threads], i, 1);
+    }
+
+    STORE_REL(&eng->running, 1);
+    for (uint8_t t = 0; t < eng->threads; t++)
+    {
+        if (pthread_create(&eng->workers[t].thread, NULL, workerMain, &eng->workers[t]) != 0)
+        {
+            STORE_REL(&eng->running, 0);
+            while (t-- != 0) { pthread_join(eng->workers[t].thread, NULL); }
+            return AD7708_ERROR;
+        }
+    }
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Move merged samples of a channel out of its column
+ */
+uint32_t ad7708_ingest_take(ad7708_ingest* eng, uint8_t channel, float* volts, uint16_t* stream, uint32_t* index, uint8_t* mux,
+    uint8_t* flags, uint32_t max)
+{
+    ad7708_ingest_column* col;
+    uint32_t n;
+
+    if (channel >= 16) { return 0; }
+    col = &eng->columns[channel];
+
+    pthread_mutex_lock(&col->lock);
+    n = col->head - col->tail;
+    if (n > max) { n = max; }
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t slot = (col->tail + i) & eng->columnMask;
+        volts[i] = col->volts[slot];
+        if (stream != NULL) { stream[i] = col->stream[slot]; }
+        if (index != NULL) { index[i] = col->index[slot]; }
+        if (mux != NULL) { mux[i] = col->mux[slot]; }
+        if (flags != NULL) { flags[i] = col->flags[slot]; }
+    }
+    col->tail += n;
+    pthread_mutex_unlock(&col->lock);
+
+    return n;
+}
+
+/*!
+ * @brief Every stream reached end of file and was merged
+ */
+uint8_t ad7708_ingest_finished(const ad7708_ingest* eng)
+{
+    // Pairs with the release of the last worker, everything it merged is visible
+    return LOAD_ACQ(&eng->streamsDone) == eng->streamCount;
+}
+
+/*!
+ * @brief Figures of one stream, safe while the engine runs
+ */
+StatusTypeDef ad7708_ingest_getStream(const ad7708_ingest* eng, uint16_t id, ad7708_ingest_stream_stats* stats)
+{
+    const ad7708_ingest_stream* s;
+
+    if (id >= eng->streamCount) { return AD7708_ERROR; }
+    s = &eng->streams[id];
+
+    stats->bytes = LOAD(&s->bytes);
+    stats->samples = LOAD(&s->samples);
+    stats->queuedBytes = LOAD(&s->queuedBytes);
+    stats->blockedSamples = LOAD(&s->count);
+    stats->stalls = LOAD(&s->stalls);
+    stats->maxGapNs = LOAD(&s->maxGapNs);
+    stats->lostSamples = LOAD(&s->dec.lostSamples);
+    stats->badFrames = LOAD(&s->dec.crcErrors) + LOAD(&s->dec.framingErrors);
+    stats->done = LOAD(&s->done);
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Stop and join the workers, columns and figures stay readable
+ */
+void ad7708_ingest_stop(ad7708_ingest* eng)
+{
+    if (!eng->running) { return; }
+
+    STORE_REL(&eng->running, 0);
+    for (uint8_t t = 0; t < eng->threads; t++) { pthread_join(eng->workers[t].thread, NULL); }
+}
+
+/*!
+ * @brief Stop and join the workers, release everything
+ */
+void ad7708_ingest_destroy(ad7708_ingest* eng)
+{
+    ad7708_ingest_stop(eng);
+
+    if (eng->workers != NULL)
+    {
+        for (uint8_t t = 0; t < eng->threads; t++)
+        {
+            free(eng->workers[t].ids);
+            pthread_mutex_destroy(&eng->workers[t].lock);
+        }
+    }
+    for (uint8_t c = 0; c < 16; c++)
+    {
+        free(eng->columns[c].volts);
+        free(eng->columns[c].stream);
+        free(eng->columns[c].index);
+        free(eng->columns[c].mux);
+        free(eng->columns[c].flags);
+        pthread_mutex_destroy(&eng->columns[c].lock);
+    }
+    free(eng->workers);
+    free(eng->streams);
+    memset(eng, 0, sizeof(*eng));
+}
+
+/****************** Static Function Definitions *******************************/
+
+static void* workerMain(void* arg)
+{
+    ad7708_ingest_worker* w = (ad7708_ingest_worker*)arg;
+    ad7708_ingest* eng = (ad7708_ingest*)w->eng;
+    uint8_t self = (uint8_t)(w - eng->workers);
+    uint32_t idle = 0;
+
+    while (LOAD_ACQ(&eng->running) && !ad7708_ingest_finished(eng))
+    {
+        uint16_t id;
+        ServiceResult result;
+
+        if (!takeStream(eng, self, &id))
+        {
+            // Every stream is being serviced by another worker or done
+            struct timespec ts = { 0, AD7708_INGEST_IDLE_NS };
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+        result = service(eng, id);
+        w->services++;
+        if (result == SERVICE_DONE)
+        {
+            __atomic_fetch_add(&eng->streamsDone, 1, __ATOMIC_RELEASE);
+            continue;
+        }
+
+        // A busy stream stays hot for a burst, then it and idle ones go where thieves look first
+        if (result == SERVICE_PROGRESS && ++eng->streams[id].burst < AD7708_INGEST_BURST) { putStream(w, id, 1); }
+        else
+        {
+            eng->streams[id].burst = 0;
+            putStream(w, id, 0);
+        }
+        idle = result == SERVICE_IDLE ? idle + 1 : 0;
+        if (idle > w->tail - w->head)
+        {
+            // A whole round found nothing to do
+            struct timespec ts = { 0, AD7708_INGEST_IDLE_NS };
+            nanosleep(&ts, NULL);
+            idle = 0;
+        }
+    }
+
+    return NULL;
+}
+
+static uint8_t takeStream(ad7708_ingest* eng, uint8_t self, uint16_t* id)
+{
+    ad7708_ingest_worker* own = &eng->workers[self];
+    uint32_t mask = eng->maxStreams;
+
+    pthread_mutex_lock(&own->lock);
+    if (own->tail != own->head)
+    {
+        own->tail--;
+        *id = own->ids[own->tail % mask];
+        pthread_mutex_unlock(&own->lock);
+        return 1;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    for (uint8_t k = 1; k < eng->threads; k++)
+    {
+        ad7708_ingest_worker* victim = &eng->workers[(self + k) % eng->threads];
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->tail != victim->head)
+        {
+            *id = victim->ids[victim->head % mask];
+            victim->head++;
+            pthread_mutex_unlock(&victim->lock);
+            own->steals++;
+            return 1;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+
+    return 0;
+}
+
+static void putStream(ad7708_ingest_worker* w, uint16_t id, uint8_t newest)
+{
+    ad7708_ingest* eng = (ad7708_ingest*)w->eng;
+    uint32_t size = eng->maxStreams;
+
+    pthread_mutex_lock(&w->lock);
+    if (newest)
+    {
+        w->ids[w->tail % size] = id;
+        w->tail++;
+    }
+    else
+    {
+        // Indices run freely, keep head below tail when stepping back past 0
+        if (w->head == 0)
+        {
+            w->head += size;
+            w->tail += size;
+        }
+        w->head--;
+        w->ids[w->head % size] = id;
+    }
+    pthread_mutex_unlock(&w->lock);
+}
+
+static ServiceResult service(ad7708_ingest* eng, uint16_t id)
+{
+    ad7708_ingest_stream* s = &eng->streams[id];
+    uint8_t buf[AD7708_INGEST_READ];
+    uint32_t count[16] = { 0 };
+    uint64_t now = nowNs();
+    ssize_t n;
+    int queued = 0;
+
+    if (now - s->lastServiceNs > s->maxGapNs) { STORE(&s->maxGapNs, now - s->lastServiceNs); }
+    s->lastServiceNs = now;
+
+    // Backpressure: nothing new is read while the previous slice waits for room
+    if (s->count != 0)
+    {
+        if (!merge(eng, id))
+        {
+            STORE(&s->stalls, s->stalls + 1);
+            return SERVICE_IDLE;
+        }
+        return SERVICE_PROGRESS;
+    }
+
+    n = read(s->fd, buf, sizeof(buf));
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) { return SERVICE_IDLE; }
+    if (n <= 0)
+    {
+        STORE(&s->done, 1);
+        return SERVICE_DONE;
+    }
+    if (ioctl(s->fd, FIONREAD, &queued) == 0) { STORE(&s->queuedBytes, (uint32_t)queued); }
+    STORE(&s->bytes, s->bytes + (uint64_t)n);
+
+    ad7708_wire_decode(&s->dec, buf, (uint32_t)n);
+    if (s->count == 0) { return SERVICE_PROGRESS; }
+
+    ad7708_convertVolts(s->slice, s->volts, s->count);
+
+    // Group by channel code so every column is locked once per slice
+    for (uint32_t i = 0; i < s->count; i++) { count[s->slice[i].channel & 0x0FU]++; }
+    s->groupAt[0] = 0;
+    for (uint8_t c = 0; c < 16; c++)
+    {
+        s->groupAt[c + 1] = s->groupAt[c] + count[c];
+        if (count[c] != 0) { s->blocked |= (uint16_t)(1U << c); }
+        count[c] = s->groupAt[c];
+    }
+    for (uint32_t i = 0; i < s->count; i++)
+    {
+        uint32_t at = count[s->slice[i].channel & 0x0FU]++;
+        s->sortedVolts[at] = s->volts[i];
+        s->sortedIndex[at] = s->index[i];
+        s->sortedMux[at] = (uint8_t)(s->slice[i].channel >> AD7708_SAMPLE_MUX_SHIFT);
+        s->sortedFlags[at] = s->slice[i].flags;
+    }
+
+    if (!merge(eng, id)) { STORE(&s->stalls, s->stalls + 1); }
+
+    return SERVICE_PROGRESS;
+}
+
+static uint8_t merge(ad7708_ingest* eng, uint16_t id)
+{
+    ad7708_ingest_stream* s = &eng->streams[id];
+    uint32_t capacity = eng->columnMask + 1;
+
+    for (uint8_t c = 0; c < 16; c++)
+    {
+        ad7708_ingest_column* col = &eng->columns[c];
+        uint32_t at = s->groupAt[c];
+        uint32_t n = s->groupAt[c + 1] - at;
+
+        if (!(s->blocked & (1U << c))) { continue; }
+
+        pthread_mutex_lock(&col->lock);
+        if (capacity - (col->head - col->tail) < n)
+        {
+            col->fullEvents++;
+            pthread_mutex_unlock(&col->lock);
+            continue;
+        }
+        for (uint32_t i = 0; i < n; i++)
+        {
+            uint32_t slot = (col->head + i) & eng->columnMask;
+            col->volts[slot] = s->sortedVolts[at + i];
+            col->stream[slot] = id;
+            col->index[slot] = s->sortedIndex[at + i];
+            col->mux[slot] = s->sortedMux[at + i];
+            col->flags[slot] = s->sortedFlags[at + i];
+        }
+        col->head += n;
+        col->appended += n;
+        pthread_mutex_unlock(&col->lock);
+
+        s->blocked &= (uint16_t)~(1U << c);
+        STORE(&s->samples, s->samples + n);
+    }
+
+    if (s->blocked != 0) { return 0; }
+
+    STORE(&s->count, 0);
+    return 1;
+}
+
+static void onSamples(void* arg, const ad7708_wire_config* config, uint32_t first, const ad7708_sample* samples, uint8_t count)
+{
+    ad7708_ingest_stream* s = (ad7708_ingest_stream*)arg;
+
+    (void)config;
+    // A read of AD7708_INGEST_READ bytes cannot complete more than AD7708_INGEST_SLICE samples
+    for (uint8_t k = 0; k < count && s->count < AD7708_INGEST_SLICE; k++)
+    {
+        s->slice[s->count] = samples[k];
+        s->index[s->count] = first + k;
+        s->count++;
+    }
+}
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
@@ -0,0 +1,200 @@
+#ifndef __AD7708_INGEST_H__
+#define __AD7708_INGEST_H__
+
+#include <pthread.h>
+
+#include "ad7708_defs.h"
+#include "ad7708_wire.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Host ingest of many wire streams (ad7708_wire.h).
+ *
+ * Every stream is a file, pipe or socket descriptor. A pool of worker threads
+ * services the streams: a worker reads a chunk, decodes it, scales the codes
+ * to volts with the range/polarity nibble of each sample and merges them into
+ * one columnar buffer per channel code, which the application drains with
+ * ad7708_ingest_take(). The external mux addresses of a channel code share
+ * its column, every sample keeps its mux address and flags next to its volts
+ * so the inputs stay apart and clamped samples stay marked. Each worker owns a deque of streams. It keeps servicing the newest
+ * one for a burst of AD7708_INGEST_BURST chunks, then moves it to the old end.
+ * An idle worker steals the oldest stream of another worker, so load follows
+ * the busy streams across cores.
+ *
+ * Columns are bounded. A stream whose samples do not fit keeps them and is
+ * not read further until the application makes room: backpressure reaches
+ * the descriptor and from there the sender. Per-stream counters expose
+ * queued bytes, blocked samples and the gap between services.
+ *
+ * Host only, needs POSIX threads.
+ */
+
+#define AD7708_INGEST_READ 4096 // Bytes read per service
+#define AD7708_INGEST_SLICE (AD7708_INGEST_READ / 4 + AD7708_WIRE_MAX_SAMPLES) // Samples one read can yield
+#define AD7708_INGEST_BURST 8 // Services in a row before a busy stream yields to the others
+#define AD7708_INGEST_IDLE_NS 50000 // Worker sleep when no stream had anything to do
+
+/*! @name One stream */
+typedef struct
+{
+    int fd;
+    uint32_t tag;                 // Caller defined
+    uint8_t done;                 // End of file reached and everything merged
+    uint8_t burst;                // Services in a row by the same worker
+    ad7708_wire_decoder dec;
+    uint32_t count;               // Samples of the slice waiting to be merged
+    uint16_t blocked;             // Bit per channel code still to merge
+    ad7708_sample slice[AD7708_INGEST_SLICE];
+    uint32_t index[AD7708_INGEST_SLICE];
+    float volts[AD7708_INGEST_SLICE];
+    uint32_t groupAt[17];         // Start of each channel's group in the sorted slice
+    float sortedVolts[AD7708_INGEST_SLICE];
+    uint32_t sortedIndex[AD7708_INGEST_SLICE];
+    uint8_t sortedMux[AD7708_INGEST_SLICE];
+    uint8_t sortedFlags[AD7708_INGEST_SLICE];
+    uint64_t lastServiceNs;
+    // Metrics, written by the worker servicing the stream, read with ad7708_ingest_getStream
+    uint64_t bytes;
+    uint64_t samples;             // Merged into columns
+    uint32_t queuedBytes;         // Waiting in the descriptor at the last service, pipes and sockets
+    uint32_t stalls;              // Services that found a full column
+    uint64_t maxGapNs;            // Longest time between two services
+} ad7708_ingest_stream;
+
+/*! @name Per-stream figures */
+typedef struct
+{
+    uint64_t bytes;
+    uint64_t samples;
+    uint32_t queuedBytes;
+    uint32_t blockedSamples;      // Decoded, waiting for room in a column
+    uint32_t stalls;
+    uint64_t maxGapNs;
+    uint32_t lostSamples;         // From the wire decoder
+    uint32_t badFrames;           // CRC and framing errors
+    uint8_t done;
+} ad7708_ingest_stream_stats;
+
+/*! @name Merged samples of one channel code, ring of structure of arrays */
+typedef struct
+{
+    pthread_mutex_t lock;
+    float* volts;
+    uint16_t* stream;             // Stream id of each sample
+    uint32_t* index;              // Sample number within its stream
+    uint8_t* mux;                 // External mux address of each sample
+    uint8_t* flags;               // Range, polarity and clamp flags of each sample
+    uint32_t head;                // Next slot to write
+    uint32_t tail;                // Next slot to read
+    uint64_t appended;
+    uint32_t fullEvents;          // Merges refused for lack of room
+} ad7708_ingest_column;
+
+/*! @name Worker and its deque of stream ids */
+typedef struct
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    uint16_t* ids;
+    uint32_t head;                // Oldest, thieves take here
+    uint32_t tail;                // Newest, the owner works here
+    uint64_t services;
+    uint64_t steals;
+    void* eng;                    // Owning ad7708_ingest
+} ad7708_ingest_worker;
+
+/*! @name Engine state */
+typedef struct
+{
+    ad7708_ingest_stream* streams;
+    uint16_t streamCount;
+    uint16_t maxStreams;
+    ad7708_ingest_column columns[16];
+    uint32_t columnMask;          // Column capacity - 1
+    ad7708_ingest_worker* workers;
+    uint8_t threads;
+    volatile uint8_t running;
+    volatile uint32_t streamsDone;
+} ad7708_ingest;
+
+/*!
+ * @brief Allocate an engine
+ * @param[in] eng - Pointer to the engine
+ * @param[in] maxStreams - Streams that can be added
+ * @param[in] columnCapacity - Samples per channel column, power of 2
+ * @param[in] threads - Worker threads, 0: one per online CPU
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_ingest_create(ad7708_ingest* eng, uint16_t maxStreams, uint32_t columnCapacity, uint8_t threads);
+
+/*!
+ * @brief Add a stream before the engine starts
+ * @param[in] eng - Pointer to the engine
+ * @param[in] fd - Readable descriptor, switched to non-blocking, not closed by the engine, keep it open until ad7708_ingest_stop
+ * @param[in] tag - Caller defined
+ * @param[out] id - Stream id, as found in the stream column of the merged samples
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_ingest_addFd(ad7708_ingest* eng, int fd, uint32_t tag, uint16_t* id);
+
+/*!
+ * @brief Deal the streams to the workers and start them
+ * @param[in] eng - Pointer to the engine
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_ingest_start(ad7708_ingest* eng);
+
+/*!
+ * @brief Move merged samples of a channel out of its column
+ * @param[in] eng - Pointer to the engine
+ * @param[in] channel - Channel code
+ * @param[out] volts - Scaled samples
+ * @param[out] stream - Stream id per sample, may be NULL
+ * @param[out] index - Sample number per sample, may be NULL
+ * @param[out] mux - External mux address per sample, may be NULL
+ * @param[out] flags - Sample flags per sample, AD7708_SAMPLE_CLAMPED included, may be NULL
+ * @param[in] max - Capacity of the outputs
+ * @return Number of samples moved
+ */
+uint32_t ad7708_ingest_take(ad7708_ingest* eng, uint8_t channel, float* volts, uint16_t* stream, uint32_t* index, uint8_t* mux,
+    uint8_t* flags, uint32_t max);
+
+/*!
+ * @brief Every stream reached end of file and was merged
+ * @param[in] eng - Pointer to the engine
+ * @return 1: finished, 0: still running
+ */
+uint8_t ad7708_ingest_finished(const ad7708_ingest* eng);
+
+/*!
+ * @brief Figures of one stream, safe while the engine runs
+ * @param[in] eng - Pointer to the engine
+ * @param[in] id - Stream id
+ * @param[out] stats - Figures
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_ingest_getStream(const ad7708_ingest* eng, uint16_t id, ad7708_ingest_stream_stats* stats);
+
+/*!
+ * @brief Stop and join the workers, columns and figures stay readable
+ * @param[in] eng - Pointer to the engine
+ * @return void
+ * @note The stream descriptors may be closed once it returns
+ */
+void ad7708_ingest_stop(ad7708_ingest* eng);
+
+/*!
+ * @brief Stop and join the workers, release everything
+ * @param[in] eng - Pointer to the engine
+ * @return void
+ */
+void ad7708_ingest_destroy(ad7708_ingest* eng);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
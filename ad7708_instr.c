@@ -0,0 +1,69 @@
+#include "ad7708_instr.h"
+#include "ad7708.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#if AD7708_INSTRUMENT
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Time base of the instrumentation
+ */
+uint32_t ad7708_instr_now(const ad7708_dev* dev)
+{
+    return ad7708_nowUs(dev);
+}
+
+/*!
+ * @brief Add one measurement to a latency distribution
+ */
+void ad7708_instr_record(ad7708_latency* lat, uint32_t us)
+{
+    uint8_t bucket = 0;
+
+    while (bucket < AD7708_LAT_BUCKETS - 1 && us >= (1UL << bucket)) { bucket++; }
+
+    if (lat->count == 0 || us < lat->minUs) { lat->minUs = us; }
+    if (us > lat->maxUs) { lat->maxUs = us; }
+    lat->sumUs += us;
+    lat->hist[bucket]++;
+    lat->count++;
+}
+
+/*!
+ * @brief Copy the counters of a device
+ */
+void ad7708_instr_snapshot(const ad7708_dev* dev, ad7708_instr* snap)
+{
+    memcpy(snap, &dev->instr, sizeof(*snap));
+    snap->trace = NULL;
+    snap->traceArg = NULL;
+}
+
+/*!
+ * @brief Zero the counters, keeping the trace hook
+ */
+void ad7708_instr_reset(ad7708_dev* dev)
+{
+    ad7708_trace_fptr_t trace = dev->instr.trace;
+    void* arg = dev->instr.traceArg;
+
+    memset(&dev->instr, 0, sizeof(dev->instr));
+    dev->instr.trace = trace;
+    dev->instr.traceArg = arg;
+}
+
+/*!
+ * @brief Install or remove the trace hook
+ */
+void ad7708_instr_setTrace(ad7708_dev* dev, ad7708_trace_fptr_t trace, void* arg)
+{
+    // Never let an ISR see the new hook with the old argument
+    __atomic_store_n(&dev->instr.trace, NULL, __ATOMIC_RELEASE);
+    dev->instr.traceArg = arg;
+    __atomic_store_n(&dev->instr.trace, trace, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef __AD7708_INSTR_H__
+#define __AD7708_INSTR_H__
+
+#include "ad7708_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Driver instrumentation.
+ *
+ * With AD7708_INSTRUMENT set (default) every ad7708_dev counts SPI bytes, CS
+ * assertions, idle polls, timeouts and out-of-range results, keeps latency
+ * histograms of register writes, data reads and calibrations, and can call a
+ * trace hook with a us timestamp. Build with -DAD7708_INSTRUMENT=0 and all
+ * of it, including the fields in ad7708_dev, compiles away.
+ *
+ * Counters are only ever incremented, so a monitor computes rates from the
+ * difference of two snapshots. A snapshot is a plain copy without locking;
+ * each field is consistent on its own.
+ */
+
+typedef enum
+{
+    AD7708_TRACE_REG_WRITE = 0x01U, // value: register << 8 | byte
+    AD7708_TRACE_DATA_READ = 0x02U, // value: code
+    AD7708_TRACE_CAL_START = 0x03U, // value: mode
+    AD7708_TRACE_CAL_DONE = 0x04U,  // value: status
+    AD7708_TRACE_TIMEOUT = 0x05U,   // value: timeout in ms
+    AD7708_TRACE_ERR = 0x06U,       // value: status register
+    AD7708_TRACE_RANGE = 0x07U,     // value: channel << 4 | new range
+    AD7708_TRACE_RECOVER = 0x08U    // value: status
+} AD7708_TraceEvent;
+
+#if AD7708_INSTRUMENT
+
+#define AD7708_INSTR_ADD(dev, field, n) ((dev)->instr.field += (n))
+#define AD7708_INSTR_START(dev, var) uint32_t var = ad7708_instr_now(dev)
+#define AD7708_INSTR_LATENCY(dev, field, start) ad7708_instr_record(&(dev)->instr.field, ad7708_instr_now(dev) - (start))
+#define AD7708_INSTR_TRACE(dev, event, value) \
+    do { if ((dev)->instr.trace != NULL) { (dev)->instr.trace((dev)->instr.traceArg, (event), ad7708_instr_now(dev), (value)); } } while (0)
+#define AD7708_INSTR_CODE(dev, code) \
+    do { if ((code) == 0x0000U || (code) == 0xFFFFU) { (dev)->instr.clamped++; } } while (0)
+
+/*!
+ * @brief Time base of the instrumentation
+ * @param[in] dev - Pointer to the device structure
+ * @return Transport us tick, ms tick x 1000 when the transport has none
+ */
+uint32_t ad7708_instr_now(const ad7708_dev* dev);
+
+/*!
+ * @brief Add one measurement to a latency distribution
+ * @param[in] lat - Distribution
+ * @param[in] us - Latency
+ * @return void
+ */
+void ad7708_instr_record(ad7708_latency* lat, uint32_t us);
+
+/*!
+ * @brief Copy the counters of a device
+ * @param[in] dev - Pointer to the device structure
+ * @param[out] snap - Copy, trace fields cleared
+ * @return void
+ */
+void ad7708_instr_snapshot(const ad7708_dev* dev, ad7708_instr* snap);
+
+/*!
+ * @brief Zero the counters, keeping the trace hook
+ * @param[in] dev - Pointer to the device structure
+ * @return void
+ */
+void ad7708_instr_reset(ad7708_dev* dev);
+
+/*!
+ * @brief Install or remove the trace hook
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] trace - Called for every AD7708_TraceEvent, NULL to disable
+ * @param[in] arg - Passed back to trace
+ * @return void
+ */
+void ad7708_instr_setTrace(ad7708_dev* dev, ad7708_trace_fptr_t trace, void* arg);
+
+#else
+
+#define AD7708_INSTR_ADD(dev, field, n) ((void)0)
+#define AD7708_INSTR_START(dev, var)
+#define AD7708_INSTR_LATENCY(dev, field, start) ((void)0)
+#define AD7708_INSTR_TRACE(dev, event, value) ((void)0)
+#define AD7708_INSTR_CODE(dev, code) ((void)0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,202 @@
+#include "ad7708_oversample.h"
+#include "ad7708.h"
+#include "ad7708_plan.h"
+
+#include <math.h>
+#include <string.h>
+
+
+/********************** Static function declarations ************************/
+
+/*!
+ * @brief Effective resolution for a ratio
+ * @param[in] ratio - Conversions per result
+ * @return 16 + floor(log2(ratio)) / 2
+ */
+static uint8_t effectiveBits(uint16_t ratio);
+
+/*!
+ * @brief Emit the mean of a full group
+ * @param[in] c - Channel state
+ * @param[in] channel - Channel code
+ * @param[out] out - Result
+ * @return void
+ */
+static void emit(ad7708_oversample_channel* c, uint8_t channel, ad7708_oversample_result* out);
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Reset the engine with every channel passing through
+ */
+void ad7708_oversample_init(ad7708_oversample* os)
+{
+    memset(os, 0, sizeof(*os));
+    for (uint8_t i = 0; i < 16; i++) { os->ch[i].ratio = 1; }
+}
+
+/*!
+ * @brief Set the oversampling ratio of a channel, clearing its accumulator
+ */
+StatusTypeDef ad7708_oversample_setRatio(ad7708_oversample* os, uint8_t channel, uint16_t ratio)
+{
+    if (channel >= 16 || ratio == 0 || ratio > AD7708_OVERSAMPLE_MAX) { return AD7708_ERROR; }
+
+    memset(&os->ch[channel], 0, sizeof(os->ch[channel]));
+    os->ch[channel].ratio = ratio;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Set chop and start continuous conversion, recording the conversion period
+ */
+StatusTypeDef ad7708_oversample_start(ad7708_oversample* os, ad7708_dev* dev, uint8_t chop)
+{
+    StatusTypeDef status;
+    ModeReg mode = dev->modeReg;
+
+    if (chop && dev->filterReg.byte < AD7708_PLAN_SF_MIN_CHOP) { return AD7708_ERROR; }
+
+    if (mode.bits.chop != chop)
+    {
+        status = ad7708_modeConfig(dev, AD7708_Idle, mode.bits.chcon, mode.bits.refsel, chop, mode.bits.negbuf, mode.bits.oscpd);
+        if (status != AD7708_OK) { return status; }
+    }
+
+    os->conversionNs = ad7708_plan_periodNs(dev->filterReg.byte, chop);
+    os->conversions = 0;
+
+    return ad7708_startContinuousConversion(dev);
+}
+
+/*!
+ * @brief Accumulate a block of samples
+ */
+uint32_t ad7708_oversample_process(ad7708_oversample* os, const ad7708_sample* in, uint32_t n, ad7708_oversample_result* out)
+{
+    uint32_t produced = 0;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint8_t channel = in[i].channel & 0x0FU;
+        uint8_t mux = in[i].channel >> AD7708_SAMPLE_MUX_SHIFT;
+        uint8_t tag = in[i].flags & AD7708_SAMPLE_TAG_MASK;
+        ad7708_oversample_channel* c = &os->ch[channel];
+
+        if (tag != c->flags || mux != c->mux)
+        {
+            // Different scale or input, neither the group nor the differences carry over
+            if (c->fill != 0) { c->dropped++; }
+            c->fill = 0;
+            c->sum = 0;
+            c->haveRaw = 0;
+            c->haveOut = 0;
+            c->flags = tag;
+            c->mux = mux;
+        }
+
+        if (c->haveRaw)
+        {
+            int32_t d = (int32_t)in[i].code - c->lastCode;
+            c->rawDiffSq += (uint64_t)((int64_t)d * d);
+            c->rawDiffs++;
+        }
+        c->lastCode = in[i].code;
+        c->haveRaw = 1;
+
+        c->sum += (int32_t)in[i].code - AD7708_SAMPLE_ZERO_CODE(tag);
+        c->conversions++;
+        os->conversions++;
+
+        if (++c->fill >= c->ratio) { emit(c, in[i].channel, &out[produced++]); }
+    }
+
+    return produced;
+}
+
+/*!
+ * @brief Pop up to max samples from a ring and accumulate them
+ */
+uint32_t ad7708_oversample_drain(ad7708_oversample* os, ad7708_ring* ring, ad7708_oversample_result* out, uint32_t max)
+{
+    ad7708_sample block[AD7708_OVERSAMPLE_BLOCK];
+    uint32_t produced = 0;
+
+    while (max != 0)
+    {
+        uint32_t got = ad7708_ring_pop(ring, block, max < AD7708_OVERSAMPLE_BLOCK ? max : AD7708_OVERSAMPLE_BLOCK);
+        if (got == 0) { break; }
+
+        produced += ad7708_oversample_process(os, block, got, out + produced);
+        max -= got;
+    }
+
+    return produced;
+}
+
+/*!
+ * @brief Report rate, resolution and measured noise reduction of a channel
+ */
+StatusTypeDef ad7708_oversample_getReport(const ad7708_oversample* os, uint8_t channel, ad7708_oversample_report* report)
+{
+    const ad7708_oversample_channel* c;
+    double share = 1.0;
+
+    if (channel >= 16) { return AD7708_ERROR; }
+    c = &os->ch[channel];
+
+    memset(report, 0, sizeof(*report));
+    if (os->conversions != 0) { share = (double)c->conversions / (double)os->conversions; }
+    if (os->conversionNs != 0) { report->rateMilliHz = (uint32_t)(1e12 / os->conversionNs * share / c->ratio + 0.5); }
+
+    report->bits = effectiveBits(c->ratio);
+    report->idealX100 = (uint32_t)(sqrt((double)c->ratio) * 100.0 + 0.5);
+
+    // The variance of a difference of two independent samples is twice theirs
+    if (c->rawDiffs != 0) { report->noiseRawX100 = (uint32_t)(sqrt((double)c->rawDiffSq / (2.0 * c->rawDiffs)) * 100.0 + 0.5); }
+    if (c->outDiffs != 0)
+    {
+        double out = sqrt((double)c->outDiffSq / (2.0 * c->outDiffs)) / (double)(1L << AD7708_OVERSAMPLE_FRAC);
+        report->noiseOutX100 = (uint32_t)(out * 100.0 + 0.5);
+        if (out > 0.0 && c->rawDiffs != 0) { report->reductionX100 = (uint32_t)(sqrt((double)c->rawDiffSq / (2.0 * c->rawDiffs)) / out * 100.0 + 0.5); }
+    }
+
+    return AD7708_OK;
+}
+
+/****************** Static Function Definitions *******************************/
+
+static uint8_t effectiveBits(uint16_t ratio)
+{
+    uint8_t log2 = 0;
+
+    while ((ratio >> (log2 + 1U)) != 0) { log2++; }
+
+    return (uint8_t)(16U + log2 / 2U);
+}
+
+static void emit(ad7708_oversample_channel* c, uint8_t channel, ad7708_oversample_result* out)
+{
+    int64_t num = c->sum * (1L << AD7708_OVERSAMPLE_FRAC);
+    int64_t half = c->fill / 2;
+    int32_t value = (int32_t)((num >= 0 ? num + half : num - half) / c->fill); // Round to nearest
+
+    if (c->haveOut)
+    {
+        int64_t d = (int64_t)value - c->lastValue;
+        c->outDiffSq += (uint64_t)(d * d);
+        c->outDiffs++;
+    }
+    c->lastValue = value;
+    c->haveOut = 1;
+
+    out->value = value;
+    out->channel = channel;
+    out->flags = c->flags;
+    out->bits = effectiveBits(c->ratio);
+
+    c->results++;
+    c->fill = 0;
+    c->sum = 0;
+}
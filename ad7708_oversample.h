@@ -0,0 +1,143 @@
+#ifndef __AD7708_OVERSAMPLE_H__
+#define __AD7708_OVERSAMPLE_H__
+
+#include "ad7708_defs.h"
+#include "ad7708_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Oversampling and averaging for more than 16 bits of effective resolution.
+ *
+ * Every channel code owns an accumulator that sums ratio conversions of the
+ * continuous conversion stream in 64 bits and emits their mean as one result
+ * with AD7708_OVERSAMPLE_FRAC fraction bits. White noise falls by sqrt(ratio),
+ * half a bit per doubling, at ratio times lower rate; ratio 1 passes results
+ * through at full speed, so fast and slow channels share one stream. Averaging
+ * does not remove offset drift; start with chop enabled for channels where it
+ * would dominate, at three times the conversion period. A group averages one
+ * input: a change of range or of the external mux address on the channel
+ * code starts a new group, so a mux scan needs whole groups per address.
+ *
+ * Noise is measured from successive differences, of raw conversions inside
+ * each group and of consecutive results, so a slowly moving input is not
+ * counted. ad7708_oversample_getReport() puts the measured reduction next to
+ * the ideal sqrt(ratio) and the resulting rate of the channel.
+ */
+
+#define AD7708_OVERSAMPLE_MAX 4096   // Largest ratio, +6 bits
+#define AD7708_OVERSAMPLE_FRAC 8     // Fraction bits of a result
+#define AD7708_OVERSAMPLE_BLOCK 64   // Samples popped per ring access
+
+/*! @name Averaged result */
+typedef struct
+{
+    int32_t value;   // Mean code relative to zero scale, LSB << AD7708_OVERSAMPLE_FRAC
+    uint8_t channel; // Channel code, bits 4-5: external mux address
+    uint8_t flags;   // Range/polarity of the averaged conversions
+    uint8_t bits;    // Effective resolution, 16 + log2(ratio) / 2
+} ad7708_oversample_result;
+
+/*! @name Per channel accumulator and noise statistics */
+typedef struct
+{
+    uint16_t ratio;      // Conversions per result, 0 or 1: pass-through
+    uint16_t fill;
+    uint8_t flags;       // Range/polarity of the group being accumulated
+    uint8_t mux;         // External mux address of the group
+    uint8_t haveRaw;
+    uint8_t haveOut;
+    int64_t sum;         // Codes relative to zero scale
+    uint16_t lastCode;
+    int32_t lastValue;
+    uint64_t rawDiffSq;  // Sum of squared successive raw differences, LSB^2
+    uint32_t rawDiffs;
+    uint64_t outDiffSq;  // Same for results, (LSB << FRAC)^2
+    uint32_t outDiffs;
+    uint32_t conversions;
+    uint32_t results;
+    uint32_t dropped;    // Partial groups discarded on a range/polarity or mux address change
+} ad7708_oversample_channel;
+
+/*! @name Engine state */
+typedef struct
+{
+    ad7708_oversample_channel ch[16]; // Indexed by channel code
+    uint32_t conversionNs;  // Time between conversions of the stream
+    uint32_t conversions;   // Of all channels, for each channel's share of the stream
+} ad7708_oversample;
+
+/*! @name Throughput and precision of one channel */
+typedef struct
+{
+    uint32_t rateMilliHz;    // Results per second x1000
+    uint8_t bits;            // Effective resolution
+    uint32_t noiseRawX100;   // RMS noise of single conversions, LSB x100
+    uint32_t noiseOutX100;   // RMS noise of results, LSB x100
+    uint32_t reductionX100;  // noiseRaw / noiseOut x100, 0 until both are measured
+    uint32_t idealX100;      // sqrt(ratio) x100
+} ad7708_oversample_report;
+
+/*!
+ * @brief Reset the engine with every channel passing through
+ * @param[in] os - Pointer to the engine
+ * @return void
+ */
+void ad7708_oversample_init(ad7708_oversample* os);
+
+/*!
+ * @brief Set the oversampling ratio of a channel, clearing its accumulator
+ * @param[in] os - Pointer to the engine
+ * @param[in] channel - Channel code, 0..15
+ * @param[in] ratio - Conversions per result, 1..AD7708_OVERSAMPLE_MAX
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_oversample_setRatio(ad7708_oversample* os, uint8_t channel, uint16_t ratio);
+
+/*!
+ * @brief Set chop and start continuous conversion, recording the conversion period
+ * @param[in] os - Pointer to the engine
+ * @param[in] dev - Pointer to the device structure, channel and filter already configured
+ * @param[in] chop - 1: chop enabled, needs SF >= 13
+ * @return 0: case of success, error code otherwise.
+ * @note A scan converts one entry per ad7708_plan.stepNs, set conversionNs to it afterwards
+ */
+StatusTypeDef ad7708_oversample_start(ad7708_oversample* os, ad7708_dev* dev, uint8_t chop);
+
+/*!
+ * @brief Accumulate a block of samples
+ * @param[in] os - Pointer to the engine
+ * @param[in] in - Samples in acquisition order
+ * @param[in] n - Number of samples
+ * @param[out] out - Results, room for n
+ * @return Number of results written to out
+ */
+uint32_t ad7708_oversample_process(ad7708_oversample* os, const ad7708_sample* in, uint32_t n, ad7708_oversample_result* out);
+
+/*!
+ * @brief Pop up to max samples from a ring and accumulate them
+ * @param[in] os - Pointer to the engine
+ * @param[in] ring - Sample ring, the engine is its consumer
+ * @param[out] out - Results, room for max
+ * @param[in] max - Samples to take from the ring at most
+ * @return Number of results written to out
+ */
+uint32_t ad7708_oversample_drain(ad7708_oversample* os, ad7708_ring* ring, ad7708_oversample_result* out, uint32_t max);
+
+/*!
+ * @brief Report rate, resolution and measured noise reduction of a channel
+ * @param[in] os - Pointer to the engine
+ * @param[in] channel - Channel code, 0..15
+ * @param[out] report - Filled in
+ * @return 0: case of success, error code otherwise.
+ * @note The rate is the channel's share of the stream so far divided by its ratio
+ */
+StatusTypeDef ad7708_oversample_getReport(const ad7708_oversample* os, uint8_t channel, ad7708_oversample_report* report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
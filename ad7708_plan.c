@@ -0,0 +1,153 @@
+#include "ad7708_plan.h"
+#include "ad7708.h"
+
+#include <stddef.h>
+
+/********************** Static function declarations ************************/
+
+/*!
+ * @brief Integer square root
+ * @param[in] x - Radicand
+ * @return floor(sqrt(x))
+ */
+static uint32_t isqrt(uint64_t x);
+
+/*
+ * Input referred rms noise per range at the reference rate, nV. Typical
+ * figures for this part family, tune per board: the estimate only ranks
+ * configurations against each other.
+ */
+#define NOISE_REF_MILLIHZ 19790UL // SF 69 with chop
+static const uint16_t noiseRefNv[8] = { 900, 900, 1000, 1100, 1300, 1600, 2000, 2500 };
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Conversion period
+ */
+uint32_t ad7708_plan_periodNs(uint8_t sf, uint8_t chop)
+{
+    uint8_t sfMin = chop ? AD7708_PLAN_SF_MIN_CHOP : AD7708_PLAN_SF_MIN;
+
+    if (sf < sfMin) { sf = sfMin; }
+
+    return (uint32_t)((uint64_t)sf * (chop ? 24U : 8U) * 1000000000ULL / AD7708_PLAN_FMOD_HZ);
+}
+
+/*!
+ * @brief Time from a channel switch or mode start to the first settled result
+ */
+uint32_t ad7708_plan_settleNs(uint8_t sf, uint8_t chop)
+{
+    return ad7708_plan_periodNs(sf, chop) * (chop ? 2U : 3U);
+}
+
+/*!
+ * @brief Time per sample of a continuous scan
+ */
+uint32_t ad7708_plan_stepNs(uint8_t sf, uint8_t chop, uint8_t channels, uint32_t byteNs)
+{
+    if (channels <= 1) { return ad7708_plan_periodNs(sf, chop); }
+
+    // Every sample switches channel, the filter restarts once the control write is clocked in
+    return ad7708_plan_settleNs(sf, chop) + (AD7708_PLAN_SWITCH_BYTES - 1U) * byteNs;
+}
+
+/*!
+ * @brief Predicted performance of a given configuration
+ */
+void ad7708_plan_evaluate(const ad7708_plan_request* req, uint8_t sf, ad7708_plan* plan)
+{
+    uint8_t chop = req->chop ? 1 : 0;
+    uint8_t channels = req->channels ? req->channels : 1;
+    uint32_t byteNs = req->byteNs ? req->byteNs : AD7708_PLAN_BYTE_NS;
+    uint8_t sfMin = chop ? AD7708_PLAN_SF_MIN_CHOP : AD7708_PLAN_SF_MIN;
+    uint32_t lsbNv;
+
+    if (sf < sfMin) { sf = sfMin; }
+
+    plan->sf = sf;
+    plan->chop = chop;
+    plan->periodNs = ad7708_plan_periodNs(sf, chop);
+    plan->settleNs = ad7708_plan_settleNs(sf, chop);
+    plan->stepNs = ad7708_plan_stepNs(sf, chop, channels, byteNs);
+    plan->odrMilliHz = (uint32_t)(1000000000000ULL / plan->periodNs);
+    plan->aggregateMilliHz = (uint32_t)(1000000000000ULL / plan->stepNs);
+    plan->channelRateMilliHz = plan->aggregateMilliHz / channels;
+    plan->feasible = plan->channelRateMilliHz >= req->rateMilliHz;
+
+    // White noise scales with the square root of the filter bandwidth, which tracks the output rate
+    plan->noiseNv = (uint32_t)(noiseRefNv[req->range & 0x07U] * (uint64_t)isqrt((uint64_t)plan->odrMilliHz * 1000000ULL / NOISE_REF_MILLIHZ) / 1000U);
+
+    // Bipolar span is 2 * 20 mV << range over 65536 codes
+    lsbNv = (40000000UL << (req->range & 0x07U)) / 65536UL;
+    plan->noiseLsbX100 = (uint16_t)((uint64_t)plan->noiseNv * 100U / lsbNv);
+}
+
+/*!
+ * @brief Lowest noise configuration meeting the requested rate
+ */
+StatusTypeDef ad7708_plan_compute(const ad7708_plan_request* req, ad7708_plan* plan)
+{
+    uint8_t sfMin = req->chop ? AD7708_PLAN_SF_MIN_CHOP : AD7708_PLAN_SF_MIN;
+    uint32_t lo = sfMin, hi = AD7708_PLAN_SF_MAX;
+
+    if (req->channels == 0 || req->channels > 16 || req->rateMilliHz == 0) { return AD7708_ERROR; }
+
+    // Rate falls monotonically with SF, binary search the largest SF that still meets it
+    ad7708_plan_evaluate(req, sfMin, plan);
+    if (!plan->feasible) { return AD7708_ERROR; }
+
+    while (lo < hi)
+    {
+        uint32_t mid = (lo + hi + 1U) / 2U;
+        ad7708_plan_evaluate(req, (uint8_t)mid, plan);
+        if (plan->feasible) { lo = mid; }
+        else { hi = mid - 1U; }
+    }
+    ad7708_plan_evaluate(req, (uint8_t)lo, plan);
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Program the filter word and chop bit of a plan in one frame
+ */
+StatusTypeDef ad7708_plan_apply(ad7708_dev* dev, const ad7708_plan* plan)
+{
+    ModeReg mode = dev->modeReg;
+    ad7708_op ops[2];
+
+    mode.bits.chop = plan->chop;
+
+    // Filter first so a running conversion restarts with both settings
+    ops[0].reg = FILTER_REG;
+    ops[0].rw = AD7708_Write;
+    ops[0].value = plan->sf;
+    ops[1].reg = MODE_REG;
+    ops[1].rw = AD7708_Write;
+    ops[1].value = mode.byte;
+
+    return ad7708_batch(dev, ops, 2);
+}
+
+/****************** Static Function Definitions *******************************/
+
+static uint32_t isqrt(uint64_t x)
+{
+    uint64_t r = 0, bit = 1ULL << 62;
+
+    while (bit > x) { bit >>= 2; }
+    while (bit != 0)
+    {
+        if (x >= r + bit)
+        {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        }
+        else { r >>= 1; }
+        bit >>= 2;
+    }
+
+    return (uint32_t)r;
+}
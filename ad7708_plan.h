@@ -0,0 +1,109 @@
+#ifndef __AD7708_PLAN_H__
+#define __AD7708_PLAN_H__
+
+#include "ad7708_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Filter planning from target rates instead of raw SF words.
+ *
+ * Timing model, f_MOD = 32768 Hz:
+ *   conversion period  T = 8 * SF / f_MOD, 24 * SF / f_MOD with chop
+ *   settling           3 T after a channel switch, 2 T with chop
+ *   scan step          T for a single channel, settling + switch frame otherwise
+ * The planner picks the largest SF, hence the lowest noise, that still meets
+ * the requested per-channel rate.
+ */
+
+#define AD7708_PLAN_FMOD_HZ 32768U
+#define AD7708_PLAN_SF_MIN 0x03U       // Chop disabled
+#define AD7708_PLAN_SF_MIN_CHOP 0x0DU  // Chop enabled
+#define AD7708_PLAN_SF_MAX 0xFFU
+#define AD7708_PLAN_BYTE_NS 2000U      // Default SPI byte time, 4 MHz SCLK
+#define AD7708_PLAN_SWITCH_BYTES 5U    // Data read + control write, see ad7708_scan
+
+/*! @name What the application needs */
+typedef struct
+{
+    uint32_t rateMilliHz; // Per channel sample rate
+    uint8_t channels;     // Channels in the scan list, 1..16
+    uint8_t chop;
+    AD7708_Range range;   // Used for the noise estimate only
+    uint32_t byteNs;      // SPI byte time, 0: AD7708_PLAN_BYTE_NS
+} ad7708_plan_request;
+
+/*! @name Chosen configuration and its predicted performance */
+typedef struct
+{
+    uint8_t sf;
+    uint8_t chop;
+    uint8_t feasible;             // 0: target not reachable, fastest configuration returned
+    uint32_t odrMilliHz;          // Conversion rate of the modulator/filter
+    uint32_t periodNs;
+    uint32_t settleNs;            // After a channel switch
+    uint32_t stepNs;              // Time per sample of the scan
+    uint32_t channelRateMilliHz;  // Achieved per channel
+    uint32_t aggregateMilliHz;    // All channels together
+    uint32_t noiseNv;             // Predicted input referred rms noise
+    uint16_t noiseLsbX100;        // Same, in 1/100 LSB of the selected range
+} ad7708_plan;
+
+/*!
+ * @brief Conversion period
+ * @param[in] sf - Filter word
+ * @param[in] chop - Chopping enabled
+ * @return Period in ns
+ */
+uint32_t ad7708_plan_periodNs(uint8_t sf, uint8_t chop);
+
+/*!
+ * @brief Time from a channel switch or mode start to the first settled result
+ * @param[in] sf - Filter word
+ * @param[in] chop - Chopping enabled
+ * @return Settling time in ns
+ */
+uint32_t ad7708_plan_settleNs(uint8_t sf, uint8_t chop);
+
+/*!
+ * @brief Time per sample of a continuous scan
+ * @param[in] sf - Filter word
+ * @param[in] chop - Chopping enabled
+ * @param[in] channels - Channels in the scan list
+ * @param[in] byteNs - SPI byte time
+ * @return Step time in ns
+ */
+uint32_t ad7708_plan_stepNs(uint8_t sf, uint8_t chop, uint8_t channels, uint32_t byteNs);
+
+/*!
+ * @brief Predicted performance of a given configuration
+ * @param[in] req - Scan shape, rateMilliHz is ignored
+ * @param[in] sf - Filter word, clamped to the minimum for the chop setting
+ * @param[out] plan - Predicted timing and noise
+ * @return void
+ */
+void ad7708_plan_evaluate(const ad7708_plan_request* req, uint8_t sf, ad7708_plan* plan);
+
+/*!
+ * @brief Lowest noise configuration meeting the requested rate
+ * @param[in] req - Target rate and scan shape
+ * @param[out] plan - Chosen configuration, the fastest one if the target cannot be met
+ * @return 0: case of success, AD7708_ERROR if the target is not reachable or the request is invalid
+ */
+StatusTypeDef ad7708_plan_compute(const ad7708_plan_request* req, ad7708_plan* plan);
+
+/*!
+ * @brief Program the filter word and chop bit of a plan in one frame
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] plan - Plan from ad7708_plan_compute
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_plan_apply(ad7708_dev* dev, const ad7708_plan* plan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,149 @@
+#include "ad7708_poll.h"
+#include "ad7708.h"
+#include "ad7708_instr.h"
+#include "ad7708_plan.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Start continuous conversion and time polls from the current filter setting
+ */
+StatusTypeDef ad7708_poll_start(ad7708_poll* poll, ad7708_dev* dev, ad7708_ring* ring, uint8_t div)
+{
+    StatusTypeDef status;
+    uint8_t chop = dev->modeReg.bits.chop;
+
+    memset(poll, 0, sizeof(*poll));
+    poll->dev = dev;
+    poll->ring = ring;
+    poll->div = div ? div : AD7708_POLL_DIV;
+    poll->periodUs = ad7708_plan_periodNs(dev->filterReg.byte, chop) / 1000U;
+    poll->stepUs = poll->periodUs / poll->div;
+    if (poll->stepUs == 0) { poll->stepUs = 1; }
+
+    status = ad7708_startContinuousConversion(dev);
+    if (status != AD7708_OK) { return status; }
+
+    // The first result follows the settling time, not a single period
+    poll->edgeUs = ad7708_nowUs(dev) + ad7708_plan_settleNs(dev->filterReg.byte, chop) / 1000U - poll->periodUs;
+    poll->nextPollUs = poll->edgeUs + poll->periodUs;
+    poll->running = 1;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Hand range selection of the polled channel to an auto-ranging state
+ */
+void ad7708_poll_setRanger(ad7708_poll* poll, ad7708_ranger* ranger)
+{
+    poll->ranger = ranger;
+}
+
+/*!
+ * @brief Stop polling, the device is left converting
+ */
+void ad7708_poll_stop(ad7708_poll* poll)
+{
+    poll->running = 0;
+}
+
+/*!
+ * @brief Poll if one is due, call from the main loop as often as convenient
+ */
+StatusTypeDef ad7708_poll_service(ad7708_poll* poll)
+{
+    ad7708_dev* dev = poll->dev;
+    statusReg status;
+    ad7708_sample sample;
+    StatusTypeDef result;
+    uint32_t now;
+    uint8_t switched = 0;
+    uint8_t probeHit;
+    uint8_t lost = 0;
+
+    if (!poll->running) { return AD7708_ERROR; }
+
+    now = ad7708_nowUs(dev);
+    if ((int32_t)(now - poll->nextPollUs) < 0) { return AD7708_BUSY; }
+
+    poll->polls++;
+    sample.channel = dev->controlReg.byte >> 4;
+    sample.flags = dev->controlReg.byte & 0x0FU;
+    result = ad7708_readStatusData(dev, &status, &sample.code);
+
+    if (result == AD7708_BUSY)
+    {
+        poll->missed = 1;
+        poll->lastMissUs = now;
+        poll->nextPollUs = now + poll->stepUs;
+        return AD7708_BUSY;
+    }
+    if (result != AD7708_OK)
+    {
+        poll->errors++;
+        poll->nextPollUs = now + poll->stepUs;
+        return result;
+    }
+
+    // The edge is between the last miss and now; without a miss keep the model, never later than now
+    if (poll->missed) { poll->edgeUs = now - (now - poll->lastMissUs) / 2U; }
+    else
+    {
+        poll->edgeUs += poll->periodUs;
+        if ((int32_t)(now - poll->edgeUs) < 0) { poll->edgeUs = now; }
+        if ((int32_t)(now - poll->edgeUs) > (int32_t)poll->periodUs)
+        {
+            // Lost sync, the edge was anywhere in the last period
+            poll->edgeUs = now;
+            lost = 1;
+        }
+    }
+    if (now - poll->edgeUs > poll->latencyMaxUs) { poll->latencyMaxUs = now - poll->edgeUs; }
+    probeHit = poll->probing && !poll->missed; // The edge came earlier still, the model is late
+    poll->missed = 0;
+    poll->probing = 0;
+
+    // Next cycle: just after the expected edge, or one step early to re-measure it
+    poll->nextPollUs = poll->edgeUs + poll->periodUs + poll->stepUs / 4U;
+    if (lost) { poll->nextPollUs = now + poll->stepUs; } // Walk the retry grid until a miss brackets the next edge
+    else if (++poll->sinceProbe >= AD7708_POLL_PROBE || probeHit)
+    {
+        poll->sinceProbe = 0;
+        poll->probing = 1;
+        poll->nextPollUs -= poll->stepUs;
+    }
+
+    if (status.bits.err)
+    {
+        sample.flags |= AD7708_SAMPLE_CLAMPED;
+        poll->clamped++;
+    }
+    if (poll->ranger != NULL && ad7708_range_update(poll->ranger, &sample, status.bits.err, &switched) != AD7708_OK) { poll->errors++; }
+    if (switched)
+    {
+        // The control write restarted the filter, the next result follows the settling time
+        poll->edgeUs = ad7708_nowUs(dev) + ad7708_plan_settleNs(dev->filterReg.byte, dev->modeReg.bits.chop) / 1000U - poll->periodUs;
+        poll->nextPollUs = poll->edgeUs + poll->periodUs;
+        poll->sinceProbe = 0;
+        poll->probing = 0;
+    }
+
+    if (ad7708_ring_pushStamped(poll->ring, &sample, poll->edgeUs) == AD7708_OK) { poll->samples++; }
+    else { poll->fullOverruns++; }
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Time until the next poll is due, for sleeping between calls
+ */
+uint32_t ad7708_poll_dueIn(const ad7708_poll* poll)
+{
+    int32_t left = (int32_t)(poll->nextPollUs - ad7708_nowUs(poll->dev));
+
+    return left > 0 ? (uint32_t)left : 0;
+}
@@ -0,0 +1,102 @@
+#ifndef __AD7708_POLL_H__
+#define __AD7708_POLL_H__
+
+#include "ad7708_defs.h"
+#include "ad7708_range.h"
+#include "ad7708_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Polled acquisition for boards without the RDY pin on an EXTI line.
+ *
+ * Each poll is one CS frame: the status register, followed by the data
+ * register only when RDY is set. Polls are timed from the conversion period
+ * implied by the filter and chop settings: the first poll of a cycle lands
+ * just after the expected edge and, if early, retries every period / div.
+ * Data latency therefore stays within period / div plus the caller's own
+ * scheduling jitter, and a sample usually costs a single 5 byte frame. The
+ * edge estimate is refined from misses, and an early probe every
+ * AD7708_POLL_PROBE samples keeps it from drifting late unnoticed; a probe
+ * that still finds the result waiting is repeated the next cycle until one
+ * misses.
+ *
+ * The status byte of every sample is at hand, so clamped results are flagged
+ * and, with ad7708_poll_setRanger(), drive automatic range selection; after a
+ * switch the next poll waits for the settling time.
+ */
+
+#define AD7708_POLL_DIV 8     // Default retry step, fraction of the conversion period
+#define AD7708_POLL_PROBE 16  // Samples between deliberately early polls
+
+/*! @name Polled acquisition state */
+typedef struct
+{
+    ad7708_dev* dev;
+    ad7708_ring* ring;
+    ad7708_ranger* ranger;   // NULL: fixed range
+    uint8_t running;
+    uint8_t div;
+    uint8_t missed;          // Current cycle already saw a poll with RDY clear
+    uint8_t probing;         // Current cycle started with a deliberately early poll
+    uint8_t sinceProbe;
+    uint32_t periodUs;
+    uint32_t stepUs;         // periodUs / div
+    uint32_t edgeUs;         // Estimated time of the last RDY edge
+    uint32_t lastMissUs;
+    uint32_t nextPollUs;
+    uint32_t polls;
+    uint32_t samples;
+    uint32_t fullOverruns;
+    uint32_t errors;
+    uint32_t clamped;
+    uint32_t latencyMaxUs;   // Upper bound, estimated edge to read
+} ad7708_poll;
+
+/*!
+ * @brief Start continuous conversion and time polls from the current filter setting
+ * @param[in] poll - Pointer to the acquisition state
+ * @param[in] dev - Pointer to the device structure, filter and mode already configured
+ * @param[in] ring - Sample ring
+ * @param[in] div - Retry step as a fraction of the period, 0: AD7708_POLL_DIV
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_poll_start(ad7708_poll* poll, ad7708_dev* dev, ad7708_ring* ring, uint8_t div);
+
+/*!
+ * @brief Hand range selection of the polled channel to an auto-ranging state
+ * @param[in] poll - Pointer to the acquisition state
+ * @param[in] ranger - Initialized auto-ranging state of the same device, NULL to keep the range fixed
+ * @return void
+ * @note Call after ad7708_poll_start(), which clears it
+ */
+void ad7708_poll_setRanger(ad7708_poll* poll, ad7708_ranger* ranger);
+
+/*!
+ * @brief Stop polling, the device is left converting
+ * @param[in] poll - Pointer to the acquisition state
+ * @return void
+ */
+void ad7708_poll_stop(ad7708_poll* poll);
+
+/*!
+ * @brief Poll if one is due, call from the main loop as often as convenient
+ * @param[in] poll - Pointer to the acquisition state
+ * @return 0: a sample was pushed, AD7708_BUSY: nothing due or not ready yet, error code otherwise.
+ */
+StatusTypeDef ad7708_poll_service(ad7708_poll* poll);
+
+/*!
+ * @brief Time until the next poll is due, for sleeping between calls
+ * @param[in] poll - Pointer to the acquisition state
+ * @return us, 0 if a poll is due now
+ */
+uint32_t ad7708_poll_dueIn(const ad7708_poll* poll);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
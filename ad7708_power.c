@@ -0,0 +1,251 @@
+#include "ad7708_power.h"
+#include "ad7708.h"
+#include "ad7708_instr.h"
+#include "ad7708_plan.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/********************** Static function declarations ************************/
+
+/*!
+ * @brief Write the mode register, keeping its configuration bits and the scheduler's OSCPD
+ * @param[in] p - Pointer to the scheduler state
+ * @param[in] mode - Operating mode
+ * @return 0: case of success, error code otherwise.
+ */
+static StatusTypeDef writeMode(ad7708_power* p, AD7708_Mode mode);
+
+/*!
+ * @brief Select the current entry and start a single conversion in one frame
+ * @param[in] p - Pointer to the scheduler state
+ * @return 0: case of success, error code otherwise.
+ */
+static StatusTypeDef startConversion(ad7708_power* p);
+
+/*!
+ * @brief Power down and close the accounting of the running scan
+ * @param[in] p - Pointer to the scheduler state
+ * @param[in] status - Outcome of the scan
+ * @return status, or the power-down error
+ */
+static StatusTypeDef finishScan(ad7708_power* p, StatusTypeDef status);
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Load the scan list and power the part down until the first scan
+ */
+StatusTypeDef ad7708_power_start(ad7708_power* p, ad7708_dev* dev, const ad7708_scan_entry* entries, uint8_t count, ad7708_ring* ring,
+    uint32_t intervalMs, uint8_t oscOff)
+{
+    StatusTypeDef status;
+
+    if (count == 0 || count > AD7708_SCAN_MAX) { return AD7708_ERROR; }
+
+    memset(p, 0, sizeof(*p));
+    p->dev = dev;
+    p->ring = ring;
+    p->count = count;
+    p->oscOff = oscOff ? 1U : 0U;
+    p->intervalUs = intervalMs * 1000U;
+    p->convUs = ad7708_plan_settleNs(dev->filterReg.byte, dev->modeReg.bits.chop) / 1000U + 1U;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        ControlReg reg = { 0 };
+
+        reg.merged.channelConfig = entries[i].channel;
+        reg.merged.range = entries[i].range;
+        reg.bits.ub = entries[i].polarity;
+        p->control[i] = reg.byte;
+        p->discard[i] = entries[i].discard;
+    }
+
+    status = writeMode(p, AD7708_PowerDown);
+    if (status != AD7708_OK) { return status; }
+
+    p->state = AD7708_POWER_SLEEP;
+    p->nextUs = ad7708_nowUs(dev);
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Power the part down and stop scheduling
+ */
+StatusTypeDef ad7708_power_stop(ad7708_power* p)
+{
+    p->state = AD7708_POWER_STOPPED;
+
+    return writeMode(p, AD7708_PowerDown);
+}
+
+/*!
+ * @brief Run the step that is due, call after waking up
+ */
+StatusTypeDef ad7708_power_service(ad7708_power* p)
+{
+    ad7708_dev* dev = p->dev;
+    statusReg status;
+    ad7708_sample sample;
+    StatusTypeDef result;
+    uint32_t now;
+
+    if (p->state == AD7708_POWER_STOPPED) { return AD7708_ERROR; }
+
+    now = ad7708_nowUs(dev);
+    if ((int32_t)(now - p->nextUs) < 0) { return AD7708_BUSY; }
+
+    switch (p->state)
+    {
+    case AD7708_POWER_SLEEP:
+        memset(&p->current, 0, sizeof(p->current));
+#if AD7708_INSTRUMENT
+        p->bytesStart = dev->instr.spiBytes;
+        p->csStart = dev->instr.csToggles;
+#endif
+        p->scanStartUs = now;
+        p->index = 0;
+        p->discardLeft = p->discard[0];
+
+        // A running oscillator keeps the PLL locked, wake straight into the first conversion
+        if (!p->oscOff)
+        {
+            if (startConversion(p) != AD7708_OK) { return finishScan(p, AD7708_ERROR); }
+            return AD7708_BUSY;
+        }
+
+        if (writeMode(p, AD7708_Idle) != AD7708_OK) { return finishScan(p, AD7708_ERROR); }
+        p->state = AD7708_POWER_LOCKING;
+        p->lockStartUs = now;
+        p->nextUs = now + (p->lockEstUs > AD7708_POWER_LOCK_POLL_US ? p->lockEstUs : AD7708_POWER_LOCK_POLL_US);
+        return AD7708_BUSY;
+
+    case AD7708_POWER_LOCKING:
+        if (ad7708_readStatus(dev, &status) != AD7708_OK) { return finishScan(p, AD7708_ERROR); }
+        if (!status.bits.lock)
+        {
+            p->current.polls++;
+            if ((now - p->lockStartUs) >= AD7708_POWER_LOCK_TIMEOUT_US)
+            {
+                p->lockTimeouts++;
+                return finishScan(p, AD7708_TIMEOUT);
+            }
+            p->nextUs = now + AD7708_POWER_LOCK_POLL_US;
+            return AD7708_BUSY;
+        }
+
+        // The measured wait overshoots by up to one poll, aim the next first poll just below it
+        p->current.lockUs = now - p->lockStartUs;
+        p->lockEstUs = p->current.lockUs - AD7708_POWER_LOCK_POLL_US;
+        if (startConversion(p) != AD7708_OK) { return finishScan(p, AD7708_ERROR); }
+        return AD7708_BUSY;
+
+    case AD7708_POWER_CONVERT:
+        result = ad7708_readStatusData(dev, &status, &sample.code);
+        if (result == AD7708_BUSY)
+        {
+            // Late by a fraction of the conversion, the oscillator may run slow
+            p->current.polls++;
+            p->nextUs = now + p->convUs / 8U + 1U;
+            return AD7708_BUSY;
+        }
+        if (result != AD7708_OK) { return finishScan(p, AD7708_ERROR); }
+
+        p->current.conversions++;
+        if (p->discardLeft != 0) { p->discardLeft--; }
+        else
+        {
+            sample.channel = p->control[p->index] >> 4;
+            sample.flags = p->control[p->index] & 0x0FU;
+            if (status.bits.err) { sample.flags |= AD7708_SAMPLE_CLAMPED; }
+            if (ad7708_ring_pushStamped(p->ring, &sample, now) == AD7708_OK) { p->samples++; }
+            else { p->fullOverruns++; }
+
+            if (++p->index == p->count) { return finishScan(p, AD7708_OK); }
+            p->discardLeft = p->discard[p->index];
+        }
+
+        if (startConversion(p) != AD7708_OK) { return finishScan(p, AD7708_ERROR); }
+        return AD7708_BUSY;
+
+    default:
+        return AD7708_ERROR;
+    }
+}
+
+/*!
+ * @brief Time the MCU may sleep before the next step
+ */
+uint32_t ad7708_power_dueIn(const ad7708_power* p)
+{
+    int32_t left = (int32_t)(p->nextUs - ad7708_nowUs(p->dev));
+
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+/*!
+ * @brief Average on-time per scan so far
+ */
+uint32_t ad7708_power_activeAvgUs(const ad7708_power* p)
+{
+    return p->scans ? (uint32_t)(p->totalActiveUs / p->scans) : 0;
+}
+
+/****************** Static Function Definitions *******************************/
+
+static StatusTypeDef writeMode(ad7708_power* p, AD7708_Mode mode)
+{
+    ModeReg reg = p->dev->modeReg;
+
+    return ad7708_modeConfig(p->dev, mode, reg.bits.chcon, reg.bits.refsel, reg.bits.chop, reg.bits.negbuf, p->oscOff);
+}
+
+static StatusTypeDef startConversion(ad7708_power* p)
+{
+    ad7708_dev* dev = p->dev;
+    ModeReg mode = dev->modeReg;
+    ad7708_op ops[2];
+    StatusTypeDef status;
+
+    mode.merged.mode = AD7708_SingleConversion;
+    mode.bits.oscpd = p->oscOff;
+
+    ops[0].reg = CONTROL_REG;
+    ops[0].rw = AD7708_Write;
+    ops[0].value = p->control[p->index];
+    ops[1].reg = MODE_REG;
+    ops[1].rw = AD7708_Write;
+    ops[1].value = mode.byte;
+
+    status = ad7708_batch(dev, ops, 2);
+    p->state = AD7708_POWER_CONVERT;
+    p->nextUs = ad7708_nowUs(dev) + p->convUs;
+
+    return status;
+}
+
+static StatusTypeDef finishScan(ad7708_power* p, StatusTypeDef status)
+{
+    ad7708_dev* dev = p->dev;
+    StatusTypeDef down = writeMode(p, AD7708_PowerDown);
+    uint32_t now = ad7708_nowUs(dev);
+
+    p->current.activeUs = now - p->scanStartUs;
+#if AD7708_INSTRUMENT
+    p->current.spiBytes = dev->instr.spiBytes - p->bytesStart;
+    p->current.csCycles = dev->instr.csToggles - p->csStart;
+#endif
+    p->last = p->current;
+    p->totalActiveUs += p->current.activeUs;
+    p->scans++;
+    if (status != AD7708_OK || down != AD7708_OK) { p->errors++; }
+
+    // Scans start on a fixed grid; one that overran its slot starts the next at once
+    p->state = AD7708_POWER_SLEEP;
+    p->nextUs = p->scanStartUs + p->intervalUs;
+    if ((int32_t)(now - p->nextUs) > 0) { p->nextUs = now; }
+
+    return (status != AD7708_OK) ? status : down;
+}
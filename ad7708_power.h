@@ -0,0 +1,132 @@
+#ifndef __AD7708_POWER_H__
+#define __AD7708_POWER_H__
+
+#include "ad7708_defs.h"
+#include "ad7708_ring.h"
+#include "ad7708_scan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Duty-cycled acquisition for battery powered nodes.
+ *
+ * Between scans the part sits in power-down, with the oscillator stopped when
+ * oscOff is set (OSCPD). Every interval the scheduler wakes it, waits for the
+ * LOCK bit if the oscillator was stopped (first polled just before the lock
+ * time measured on the previous scan), runs one single conversion per scan
+ * entry and powers it down again. Entry selection and the conversion start
+ * share one frame, results come with their status byte in one frame, and the
+ * MCU is only needed when a step is due: ad7708_power_dueIn() tells how long
+ * it may sleep, so the SPI is touched once per conversion in the common case.
+ *
+ * Every scan records its on-time (power-down exit to re-entry), the part of
+ * it spent waiting for lock, the conversions done and, with
+ * AD7708_INSTRUMENT, the SPI bytes and CS frames it took. Keeping the
+ * oscillator running (oscOff = 0) removes the lock wait from every scan at
+ * the cost of the oscillator current between scans.
+ */
+
+#define AD7708_POWER_LOCK_POLL_US 2000U      // Status poll interval while waiting for LOCK
+#define AD7708_POWER_LOCK_TIMEOUT_US 2000000U
+
+typedef enum
+{
+    AD7708_POWER_STOPPED = 0x00U,
+    AD7708_POWER_SLEEP = 0x01U,    // Powered down until the next scan
+    AD7708_POWER_LOCKING = 0x02U,  // Awake, waiting for the PLL
+    AD7708_POWER_CONVERT = 0x03U   // Single conversion of the current entry running
+} AD7708_PowerState;
+
+/*! @name Cost of one scan */
+typedef struct
+{
+    uint32_t activeUs;     // Power-down exit to re-entry
+    uint32_t lockUs;       // Of which waiting for LOCK
+    uint32_t conversions;  // Including discarded ones
+    uint32_t polls;        // Status reads that found no result yet
+    uint32_t spiBytes;     // 0 without AD7708_INSTRUMENT
+    uint32_t csCycles;     // 0 without AD7708_INSTRUMENT
+} ad7708_power_scan;
+
+/*! @name Scheduler state */
+typedef struct
+{
+    ad7708_dev* dev;
+    ad7708_ring* ring;
+    uint8_t control[AD7708_SCAN_MAX]; // Precomputed control register per entry
+    uint8_t discard[AD7708_SCAN_MAX];
+    uint8_t count;
+    uint8_t index;
+    uint8_t discardLeft;
+    uint8_t oscOff;
+    AD7708_PowerState state;
+    uint32_t intervalUs;
+    uint32_t convUs;       // Single conversion time, from the filter setting
+    uint32_t scanStartUs;
+    uint32_t lockStartUs;
+    uint32_t lockEstUs;    // Expected lock wait, learnt from the previous scan
+    uint32_t nextUs;       // When the current step is due
+#if AD7708_INSTRUMENT
+    uint32_t bytesStart;   // Instrumentation counters at the start of the scan
+    uint32_t csStart;
+#endif
+    ad7708_power_scan current;
+    ad7708_power_scan last;  // Last completed scan
+    uint64_t totalActiveUs;
+    uint32_t scans;
+    uint32_t samples;
+    uint32_t fullOverruns;
+    uint32_t lockTimeouts;
+    uint32_t errors;
+} ad7708_power;
+
+/*!
+ * @brief Load the scan list and power the part down until the first scan
+ * @param[in] p - Pointer to the scheduler state
+ * @param[in] dev - Pointer to the device structure, filter and mode bits already configured
+ * @param[in] entries - Scan list, copied; discard counts extra conversions thrown away per entry
+ * @param[in] count - Number of entries, 1..AD7708_SCAN_MAX
+ * @param[in] ring - Sample ring, the application is its consumer
+ * @param[in] intervalMs - Scan period, from one scan start to the next
+ * @param[in] oscOff - 1: stop the oscillator in power-down, 0: keep it running
+ * @return 0: case of success, error code otherwise.
+ * @note The first scan is due at once
+ */
+StatusTypeDef ad7708_power_start(ad7708_power* p, ad7708_dev* dev, const ad7708_scan_entry* entries, uint8_t count, ad7708_ring* ring,
+    uint32_t intervalMs, uint8_t oscOff);
+
+/*!
+ * @brief Power the part down and stop scheduling
+ * @param[in] p - Pointer to the scheduler state
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_power_stop(ad7708_power* p);
+
+/*!
+ * @brief Run the step that is due, call after waking up
+ * @param[in] p - Pointer to the scheduler state
+ * @return 0: a scan completed, AD7708_BUSY: in progress or nothing due, error code otherwise.
+ */
+StatusTypeDef ad7708_power_service(ad7708_power* p);
+
+/*!
+ * @brief Time the MCU may sleep before the next step
+ * @param[in] p - Pointer to the scheduler state
+ * @return us, 0 if a step is due now
+ */
+uint32_t ad7708_power_dueIn(const ad7708_power* p);
+
+/*!
+ * @brief Average on-time per scan so far
+ * @param[in] p - Pointer to the scheduler state
+ * @return us, 0 before the first scan
+ */
+uint32_t ad7708_power_activeAvgUs(const ad7708_power* p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
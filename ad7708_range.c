@@ -0,0 +1,182 @@
+#include "ad7708_range.h"
+#include "ad7708.h"
+#include "ad7708_instr.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/********************** Static function declarations ************************/
+
+/*!
+ * @brief Magnitude of a result relative to the full scale of its range
+ * @param[in] code - Data register value
+ * @param[in] unipolar - Polarity of the conversion
+ * @return 0..65535
+ */
+static uint16_t magnitude(uint16_t code, uint8_t unipolar);
+
+/*!
+ * @brief Select another range on the current channel, restoring cached coefficients
+ * @param[in] r - Pointer to the auto-ranging state
+ * @param[in] channel - Channel configuration bits
+ * @param[in] range - New range
+ * @return 0: case of success, error code otherwise.
+ */
+static StatusTypeDef switchRange(ad7708_ranger* r, uint8_t channel, uint8_t range);
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Initialize with no channel under control
+ */
+void ad7708_range_init(ad7708_ranger* r, ad7708_dev* dev, const ad7708_calstore* cal, const ad7708_calstore_limits* limits)
+{
+    memset(r, 0, sizeof(*r));
+    r->dev = dev;
+    r->cal = cal;
+    r->limits = limits;
+    r->hold = AD7708_RANGE_HOLD;
+    r->minRange = AD7708_Range_20mV;
+    r->maxRange = AD7708_Range_2p56V;
+}
+
+/*!
+ * @brief Put a channel under automatic range control
+ */
+StatusTypeDef ad7708_range_enable(ad7708_ranger* r, AD7708_Channel channel, AD7708_Range range, AD7708_Polarity polarity)
+{
+    ad7708_range_channel* ch;
+
+    if ((uint8_t)channel >= AD7708_RANGE_CHANNELS || range < r->minRange || range > r->maxRange) { return AD7708_ERROR; }
+
+    ch = &r->ch[channel];
+    memset(ch, 0, sizeof(*ch));
+    ch->enabled = 1;
+    ch->range = (uint8_t)range;
+    ch->polarity = (uint8_t)polarity;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Feed a result and switch range when needed
+ */
+StatusTypeDef ad7708_range_update(ad7708_ranger* r, ad7708_sample* sample, uint8_t err, uint8_t* switched)
+{
+    ad7708_range_channel* ch;
+    uint8_t unipolar = (sample->flags & AD7708_SAMPLE_UNIPOLAR) ? 1U : 0U;
+    uint8_t target;
+    uint16_t m;
+    StatusTypeDef status;
+
+    if (switched != NULL) { *switched = 0; }
+    if (err) { sample->flags |= AD7708_SAMPLE_CLAMPED; }
+
+    if (sample->channel >= AD7708_RANGE_CHANNELS) { return AD7708_OK; }
+    ch = &r->ch[sample->channel];
+    if (!ch->enabled || (sample->flags & AD7708_SAMPLE_RANGE_MASK) != ch->range) { return AD7708_OK; }
+
+    m = magnitude(sample->code, unipolar);
+    target = ch->range;
+
+    if (err)
+    {
+        ch->clamps++;
+        // A unipolar result clamped at zero is a negative input, no range fixes that
+        if (!(unipolar && sample->code == 0x0000U)) { target = r->maxRange; }
+    }
+    else if (m >= AD7708_RANGE_UP) { target = (uint8_t)(ch->range + 1U); }
+    else if (m < AD7708_RANGE_DOWN)
+    {
+        if (m > ch->peak) { ch->peak = m; }
+        if (++ch->quiet >= r->hold)
+        {
+            // Every step down doubles the magnitude, stop before it reaches the target ceiling
+            uint32_t p = ch->peak;
+            while (target > r->minRange && (p << 1) <= AD7708_RANGE_TARGET)
+            {
+                p <<= 1;
+                target--;
+            }
+            ch->quiet = 0;
+            ch->peak = 0;
+        }
+    }
+    else
+    {
+        ch->quiet = 0;
+        ch->peak = 0;
+    }
+
+    if (target > r->maxRange) { target = r->maxRange; }
+    if (target == ch->range) { return AD7708_OK; }
+
+    status = switchRange(r, sample->channel, target);
+    if (status != AD7708_OK)
+    {
+        r->errors++;
+        return status;
+    }
+
+    if (target > ch->range) { ch->ups++; }
+    else { ch->downs++; }
+    ch->range = target;
+    ch->quiet = 0;
+    ch->peak = 0;
+    r->switches++;
+    if (switched != NULL) { *switched = 1; }
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Calibrate a channel in every range and cache the coefficients
+ */
+StatusTypeDef ad7708_range_calibrate(ad7708_calstore* table, ad7708_dev* dev, AD7708_Channel channel, AD7708_Polarity polarity, int16_t tempC10,
+    uint32_t stamp)
+{
+    StatusTypeDef status;
+
+    for (uint8_t range = AD7708_Range_20mV; range <= AD7708_Range_2p56V; range++)
+    {
+        status = ad7708_calibrateRange(dev, channel, (AD7708_Range)range, polarity);
+        if (status != AD7708_OK) { return status; }
+        status = ad7708_calstore_capture(table, dev, tempC10, stamp);
+        if (status != AD7708_OK) { return status; }
+    }
+
+    return AD7708_OK;
+}
+
+/****************** Static Function Definitions *******************************/
+
+static uint16_t magnitude(uint16_t code, uint8_t unipolar)
+{
+    uint32_t m;
+
+    if (unipolar) { return code; }
+
+    m = (code >= 0x8000U) ? (uint32_t)(code - 0x8000U) : (uint32_t)(0x8000U - code);
+    m <<= 1;
+
+    return (m > 0xFFFFU) ? 0xFFFFU : (uint16_t)m;
+}
+
+static StatusTypeDef switchRange(ad7708_ranger* r, uint8_t channel, uint8_t range)
+{
+    ad7708_range_channel* ch = &r->ch[channel];
+
+    AD7708_INSTR_TRACE(r->dev, AD7708_TRACE_RANGE, (uint32_t)channel << 4 | range);
+
+    if (r->cal != NULL
+        && ad7708_calstore_restore(r->cal, r->dev, (AD7708_Channel)channel, (AD7708_Range)range, (AD7708_Polarity)ch->polarity, r->limits)
+            == AD7708_OK)
+    {
+        return AD7708_OK;
+    }
+
+    // No usable coefficients: switch anyway, the device keeps the pair of the previous range
+    ch->uncalibrated++;
+
+    return ad7708_channelConfig(r->dev, (AD7708_Channel)channel, (AD7708_Range)range, (AD7708_Polarity)ch->polarity);
+}
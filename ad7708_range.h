@@ -0,0 +1,115 @@
+#ifndef __AD7708_RANGE_H__
+#define __AD7708_RANGE_H__
+
+#include "ad7708_calstore.h"
+#include "ad7708_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Automatic input range selection.
+ *
+ * Every channel under control keeps its current range and the peak magnitude
+ * seen since its last switch. A result above AD7708_RANGE_UP of full scale
+ * moves it one range up. A clamped result (status ERR) says nothing about the
+ * real amplitude, so it moves straight to maxRange: one lost sample instead of
+ * one per step. When the peak stays below AD7708_RANGE_DOWN for hold
+ * consecutive samples it moves down as many steps as keep the peak under
+ * AD7708_RANGE_TARGET of the new range, so the up and down thresholds never
+ * meet.
+ *
+ * A switch writes the control register and, when a table is given, the
+ * offset/gain pair captured for the new range by ad7708_calstore, in one SPI
+ * frame. Nothing is recalibrated; ad7708_range_calibrate() fills the table
+ * once. The device restarts its filter on the control write, so the next
+ * result is settled and carries the new range in ad7708_sample.flags.
+ */
+
+#define AD7708_RANGE_CHANNELS 16
+#define AD7708_RANGE_HOLD 32         // Default quiet samples before stepping down
+
+/* Thresholds on the magnitude, 65535 = full scale of the current range */
+#define AD7708_RANGE_UP 61440U       // 15/16
+#define AD7708_RANGE_DOWN 24576U     // 3/8, 3/4 of the next range down
+#define AD7708_RANGE_TARGET 49152U   // 3/4, upper bound after stepping down
+
+/*! @name Per channel state */
+typedef struct
+{
+    uint8_t enabled;
+    uint8_t range;      // AD7708_Range in use
+    uint8_t polarity;
+    uint16_t peak;      // Largest magnitude of the current quiet window
+    uint16_t quiet;     // Consecutive samples below AD7708_RANGE_DOWN
+    uint32_t ups;
+    uint32_t downs;
+    uint32_t clamps;    // Clamped results seen
+    uint32_t uncalibrated; // Switches made without cached coefficients
+} ad7708_range_channel;
+
+/*! @name Auto-ranging state of one device */
+typedef struct
+{
+    ad7708_dev* dev;
+    const ad7708_calstore* cal;             // NULL: switch ranges without restoring coefficients
+    const ad7708_calstore_limits* limits;   // NULL: accept any cached entry
+    ad7708_range_channel ch[AD7708_RANGE_CHANNELS];
+    uint16_t hold;
+    uint8_t minRange;
+    uint8_t maxRange;
+    uint32_t switches;
+    uint32_t errors;
+} ad7708_ranger;
+
+/*!
+ * @brief Initialize with no channel under control
+ * @param[in] r - Pointer to the auto-ranging state
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] cal - Calibration cache, NULL to switch without restoring coefficients
+ * @param[in] limits - Staleness limits for cached entries, NULL accepts any
+ * @return void
+ */
+void ad7708_range_init(ad7708_ranger* r, ad7708_dev* dev, const ad7708_calstore* cal, const ad7708_calstore_limits* limits);
+
+/*!
+ * @brief Put a channel under automatic range control
+ * @param[in] r - Pointer to the auto-ranging state
+ * @param[in] channel - Channel configuration bits, as in the control register
+ * @param[in] range - Starting range, must match the device when the channel is selected
+ * @param[in] polarity - Polarity, kept across switches
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_range_enable(ad7708_ranger* r, AD7708_Channel channel, AD7708_Range range, AD7708_Polarity polarity);
+
+/*!
+ * @brief Feed a result and switch range when needed
+ * @param[in] r - Pointer to the auto-ranging state
+ * @param[in,out] sample - Result as read, AD7708_SAMPLE_CLAMPED is set when err is
+ * @param[in] err - ERR bit of the status read with the result
+ * @param[out] switched - Set to 1 if the control register was rewritten, may be NULL
+ * @return 0: case of success, error code of the switch frame otherwise.
+ * @note Results of the channel tagged with another range are in flight from before a switch and are ignored
+ */
+StatusTypeDef ad7708_range_update(ad7708_ranger* r, ad7708_sample* sample, uint8_t err, uint8_t* switched);
+
+/*!
+ * @brief Calibrate a channel in every range and cache the coefficients
+ * @param[in] table - Calibration cache
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] channel - Desired channel
+ * @param[in] polarity - Desired polarity
+ * @param[in] tempC10 - Current temperature in 0.1 degC
+ * @param[in] stamp - Current time
+ * @return 0: case of success, error code otherwise.
+ * @note Blocking, one internal zero and full-scale calibration per range; the device is left idle
+ */
+StatusTypeDef ad7708_range_calibrate(ad7708_calstore* table, ad7708_dev* dev, AD7708_Channel channel, AD7708_Polarity polarity, int16_t tempC10,
+    uint32_t stamp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
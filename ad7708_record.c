@@ -0,0 +1,445 @@
+#ifndef AD7708_RECORD_NO_READER
+#define _POSIX_C_SOURCE 200809L // mmap, fstat
+#endif
+
+#include "ad7708_record.h"
+#include "ad7708_crc.h"
+
+#include <string.h>
+
+#ifndef AD7708_RECORD_NO_READER
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+typedef char hdrIs24Bytes[(sizeof(ad7708_record_block_hdr) == 24) ? 1 : -1]; // Part of the file format
+typedef char configIs20Bytes[(sizeof(ad7708_record_config) == 20) ? 1 : -1];
+
+/********************** Static function declarations ************************/
+
+/*!
+ * @brief Checksum and hand a finished block to the sink
+ * @param[in] w - Pointer to the writer
+ * @param[in] type - Block type
+ * @param[in] count - Samples, DATA blocks only
+ * @param[in] t0 - Block time
+ * @return 0: case of success, error code otherwise.
+ */
+static StatusTypeDef emitBlock(ad7708_record_writer* w, uint8_t type, uint16_t count, uint64_t t0);
+
+/*!
+ * @brief Capture the register shadow of a device
+ * @param[in] w - Pointer to the writer
+ * @param[in] dev - Pointer to the device structure
+ * @return void
+ */
+static void captureConfig(ad7708_record_writer* w, const ad7708_dev* dev);
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Start a record and write its first configuration block
+ */
+StatusTypeDef ad7708_record_open(ad7708_record_writer* w, const ad7708_record_sink* sink, const ad7708_dev* dev, uint32_t tickHz, uint64_t t)
+{
+    if (sink->write == NULL || tickHz == 0) { return AD7708_ERROR; }
+
+    memset(w, 0, sizeof(*w));
+    w->sink = *sink;
+    w->config.magic = AD7708_RECORD_MAGIC;
+    w->config.version = AD7708_RECORD_VERSION;
+    w->config.blockBytes = AD7708_RECORD_BLOCK_BYTES;
+    w->config.tickHz = tickHz;
+
+    return ad7708_record_config_update(w, dev, t);
+}
+
+/*!
+ * @brief Record a configuration change, flushing pending samples first
+ */
+StatusTypeDef ad7708_record_config_update(ad7708_record_writer* w, const ad7708_dev* dev, uint64_t t)
+{
+    StatusTypeDef status = ad7708_record_flush(w);
+    if (status != AD7708_OK) { return status; }
+
+    captureConfig(w, dev);
+    memset(w->block, 0, sizeof(w->block));
+    memcpy(w->block + sizeof(ad7708_record_block_hdr), &w->config, sizeof(w->config));
+
+    return emitBlock(w, AD7708_RECORD_CONFIG, 0, t);
+}
+
+/*!
+ * @brief Append one sample
+ */
+StatusTypeDef ad7708_record_append(ad7708_record_writer* w, const ad7708_sample* sample, uint64_t t)
+{
+    uint64_t delta = t - w->last;
+    uint8_t need = 1;
+
+    if (w->count != 0)
+    {
+        // Gaps beyond 32 bits start a new block, so a varint never exceeds 5 bytes
+        if (t < w->last || delta > 0xFFFFFFFFULL) { need = 0xFF; }
+        else
+        {
+            for (uint64_t v = delta; v >= 0x80U; v >>= 7) { need++; }
+        }
+
+        if (need == 0xFF || sizeof(ad7708_record_block_hdr) + 4U * (w->count + 1U) + w->deltaBytes + need > AD7708_RECORD_BLOCK_BYTES)
+        {
+            StatusTypeDef status = ad7708_record_flush(w);
+            if (status != AD7708_OK) { return status; }
+        }
+    }
+
+    if (w->count == 0) { w->t0 = t; }
+    else
+    {
+        while (delta >= 0x80U)
+        {
+            w->deltas[w->deltaBytes++] = (uint8_t)(delta | 0x80U);
+            delta >>= 7;
+        }
+        w->deltas[w->deltaBytes++] = (uint8_t)delta;
+    }
+
+    w->codes[w->count] = sample->code;
+    w->tags[w->count] = (uint16_t)(sample->channel << 8 | sample->flags);
+    w->count++;
+    w->last = t;
+    w->samples++;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Append a block of samples
+ */
+StatusTypeDef ad7708_record_appendBlock(ad7708_record_writer* w, const ad7708_sample* samples, const uint64_t* t, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        StatusTypeDef status = ad7708_record_append(w, &samples[i], t[i]);
+        if (status != AD7708_OK) { return status; }
+    }
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Write the pending samples as a padded block
+ */
+StatusTypeDef ad7708_record_flush(ad7708_record_writer* w)
+{
+    uint8_t* p = w->block + sizeof(ad7708_record_block_hdr);
+    uint16_t count = w->count;
+
+    if (count == 0) { return AD7708_OK; }
+
+    memset(w->block, 0, sizeof(w->block));
+    memcpy(p, w->codes, 2U * count);
+    p += 2U * count;
+    memcpy(p, w->tags, 2U * count);
+    p += 2U * count;
+    memcpy(p, w->deltas, w->deltaBytes);
+
+    w->count = 0;
+    ((ad7708_record_block_hdr*)w->block)->deltaBytes = w->deltaBytes;
+    w->deltaBytes = 0;
+
+    return emitBlock(w, AD7708_RECORD_DATA, count, w->t0);
+}
+
+/****************** Static Function Definitions *******************************/
+
+static StatusTypeDef emitBlock(ad7708_record_writer* w, uint8_t type, uint16_t count, uint64_t t0)
+{
+    ad7708_record_block_hdr* hdr = (ad7708_record_block_hdr*)w->block;
+
+    hdr->sync = AD7708_RECORD_SYNC;
+    hdr->type = type;
+    hdr->count = count;
+    hdr->seq = w->seq++;
+    hdr->crc = 0;
+    hdr->t0 = t0;
+    hdr->crc = ad7708_crc16(AD7708_CRC16_INIT, w->block, AD7708_RECORD_BLOCK_BYTES);
+
+    if (w->sink.write(w->sink.ctx, w->block, AD7708_RECORD_BLOCK_BYTES) != AD7708_OK)
+    {
+        w->errors++;
+        return AD7708_ERROR;
+    }
+
+    return AD7708_OK;
+}
+
+static void captureConfig(ad7708_record_writer* w, const ad7708_dev* dev)
+{
+    w->config.mode = dev->modeReg.byte;
+    w->config.control = dev->controlReg.byte;
+    w->config.filter = dev->filterReg.byte;
+    w->config.ioControl = dev->ioControlReg.byte;
+}
+
+#ifndef AD7708_RECORD_NO_READER
+
+/********************** Host reader ************************/
+
+/*!
+ * @brief Check a block in place
+ * @param[in] block - Start of the block
+ * @return 0: case of success, AD7708_ERROR on a bad sync, CRC or layout
+ */
+static StatusTypeDef checkBlock(const uint8_t* block);
+
+/*!
+ * @brief Load the cursor with the view of an index entry
+ * @param[in] it - Cursor
+ * @param[in] entry - Index entry
+ * @return 0: case of success, AD7708_ERROR past the last block
+ */
+static StatusTypeDef enterBlock(ad7708_record_iter* it, uint32_t entry);
+
+static StatusTypeDef fileWrite(void* ctx, const void* block, uint32_t len);
+
+/*!
+ * @brief Sink appending blocks to a stdio stream
+ */
+void ad7708_record_fileSink(ad7708_record_sink* sink, void* file)
+{
+    sink->write = fileWrite;
+    sink->ctx = file;
+}
+
+/*!
+ * @brief Map a record file and index its blocks
+ */
+StatusTypeDef ad7708_record_map(ad7708_record_reader* r, const char* path)
+{
+    struct stat st;
+    void* map;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) { return AD7708_ERROR; }
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)AD7708_RECORD_BLOCK_BYTES)
+    {
+        close(fd);
+        return AD7708_ERROR;
+    }
+
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        close(fd);
+        return AD7708_ERROR;
+    }
+
+    if (ad7708_record_attach(r, map, (size_t)st.st_size) != AD7708_OK)
+    {
+        munmap(map, (size_t)st.st_size);
+        close(fd);
+        return AD7708_ERROR;
+    }
+    r->fd = fd;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Index a record already in memory
+ */
+StatusTypeDef ad7708_record_attach(ad7708_record_reader* r, const void* data, size_t size)
+{
+    size_t total = size / AD7708_RECORD_BLOCK_BYTES;
+    uint32_t config = UINT32_MAX;
+
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    r->base = (const uint8_t*)data;
+    r->size = size;
+    if (total == 0) { return AD7708_ERROR; }
+
+    r->index = (ad7708_record_index*)malloc(total * sizeof(ad7708_record_index));
+    if (r->index == NULL) { return AD7708_ERROR; }
+
+    // One header read per block, the sample payload is not touched until iterated
+    for (size_t b = 0; b < total; b++)
+    {
+        const uint8_t* block = r->base + b * AD7708_RECORD_BLOCK_BYTES;
+        const ad7708_record_block_hdr* hdr = (const ad7708_record_block_hdr*)block;
+
+        if (checkBlock(block) != AD7708_OK)
+        {
+            r->badBlocks++;
+            continue;
+        }
+        if (hdr->type == AD7708_RECORD_CONFIG)
+        {
+            const ad7708_record_config* cfg = (const ad7708_record_config*)(block + sizeof(ad7708_record_block_hdr));
+
+            // Data of another layout version would be misread, drop it with its configuration
+            if (cfg->magic != AD7708_RECORD_MAGIC || cfg->version != AD7708_RECORD_VERSION) { config = UINT32_MAX; }
+            else { config = (uint32_t)b; }
+            continue;
+        }
+        if (config == UINT32_MAX || hdr->count == 0)
+        {
+            r->badBlocks++; // Data before any usable configuration cannot be interpreted
+            continue;
+        }
+
+        r->index[r->blocks].t0 = hdr->t0;
+        r->index[r->blocks].block = (uint32_t)b;
+        r->index[r->blocks].config = config;
+        r->blocks++;
+    }
+
+    if (r->blocks == 0) { return AD7708_ERROR; }
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Release the index and the mapping
+ */
+void ad7708_record_close(ad7708_record_reader* r)
+{
+    free(r->index);
+    if (r->fd >= 0)
+    {
+        munmap((void*)r->base, r->size);
+        close(r->fd);
+    }
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+/*!
+ * @brief View of an indexed DATA block
+ */
+StatusTypeDef ad7708_record_block(const ad7708_record_reader* r, uint32_t entry, ad7708_record_view* view)
+{
+    const uint8_t* block;
+    uint16_t count;
+
+    if (entry >= r->blocks) { return AD7708_ERROR; }
+
+    block = r->base + (size_t)r->index[entry].block * AD7708_RECORD_BLOCK_BYTES;
+    view->hdr = (const ad7708_record_block_hdr*)block;
+    view->config = (const ad7708_record_config*)(r->base + (size_t)r->index[entry].config * AD7708_RECORD_BLOCK_BYTES + sizeof(ad7708_record_block_hdr));
+
+    count = view->hdr->count;
+    view->codes = (const uint16_t*)(block + sizeof(ad7708_record_block_hdr));
+    view->tags = view->codes + count;
+    view->deltas = (const uint8_t*)(view->tags + count);
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Position a cursor on the first sample at or after a time
+ */
+StatusTypeDef ad7708_record_seek(const ad7708_record_reader* r, ad7708_record_iter* it, uint64_t t)
+{
+    uint32_t lo = 0, hi = r->blocks;
+    ad7708_record_item item;
+
+    it->reader = r;
+
+    // Last block starting at or before t, the sample may sit anywhere inside it
+    while (hi - lo > 1)
+    {
+        uint32_t mid = lo + (hi - lo) / 2U;
+        if (r->index[mid].t0 <= t) { lo = mid; }
+        else { hi = mid; }
+    }
+    if (enterBlock(it, lo) != AD7708_OK) { return AD7708_ERROR; }
+
+    for (;;)
+    {
+        ad7708_record_iter prev = *it;
+        if (ad7708_record_next(it, &item) != AD7708_OK) { return AD7708_ERROR; }
+        if (item.t >= t)
+        {
+            *it = prev;
+            return AD7708_OK;
+        }
+    }
+}
+
+/*!
+ * @brief Decode the next sample
+ */
+StatusTypeDef ad7708_record_next(ad7708_record_iter* it, ad7708_record_item* item)
+{
+    uint16_t tag;
+
+    while (it->i >= it->view.hdr->count)
+    {
+        if (enterBlock(it, it->entry + 1U) != AD7708_OK) { return AD7708_ERROR; }
+    }
+
+    if (it->i == 0) { it->t = it->view.hdr->t0; }
+    else
+    {
+        uint64_t delta = 0;
+        uint8_t shift = 0, byte;
+        do
+        {
+            byte = *it->delta++;
+            delta |= (uint64_t)(byte & 0x7FU) << shift;
+            shift += 7;
+        } while (byte & 0x80U);
+        it->t += delta;
+    }
+
+    tag = it->view.tags[it->i];
+    item->t = it->t;
+    item->code = it->view.codes[it->i];
+    item->channel = (uint8_t)(tag >> 8);
+    item->flags = (uint8_t)tag;
+    it->i++;
+
+    return AD7708_OK;
+}
+
+static StatusTypeDef checkBlock(const uint8_t* block)
+{
+    ad7708_record_block_hdr hdr;
+    uint16_t crc;
+
+    memcpy(&hdr, block, sizeof(hdr));
+    if (hdr.sync != AD7708_RECORD_SYNC) { return AD7708_ERROR; }
+    if (hdr.type == AD7708_RECORD_DATA && sizeof(hdr) + 4U * hdr.count + hdr.deltaBytes > AD7708_RECORD_BLOCK_BYTES) { return AD7708_ERROR; }
+    if (hdr.type != AD7708_RECORD_DATA && hdr.type != AD7708_RECORD_CONFIG) { return AD7708_ERROR; }
+
+    // CRC was computed with the crc field zeroed
+    hdr.crc = 0;
+    crc = ad7708_crc16(AD7708_CRC16_INIT, &hdr, sizeof(hdr));
+    crc = ad7708_crc16(crc, block + sizeof(hdr), AD7708_RECORD_BLOCK_BYTES - sizeof(hdr));
+
+    return crc == ((const ad7708_record_block_hdr*)block)->crc ? AD7708_OK : AD7708_ERROR;
+}
+
+static StatusTypeDef enterBlock(ad7708_record_iter* it, uint32_t entry)
+{
+    if (ad7708_record_block(it->reader, entry, &it->view) != AD7708_OK) { return AD7708_ERROR; }
+
+    it->entry = entry;
+    it->i = 0;
+    it->delta = it->view.deltas;
+
+    return AD7708_OK;
+}
+
+static StatusTypeDef fileWrite(void* ctx, const void* block, uint32_t len)
+{
+    return fwrite(block, 1, len, (FILE*)ctx) == len ? AD7708_OK : AD7708_ERROR;
+}
+
+#endif
@@ -0,0 +1,259 @@
+#ifndef __AD7708_RECORD_H__
+#define __AD7708_RECORD_H__
+
+#include <stddef.h>
+
+#include "ad7708_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary sample record.
+ *
+ * A record is a sequence of AD7708_RECORD_BLOCK_BYTES blocks, one SD/flash
+ * sector each, little endian. Every block starts with ad7708_record_block_hdr
+ * and is protected by a CRC-16:
+ *   CONFIG block - ad7708_record_config: register values and timestamp unit.
+ *                  First block of a record, repeated whenever the
+ *                  configuration changes.
+ *   DATA block   - count samples stored as arrays:
+ *                    uint16_t codes[count]
+ *                    uint16_t tags[count]      channel << 8 | flags, mux address and clamp included
+ *                    varint   deltas[count-1]  LEB128 tick delta to the previous sample
+ *                  The first sample is at hdr.t0.
+ *
+ * The writer runs in the acquisition path with no allocation and hands whole
+ * blocks to a sink. The host reader maps a file, builds an index of block
+ * start times and iterates samples straight out of the mapping. Define
+ * AD7708_RECORD_NO_READER on targets without POSIX mmap.
+ */
+
+#define AD7708_RECORD_BLOCK_BYTES 512U
+#define AD7708_RECORD_SYNC 0xAD78U
+#define AD7708_RECORD_MAGIC 0x52374441UL // "AD7R"
+#define AD7708_RECORD_VERSION 2 // 1: one byte tags without mux address and clamp
+#define AD7708_RECORD_CONFIG 0x01U
+#define AD7708_RECORD_DATA 0x02U
+
+/*! @name Header of every block */
+typedef struct
+{
+    uint16_t sync;       // AD7708_RECORD_SYNC
+    uint8_t type;        // AD7708_RECORD_CONFIG / AD7708_RECORD_DATA
+    uint8_t reserved;
+    uint16_t count;      // Samples in a DATA block
+    uint16_t deltaBytes; // Size of the varint delta stream
+    uint32_t seq;        // Block number in the record
+    uint16_t crc;        // CRC-16 of the whole block with this field zeroed
+    uint16_t reserved2;
+    uint64_t t0;         // Time of the first sample, or of the configuration change
+} ad7708_record_block_hdr;
+
+#define AD7708_RECORD_PAYLOAD (AD7708_RECORD_BLOCK_BYTES - sizeof(ad7708_record_block_hdr))
+#define AD7708_RECORD_MAX_SAMPLES (AD7708_RECORD_PAYLOAD / 4U)
+
+/*! @name Payload of a CONFIG block */
+typedef struct
+{
+    uint32_t magic;      // AD7708_RECORD_MAGIC
+    uint16_t version;
+    uint16_t blockBytes;
+    uint32_t tickHz;     // Timestamp unit
+    uint8_t mode;        // MODE_REG
+    uint8_t control;     // CONTROL_REG
+    uint8_t filter;      // FILTER_REG
+    uint8_t ioControl;   // IO_CONTROL_REG
+    uint32_t deviceTag;  // Caller defined, e.g. bus slot or serial number
+} ad7708_record_config;
+
+typedef StatusTypeDef (*ad7708_record_fptr_t)(void* ctx, const void* block, uint32_t len);
+
+/*! @name Where finished blocks go: file, SD card, ring... */
+typedef struct
+{
+    ad7708_record_fptr_t write;
+    void* ctx;
+} ad7708_record_sink;
+
+/*! @name Writer state */
+typedef struct
+{
+    ad7708_record_sink sink;
+    ad7708_record_config config;
+    uint32_t seq;
+    uint16_t count;
+    uint16_t deltaBytes;
+    uint64_t t0;
+    uint64_t last;
+    uint16_t codes[AD7708_RECORD_MAX_SAMPLES];
+    uint16_t tags[AD7708_RECORD_MAX_SAMPLES];
+    uint8_t deltas[AD7708_RECORD_PAYLOAD];
+    uint8_t block[AD7708_RECORD_BLOCK_BYTES];
+    uint32_t samples;
+    uint32_t errors;     // Blocks the sink refused
+} ad7708_record_writer;
+
+/*!
+ * @brief Start a record and write its first configuration block
+ * @param[in] w - Pointer to the writer
+ * @param[in] sink - Block sink, copied
+ * @param[in] dev - Device whose register shadow is recorded
+ * @param[in] tickHz - Unit of the timestamps passed to append
+ * @param[in] t - Current time
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_record_open(ad7708_record_writer* w, const ad7708_record_sink* sink, const ad7708_dev* dev, uint32_t tickHz, uint64_t t);
+
+/*!
+ * @brief Record a configuration change, flushing pending samples first
+ * @param[in] w - Pointer to the writer
+ * @param[in] dev - Device whose register shadow is recorded
+ * @param[in] t - Time of the change
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_record_config_update(ad7708_record_writer* w, const ad7708_dev* dev, uint64_t t);
+
+/*!
+ * @brief Append one sample
+ * @param[in] w - Pointer to the writer
+ * @param[in] sample - Tagged sample
+ * @param[in] t - Its timestamp, not earlier than the previous one
+ * @return 0: case of success, error code if a full block could not be written
+ */
+StatusTypeDef ad7708_record_append(ad7708_record_writer* w, const ad7708_sample* sample, uint64_t t);
+
+/*!
+ * @brief Append a block of samples
+ * @param[in] w - Pointer to the writer
+ * @param[in] samples - Tagged samples
+ * @param[in] t - One timestamp per sample
+ * @param[in] n - Number of samples
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_record_appendBlock(ad7708_record_writer* w, const ad7708_sample* samples, const uint64_t* t, uint32_t n);
+
+/*!
+ * @brief Write the pending samples as a padded block
+ * @param[in] w - Pointer to the writer
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_record_flush(ad7708_record_writer* w);
+
+#ifndef AD7708_RECORD_NO_READER
+
+/*! @name Index entry of a DATA block */
+typedef struct
+{
+    uint64_t t0;
+    uint32_t block;  // Block number in the file
+    uint32_t config; // CONFIG block in effect
+} ad7708_record_index;
+
+/*! @name Memory mapped record */
+typedef struct
+{
+    const uint8_t* base;
+    size_t size;
+    ad7708_record_index* index; // DATA blocks in time order
+    uint32_t blocks;            // Valid DATA blocks
+    uint32_t badBlocks;         // Skipped on CRC or sync errors, or for lack of a configuration of this version
+    int fd;
+} ad7708_record_reader;
+
+/*! @name One decoded sample */
+typedef struct
+{
+    uint64_t t;
+    uint16_t code;
+    uint8_t channel;
+    uint8_t flags;
+} ad7708_record_item;
+
+/*! @name Zero-copy view of a DATA block */
+typedef struct
+{
+    const ad7708_record_block_hdr* hdr;
+    const ad7708_record_config* config;
+    const uint16_t* codes;
+    const uint16_t* tags;
+    const uint8_t* deltas;
+} ad7708_record_view;
+
+/*! @name Sample cursor */
+typedef struct
+{
+    const ad7708_record_reader* reader;
+    uint32_t entry;       // Index entry of the current block
+    uint16_t i;           // Next sample in the block
+    uint64_t t;           // Time of the previous sample
+    const uint8_t* delta; // Next varint
+    ad7708_record_view view;
+} ad7708_record_iter;
+
+/*!
+ * @brief Sink appending blocks to a stdio stream
+ * @param[out] sink - Sink to fill
+ * @param[in] file - Open FILE*, written in binary mode
+ * @return void
+ */
+void ad7708_record_fileSink(ad7708_record_sink* sink, void* file);
+
+/*!
+ * @brief Map a record file and index its blocks
+ * @param[in] r - Pointer to the reader
+ * @param[in] path - File name
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_record_map(ad7708_record_reader* r, const char* path);
+
+/*!
+ * @brief Index a record already in memory
+ * @param[in] r - Pointer to the reader
+ * @param[in] data - Record bytes, must outlive the reader
+ * @param[in] size - Size in bytes
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_record_attach(ad7708_record_reader* r, const void* data, size_t size);
+
+/*!
+ * @brief Release the index and the mapping
+ * @param[in] r - Pointer to the reader
+ * @return void
+ */
+void ad7708_record_close(ad7708_record_reader* r);
+
+/*!
+ * @brief View of an indexed DATA block
+ * @param[in] r - Pointer to the reader
+ * @param[in] entry - Index entry, 0..blocks-1
+ * @param[out] view - Pointers into the mapping
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_record_block(const ad7708_record_reader* r, uint32_t entry, ad7708_record_view* view);
+
+/*!
+ * @brief Position a cursor on the first sample at or after a time
+ * @param[in] r - Pointer to the reader
+ * @param[out] it - Cursor
+ * @param[in] t - Time, 0 for the start of the record
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_record_seek(const ad7708_record_reader* r, ad7708_record_iter* it, uint64_t t);
+
+/*!
+ * @brief Decode the next sample
+ * @param[in] it - Cursor
+ * @param[out] item - Sample and its time
+ * @return 0: case of success, AD7708_ERROR at the end of the record
+ */
+StatusTypeDef ad7708_record_next(ad7708_record_iter* it, ad7708_record_item* item);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
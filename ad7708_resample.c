@@ -0,0 +1,254 @@
+#include "ad7708_resample.h"
+
+#include <string.h>
+
+#define HIST_MASK (AD7708_RESAMPLE_HISTORY - 1U)
+#define U_ONE 65536 // Position between two samples, Q16
+
+/********************** Static function declarations ************************/
+
+/*!
+ * @brief Start the grid at the first tick every channel can serve
+ * @param[in] rs - Pointer to the resampler
+ * @return 1: started, 0: some channel has too few samples yet
+ */
+static uint8_t startGrid(ad7708_resample* rs);
+
+/*!
+ * @brief Value of one channel at a tick
+ * @param[in] rs - Pointer to the resampler
+ * @param[in] h - Channel history
+ * @param[in] t - Tick
+ * @param[out] value - Interpolated value
+ * @return AD7708_OK, AD7708_BUSY: samples after t still missing, AD7708_ERROR: samples before t already gone
+ */
+static StatusTypeDef valueAt(const ad7708_resample* rs, const ad7708_resample_history* h, uint32_t t, int32_t* value);
+
+/*!
+ * @brief Emit every frame the histories can serve
+ * @param[in] rs - Pointer to the resampler
+ * @param[in,out] out - Frame block
+ * @return Number of frames appended
+ */
+static uint32_t emitFrames(ad7708_resample* rs, ad7708_frames* out);
+
+/*!
+ * @brief Divide by 2^16, rounding to nearest
+ * @param[in] x - Dividend
+ * @return x / 65536
+ */
+static int64_t roundQ16(int64_t x);
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Select the channels to align and the grid
+ */
+StatusTypeDef ad7708_resample_init(ad7708_resample* rs, const uint8_t* channels, uint8_t count, uint32_t periodUs, AD7708_Interp interp)
+{
+    if (count == 0 || count > AD7708_RESAMPLE_MAX || periodUs == 0) { return AD7708_ERROR; }
+    if (interp != AD7708_INTERP_LINEAR && interp != AD7708_INTERP_CUBIC) { return AD7708_ERROR; }
+
+    memset(rs, 0, sizeof(*rs));
+    memset(rs->column, 0xFF, sizeof(rs->column));
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (channels[i] >= sizeof(rs->column) || rs->column[channels[i]] != 0xFF) { return AD7708_ERROR; }
+        rs->column[channels[i]] = i;
+    }
+
+    rs->channels = count;
+    rs->periodUs = periodUs;
+    rs->interp = interp;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Point a frame block at caller storage and empty it
+ */
+void ad7708_frames_init(ad7708_frames* frames, int32_t* data, uint8_t columns, uint16_t capacity)
+{
+    frames->data = data;
+    frames->capacity = capacity;
+    frames->count = 0;
+    frames->columns = columns;
+    frames->t0Us = 0;
+    frames->periodUs = 0;
+}
+
+/*!
+ * @brief Add stamped samples and emit the frames they complete
+ */
+uint32_t ad7708_resample_process(ad7708_resample* rs, const ad7708_sample* in, const uint32_t* timeUs, uint32_t n, ad7708_frames* out)
+{
+    uint32_t produced = 0;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint8_t column = rs->column[in[i].channel & 0x3FU];
+        ad7708_resample_history* h;
+
+        if (column == 0xFF) { continue; }
+
+        h = &rs->hist[column];
+        h->t[h->head & HIST_MASK] = timeUs[i];
+        h->v[h->head & HIST_MASK] = ((int32_t)in[i].code - AD7708_SAMPLE_ZERO_CODE(in[i].flags)) * (1L << AD7708_RESAMPLE_FRAC);
+        h->head++;
+
+        // Only a new sample can complete a frame, check right away so the history never runs short
+        produced += emitFrames(rs, out);
+    }
+
+    return produced;
+}
+
+/*!
+ * @brief Pop up to max stamped samples from a ring and resample them
+ */
+uint32_t ad7708_resample_drain(ad7708_resample* rs, ad7708_ring* ring, ad7708_frames* out, uint32_t max)
+{
+    ad7708_sample block[AD7708_RESAMPLE_BLOCK];
+    uint32_t stamps[AD7708_RESAMPLE_BLOCK];
+    uint32_t produced = 0;
+
+    if (ring->stamps == NULL) { return 0; }
+
+    // Ticks left waiting by the previous call go out before anything new is added to the history
+    produced += emitFrames(rs, out);
+
+    // One sample per free frame at a time, so the block fills near the end of a pop and what
+    // follows in it cannot push the samples of the waiting ticks out of the history
+    while (max != 0 && out->count < out->capacity)
+    {
+        uint32_t want = (uint32_t)(out->capacity - out->count);
+        uint32_t got;
+
+        if (want > AD7708_RESAMPLE_BLOCK) { want = AD7708_RESAMPLE_BLOCK; }
+        if (want > max) { want = max; }
+        got = ad7708_ring_popStamped(ring, block, stamps, want);
+        if (got == 0) { break; }
+
+        produced += ad7708_resample_process(rs, block, stamps, got, out);
+        max -= got;
+    }
+
+    return produced;
+}
+
+/****************** Static Function Definitions *******************************/
+
+static uint8_t startGrid(ad7708_resample* rs)
+{
+    // Cubic wants a sample before the first tick as well
+    uint32_t need = rs->interp == AD7708_INTERP_CUBIC ? 2U : 1U;
+    uint32_t start = 0;
+
+    for (uint8_t c = 0; c < rs->channels; c++)
+    {
+        const ad7708_resample_history* h = &rs->hist[c];
+        uint32_t oldest = h->head > AD7708_RESAMPLE_HISTORY ? h->head - AD7708_RESAMPLE_HISTORY : 0;
+        uint32_t t;
+
+        if (h->head < oldest + need) { return 0; }
+
+        t = h->t[(oldest + need - 1U) & HIST_MASK];
+        if (c == 0 || (int32_t)(t - start) > 0) { start = t; }
+    }
+
+    rs->nextUs = start + (rs->periodUs - start % rs->periodUs) % rs->periodUs;
+    rs->started = 1;
+
+    return 1;
+}
+
+static StatusTypeDef valueAt(const ad7708_resample* rs, const ad7708_resample_history* h, uint32_t t, int32_t* value)
+{
+    uint32_t oldest = h->head > AD7708_RESAMPLE_HISTORY ? h->head - AD7708_RESAMPLE_HISTORY : 0;
+    uint32_t after = rs->interp == AD7708_INTERP_CUBIC ? 2U : 1U;
+    uint32_t k = h->head;
+    int64_t p0, p1, p2, p3, u, v;
+    uint32_t t1, t2;
+
+    if (k == 0) { return AD7708_BUSY; }
+
+    // Newest sample at or before t
+    while (k > oldest && (int32_t)(h->t[(k - 1U) & HIST_MASK] - t) > 0) { k--; }
+    if (k == oldest) { return AD7708_ERROR; }
+    k--;
+    if (k + after >= h->head) { return AD7708_BUSY; }
+
+    t1 = h->t[k & HIST_MASK];
+    t2 = h->t[(k + 1U) & HIST_MASK];
+    p1 = h->v[k & HIST_MASK];
+    p2 = h->v[(k + 1U) & HIST_MASK];
+    u = t2 != t1 ? (int64_t)((uint64_t)(t - t1) * U_ONE / (t2 - t1)) : 0;
+
+    if (rs->interp == AD7708_INTERP_LINEAR)
+    {
+        *value = (int32_t)(p1 + roundQ16((p2 - p1) * u));
+        return AD7708_OK;
+    }
+
+    // Catmull-Rom, the missing neighbour before the first sample repeats it
+    p0 = k > oldest ? h->v[(k - 1U) & HIST_MASK] : p1;
+    p3 = h->v[(k + 2U) & HIST_MASK];
+    v = roundQ16((-p0 + 3 * p1 - 3 * p2 + p3) * u);
+    v = roundQ16((v + 2 * p0 - 5 * p1 + 4 * p2 - p3) * u);
+    v = roundQ16((v + p2 - p0) * u);
+    v += 2 * p1;
+    *value = (int32_t)(v >= 0 ? (v + 1) / 2 : (v - 1) / 2);
+
+    return AD7708_OK;
+}
+
+static uint32_t emitFrames(ad7708_resample* rs, ad7708_frames* out)
+{
+    uint32_t produced = 0;
+
+    if (!rs->started && !startGrid(rs)) { return 0; }
+
+    while (out->count < out->capacity)
+    {
+        int32_t values[AD7708_RESAMPLE_MAX];
+        uint8_t wait = 0;
+        uint8_t lost = 0;
+
+        for (uint8_t c = 0; c < rs->channels; c++)
+        {
+            StatusTypeDef status = valueAt(rs, &rs->hist[c], rs->nextUs, &values[c]);
+            if (status == AD7708_BUSY) { wait = 1; }
+            if (status == AD7708_ERROR) { lost = 1; }
+        }
+
+        if (lost)
+        {
+            // Frames of a block are consecutive ticks, a gap has to start a new one
+            if (out->count != 0) { break; }
+            rs->skipped++;
+            rs->nextUs += rs->periodUs;
+            continue;
+        }
+        if (wait) { break; }
+
+        if (out->count == 0)
+        {
+            out->t0Us = rs->nextUs;
+            out->periodUs = rs->periodUs;
+        }
+        for (uint8_t c = 0; c < rs->channels; c++) { AD7708_FRAMES_COLUMN(out, c)[out->count] = values[c]; }
+
+        out->count++;
+        rs->frames++;
+        rs->nextUs += rs->periodUs;
+        produced++;
+    }
+
+    return produced;
+}
+
+static int64_t roundQ16(int64_t x)
+{
+    return (x >= 0 ? x + U_ONE / 2 : x - U_ONE / 2) / U_ONE;
+}
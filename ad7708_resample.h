@@ -0,0 +1,129 @@
+#ifndef __AD7708_RESAMPLE_H__
+#define __AD7708_RESAMPLE_H__
+
+#include "ad7708_defs.h"
+#include "ad7708_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Time alignment of multiplexed channels.
+ *
+ * The AD7708 converts one input at a time, so in a scan every channel is
+ * sampled at a different instant, up to a full pass apart. With a ring that
+ * keeps stamps (ad7708_ring_setStamps) stream, scan, bus and poll record the
+ * RDY time of every result; this stage interpolates each selected channel onto
+ * a common grid of period periodUs and emits aligned frames, one value per
+ * channel per grid tick.
+ *
+ * Interpolation is linear or Catmull-Rom cubic in fixed point, on codes
+ * relative to zero scale with AD7708_RESAMPLE_FRAC fraction bits. A frame is
+ * emitted as soon as every channel has the samples around its tick, so output
+ * lags input by about one scan pass (two with cubic). The RDY time trails the
+ * conversion's own instant by the digital filter delay, which is the same on
+ * every channel and cancels out. Frames are written in structure-of-arrays
+ * layout, one contiguous column per channel. A column assumes a fixed range.
+ * Behind an external mux every mux address of a channel code is a channel of
+ * its own, selected with the address in bits 4-5 as in ad7708_sample.
+ */
+
+#define AD7708_RESAMPLE_MAX 10      // Channels per frame
+#define AD7708_RESAMPLE_HISTORY 8   // Samples kept per channel, power of 2
+#define AD7708_RESAMPLE_FRAC 8      // Fraction bits of the frame values
+#define AD7708_RESAMPLE_BLOCK 64    // Samples popped per ring access
+
+typedef enum
+{
+    AD7708_INTERP_LINEAR = 0x00U,
+    AD7708_INTERP_CUBIC = 0x01U    // Catmull-Rom, one more sample of latency
+} AD7708_Interp;
+
+/*! @name Block of aligned frames, structure of arrays */
+typedef struct
+{
+    int32_t* data;       // columns * capacity values, column c starts at data + c * capacity
+    uint16_t capacity;   // Frames per block
+    uint16_t count;      // Frames written
+    uint8_t columns;
+    uint32_t t0Us;       // Tick of frame 0, frame k is at t0Us + k * periodUs
+    uint32_t periodUs;
+} ad7708_frames;
+
+#define AD7708_FRAMES_COLUMN(f, c) ((f)->data + (uint32_t)(c) * (f)->capacity)
+
+/*! @name Recent samples of one channel */
+typedef struct
+{
+    uint32_t t[AD7708_RESAMPLE_HISTORY];
+    int32_t v[AD7708_RESAMPLE_HISTORY];
+    uint32_t head;       // Samples received, the newest is at head - 1
+} ad7708_resample_history;
+
+/*! @name Resampler state */
+typedef struct
+{
+    uint8_t column[64];  // Column of each channel code and mux address, 0xFF: not aligned
+    uint8_t channels;
+    AD7708_Interp interp;
+    uint8_t started;
+    uint32_t periodUs;
+    uint32_t nextUs;     // Tick of the next frame
+    ad7708_resample_history hist[AD7708_RESAMPLE_MAX];
+    uint32_t frames;
+    uint32_t skipped;    // Ticks dropped because the samples around them were already gone
+} ad7708_resample;
+
+/*!
+ * @brief Select the channels to align and the grid
+ * @param[in] rs - Pointer to the resampler
+ * @param[in] channels - Channel codes, bits 4-5: external mux address, column order of the frames
+ * @param[in] count - Number of channels, 1..AD7708_RESAMPLE_MAX
+ * @param[in] periodUs - Grid period
+ * @param[in] interp - Interpolation
+ * @return 0: case of success, error code otherwise.
+ * @note The grid is aligned to multiples of periodUs of the transport tick
+ */
+StatusTypeDef ad7708_resample_init(ad7708_resample* rs, const uint8_t* channels, uint8_t count, uint32_t periodUs, AD7708_Interp interp);
+
+/*!
+ * @brief Point a frame block at caller storage and empty it
+ * @param[out] frames - Block to set up
+ * @param[in] data - Storage for columns * capacity values
+ * @param[in] columns - Channels per frame, as given to ad7708_resample_init
+ * @param[in] capacity - Frames per block
+ * @return void
+ */
+void ad7708_frames_init(ad7708_frames* frames, int32_t* data, uint8_t columns, uint16_t capacity);
+
+/*!
+ * @brief Add stamped samples and emit the frames they complete
+ * @param[in] rs - Pointer to the resampler
+ * @param[in] in - Samples in acquisition order, channels not selected are ignored
+ * @param[in] timeUs - RDY time of each sample
+ * @param[in] n - Number of samples
+ * @param[in,out] out - Frames are appended until it is full
+ * @return Number of frames appended
+ * @note Frames that do not fit wait for the next call while the history holds their samples.
+ *       A block only holds consecutive ticks, after a gap the caller must empty it to go on.
+ */
+uint32_t ad7708_resample_process(ad7708_resample* rs, const ad7708_sample* in, const uint32_t* timeUs, uint32_t n, ad7708_frames* out);
+
+/*!
+ * @brief Pop up to max stamped samples from a ring and resample them
+ * @param[in] rs - Pointer to the resampler
+ * @param[in] ring - Ring keeping stamps, the resampler is its consumer
+ * @param[in,out] out - Frames are appended until it is full
+ * @param[in] max - Samples to take from the ring at most
+ * @return Number of frames appended
+ * @note Ticks still waiting from an earlier call are emitted first, then samples are popped no
+ *       more than one per free frame at a time, so those left in the ring stay there once out is full.
+ */
+uint32_t ad7708_resample_drain(ad7708_resample* rs, ad7708_ring* ring, ad7708_frames* out, uint32_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
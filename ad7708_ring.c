@@ -0,0 +1,111 @@
+#include "ad7708_ring.h"
+
+#include <stddef.h>
+
+// Acquire/release ordering between the index and the slot it guards
+#define RING_LOAD_ACQ(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define RING_STORE_REL(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Initialize an empty ring on caller provided storage
+ */
+StatusTypeDef ad7708_ring_init(ad7708_ring* ring, ad7708_sample* buf, uint32_t size)
+{
+    if (buf == NULL || size == 0 || (size & (size - 1)) != 0) { return AD7708_ERROR; }
+
+    ring->buf = buf;
+    ring->stamps = NULL;
+    ring->mask = size - 1;
+    ring->head = 0;
+    ring->tail = 0;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Keep a time stamp per sample
+ */
+void ad7708_ring_setStamps(ad7708_ring* ring, uint32_t* stamps)
+{
+    ring->stamps = stamps;
+}
+
+/*!
+ * @brief Append a sample, producer side
+ */
+StatusTypeDef ad7708_ring_push(ad7708_ring* ring, const ad7708_sample* sample)
+{
+    uint32_t head = ring->head;
+
+    if (head - RING_LOAD_ACQ(&ring->tail) > ring->mask) { return AD7708_BUSY; }
+
+    ring->buf[head & ring->mask] = *sample;
+    RING_STORE_REL(&ring->head, head + 1);
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Append a sample with the time its conversion completed, producer side
+ */
+StatusTypeDef ad7708_ring_pushStamped(ad7708_ring* ring, const ad7708_sample* sample, uint32_t timeUs)
+{
+    uint32_t head = ring->head;
+
+    if (head - RING_LOAD_ACQ(&ring->tail) > ring->mask) { return AD7708_BUSY; }
+
+    ring->buf[head & ring->mask] = *sample;
+    if (ring->stamps != NULL) { ring->stamps[head & ring->mask] = timeUs; }
+    RING_STORE_REL(&ring->head, head + 1);
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Remove up to max samples in one batch, consumer side
+ */
+uint32_t ad7708_ring_pop(ad7708_ring* ring, ad7708_sample* out, uint32_t max)
+{
+    uint32_t tail = ring->tail;
+    uint32_t count = RING_LOAD_ACQ(&ring->head) - tail;
+
+    if (count > max) { count = max; }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        out[i] = ring->buf[(tail + i) & ring->mask];
+    }
+    RING_STORE_REL(&ring->tail, tail + count);
+
+    return count;
+}
+
+/*!
+ * @brief Remove up to max samples and their time stamps, consumer side
+ */
+uint32_t ad7708_ring_popStamped(ad7708_ring* ring, ad7708_sample* out, uint32_t* timeUs, uint32_t max)
+{
+    uint32_t tail = ring->tail;
+    uint32_t count = RING_LOAD_ACQ(&ring->head) - tail;
+
+    if (count > max) { count = max; }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        out[i] = ring->buf[(tail + i) & ring->mask];
+        timeUs[i] = ring->stamps[(tail + i) & ring->mask];
+    }
+    RING_STORE_REL(&ring->tail, tail + count);
+
+    return count;
+}
+
+/*!
+ * @brief Number of samples waiting, safe from either side
+ */
+uint32_t ad7708_ring_count(const ad7708_ring* ring)
+{
+    return RING_LOAD_ACQ(&ring->head) - RING_LOAD_ACQ(&ring->tail);
+}
@@ -0,0 +1,96 @@
+#ifndef __AD7708_RING_H__
+#define __AD7708_RING_H__
+
+#include "ad7708_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Wait-free single-producer/single-consumer sample queue.
+ *
+ * The producer (RDY or DMA ISR) only writes head, the consumer (application
+ * task) only writes tail, so neither side ever blocks or disables interrupts.
+ * Indices run freely and are masked on access, capacity must be a power of 2.
+ *
+ * An optional companion array holds one time stamp per slot. Producers that
+ * know when RDY fired use ad7708_ring_pushStamped(), the stamp is published
+ * together with its sample and popped alongside it.
+ */
+
+/*! @name Ring buffer state */
+typedef struct
+{
+    ad7708_sample* buf;
+    uint32_t* stamps;       // Optional RDY time per slot in us, NULL: not kept
+    uint32_t mask;
+    volatile uint32_t head; // Next slot to write, owned by the producer
+    volatile uint32_t tail; // Next slot to read, owned by the consumer
+} ad7708_ring;
+
+/*!
+ * @brief Initialize an empty ring on caller provided storage
+ * @param[in] ring - Pointer to the ring
+ * @param[in] buf - Sample storage
+ * @param[in] size - Number of samples in buf, must be a power of 2
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_ring_init(ad7708_ring* ring, ad7708_sample* buf, uint32_t size);
+
+/*!
+ * @brief Keep a time stamp per sample
+ * @param[in] ring - Pointer to an empty ring
+ * @param[in] stamps - Storage, as many entries as the ring has samples
+ * @return void
+ */
+void ad7708_ring_setStamps(ad7708_ring* ring, uint32_t* stamps);
+
+/*!
+ * @brief Append a sample, producer side
+ * @param[in] ring - Pointer to the ring
+ * @param[in] sample - Sample to copy in
+ * @return 0: case of success, AD7708_BUSY if the ring is full
+ */
+StatusTypeDef ad7708_ring_push(ad7708_ring* ring, const ad7708_sample* sample);
+
+/*!
+ * @brief Append a sample with the time its conversion completed, producer side
+ * @param[in] ring - Pointer to the ring
+ * @param[in] sample - Sample to copy in
+ * @param[in] timeUs - RDY time, dropped when the ring keeps no stamps
+ * @return 0: case of success, AD7708_BUSY if the ring is full
+ */
+StatusTypeDef ad7708_ring_pushStamped(ad7708_ring* ring, const ad7708_sample* sample, uint32_t timeUs);
+
+/*!
+ * @brief Remove up to max samples in one batch, consumer side
+ * @param[in] ring - Pointer to the ring
+ * @param[out] out - Destination buffer
+ * @param[in] max - Capacity of out
+ * @return Number of samples copied
+ */
+uint32_t ad7708_ring_pop(ad7708_ring* ring, ad7708_sample* out, uint32_t max);
+
+/*!
+ * @brief Remove up to max samples and their time stamps, consumer side
+ * @param[in] ring - Pointer to a ring keeping stamps
+ * @param[out] out - Destination buffer
+ * @param[out] timeUs - Time stamps, one per sample
+ * @param[in] max - Capacity of out and timeUs
+ * @return Number of samples copied
+ */
+uint32_t ad7708_ring_popStamped(ad7708_ring* ring, ad7708_sample* out, uint32_t* timeUs, uint32_t max);
+
+/*!
+ * @brief Number of samples waiting, safe from either side
+ * @param[in] ring - Pointer to the ring
+ * @return Sample count
+ */
+uint32_t ad7708_ring_count(const ad7708_ring* ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,298 @@
+#include "ad7708_scan.h"
+#include "ad7708.h"
+#include "ad7708_instr.h"
+#include "ad7708_stats.h"
+#include "ad7708_plan.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+/********************** Static function declarations ************************/
+
+
+/*!
+ * @brief Results to discard so the mux settling stays below half an LSB
+ * @param[in] scan - Pointer to the sequencer state
+ * @return Number of extra results
+ */
+static uint8_t muxDiscards(const ad7708_scan* scan);
+
+/*!
+ * @brief Abort a frame whose transfer failed
+ * @param[in] scan - Pointer to the sequencer state
+ * @param[in] len - Length of the failed frame
+ * @return void
+ */
+static void transferFailed(ad7708_scan* scan, uint16_t len);
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Load the scan list
+ */
+StatusTypeDef ad7708_scan_init(ad7708_scan* scan, ad7708_dev* dev, const ad7708_scan_entry* entries, uint8_t count, ad7708_ring* ring)
+{
+    if (count == 0 || count > AD7708_SCAN_MAX) { return AD7708_ERROR; }
+
+    memset(scan, 0, sizeof(*scan));
+    scan->dev = dev;
+    scan->ring = ring;
+    scan->count = count;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        ControlReg reg = { 0 };
+        reg.merged.channelConfig = entries[i].channel;
+        reg.merged.range = entries[i].range;
+        reg.bits.ub = entries[i].polarity;
+        scan->control[i] = reg.byte;
+        scan->discard[i] = entries[i].discard;
+        scan->mux[i] = entries[i].mux & 0x03U;
+    }
+
+    // Read data register, then write IO and control registers as needed
+    scan->tx[0] = (uint8_t)(0x40U | DATA_REG);
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Drive an external mux from P1/P2 with the address of each entry
+ */
+StatusTypeDef ad7708_scan_setMux(ad7708_scan* scan, uint32_t settleNs)
+{
+    if (scan->running) { return AD7708_BUSY; }
+
+    scan->muxed = 1;
+    scan->muxSettleNs = settleNs;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Program the first entry and start continuous conversion
+ */
+StatusTypeDef ad7708_scan_start(ad7708_scan* scan)
+{
+    StatusTypeDef status;
+    ControlReg first;
+
+    first.byte = scan->control[0];
+    scan->index = 0;
+    scan->discardLeft = scan->discard[0];
+
+    if (scan->muxed)
+    {
+        IOControlReg io = scan->dev->ioControlReg;
+
+        if (!io.bits.p1dir || !io.bits.p2dir) { return AD7708_ERROR; }
+
+        // The filter word and chop are final by now
+        for (uint8_t i = 0; i < scan->count; i++) { scan->io[i] = (uint8_t)((io.byte & ~0x03U) | scan->mux[i]); }
+        scan->muxDiscard = muxDiscards(scan);
+
+        status = ad7708_ioWrite(scan->dev, scan->mux[0] & 0x01U, scan->mux[0] >> 1);
+        if (status != AD7708_OK) { return status; }
+    }
+
+    status = ad7708_channelConfig(scan->dev, (AD7708_Channel)first.merged.channelConfig, (AD7708_Range)first.merged.range, (AD7708_Polarity)first.bits.ub);
+    if (status != AD7708_OK) { return status; }
+
+    // A part that did not start converting must not be read from RDY
+    status = ad7708_startContinuousConversion(scan->dev);
+    if (status == AD7708_OK) { scan->running = 1; }
+
+    return status;
+}
+
+/*!
+ * @brief Stop reacting to RDY, the device is left converting
+ */
+void ad7708_scan_stop(ad7708_scan* scan)
+{
+    scan->running = 0;
+}
+
+/*!
+ * @brief RDY falling edge handler, call from the EXTI interrupt
+ */
+void ad7708_scan_onRdy(ad7708_scan* scan)
+{
+    ad7708_scan_onRdyAt(scan, scan->ring->stamps != NULL ? ad7708_nowUs(scan->dev) : 0);
+}
+
+/*!
+ * @brief RDY handler for callers that saw the edge earlier, e.g. a shared bus scheduler
+ */
+void ad7708_scan_onRdyAt(ad7708_scan* scan, uint32_t timeUs)
+{
+    ad7708_dev* dev = scan->dev;
+    uint16_t len = 3;
+
+    if (!scan->running) { return; }
+    if (scan->dmaBusy)
+    {
+        scan->busyOverruns++;
+        return;
+    }
+
+    // Stay on the entry while its settling results are being thrown away
+    scan->next = scan->index;
+    if (scan->resync)
+    {
+        // The last write frame failed, put the device back on the current entry
+        uint8_t at = 3;
+        if (scan->muxed)
+        {
+            scan->tx[at++] = (uint8_t)IO_CONTROL_REG;
+            scan->tx[at++] = scan->io[scan->index];
+        }
+        scan->tx[at++] = (uint8_t)CONTROL_REG;
+        scan->tx[at++] = scan->control[scan->index];
+        len = at;
+    }
+    else if (scan->discardLeft == 0)
+    {
+        scan->next = (uint8_t)(scan->index + 1 == scan->count ? 0 : scan->index + 1);
+        if (scan->muxed && scan->io[scan->next] != scan->io[scan->index])
+        {
+            // New address first, then restart the filter on it even if the channel stays
+            scan->tx[3] = (uint8_t)IO_CONTROL_REG;
+            scan->tx[4] = scan->io[scan->next];
+            scan->tx[5] = (uint8_t)CONTROL_REG;
+            scan->tx[6] = scan->control[scan->next];
+            len = AD7708_SCAN_XFER_LEN;
+        }
+        else if (scan->control[scan->next] != scan->control[scan->index])
+        {
+            scan->tx[3] = (uint8_t)CONTROL_REG;
+            scan->tx[4] = scan->control[scan->next];
+            len = 5;
+        }
+    }
+
+    scan->dmaBusy = 1;
+    scan->rdyUs = timeUs;
+    AD7708_INSTR_ADD(dev, csToggles, 1);
+    AD7708_INSTR_ADD(dev, spiBytes, len);
+    dev->transport->setCS(dev->intf, &dev->cs, 0);
+
+    if (dev->transport->transferDMA == NULL)
+    {
+        // No DMA on this port, clock the frame out inline
+        if (dev->transport->transfer(dev->intf, scan->tx, scan->rx, len) != AD7708_OK)
+        {
+            transferFailed(scan, len);
+            return;
+        }
+        ad7708_scan_dmaComplete(scan);
+    }
+    else if (dev->transport->transferDMA(dev->intf, scan->tx, scan->rx, len) != AD7708_OK)
+    {
+        transferFailed(scan, len);
+    }
+}
+
+/*!
+ * @brief DMA transfer complete handler, call from the SPI DMA interrupt
+ */
+void ad7708_scan_dmaComplete(ad7708_scan* scan)
+{
+    ad7708_dev* dev = scan->dev;
+    uint8_t control = scan->control[scan->index];
+    uint8_t muxMoved = scan->muxed && scan->io[scan->next] != scan->io[scan->index];
+
+    dev->transport->setCS(dev->intf, &dev->cs, 1);
+
+    if (scan->resync)
+    {
+        // The result was converted on whichever entry the failed frame left behind
+        if (scan->muxed)
+        {
+            dev->ioControlReg.byte = scan->io[scan->index];
+            dev->regDirty &= (uint16_t)~(1U << IO_CONTROL_REG);
+        }
+        dev->controlReg.byte = control;
+        dev->regDirty &= (uint16_t)~(1U << CONTROL_REG);
+        scan->resync = 0;
+        scan->discarded++;
+        scan->discardLeft = scan->discard[scan->index];
+        if (scan->muxed) { scan->discardLeft += scan->muxDiscard; }
+    }
+    else if (scan->discardLeft != 0)
+    {
+        scan->discardLeft--;
+        scan->discarded++;
+    }
+    else
+    {
+        ad7708_sample sample;
+        sample.code = (uint16_t)((scan->rx[1] << 8) | scan->rx[2]);
+        sample.channel = (uint8_t)(control >> 4);
+        if (scan->muxed) { sample.channel |= (uint8_t)(scan->mux[scan->index] << AD7708_SAMPLE_MUX_SHIFT); }
+        sample.flags = control & 0x0FU;
+        AD7708_INSTR_CODE(dev, sample.code);
+        AD7708_STATS_FEED(dev, &sample);
+
+        if (ad7708_ring_pushStamped(scan->ring, &sample, scan->rdyUs) == AD7708_OK) { scan->samples++; }
+        else { scan->fullOverruns++; }
+
+        if (muxMoved)
+        {
+            dev->ioControlReg.byte = scan->io[scan->next];
+            scan->muxSwitches++;
+        }
+        if (muxMoved || scan->control[scan->next] != control)
+        {
+            dev->controlReg.byte = scan->control[scan->next];
+            scan->switches++;
+        }
+        if (scan->next == 0) { scan->passes++; }
+        scan->index = scan->next;
+        scan->discardLeft = scan->discard[scan->index];
+        if (muxMoved) { scan->discardLeft += scan->muxDiscard; }
+    }
+
+    scan->dmaBusy = 0;
+}
+
+/****************** Static Function Definitions *******************************/
+
+
+static void transferFailed(ad7708_scan* scan, uint16_t len)
+{
+    ad7708_dev* dev = scan->dev;
+
+    dev->transport->setCS(dev->intf, &dev->cs, 1);
+    scan->errors++;
+
+    // Whether the writes reached the device is unknown, keep the shadow from vouching for them
+    if (len > 3)
+    {
+        dev->regDirty |= (uint16_t)(1U << CONTROL_REG);
+        if (scan->muxed) { dev->regDirty |= (uint16_t)(1U << IO_CONTROL_REG); }
+        scan->resync = 1;
+    }
+
+    scan->dmaBusy = 0;
+}
+
+static uint8_t muxDiscards(const ad7708_scan* scan)
+{
+    uint8_t sf = scan->dev->filterReg.byte;
+    uint8_t chop = scan->dev->modeReg.bits.chop;
+    double period = ad7708_plan_periodNs(sf, chop);
+    double window = ad7708_plan_settleNs(sf, chop);
+    double left = scan->muxSettleNs;
+    uint8_t discards = 0;
+
+    // A sinc3 window of length W weights its first t by 4.5 (t / W)^3, keep a full-scale step below 2^-17
+    while (left > 0.0 && 4.5 * pow(left / window, 3.0) > 1.0 / 131072.0 && discards < 255)
+    {
+        left -= period;
+        discards++;
+    }
+
+    return discards;
+}
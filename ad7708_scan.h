@@ -0,0 +1,141 @@
+#ifndef __AD7708_SCAN_H__
+#define __AD7708_SCAN_H__
+
+#include "ad7708_defs.h"
+#include "ad7708_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Autonomous multi-channel scan in continuous conversion mode.
+ *
+ * Every RDY edge reads the result of the current entry and, in the same
+ * CS-asserted frame, writes the control register of the next entry when it
+ * differs. Samples are pushed to the ring tagged with their channel, range
+ * and polarity. Port glue is the same as ad7708_stream.
+ *
+ * With ad7708_scan_setMux() the P1/P2 outputs drive the address of external
+ * 4:1 multiplexers in front of the analog inputs, up to 40 inputs per chip.
+ * An address change goes out in the same frame as the control write, IO
+ * register first, and the control write restarts the filter even when the
+ * channel bits are unchanged. The mux then settles during the filter
+ * restart, whose sinc3 weighting makes the first microseconds negligible, so
+ * no conversion period is spent on it. Only a settling time too long for
+ * that adds discarded results, see muxDiscard. Order the list by address to
+ * keep address changes rare.
+ *
+ * A failed transfer pushes nothing and leaves the scan on its entry. When the
+ * frame carried register writes the device may or may not have taken them,
+ * so the shadow registers are marked dirty and the next frame rewrites the
+ * current entry and discards its result.
+ */
+
+#define AD7708_SCAN_MAX 16
+#define AD7708_SCAN_XFER_LEN 7 // Data read (3) + IO write (2) + control write (2)
+
+/*! @name One step of the scan list */
+typedef struct
+{
+    AD7708_Channel channel;
+    AD7708_Range range;
+    AD7708_Polarity polarity;
+    uint8_t discard; // Results thrown away after switching to this entry, for external settling
+    uint8_t mux;     // External mux address, bit 0 on P1, bit 1 on P2, used after ad7708_scan_setMux
+} ad7708_scan_entry;
+
+/*! @name Sequencer state */
+typedef struct
+{
+    ad7708_dev* dev;
+    ad7708_ring* ring;
+    uint8_t control[AD7708_SCAN_MAX]; // Precomputed control register per entry
+    uint8_t discard[AD7708_SCAN_MAX];
+    uint8_t mux[AD7708_SCAN_MAX];     // Address per entry
+    uint8_t io[AD7708_SCAN_MAX];      // Precomputed IO register per entry, mux scan only
+    uint8_t muxed;
+    uint8_t muxDiscard;  // Extra results discarded after an address change, derived from muxSettleNs
+    uint32_t muxSettleNs;
+    uint8_t count;
+    uint8_t index;       // Entry whose conversion is running
+    uint8_t next;        // Entry programmed by the in-flight frame
+    uint8_t discardLeft;
+    uint8_t resync;      // A frame carrying register writes failed, rewrite the current entry before trusting results
+    uint32_t rdyUs;      // RDY time of the in-flight frame, stamps the sample when the ring keeps stamps
+    volatile uint8_t running;
+    volatile uint8_t dmaBusy;
+    uint8_t tx[AD7708_SCAN_XFER_LEN];
+    uint8_t rx[AD7708_SCAN_XFER_LEN];
+    volatile uint32_t samples;
+    volatile uint32_t discarded;
+    volatile uint32_t switches;     // Control register writes
+    volatile uint32_t passes;       // Completed passes over the list
+    volatile uint32_t muxSwitches;  // Address changes
+    volatile uint32_t busyOverruns;
+    volatile uint32_t fullOverruns;
+    volatile uint32_t errors;
+} ad7708_scan;
+
+/*!
+ * @brief Load the scan list
+ * @param[in] scan - Pointer to the sequencer state
+ * @param[in] dev - Pointer to the device structure
+ * @param[in] entries - Ordered scan list, copied
+ * @param[in] count - Number of entries, 1..AD7708_SCAN_MAX
+ * @param[in] ring - Initialized sample ring, the application is its consumer
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_scan_init(ad7708_scan* scan, ad7708_dev* dev, const ad7708_scan_entry* entries, uint8_t count, ad7708_ring* ring);
+
+/*!
+ * @brief Drive an external mux from P1/P2 with the address of each entry
+ * @param[in] scan - Pointer to the sequencer state, loaded but not running
+ * @param[in] settleNs - Mux and input network settling time after an address change
+ * @return 0: case of success, error code otherwise.
+ * @note P1 and P2 must be configured as outputs before ad7708_scan_start. Samples carry
+ *       the address in bits 4-5 of channel.
+ */
+StatusTypeDef ad7708_scan_setMux(ad7708_scan* scan, uint32_t settleNs);
+
+/*!
+ * @brief Program the first entry and start continuous conversion
+ * @param[in] scan - Pointer to the sequencer state
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_scan_start(ad7708_scan* scan);
+
+/*!
+ * @brief Stop reacting to RDY, the device is left converting
+ * @param[in] scan - Pointer to the sequencer state
+ * @return void
+ */
+void ad7708_scan_stop(ad7708_scan* scan);
+
+/*!
+ * @brief RDY falling edge handler, call from the EXTI interrupt
+ * @param[in] scan - Pointer to the sequencer state
+ * @return void
+ */
+void ad7708_scan_onRdy(ad7708_scan* scan);
+
+/*!
+ * @brief RDY handler for callers that saw the edge earlier, e.g. a shared bus scheduler
+ * @param[in] scan - Pointer to the sequencer state
+ * @param[in] timeUs - Transport us tick when RDY fired
+ * @return void
+ */
+void ad7708_scan_onRdyAt(ad7708_scan* scan, uint32_t timeUs);
+
+/*!
+ * @brief DMA transfer complete handler, call from the SPI DMA interrupt
+ * @param[in] scan - Pointer to the sequencer state
+ * @return void
+ */
+void ad7708_scan_dmaComplete(ad7708_scan* scan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
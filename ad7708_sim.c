@@ -0,0 +1,771 @@
+#include "ad7708_sim.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/********************** Static function declarations ************************/
+
+/*!
+ * @brief Width of a register data phase in bytes
+ * @param[in] reg - Register address
+ * @return 1 or 2
+ */
+static uint8_t regWidth(uint8_t reg);
+
+/*!
+ * @brief Current value of a register as seen by a read
+ * @param[in] sim - Pointer to the simulator
+ * @param[in] reg - Register address
+ * @return Register value
+ */
+static uint16_t readReg(ad7708_sim* sim, uint8_t reg);
+
+/*!
+ * @brief Apply a completed register write, including its side effects
+ * @param[in] sim - Pointer to the simulator
+ * @param[in] reg - Register address
+ * @param[in] value - Written value
+ * @return void
+ */
+static void writeReg(ad7708_sim* sim, uint8_t reg, uint16_t value);
+
+/*!
+ * @brief Start the operation selected by the mode register
+ * @param[in] sim - Pointer to the simulator
+ * @return void
+ */
+static void startMode(ad7708_sim* sim);
+
+/*!
+ * @brief Account for power-down entry and exit, stopping and restarting the oscillator
+ * @param[in] sim - Pointer to the simulator
+ * @param[in] prev - Mode register before the write
+ * @return void
+ */
+static void powerTransition(ad7708_sim* sim, uint8_t prev);
+
+/*!
+ * @brief Time from a mode start or channel switch to the first settled result
+ * @param[in] sim - Pointer to the simulator
+ * @return Settling time in ns
+ */
+static uint64_t settleNs(const ad7708_sim* sim);
+
+/*!
+ * @brief Complete every conversion whose ready time has passed
+ * @param[in] sim - Pointer to the simulator
+ * @return void
+ */
+static void simUpdate(ad7708_sim* sim);
+
+/*!
+ * @brief Finish the pending conversion or calibration
+ * @param[in] sim - Pointer to the simulator
+ * @return void
+ */
+static void simComplete(ad7708_sim* sim);
+
+/*!
+ * @brief Normalized input seen by the modulator, before calibration
+ * @param[in] sim - Pointer to the simulator
+ * @return Input as a fraction of the selected range
+ */
+static double sampleInput(ad7708_sim* sim);
+
+/*!
+ * @brief Run one conversion through the calibration registers
+ * @param[in] sim - Pointer to the simulator
+ * @return void
+ */
+static void convert(ad7708_sim* sim);
+
+static StatusTypeDef simTransmit(void* intf, uint8_t* data, uint16_t len);
+static StatusTypeDef simReceive(void* intf, uint8_t* data, uint16_t len);
+static StatusTypeDef simTransfer(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len);
+static void simSetCS(void* intf, const ad7708_pin* pin, uint8_t state);
+static uint8_t simReadPin(void* intf, const ad7708_pin* pin);
+static uint32_t simGetTick(void* intf);
+static uint32_t simGetTickUs(void* intf);
+static void simDelay(void* intf, uint32_t period);
+static StatusTypeDef simTransferDMA(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len);
+
+/*!
+ * @brief Bring every simulator on the bus up to the bus clock, firing due RDY edges
+ * @param[in] bus - Pointer to the bus
+ * @return void
+ */
+static void busSync(ad7708_sim_bus* bus);
+
+/*!
+ * @brief Clock bytes through whichever simulators have CS asserted, without completing conversions
+ * @param[in] bus - Pointer to the bus
+ * @param[in] tx - MOSI bytes, NULL clocks out ones
+ * @param[out] rx - MISO bytes, may be NULL
+ * @param[in] len - Number of bytes
+ * @return void
+ */
+static void busClock(ad7708_sim_bus* bus, const uint8_t* tx, uint8_t* rx, uint16_t len);
+
+static StatusTypeDef busTransmit(void* intf, uint8_t* data, uint16_t len);
+static StatusTypeDef busReceive(void* intf, uint8_t* data, uint16_t len);
+static StatusTypeDef busTransfer(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len);
+static void busSetCS(void* intf, const ad7708_pin* pin, uint8_t state);
+static uint8_t busReadPin(void* intf, const ad7708_pin* pin);
+static uint32_t busGetTick(void* intf);
+static uint32_t busGetTickUs(void* intf);
+static void busDelay(void* intf, uint32_t period);
+static StatusTypeDef busTransferDMA(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len);
+
+const ad7708_transport ad7708_simTransport = {
+    .transmit = simTransmit,
+    .receive = simReceive,
+    .transfer = simTransfer,
+    .setCS = simSetCS,
+    .readPin = simReadPin,
+    .getTick = simGetTick,
+    .getTickUs = simGetTickUs,
+    .delay_ms = simDelay,
+    .transferDMA = simTransferDMA,
+};
+
+const ad7708_transport ad7708_simBusTransport = {
+    .transmit = busTransmit,
+    .receive = busReceive,
+    .transfer = busTransfer,
+    .setCS = busSetCS,
+    .readPin = busReadPin,
+    .getTick = busGetTick,
+    .getTickUs = busGetTickUs,
+    .delay_ms = busDelay,
+    .transferDMA = busTransferDMA,
+};
+
+#define STATUS_LOCK 0x01U
+#define STATUS_ERR 0x08U
+#define STATUS_CAL 0x20U
+#define STATUS_RDY 0x80U
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Reset the simulator to the power-on state
+ */
+void ad7708_sim_init(ad7708_sim* sim)
+{
+    memset(sim, 0, sizeof(*sim));
+
+    sim->status = STATUS_LOCK;
+    sim->mode = AD7708_PowerDown;
+    sim->filter = AD7708_SIM_FILTER_DEFAULT;
+    for (uint8_t ch = 0; ch < 16; ch++)
+    {
+        sim->offset[ch] = AD7708_SIM_OFFSET_DEFAULT;
+        sim->gain[ch] = AD7708_SIM_GAIN_DEFAULT;
+    }
+
+    sim->cs = 1;
+    sim->byteNs = AD7708_SIM_BYTE_NS;
+    sim->oscStartNs = AD7708_SIM_OSC_START_NS;
+    sim->vref = 2.5;
+    sim->rng = 0x12345678U;
+}
+
+/*!
+ * @brief Bind a device to a simulator
+ */
+void ad7708_sim_attach(ad7708_sim* sim, ad7708_dev* dev)
+{
+    dev->transport = &ad7708_simTransport;
+    dev->intf = sim;
+}
+
+/*!
+ * @brief Advance the virtual clock, completing any conversion that falls due
+ */
+void ad7708_sim_advance(ad7708_sim* sim, uint64_t ns)
+{
+    uint64_t target = sim->nowNs + ns;
+
+    // Step from edge to edge so RDY handlers see the time they fired at
+    while (sim->readyAtNs != 0 && sim->readyAtNs <= target && !sim->inUpdate)
+    {
+        if (sim->nowNs < sim->readyAtNs) { sim->nowNs = sim->readyAtNs; }
+        simUpdate(sim);
+    }
+    if (sim->nowNs < target) { sim->nowNs = target; }
+}
+
+/*!
+ * @brief Time of the next RDY edge
+ */
+uint64_t ad7708_sim_nextEvent(const ad7708_sim* sim)
+{
+    return sim->readyAtNs;
+}
+
+/*!
+ * @brief Level of the RDY pin
+ */
+uint8_t ad7708_sim_rdyPin(const ad7708_sim* sim)
+{
+    return (sim->status & STATUS_RDY) ? 0 : 1;
+}
+
+/*!
+ * @brief Output data rate for the current filter and chop setting
+ */
+uint64_t ad7708_sim_periodNs(const ad7708_sim* sim)
+{
+    uint8_t chop = (sim->mode >> 7) & 0x01U;
+    uint8_t sfMin = chop ? AD7708_SIM_SF_MIN_CHOP : AD7708_SIM_SF_MIN;
+    uint64_t sf = sim->filter < sfMin ? sfMin : sim->filter;
+
+    // f_ADC = f_MOD / (8 * SF), another factor of 3 with chopping
+    return sf * (chop ? 24U : 8U) * 1000000000ULL / AD7708_SIM_FMOD_HZ;
+}
+
+/*!
+ * @brief Reset a shared bus with no devices
+ */
+void ad7708_sim_bus_init(ad7708_sim_bus* bus)
+{
+    memset(bus, 0, sizeof(*bus));
+    bus->byteNs = AD7708_SIM_BYTE_NS;
+}
+
+/*!
+ * @brief Put a simulator on the bus and bind a device to it
+ */
+StatusTypeDef ad7708_sim_bus_add(ad7708_sim_bus* bus, ad7708_sim* sim, ad7708_dev* dev)
+{
+    if (bus->count >= AD7708_SIM_BUS_MAX) { return AD7708_ERROR; }
+
+    sim->nowNs = bus->nowNs;
+    sim->byteNs = bus->byteNs;
+
+    // The pin number is the slot on the bus, port is unused on the host
+    dev->transport = &ad7708_simBusTransport;
+    dev->intf = bus;
+    dev->cs.port = NULL;
+    dev->cs.pin = bus->count;
+    dev->rdy = dev->cs;
+
+    bus->sims[bus->count++] = sim;
+
+    return AD7708_OK;
+}
+
+/*!
+ * @brief Advance the bus clock, firing RDY edges of all devices in time order
+ */
+void ad7708_sim_bus_advance(ad7708_sim_bus* bus, uint64_t ns)
+{
+    uint64_t target = bus->nowNs + ns;
+
+    for (;;)
+    {
+        uint64_t next = 0;
+        for (uint8_t i = 0; i < bus->count; i++)
+        {
+            uint64_t at = bus->sims[i]->readyAtNs;
+            if (at != 0 && at <= target && (next == 0 || at < next)) { next = at; }
+        }
+        if (next == 0) { break; }
+
+        if (bus->nowNs < next) { bus->nowNs = next; }
+        busSync(bus);
+    }
+    if (bus->nowNs < target) { bus->nowNs = target; }
+    busSync(bus);
+}
+
+/*!
+ * @brief Exchange one byte on the serial interface
+ */
+uint8_t ad7708_sim_exchange(ad7708_sim* sim, uint8_t mosi)
+{
+    uint8_t miso = 0x00U;
+
+    if (sim->phaseLeft != 0 && sim->phaseRw == AD7708_Read)
+    {
+        miso = sim->phaseBuf[regWidth(sim->phaseReg) - sim->phaseLeft];
+        if (--sim->phaseLeft == 0 && sim->phaseReg == DATA_REG)
+        {
+            sim->status &= (uint8_t)~STATUS_RDY;
+        }
+        return miso;
+    }
+
+    // 32 consecutive ones reset the interface whatever state it is in
+    sim->onesCount = (mosi == 0xFFU) ? (uint8_t)(sim->onesCount + 1) : 0;
+    if (sim->onesCount >= 4)
+    {
+        sim->phaseLeft = 0;
+        sim->onesCount = 0;
+        return miso;
+    }
+
+    if (sim->phaseLeft != 0)
+    {
+        uint8_t width = regWidth(sim->phaseReg);
+        sim->phaseBuf[width - sim->phaseLeft] = mosi;
+        if (--sim->phaseLeft == 0)
+        {
+            uint16_t value = (width == 2) ? (uint16_t)((sim->phaseBuf[0] << 8) | sim->phaseBuf[1]) : sim->phaseBuf[0];
+            writeReg(sim, sim->phaseReg, value);
+        }
+        return miso;
+    }
+
+    // Waiting for a communications register write
+    if (mosi & 0x80U) { return miso; } // WEN high, ignored
+    if (mosi & 0x30U)
+    {
+        sim->badComm++;
+        return miso;
+    }
+
+    sim->phaseReg = mosi & 0x0FU;
+    sim->phaseRw = (mosi >> 6) & 0x01U;
+    if (sim->phaseRw == AD7708_Write && sim->phaseReg == COMM_REG) { return miso; }
+
+    sim->phaseLeft = regWidth(sim->phaseReg);
+    if (sim->phaseRw == AD7708_Read)
+    {
+        uint16_t value = readReg(sim, sim->phaseReg);
+        if (sim->phaseLeft == 2)
+        {
+            sim->phaseBuf[0] = (uint8_t)(value >> 8);
+            sim->phaseBuf[1] = (uint8_t)value;
+        }
+        else
+        {
+            sim->phaseBuf[0] = (uint8_t)value;
+        }
+    }
+
+    return miso;
+}
+
+/****************** Static Function Definitions *******************************/
+
+static uint8_t regWidth(uint8_t reg)
+{
+    return (reg == DATA_REG || reg == OFFSET_REG || reg == GAIN_REG) ? 2 : 1;
+}
+
+static uint16_t readReg(ad7708_sim* sim, uint8_t reg)
+{
+    uint8_t ch = sim->control >> 4;
+
+    switch (reg)
+    {
+    case STATUS_REG: return sim->status;
+    case MODE_REG: return sim->mode;
+    case CONTROL_REG: return sim->control;
+    case FILTER_REG: return sim->filter;
+    case DATA_REG: return sim->data;
+    case OFFSET_REG: return sim->offset[ch];
+    case GAIN_REG: return sim->gain[ch];
+    case IO_CONTROL_REG:
+    {
+        uint8_t value = sim->ioControl;
+        // Pins configured as inputs read back the external level
+        if (!(value & 0x10U)) { value = (uint8_t)((value & ~0x01U) | (sim->pinIn[0] & 0x01U)); }
+        if (!(value & 0x20U)) { value = (uint8_t)((value & ~0x02U) | ((sim->pinIn[1] & 0x01U) << 1)); }
+        return value;
+    }
+    case TEST1_REG: return sim->test1;
+    case TEST2_REG: return sim->test2;
+    case ID_REG: return AD7708_SIM_ID;
+    default: return 0;
+    }
+}
+
+static void writeReg(ad7708_sim* sim, uint8_t reg, uint16_t value)
+{
+    uint8_t ch = sim->control >> 4;
+
+    switch (reg)
+    {
+    case MODE_REG:
+    {
+        uint8_t prev = sim->mode;
+        sim->mode = (uint8_t)value;
+        powerTransition(sim, prev);
+        startMode(sim);
+        break;
+    }
+    case CONTROL_REG:
+        sim->control = (uint8_t)value;
+        if ((sim->mode & 0x07U) == AD7708_ContinuousConversion) { sim->readyAtNs = sim->nowNs + settleNs(sim); }
+        break;
+    case FILTER_REG:
+        sim->filter = (uint8_t)value;
+        if ((sim->mode & 0x07U) == AD7708_ContinuousConversion) { sim->readyAtNs = sim->nowNs + settleNs(sim); }
+        break;
+    case OFFSET_REG: sim->offset[ch] = value; break;
+    case GAIN_REG: sim->gain[ch] = value; break;
+    case IO_CONTROL_REG: sim->ioControl = (uint8_t)(value & 0x33U); break; // zero bits are forced
+    case TEST1_REG: sim->test1 = (uint8_t)value; break;
+    case TEST2_REG: sim->test2 = (uint8_t)value; break;
+    default: break; // status, data and ID are read only
+    }
+}
+
+static void startMode(ad7708_sim* sim)
+{
+    switch (sim->mode & 0x07U)
+    {
+    case AD7708_PowerDown:
+    case AD7708_Idle:
+        sim->readyAtNs = 0;
+        break;
+    default:
+        sim->status &= (uint8_t)~(STATUS_RDY | STATUS_CAL);
+        // The modulator waits for the clock when the PLL is still locking
+        sim->readyAtNs = (sim->lockAtNs > sim->nowNs ? sim->lockAtNs : sim->nowNs) + settleNs(sim);
+        break;
+    }
+}
+
+static void powerTransition(ad7708_sim* sim, uint8_t prev)
+{
+    uint8_t wasDown = (prev & 0x07U) == AD7708_PowerDown;
+    uint8_t isDown = (sim->mode & 0x07U) == AD7708_PowerDown;
+
+    if (!wasDown && isDown)
+    {
+        sim->activeNs += sim->nowNs - sim->activeSinceNs;
+        if (sim->mode & 0x08U) // OSCPD
+        {
+            sim->status &= (uint8_t)~STATUS_LOCK;
+            sim->lockAtNs = 0;
+        }
+    }
+    else if (wasDown && !isDown)
+    {
+        sim->activeSinceNs = sim->nowNs;
+        sim->wakeups++;
+        if (!(sim->status & STATUS_LOCK) && sim->lockAtNs == 0) { sim->lockAtNs = sim->nowNs + sim->oscStartNs; }
+    }
+}
+
+static uint64_t settleNs(const ad7708_sim* sim)
+{
+    uint8_t chop = (sim->mode >> 7) & 0x01U;
+    return ad7708_sim_periodNs(sim) * (chop ? 2U : 3U);
+}
+
+static void simUpdate(ad7708_sim* sim)
+{
+    if (sim->lockAtNs != 0 && sim->nowNs >= sim->lockAtNs)
+    {
+        sim->status |= STATUS_LOCK;
+        sim->lockAtNs = 0;
+    }
+
+    if (sim->inUpdate) { return; } // Called back from an RDY handler, the outer loop carries on
+    sim->inUpdate = 1;
+
+    while (sim->readyAtNs != 0 && sim->nowNs >= sim->readyAtNs)
+    {
+        simComplete(sim);
+    }
+
+    sim->inUpdate = 0;
+}
+
+static void simComplete(ad7708_sim* sim)
+{
+    uint8_t ch = sim->control >> 4;
+    uint8_t mode = sim->mode & 0x07U;
+
+    switch (mode)
+    {
+    case AD7708_SingleConversion:
+        convert(sim);
+        sim->readyAtNs = 0;
+        break;
+    case AD7708_ContinuousConversion:
+        if (sim->status & STATUS_RDY) { sim->overruns++; }
+        convert(sim);
+        sim->readyAtNs += ad7708_sim_periodNs(sim);
+        break;
+    case AD7708_InternalZeroCalibration:
+        sim->offset[ch] = (uint16_t)(AD7708_SIM_OFFSET_DEFAULT + (int32_t)(sim->offsetError * 32768.0));
+        break;
+    case AD7708_InternalFullCalibration:
+        sim->gain[ch] = (uint16_t)(AD7708_SIM_GAIN_DEFAULT * (1.0 + sim->gainError) + 0.5);
+        break;
+    case AD7708_SystemZeroCalibration:
+        sim->offset[ch] = (uint16_t)(AD7708_SIM_OFFSET_DEFAULT + (int32_t)(sampleInput(sim) * 32768.0));
+        break;
+    case AD7708_SystemFullCalibration:
+    {
+        double span = sampleInput(sim) - ((int32_t)sim->offset[ch] - (int32_t)AD7708_SIM_OFFSET_DEFAULT) / 32768.0;
+        if (span > 0.0) { sim->gain[ch] = (uint16_t)(AD7708_SIM_GAIN_DEFAULT * span + 0.5); }
+        break;
+    }
+    default:
+        sim->readyAtNs = 0;
+        return;
+    }
+
+    if (mode != AD7708_ContinuousConversion)
+    {
+        // Single conversions and calibrations drop back to idle
+        sim->mode = (uint8_t)((sim->mode & ~0x07U) | AD7708_Idle);
+        sim->readyAtNs = 0;
+        if (mode != AD7708_SingleConversion) { sim->status |= STATUS_CAL; }
+    }
+
+    sim->status |= STATUS_RDY;
+    if (sim->onRdy) { sim->onRdy(sim->rdyArg); }
+}
+
+static double sampleInput(ad7708_sim* sim)
+{
+    uint8_t ch = sim->control >> 4;
+    uint8_t range = sim->control & 0x07U;
+    double fullScale = 0.020 * (double)(1U << range) * sim->vref / 2.5;
+    double volts = sim->input ? sim->input(sim->inputArg, ch, sim->nowNs) : sim->ain[ch];
+
+    return (volts / fullScale) * (1.0 + sim->gainError) + sim->offsetError;
+}
+
+static void convert(ad7708_sim* sim)
+{
+    uint8_t ch = sim->control >> 4;
+    uint8_t unipolar = (sim->control >> 3) & 0x01U;
+    double offset = ((int32_t)sim->offset[ch] - (int32_t)AD7708_SIM_OFFSET_DEFAULT) / 32768.0;
+    double x = (sampleInput(sim) - offset) * ((double)AD7708_SIM_GAIN_DEFAULT / (double)sim->gain[ch]);
+    double code = unipolar ? x * 65536.0 : 32768.0 + x * 32768.0;
+
+    if (sim->noiseCodes > 0.0)
+    {
+        // Triangular noise from two xorshift draws
+        double n = 0.0;
+        for (uint8_t i = 0; i < 2; i++)
+        {
+            sim->rng ^= sim->rng << 13;
+            sim->rng ^= sim->rng >> 17;
+            sim->rng ^= sim->rng << 5;
+            n += (double)sim->rng / 4294967296.0 - 0.5;
+        }
+        code += n * sim->noiseCodes;
+    }
+
+    code += 0.5;
+    if (code < 0.0 || code >= 65536.0)
+    {
+        sim->data = code < 0.0 ? 0x0000U : 0xFFFFU;
+        sim->status |= STATUS_ERR;
+    }
+    else
+    {
+        sim->data = (uint16_t)code;
+        sim->status &= (uint8_t)~STATUS_ERR;
+    }
+    sim->conversions++;
+}
+
+static StatusTypeDef simTransmit(void* intf, uint8_t* data, uint16_t len)
+{
+    ad7708_sim* sim = (ad7708_sim*)intf;
+
+    for (uint16_t i = 0; i < len; i++)
+    {
+        if (!sim->cs) { ad7708_sim_exchange(sim, data[i]); }
+        sim->nowNs += sim->byteNs;
+        sim->bytes++;
+    }
+    simUpdate(sim);
+
+    return AD7708_OK;
+}
+
+static StatusTypeDef simReceive(void* intf, uint8_t* data, uint16_t len)
+{
+    ad7708_sim* sim = (ad7708_sim*)intf;
+
+    for (uint16_t i = 0; i < len; i++)
+    {
+        data[i] = sim->cs ? 0xFFU : ad7708_sim_exchange(sim, 0xFFU);
+        sim->nowNs += sim->byteNs;
+        sim->bytes++;
+    }
+    simUpdate(sim);
+
+    return AD7708_OK;
+}
+
+static void simSetCS(void* intf, const ad7708_pin* pin, uint8_t state)
+{
+    ad7708_sim* sim = (ad7708_sim*)intf;
+
+    (void)pin; // One device per simulator
+
+    if (!state && sim->cs) { sim->csCycles++; }
+    sim->cs = state ? 1 : 0;
+}
+
+static uint8_t simReadPin(void* intf, const ad7708_pin* pin)
+{
+    (void)pin;
+    return ad7708_sim_rdyPin((ad7708_sim*)intf);
+}
+
+static uint32_t simGetTick(void* intf)
+{
+    return (uint32_t)(((ad7708_sim*)intf)->nowNs / 1000000ULL);
+}
+
+static uint32_t simGetTickUs(void* intf)
+{
+    return (uint32_t)(((ad7708_sim*)intf)->nowNs / 1000ULL);
+}
+
+static void simDelay(void* intf, uint32_t period)
+{
+    ad7708_sim_advance((ad7708_sim*)intf, (uint64_t)period * 1000000ULL);
+}
+
+static StatusTypeDef simTransfer(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len)
+{
+    ad7708_sim* sim = (ad7708_sim*)intf;
+
+    for (uint16_t i = 0; i < len; i++)
+    {
+        rx[i] = sim->cs ? 0xFFU : ad7708_sim_exchange(sim, tx[i]);
+        sim->nowNs += sim->byteNs;
+        sim->bytes++;
+    }
+    simUpdate(sim);
+
+    return AD7708_OK;
+}
+
+static StatusTypeDef simTransferDMA(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len)
+{
+    ad7708_sim* sim = (ad7708_sim*)intf;
+
+    // The transfer completes instantly, the clock still pays for every byte
+    for (uint16_t i = 0; i < len; i++)
+    {
+        rx[i] = sim->cs ? 0xFFU : ad7708_sim_exchange(sim, tx[i]);
+        sim->nowNs += sim->byteNs;
+        sim->bytes++;
+    }
+    if (sim->onDmaDone) { sim->onDmaDone(sim->dmaArg); }
+    simUpdate(sim);
+
+    return AD7708_OK;
+}
+
+static void busSync(ad7708_sim_bus* bus)
+{
+    // RDY handlers may clock more bytes and move the bus clock on, re-read it every time
+    for (uint8_t i = 0; i < bus->count; i++)
+    {
+        ad7708_sim* sim = bus->sims[i];
+        if (sim->nowNs < bus->nowNs) { ad7708_sim_advance(sim, bus->nowNs - sim->nowNs); }
+    }
+}
+
+static void busClock(ad7708_sim_bus* bus, const uint8_t* tx, uint8_t* rx, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++)
+    {
+        uint8_t mosi = tx ? tx[i] : 0xFFU;
+        uint8_t miso = 0xFFU; // Pulled up while nobody drives DOUT
+        uint8_t driven = 0;
+
+        for (uint8_t d = 0; d < bus->count; d++)
+        {
+            ad7708_sim* sim = bus->sims[d];
+            if (sim->cs) { continue; }
+            miso &= ad7708_sim_exchange(sim, mosi);
+            sim->bytes++;
+            driven++;
+        }
+        if (driven > 1) { bus->collisions++; }
+        if (rx) { rx[i] = miso; }
+    }
+
+    bus->nowNs += (uint64_t)len * bus->byteNs;
+    bus->busyNs += (uint64_t)len * bus->byteNs;
+    bus->bytes += len;
+}
+
+static StatusTypeDef busTransmit(void* intf, uint8_t* data, uint16_t len)
+{
+    busClock((ad7708_sim_bus*)intf, data, NULL, len);
+    busSync((ad7708_sim_bus*)intf);
+    return AD7708_OK;
+}
+
+static StatusTypeDef busReceive(void* intf, uint8_t* data, uint16_t len)
+{
+    busClock((ad7708_sim_bus*)intf, NULL, data, len);
+    busSync((ad7708_sim_bus*)intf);
+    return AD7708_OK;
+}
+
+static StatusTypeDef busTransfer(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len)
+{
+    busClock((ad7708_sim_bus*)intf, tx, rx, len);
+    busSync((ad7708_sim_bus*)intf);
+    return AD7708_OK;
+}
+
+static void busSetCS(void* intf, const ad7708_pin* pin, uint8_t state)
+{
+    ad7708_sim_bus* bus = (ad7708_sim_bus*)intf;
+    ad7708_sim* sim;
+
+    if (pin->pin >= bus->count) { return; }
+    sim = bus->sims[pin->pin];
+
+    if (!state && sim->cs)
+    {
+        sim->csCycles++;
+        bus->csCycles++;
+    }
+    sim->cs = state ? 1 : 0;
+}
+
+static uint8_t busReadPin(void* intf, const ad7708_pin* pin)
+{
+    ad7708_sim_bus* bus = (ad7708_sim_bus*)intf;
+
+    if (pin->pin >= bus->count) { return 1; }
+    return ad7708_sim_rdyPin(bus->sims[pin->pin]);
+}
+
+static uint32_t busGetTick(void* intf)
+{
+    return (uint32_t)(((ad7708_sim_bus*)intf)->nowNs / 1000000ULL);
+}
+
+static uint32_t busGetTickUs(void* intf)
+{
+    return (uint32_t)(((ad7708_sim_bus*)intf)->nowNs / 1000ULL);
+}
+
+static void busDelay(void* intf, uint32_t period)
+{
+    ad7708_sim_bus_advance((ad7708_sim_bus*)intf, (uint64_t)period * 1000000ULL);
+}
+
+static StatusTypeDef busTransferDMA(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len)
+{
+    ad7708_sim_bus* bus = (ad7708_sim_bus*)intf;
+
+    // Completion is reported before the other devices catch up, like a DMA interrupt preempting the main loop
+    busClock(bus, tx, rx, len);
+    if (bus->onDmaDone) { bus->onDmaDone(bus->dmaArg); }
+    busSync(bus);
+
+    return AD7708_OK;
+}
@@ -0,0 +1,202 @@
+#ifndef __AD7708_SIM_H__
+#define __AD7708_SIM_H__
+
+#include "ad7708_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Host side model of the AD7708 register map and conversion timing.
+ *
+ * The simulator keeps a virtual clock in ns. Every SPI byte advances it by
+ * byteNs and conversions complete when the clock passes their ready time, so
+ * the driver's polling loops terminate exactly like on hardware. Tests can also
+ * jump the clock with ad7708_sim_advance().
+ */
+
+/****************** Simulator Specifications *******************************/
+
+#define AD7708_SIM_FMOD_HZ 32768U     // Modulator clock
+#define AD7708_SIM_ID 0x50U           // ID register: AD7708 in the upper nibble
+#define AD7708_SIM_OFFSET_DEFAULT 0x8000U
+#define AD7708_SIM_GAIN_DEFAULT 0x5A00U
+#define AD7708_SIM_FILTER_DEFAULT 0x45U
+#define AD7708_SIM_SF_MIN 0x03U       // Chop disabled
+#define AD7708_SIM_SF_MIN_CHOP 0x0DU  // Chop enabled
+#define AD7708_SIM_BYTE_NS 2000U      // 8 bits at 4 MHz SCLK
+#define AD7708_SIM_OSC_START_NS 300000000U // 32.768 kHz crystal start-up and PLL lock after OSCPD power-down
+
+/*! @brief Analog input source, returns the differential input voltage of a channel */
+typedef double (*ad7708_sim_input_fptr_t)(void* arg, uint8_t channel, uint64_t timeNs);
+
+/*! @brief Called on every RDY falling edge and on simulated DMA completion */
+typedef void (*ad7708_sim_rdy_fptr_t)(void* arg);
+
+/*! @name Simulator state */
+typedef struct
+{
+    /* Register file */
+    uint8_t status;
+    uint8_t mode;
+    uint8_t control;
+    uint8_t filter;
+    uint8_t ioControl;
+    uint8_t test1;
+    uint8_t test2;
+    uint16_t data;
+    uint16_t offset[16]; // One calibration pair per channel
+    uint16_t gain[16];
+
+    /* Serial interface */
+    uint8_t cs;         // Current CS level, 1: released
+    uint8_t phaseReg;   // Register of the pending data phase
+    uint8_t phaseRw;    // AD7708_Read / AD7708_Write
+    uint8_t phaseLeft;  // Bytes left in the data phase, 0: waiting for comm write
+    uint8_t phaseBuf[2];
+    uint8_t onesCount;  // Consecutive 0xFF bytes, 4 resets the interface
+
+    /* Conversion engine */
+    uint64_t nowNs;
+    uint64_t readyAtNs; // Next conversion/calibration completion, 0: none pending
+    uint32_t byteNs;
+    uint8_t inUpdate;
+
+    /* Oscillator */
+    uint32_t oscStartNs;   // Time to LOCK after leaving power-down with the oscillator stopped
+    uint64_t lockAtNs;     // Pending PLL lock, 0: locked or stopped
+
+    /* Analog front end */
+    double vref;
+    double ain[16];         // Static input per channel, used when input is NULL
+    double offsetError;     // Fraction of full scale
+    double gainError;       // Relative
+    double noiseCodes;      // Peak noise in LSB
+    uint8_t pinIn[2];       // External level of P1/P2 when configured as inputs
+    uint32_t rng;
+    ad7708_sim_input_fptr_t input;
+    void* inputArg;
+    ad7708_sim_rdy_fptr_t onRdy;   // EXTI stand-in
+    void* rdyArg;
+    ad7708_sim_rdy_fptr_t onDmaDone; // SPI DMA complete interrupt stand-in
+    void* dmaArg;
+
+    /* Statistics */
+    uint32_t csCycles;
+    uint32_t bytes;
+    uint32_t conversions;
+    uint32_t overruns;   // Conversions that replaced unread data
+    uint32_t badComm;    // Comm writes rejected (WEN or zero bits set)
+    uint32_t wakeups;    // Exits from power-down
+    uint64_t activeNs;   // Time spent out of power-down, up to the last power-down
+    uint64_t activeSinceNs;
+} ad7708_sim;
+
+/*! @name Several simulators sharing one SPI bus, selected by their CS pin */
+#define AD7708_SIM_BUS_MAX 8
+
+typedef struct
+{
+    ad7708_sim* sims[AD7708_SIM_BUS_MAX];
+    uint8_t count;
+    uint64_t nowNs;   // Master clock, every simulator is kept in step with it
+    uint32_t byteNs;
+    ad7708_sim_rdy_fptr_t onDmaDone; // One DMA channel per bus
+    void* dmaArg;
+
+    /* Statistics */
+    uint64_t busyNs;     // Time SCLK was running
+    uint32_t bytes;
+    uint32_t csCycles;
+    uint32_t collisions; // Bytes clocked with more than one CS asserted
+} ad7708_sim_bus;
+
+/*! @name Transport implementation, intf points to an ad7708_sim */
+extern const ad7708_transport ad7708_simTransport;
+
+/*! @name Transport implementation, intf points to an ad7708_sim_bus and dev->cs.pin selects the simulator */
+extern const ad7708_transport ad7708_simBusTransport;
+
+/*!
+ * @brief Reset the simulator to the power-on state
+ * @param[in] sim - Pointer to the simulator
+ * @return void
+ */
+void ad7708_sim_init(ad7708_sim* sim);
+
+/*!
+ * @brief Bind a device to a simulator
+ * @param[in] sim - Pointer to the simulator
+ * @param[in] dev - Pointer to the device structure
+ * @return void
+ */
+void ad7708_sim_attach(ad7708_sim* sim, ad7708_dev* dev);
+
+/*!
+ * @brief Advance the virtual clock, completing any conversion that falls due
+ * @param[in] sim - Pointer to the simulator
+ * @param[in] ns - Time step
+ * @return void
+ */
+void ad7708_sim_advance(ad7708_sim* sim, uint64_t ns);
+
+/*!
+ * @brief Time of the next RDY edge
+ * @param[in] sim - Pointer to the simulator
+ * @return Absolute time in ns, 0 if no conversion is pending
+ */
+uint64_t ad7708_sim_nextEvent(const ad7708_sim* sim);
+
+/*!
+ * @brief Level of the RDY pin
+ * @param[in] sim - Pointer to the simulator
+ * @return 0: data ready, 1: no new data
+ */
+uint8_t ad7708_sim_rdyPin(const ad7708_sim* sim);
+
+/*!
+ * @brief Output data rate for the current filter and chop setting
+ * @param[in] sim - Pointer to the simulator
+ * @return Conversion period in ns
+ */
+uint64_t ad7708_sim_periodNs(const ad7708_sim* sim);
+
+/*!
+ * @brief Reset a shared bus with no devices
+ * @param[in] bus - Pointer to the bus
+ * @return void
+ */
+void ad7708_sim_bus_init(ad7708_sim_bus* bus);
+
+/*!
+ * @brief Put a simulator on the bus and bind a device to it
+ * @param[in] bus - Pointer to the bus
+ * @param[in] sim - Initialized simulator, its clock is moved to the bus clock
+ * @param[in] dev - Pointer to the device structure, gets the bus transport and its CS/RDY pins
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_sim_bus_add(ad7708_sim_bus* bus, ad7708_sim* sim, ad7708_dev* dev);
+
+/*!
+ * @brief Advance the bus clock, firing RDY edges of all devices in time order
+ * @param[in] bus - Pointer to the bus
+ * @param[in] ns - Time step
+ * @return void
+ */
+void ad7708_sim_bus_advance(ad7708_sim_bus* bus, uint64_t ns);
+
+/*!
+ * @brief Exchange one byte on the serial interface
+ * @param[in] sim - Pointer to the simulator
+ * @param[in] mosi - Byte clocked into DIN
+ * @return Byte clocked out of DOUT
+ * @note Ignores CS, the transport only calls it while CS is asserted
+ */
+uint8_t ad7708_sim_exchange(ad7708_sim* sim, uint8_t mosi);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
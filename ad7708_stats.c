@@ -0,0 +1,196 @@
+#include "ad7708_stats.h"
+
+#include <math.h>
+#include <string.h>
+
+// Sequence counter ordering, data accesses stay between the two counter updates
+#define SEQ_LOAD_ACQ(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SEQ_LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define SEQ_STORE_REL(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/********************** Static function declarations ************************/
+
+#if AD7708_STATS
+/*!
+ * @brief Device hook, forwards to ad7708_stats_update
+ * @param[in] arg - Pointer to the aggregator
+ * @param[in] sample - Result
+ * @return void
+ */
+static void onSample(void* arg, const ad7708_sample* sample);
+#endif
+
+/*!
+ * @brief Empty a channel block, keeping its sequence counter
+ * @param[in] c - Channel block
+ * @return void
+ */
+static void clearChannel(ad7708_stats_channel* c);
+
+/*!
+ * @brief Signed division rounding to nearest
+ * @param[in] num - Dividend
+ * @param[in] den - Divisor, positive
+ * @return num / den
+ */
+static int64_t divRound(int64_t num, int64_t den);
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Clear every channel
+ */
+void ad7708_stats_init(ad7708_stats* stats, uint16_t channels)
+{
+    memset(stats, 0, sizeof(*stats));
+    for (uint8_t i = 0; i < 16; i++) { clearChannel(&stats->ch[i]); }
+    stats->enabled = channels;
+}
+
+/*!
+ * @brief Feed every result the device reads into the aggregator
+ */
+StatusTypeDef ad7708_stats_attach(ad7708_stats* stats, ad7708_dev* dev)
+{
+#if AD7708_STATS
+    dev->onSample = NULL;
+    dev->onSampleArg = stats;
+    if (stats != NULL) { dev->onSample = onSample; }
+
+    return AD7708_OK;
+#else
+    (void)stats;
+    (void)dev;
+
+    return AD7708_ERROR;
+#endif
+}
+
+/*!
+ * @brief Add one result, writer side
+ */
+void ad7708_stats_update(ad7708_stats* stats, const ad7708_sample* sample)
+{
+    uint8_t channel = sample->channel & 0x0FU;
+    uint8_t tag = sample->flags & AD7708_SAMPLE_TAG_MASK;
+    uint16_t bit = (uint16_t)(1U << channel);
+    ad7708_stats_channel* c = &stats->ch[channel];
+    uint32_t seq;
+    int64_t x, delta;
+
+    if (!(stats->enabled & bit)) { return; }
+
+    seq = c->seq;
+    SEQ_STORE_REL(&c->seq, seq + 1);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if ((__atomic_load_n(&stats->resetPending, __ATOMIC_ACQUIRE) & bit) || (c->count != 0 && tag != c->flags))
+    {
+        __atomic_fetch_and(&stats->resetPending, (uint16_t)~bit, __ATOMIC_RELAXED);
+        clearChannel(c);
+    }
+
+    c->flags = tag;
+    c->count++;
+    if (sample->flags & AD7708_SAMPLE_CLAMPED) { c->clamped++; }
+    if (sample->code < c->min) { c->min = sample->code; }
+    if (sample->code > c->max) { c->max = sample->code; }
+    c->hist[sample->code >> AD7708_STATS_BIN_SHIFT]++;
+
+    // Welford: the deviations from the old and the new mean keep m2 free of cancellation
+    x = (int64_t)sample->code << AD7708_STATS_MEAN_FRAC;
+    delta = x - c->mean;
+    c->mean = (uint32_t)(c->mean + divRound(delta, c->count));
+    {
+        int64_t d1 = divRound(delta, 1L << (AD7708_STATS_MEAN_FRAC - 8));
+        int64_t d2 = divRound(x - c->mean, 1L << (AD7708_STATS_MEAN_FRAC - 8));
+        int64_t dm2 = divRound(d1 * d2, 1L << (16 - AD7708_STATS_M2_FRAC));
+        if (dm2 > 0) { c->m2 += (uint64_t)dm2; }
+    }
+
+    SEQ_STORE_REL(&c->seq, seq + 2);
+}
+
+/*!
+ * @brief Ask the writer to restart a channel, safe from the reader side
+ */
+void ad7708_stats_reset(ad7708_stats* stats, uint8_t channel)
+{
+    if (channel >= 16) { return; }
+
+    __atomic_fetch_or(&stats->resetPending, (uint16_t)(1U << channel), __ATOMIC_RELEASE);
+}
+
+/*!
+ * @brief Consistent copy of a channel, reader side
+ */
+StatusTypeDef ad7708_stats_snapshot(const ad7708_stats* stats, uint8_t channel, ad7708_stats_channel* out)
+{
+    const ad7708_stats_channel* c;
+
+    if (channel >= 16) { return AD7708_ERROR; }
+    c = &stats->ch[channel];
+
+    for (uint8_t attempt = 0; attempt < AD7708_STATS_RETRIES; attempt++)
+    {
+        uint32_t before = SEQ_LOAD_ACQ(&c->seq);
+
+        if (before & 1U) { continue; } // Writer inside an update
+
+        memcpy(out, (const void*)c, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (SEQ_LOAD(&c->seq) == before) { return AD7708_OK; }
+    }
+
+    return AD7708_BUSY;
+}
+
+/*!
+ * @brief Mean, deviation and RMS of a snapshot
+ */
+void ad7708_stats_summarize(const ad7708_stats_channel* snap, ad7708_stats_summary* summary)
+{
+    double mean = (double)snap->mean / (double)(1UL << AD7708_STATS_MEAN_FRAC);
+    double m2 = (double)snap->m2 / (double)(1UL << AD7708_STATS_M2_FRAC);
+    double offset = mean - AD7708_SAMPLE_ZERO_CODE(snap->flags);
+
+    memset(summary, 0, sizeof(*summary));
+    summary->count = snap->count;
+    summary->clamped = snap->clamped;
+    if (snap->count == 0) { return; }
+
+    summary->min = snap->min;
+    summary->max = snap->max;
+    summary->meanX100 = (uint32_t)(mean * 100.0 + 0.5);
+    if (snap->count > 1) { summary->stdX100 = (uint32_t)(sqrt(m2 / (snap->count - 1)) * 100.0 + 0.5); }
+
+    // Mean square about zero scale is the population variance plus the squared offset of the mean
+    summary->rmsX100 = (uint32_t)(sqrt(m2 / snap->count + offset * offset) * 100.0 + 0.5);
+}
+
+/****************** Static Function Definitions *******************************/
+
+#if AD7708_STATS
+static void onSample(void* arg, const ad7708_sample* sample)
+{
+    ad7708_stats_update((ad7708_stats*)arg, sample);
+}
+#endif
+
+static void clearChannel(ad7708_stats_channel* c)
+{
+    c->count = 0;
+    c->clamped = 0;
+    c->min = 0xFFFFU;
+    c->max = 0;
+    c->flags = 0;
+    c->mean = 0;
+    c->m2 = 0;
+    memset(c->hist, 0, sizeof(c->hist));
+}
+
+static int64_t divRound(int64_t num, int64_t den)
+{
+    return (num >= 0 ? num + den / 2 : num - den / 2) / den;
+}
@@ -0,0 +1,127 @@
+#ifndef __AD7708_STATS_H__
+#define __AD7708_STATS_H__
+
+#include "ad7708_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Running per-channel statistics.
+ *
+ * ad7708_stats_attach() hooks the aggregator into the device, every result
+ * read by ad7708_readData, ad7708_readStatusData, the stream and the scan
+ * then updates count, min/max, a Welford mean and sum of squared deviations,
+ * and a histogram, all O(1) in the acquisition context. No sample buffer is
+ * kept. Each channel is one contiguous block guarded by its own sequence
+ * counter: the writer makes it odd for the duration of an update, a reader on
+ * another task or core copies the block and retries when the counter moved.
+ * The writer never waits. Results are keyed by channel code, the mux address
+ * of an external mux scan is not told apart.
+ */
+
+#ifndef AD7708_STATS_BIN_SHIFT
+#define AD7708_STATS_BIN_SHIFT 10 // Code bits per histogram bin, 10: 64 bins
+#endif
+#define AD7708_STATS_BINS (65536UL >> AD7708_STATS_BIN_SHIFT)
+#define AD7708_STATS_MEAN_FRAC 16 // Fraction bits of the running mean
+#define AD7708_STATS_M2_FRAC 8    // Fraction bits of the sum of squared deviations
+#define AD7708_STATS_RETRIES 16   // Snapshot attempts before giving up
+
+/*! @name Statistics of one channel, copied whole by a snapshot */
+typedef struct
+{
+    volatile uint32_t seq; // Odd while the writer is updating the block
+    uint32_t count;
+    uint32_t clamped;      // Results flagged AD7708_SAMPLE_CLAMPED
+    uint16_t min;
+    uint16_t max;
+    uint8_t flags;         // Range and polarity the block was collected with
+    uint32_t mean;         // Mean code, AD7708_STATS_MEAN_FRAC fraction bits
+    uint64_t m2;           // Sum of squared deviations from the mean, AD7708_STATS_M2_FRAC fraction bits
+    uint32_t hist[AD7708_STATS_BINS];
+} ad7708_stats_channel;
+
+/*! @name Aggregator state */
+typedef struct
+{
+    ad7708_stats_channel ch[16];
+    uint16_t enabled;             // Bit per channel code
+    volatile uint16_t resetPending; // Bit per channel code, applied by the writer on its next result
+} ad7708_stats;
+
+/*! @name Derived figures, codes times 100 */
+typedef struct
+{
+    uint32_t count;
+    uint32_t clamped;
+    uint16_t min;
+    uint16_t max;
+    uint32_t meanX100;
+    uint32_t stdX100; // Sample standard deviation
+    uint32_t rmsX100; // Root mean square about zero scale, 0 or 32768 by polarity
+} ad7708_stats_summary;
+
+#if AD7708_STATS
+#define AD7708_STATS_FEED(dev, sample) \
+    do { if ((dev)->onSample != NULL) { (dev)->onSample((dev)->onSampleArg, (sample)); } } while (0)
+#else
+#define AD7708_STATS_FEED(dev, sample) ((void)0)
+#endif
+
+/*!
+ * @brief Clear every channel
+ * @param[in] stats - Pointer to the aggregator
+ * @param[in] channels - Bit per channel code to collect
+ * @return void
+ */
+void ad7708_stats_init(ad7708_stats* stats, uint16_t channels);
+
+/*!
+ * @brief Feed every result the device reads into the aggregator
+ * @param[in] stats - Pointer to the aggregator, NULL detaches
+ * @param[in] dev - Pointer to the device structure
+ * @return 0: case of success, AD7708_ERROR when built with AD7708_STATS 0
+ */
+StatusTypeDef ad7708_stats_attach(ad7708_stats* stats, ad7708_dev* dev);
+
+/*!
+ * @brief Add one result, writer side
+ * @param[in] stats - Pointer to the aggregator
+ * @param[in] sample - Result
+ * @return void
+ * @note A change of range or polarity restarts the channel
+ */
+void ad7708_stats_update(ad7708_stats* stats, const ad7708_sample* sample);
+
+/*!
+ * @brief Ask the writer to restart a channel, safe from the reader side
+ * @param[in] stats - Pointer to the aggregator
+ * @param[in] channel - Channel code
+ * @return void
+ */
+void ad7708_stats_reset(ad7708_stats* stats, uint8_t channel);
+
+/*!
+ * @brief Consistent copy of a channel, reader side
+ * @param[in] stats - Pointer to the aggregator
+ * @param[in] channel - Channel code
+ * @param[out] out - Copy of the channel block
+ * @return 0: case of success, AD7708_BUSY: the writer kept updating, AD7708_ERROR: bad channel
+ */
+StatusTypeDef ad7708_stats_snapshot(const ad7708_stats* stats, uint8_t channel, ad7708_stats_channel* out);
+
+/*!
+ * @brief Mean, deviation and RMS of a snapshot
+ * @param[in] snap - Channel block from ad7708_stats_snapshot
+ * @param[out] summary - Derived figures
+ * @return void
+ */
+void ad7708_stats_summarize(const ad7708_stats_channel* snap, ad7708_stats_summary* summary);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
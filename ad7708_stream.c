@@ -0,0 +1,103 @@
+#include "ad7708_stream.h"
+#include "ad7708.h"
+#include "ad7708_instr.h"
+#include "ad7708_stats.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Put the device in continuous conversion and start streaming into ring
+ */
+StatusTypeDef ad7708_stream_start(ad7708_stream* stream, ad7708_dev* dev, ad7708_ring* ring)
+{
+    StatusTypeDef status;
+
+    memset(stream, 0, sizeof(*stream));
+    stream->dev = dev;
+    stream->ring = ring;
+
+    // Read data register: WEN=0, RW=1, the two trailing bytes only clock DOUT
+    stream->tx[0] = (uint8_t)(0x40U | DATA_REG);
+    stream->tx[1] = 0x00U;
+    stream->tx[2] = 0x00U;
+
+    // A part that did not start converting must not be read from RDY
+    status = ad7708_startContinuousConversion(dev);
+    if (status == AD7708_OK) { stream->running = 1; }
+
+    return status;
+}
+
+/*!
+ * @brief Stop reacting to RDY, the device is left converting
+ */
+void ad7708_stream_stop(ad7708_stream* stream)
+{
+    stream->running = 0;
+}
+
+/*!
+ * @brief RDY falling edge handler, call from the EXTI interrupt
+ */
+void ad7708_stream_onRdy(ad7708_stream* stream)
+{
+    ad7708_dev* dev = stream->dev;
+
+    if (!stream->running) { return; }
+    if (stream->dmaBusy)
+    {
+        stream->busyOverruns++;
+        return;
+    }
+
+    stream->dmaBusy = 1;
+    stream->control = dev->controlReg.byte;
+    if (stream->ring->stamps != NULL) { stream->rdyUs = ad7708_nowUs(dev); }
+    AD7708_INSTR_ADD(dev, csToggles, 1);
+    AD7708_INSTR_ADD(dev, spiBytes, AD7708_STREAM_XFER_LEN);
+    dev->transport->setCS(dev->intf, &dev->cs, 0);
+
+    if (dev->transport->transferDMA == NULL)
+    {
+        // No DMA on this port, clock the frame out inline
+        if (dev->transport->transfer(dev->intf, stream->tx, stream->rx, AD7708_STREAM_XFER_LEN) != AD7708_OK)
+        {
+            // rx holds no valid code, drop the conversion rather than push a stale one
+            dev->transport->setCS(dev->intf, &dev->cs, 1);
+            stream->errors++;
+            stream->dmaBusy = 0;
+            return;
+        }
+        ad7708_stream_dmaComplete(stream);
+    }
+    else if (dev->transport->transferDMA(dev->intf, stream->tx, stream->rx, AD7708_STREAM_XFER_LEN) != AD7708_OK)
+    {
+        dev->transport->setCS(dev->intf, &dev->cs, 1);
+        stream->errors++;
+        stream->dmaBusy = 0;
+    }
+}
+
+/*!
+ * @brief DMA transfer complete handler, call from the SPI DMA interrupt
+ */
+void ad7708_stream_dmaComplete(ad7708_stream* stream)
+{
+    ad7708_dev* dev = stream->dev;
+    ad7708_sample sample;
+
+    dev->transport->setCS(dev->intf, &dev->cs, 1);
+
+    sample.code = (uint16_t)((stream->rx[1] << 8) | stream->rx[2]);
+    sample.channel = stream->control >> 4;
+    sample.flags = stream->control & 0x0FU;
+    stream->dmaBusy = 0;
+    AD7708_INSTR_CODE(dev, sample.code);
+    AD7708_STATS_FEED(dev, &sample);
+
+    if (ad7708_ring_pushStamped(stream->ring, &sample, stream->rdyUs) == AD7708_OK) { stream->samples++; }
+    else { stream->fullOverruns++; }
+}
@@ -0,0 +1,74 @@
+#ifndef __AD7708_STREAM_H__
+#define __AD7708_STREAM_H__
+
+#include "ad7708_defs.h"
+#include "ad7708_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Interrupt driven acquisition.
+ *
+ * Port glue on STM32:
+ *   HAL_GPIO_EXTI_Callback(RDY_Pin)  -> ad7708_stream_onRdy(&stream)
+ *   HAL_SPI_TxRxCpltCallback(hspi)   -> ad7708_stream_dmaComplete(&stream)
+ * On the host the simulator's onRdy hook plays the EXTI line and its DMA
+ * completes immediately.
+ */
+
+#define AD7708_STREAM_XFER_LEN 3 // Comm byte + 16 bit data register
+
+/*! @name Streaming acquisition state */
+typedef struct
+{
+    ad7708_dev* dev;
+    ad7708_ring* ring;
+    volatile uint8_t running;
+    volatile uint8_t dmaBusy;
+    uint8_t control;                         // Control register latched when the DMA is started, tags the sample
+    uint32_t rdyUs;                          // RDY time, stamps the sample when the ring keeps stamps
+    uint8_t tx[AD7708_STREAM_XFER_LEN];
+    uint8_t rx[AD7708_STREAM_XFER_LEN];
+    volatile uint32_t samples;               // Samples pushed to the ring
+    volatile uint32_t busyOverruns;          // RDY edges lost because the previous DMA was still running
+    volatile uint32_t fullOverruns;          // Samples dropped because the consumer fell behind
+    volatile uint32_t errors;                // Failed DMA starts
+} ad7708_stream;
+
+/*!
+ * @brief Put the device in continuous conversion and start streaming into ring
+ * @param[in] stream - Pointer to the stream state
+ * @param[in] dev - Pointer to the device structure, channel already configured
+ * @param[in] ring - Initialized sample ring, the application is its consumer
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_stream_start(ad7708_stream* stream, ad7708_dev* dev, ad7708_ring* ring);
+
+/*!
+ * @brief Stop reacting to RDY, the device is left converting
+ * @param[in] stream - Pointer to the stream state
+ * @return void
+ */
+void ad7708_stream_stop(ad7708_stream* stream);
+
+/*!
+ * @brief RDY falling edge handler, call from the EXTI interrupt
+ * @param[in] stream - Pointer to the stream state
+ * @return void
+ */
+void ad7708_stream_onRdy(ad7708_stream* stream);
+
+/*!
+ * @brief DMA transfer complete handler, call from the SPI DMA interrupt
+ * @param[in] stream - Pointer to the stream state
+ * @return void
+ */
+void ad7708_stream_dmaComplete(ad7708_stream* stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
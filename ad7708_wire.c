@@ -0,0 +1,429 @@
+#ifndef AD7708_WIRE_NO_HOST
+#define _POSIX_C_SOURCE 200809L // write
+#endif
+
+#include "ad7708_wire.h"
+#include "ad7708_crc.h"
+
+#include <string.h>
+
+#ifndef AD7708_WIRE_NO_HOST
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#endif
+
+#define SAMPLES_HDR 8  // type, seq, first, count
+#define CONFIG_LEN 12  // type, seq, version, four registers, deviceTag
+
+/********************** Static function declarations ************************/
+
+/*!
+ * @brief Append the CRC, COBS encode the raw frame and hand it to the sink
+ * @param[in] enc - Pointer to the encoder
+ * @param[in] len - Raw frame length without CRC, type and payload already in place
+ * @return 0: case of success, error code otherwise.
+ */
+static StatusTypeDef emitFrame(ad7708_wire_encoder* enc, uint16_t len);
+
+/*!
+ * @brief Build and send a CONFIG frame
+ * @param[in] enc - Pointer to the encoder
+ * @return 0: case of success, error code otherwise.
+ */
+static StatusTypeDef sendConfig(ad7708_wire_encoder* enc);
+
+/*!
+ * @brief Capture the register shadow of a device
+ * @param[in] enc - Pointer to the encoder
+ * @param[in] dev - Pointer to the device structure
+ * @return void
+ */
+static void captureConfig(ad7708_wire_encoder* enc, const ad7708_dev* dev);
+
+/*!
+ * @brief COBS encode, without the delimiter
+ * @param[in] in - Raw bytes
+ * @param[in] len - Number of raw bytes
+ * @param[out] out - At least len + len / 254 + 1 bytes
+ * @return Encoded length
+ */
+static uint16_t cobsEncode(const uint8_t* in, uint16_t len, uint8_t* out);
+
+/*!
+ * @brief COBS decode a frame without its delimiter
+ * @param[in] in - Encoded bytes
+ * @param[in] len - Number of encoded bytes
+ * @param[out] out - At least len bytes
+ * @return Raw length, -1 if the encoding is invalid
+ */
+static int32_t cobsDecode(const uint8_t* in, uint16_t len, uint8_t* out);
+
+/*!
+ * @brief Check and dispatch a complete frame
+ * @param[in] dec - Pointer to the decoder
+ * @return Number of samples delivered
+ */
+static uint32_t decodeFrame(ad7708_wire_decoder* dec);
+
+/****************** User Function Definitions *******************************/
+
+/*!
+ * @brief Open a stream and send its first CONFIG frame
+ */
+StatusTypeDef ad7708_wire_open(ad7708_wire_encoder* enc, const ad7708_wire_sink* sink, const ad7708_dev* dev, uint32_t deviceTag)
+{
+    static const uint8_t delimiter = 0x00U;
+
+    if (sink->write == NULL) { return AD7708_ERROR; }
+
+    memset(enc, 0, sizeof(*enc));
+    enc->sink = *sink;
+    enc->config.version = AD7708_WIRE_VERSION;
+    enc->config.deviceTag = deviceTag;
+    captureConfig(enc, dev);
+
+    // A receiver listening before the stream opened discards what it got so far
+    if (enc->sink.write(enc->sink.ctx, &delimiter, 1) != AD7708_OK)
+    {
+        enc->errors++;
+        return AD7708_ERROR;
+    }
+    enc->bytes++;
+
+    return sendConfig(enc);
+}
+
+/*!
+ * @brief Send a configuration change, flushing waiting samples first
+ */
+StatusTypeDef ad7708_wire_config_update(ad7708_wire_encoder* enc, const ad7708_dev* dev)
+{
+    StatusTypeDef status = ad7708_wire_flush(enc);
+
+    captureConfig(enc, dev);
+
+    return sendConfig(enc) == AD7708_OK ? status : AD7708_ERROR;
+}
+
+/*!
+ * @brief Append one sample, a full frame is sent at once
+ */
+StatusTypeDef ad7708_wire_append(ad7708_wire_encoder* enc, const ad7708_sample* sample)
+{
+    uint8_t* p = &enc->raw[SAMPLES_HDR + 4U * enc->count];
+
+    if (enc->count == 0) { enc->first = enc->samples; }
+
+    p[0] = sample->flags;
+    p[1] = sample->channel;
+    p[2] = (uint8_t)sample->code;
+    p[3] = (uint8_t)(sample->code >> 8);
+    enc->count++;
+    enc->samples++;
+
+    return enc->count == AD7708_WIRE_MAX_SAMPLES ? ad7708_wire_flush(enc) : AD7708_OK;
+}
+
+/*!
+ * @brief Append a block of samples
+ */
+StatusTypeDef ad7708_wire_appendBlock(ad7708_wire_encoder* enc, const ad7708_sample* samples, uint32_t n)
+{
+    StatusTypeDef status = AD7708_OK;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (ad7708_wire_append(enc, &samples[i]) != AD7708_OK) { status = AD7708_ERROR; }
+    }
+
+    return status;
+}
+
+/*!
+ * @brief Send the waiting samples as a short frame
+ */
+StatusTypeDef ad7708_wire_flush(ad7708_wire_encoder* enc)
+{
+    StatusTypeDef status = AD7708_OK;
+    uint8_t count = enc->count;
+
+    if (count == 0) { return AD7708_OK; }
+
+    // Repeat the configuration ahead of the samples it describes
+    if (enc->sinceConfig >= AD7708_WIRE_CONFIG_EVERY) { status = sendConfig(enc); }
+
+    enc->raw[0] = AD7708_WIRE_SAMPLES;
+    enc->raw[3] = (uint8_t)enc->first;
+    enc->raw[4] = (uint8_t)(enc->first >> 8);
+    enc->raw[5] = (uint8_t)(enc->first >> 16);
+    enc->raw[6] = (uint8_t)(enc->first >> 24);
+    enc->raw[7] = count;
+    enc->count = 0;
+
+    if (emitFrame(enc, (uint16_t)(SAMPLES_HDR + 4U * count)) != AD7708_OK) { status = AD7708_ERROR; }
+
+    return status;
+}
+
+/*!
+ * @brief Per-result hook forwarding every result to an encoder
+ */
+void ad7708_wire_onSample(void* arg, const ad7708_sample* sample)
+{
+    (void)ad7708_wire_append((ad7708_wire_encoder*)arg, sample);
+}
+
+/*!
+ * @brief Reset a decoder
+ */
+void ad7708_wire_decoder_init(ad7708_wire_decoder* dec, ad7708_wire_samples_fptr_t onSamples, void* arg)
+{
+    memset(dec, 0, sizeof(*dec));
+    dec->onSamples = onSamples;
+    dec->arg = arg;
+}
+
+/*!
+ * @brief Decode a chunk of the byte stream, any split is allowed
+ */
+uint32_t ad7708_wire_decode(ad7708_wire_decoder* dec, const uint8_t* data, uint32_t len)
+{
+    uint32_t delivered = 0;
+
+    dec->bytes += len;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        if (data[i] == 0x00U)
+        {
+            if (dec->synced && (dec->len != 0 || dec->overflow)) { delivered += decodeFrame(dec); }
+            dec->synced = 1;
+            dec->len = 0;
+            dec->overflow = 0;
+        }
+        else if (dec->synced)
+        {
+            if (dec->len < sizeof(dec->buf)) { dec->buf[dec->len++] = data[i]; }
+            else { dec->overflow = 1; }
+        }
+    }
+
+    return delivered;
+}
+
+/****************** Static Function Definitions *******************************/
+
+static StatusTypeDef emitFrame(ad7708_wire_encoder* enc, uint16_t len)
+{
+    uint16_t crc;
+    uint16_t n;
+
+    enc->raw[1] = (uint8_t)enc->seq;
+    enc->raw[2] = (uint8_t)(enc->seq >> 8);
+    crc = ad7708_crc16(AD7708_CRC16_INIT, enc->raw, len);
+    enc->raw[len] = (uint8_t)crc;
+    enc->raw[len + 1U] = (uint8_t)(crc >> 8);
+
+    n = cobsEncode(enc->raw, (uint16_t)(len + 2U), enc->frame);
+    enc->frame[n++] = 0x00U;
+
+    enc->seq++;
+    enc->frames++;
+    if (enc->sinceConfig < 0xFFU) { enc->sinceConfig++; }
+
+    if (enc->sink.write(enc->sink.ctx, enc->frame, n) != AD7708_OK)
+    {
+        enc->errors++;
+        return AD7708_ERROR;
+    }
+    enc->bytes += n;
+
+    return AD7708_OK;
+}
+
+static StatusTypeDef sendConfig(ad7708_wire_encoder* enc)
+{
+    // Samples waiting in raw are kept, the config frame does not reach past the header
+    uint8_t saved[CONFIG_LEN + 2];
+    StatusTypeDef status;
+
+    memcpy(saved, enc->raw, sizeof(saved));
+
+    enc->raw[0] = AD7708_WIRE_CONFIG;
+    enc->raw[3] = enc->config.version;
+    enc->raw[4] = enc->config.mode;
+    enc->raw[5] = enc->config.control;
+    enc->raw[6] = enc->config.filter;
+    enc->raw[7] = enc->config.ioControl;
+    enc->raw[8] = (uint8_t)enc->config.deviceTag;
+    enc->raw[9] = (uint8_t)(enc->config.deviceTag >> 8);
+    enc->raw[10] = (uint8_t)(enc->config.deviceTag >> 16);
+    enc->raw[11] = (uint8_t)(enc->config.deviceTag >> 24);
+
+    status = emitFrame(enc, CONFIG_LEN);
+    enc->sinceConfig = 0;
+
+    memcpy(enc->raw, saved, sizeof(saved));
+
+    return status;
+}
+
+static void captureConfig(ad7708_wire_encoder* enc, const ad7708_dev* dev)
+{
+    enc->config.mode = dev->modeReg.byte;
+    enc->config.control = dev->controlReg.byte;
+    enc->config.filter = dev->filterReg.byte;
+    enc->config.ioControl = dev->ioControlReg.byte;
+}
+
+static uint16_t cobsEncode(const uint8_t* in, uint16_t len, uint8_t* out)
+{
+    uint16_t codeAt = 0;
+    uint16_t o = 1;
+    uint8_t code = 1;
+
+    for (uint16_t i = 0; i < len; i++)
+    {
+        if (in[i] != 0x00U)
+        {
+            out[o++] = in[i];
+            code++;
+        }
+        if (in[i] == 0x00U || code == 0xFFU)
+        {
+            out[codeAt] = code;
+            codeAt = o++;
+            code = 1;
+        }
+    }
+    out[codeAt] = code;
+
+    return o;
+}
+
+static int32_t cobsDecode(const uint8_t* in, uint16_t len, uint8_t* out)
+{
+    uint16_t i = 0;
+    int32_t o = 0;
+
+    while (i < len)
+    {
+        uint8_t code = in[i++];
+
+        if (code == 0x00U || i + code - 1U > len) { return -1; }
+        for (uint8_t k = 1; k < code; k++) { out[o++] = in[i++]; }
+        if (code != 0xFFU && i < len) { out[o++] = 0x00U; }
+    }
+
+    return o;
+}
+
+static uint32_t decodeFrame(ad7708_wire_decoder* dec)
+{
+    int32_t len;
+    uint16_t seq;
+    uint32_t first;
+    uint8_t count;
+
+    if (dec->overflow || (len = cobsDecode(dec->buf, dec->len, dec->raw)) < 5)
+    {
+        dec->framingErrors++;
+        return 0;
+    }
+    if (ad7708_crc16(AD7708_CRC16_INIT, dec->raw, (uint32_t)len - 2U) != (uint16_t)(dec->raw[len - 2] | dec->raw[len - 1] << 8))
+    {
+        dec->crcErrors++;
+        return 0;
+    }
+
+    seq = (uint16_t)(dec->raw[1] | dec->raw[2] << 8);
+    if (dec->haveSeq) { dec->lostFrames += (uint16_t)(seq - dec->seq - 1U); }
+    dec->seq = seq;
+    dec->haveSeq = 1;
+
+    if (dec->raw[0] == AD7708_WIRE_CONFIG && len == CONFIG_LEN + 2)
+    {
+        // Samples of another version have another layout, their frames fail the length check below
+        if (dec->raw[3] != AD7708_WIRE_VERSION)
+        {
+            dec->framingErrors++;
+            return 0;
+        }
+        dec->config.version = dec->raw[3];
+        dec->config.mode = dec->raw[4];
+        dec->config.control = dec->raw[5];
+        dec->config.filter = dec->raw[6];
+        dec->config.ioControl = dec->raw[7];
+        dec->config.deviceTag = (uint32_t)dec->raw[8] | (uint32_t)dec->raw[9] << 8 | (uint32_t)dec->raw[10] << 16 | (uint32_t)dec->raw[11] << 24;
+        dec->haveConfig = 1;
+        dec->frames++;
+        return 0;
+    }
+
+    count = dec->raw[7];
+    if (dec->raw[0] != AD7708_WIRE_SAMPLES || len < SAMPLES_HDR + 2 || count > AD7708_WIRE_MAX_SAMPLES || len != SAMPLES_HDR + 4 * count + 2)
+    {
+        dec->framingErrors++;
+        return 0;
+    }
+
+    first = (uint32_t)dec->raw[3] | (uint32_t)dec->raw[4] << 8 | (uint32_t)dec->raw[5] << 16 | (uint32_t)dec->raw[6] << 24;
+    if (dec->haveNext && (int32_t)(first - dec->next) > 0) { dec->lostSamples += first - dec->next; }
+    dec->next = first + count;
+    dec->haveNext = 1;
+
+    for (uint8_t k = 0; k < count; k++)
+    {
+        const uint8_t* p = &dec->raw[SAMPLES_HDR + 4U * k];
+        dec->samples[k].flags = p[0];
+        dec->samples[k].channel = p[1];
+        dec->samples[k].code = (uint16_t)(p[2] | p[3] << 8);
+    }
+
+    dec->frames++;
+    dec->samplesOk += count;
+    if (dec->onSamples != NULL) { dec->onSamples(dec->arg, dec->haveConfig ? &dec->config : NULL, first, dec->samples, count); }
+
+    return count;
+}
+
+#ifndef AD7708_WIRE_NO_HOST
+
+/********************** Host side ************************/
+
+/*!
+ * @brief Write a whole frame to the descriptor
+ * @param[in] ctx - File descriptor
+ * @param[in] data - Frame bytes
+ * @param[in] len - Frame length
+ * @return 0: case of success, error code otherwise.
+ */
+static StatusTypeDef fdWrite(void* ctx, const uint8_t* data, uint32_t len);
+
+/*!
+ * @brief Sink writing frames to a file descriptor: pipe, pseudo-terminal, serial port
+ */
+void ad7708_wire_fdSink(ad7708_wire_sink* sink, int fd)
+{
+    sink->write = fdWrite;
+    sink->ctx = (void*)(intptr_t)fd;
+}
+
+static StatusTypeDef fdWrite(void* ctx, const uint8_t* data, uint32_t len)
+{
+    int fd = (int)(intptr_t)ctx;
+
+    while (len != 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) { continue; }
+        if (n <= 0) { return AD7708_ERROR; }
+        data += n;
+        len -= (uint32_t)n;
+    }
+
+    return AD7708_OK;
+}
+
+#endif
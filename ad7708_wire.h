@@ -0,0 +1,194 @@
+#ifndef __AD7708_WIRE_H__
+#define __AD7708_WIRE_H__
+
+#include "ad7708_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Framed binary stream of samples for a UART/USB link.
+ *
+ * Every frame is COBS encoded and ends with a 0x00 delimiter, so a receiver
+ * that lost bytes drops at most the frame they fell in and is back in step at
+ * the next delimiter. Before encoding a frame is, little endian:
+ *   uint8_t  type       AD7708_WIRE_CONFIG / AD7708_WIRE_SAMPLES
+ *   uint16_t seq        Frame number
+ *   CONFIG  - uint8_t version, mode, control, filter, ioControl, uint32_t deviceTag
+ *   SAMPLES - uint32_t first    Number of the first sample since the stream opened
+ *             uint8_t  count
+ *             count * { uint16_t tag (channel << 8 | flags), uint16_t code }
+ *   uint16_t crc        CRC-16 of everything before it
+ * A CONFIG frame opens the stream, follows every configuration change and is
+ * repeated every AD7708_WIRE_CONFIG_EVERY frames so a late receiver learns
+ * the scales. The tag keeps the mux address in the channel and the clamp
+ * flag. A full SAMPLES frame costs 4.2 bytes per sample on the wire.
+ *
+ * The encoder runs on the device with no allocation and hands whole encoded
+ * frames to a sink. ad7708_wire_onSample has the signature of the device's
+ * per-result hook. The host decoder accepts arbitrary chunks of the byte
+ * stream and counts CRC and framing errors, lost frames and lost samples.
+ * Define AD7708_WIRE_NO_HOST on targets without POSIX file descriptors.
+ */
+
+#define AD7708_WIRE_VERSION 2 // 1: one byte tags without mux address and clamp
+#define AD7708_WIRE_CONFIG 0x01U
+#define AD7708_WIRE_SAMPLES 0x02U
+#define AD7708_WIRE_MAX_SAMPLES 64
+#define AD7708_WIRE_CONFIG_EVERY 32
+#define AD7708_WIRE_MAX_RAW (3 + 5 + 4 * AD7708_WIRE_MAX_SAMPLES + 2) // Longest frame before encoding
+#define AD7708_WIRE_MAX_FRAME (AD7708_WIRE_MAX_RAW + AD7708_WIRE_MAX_RAW / 254 + 2) // Encoded, with delimiter
+
+typedef StatusTypeDef (*ad7708_wire_fptr_t)(void* ctx, const uint8_t* data, uint32_t len);
+
+/*! @name Where encoded frames go: UART DMA, USB endpoint, file descriptor... */
+typedef struct
+{
+    ad7708_wire_fptr_t write;
+    void* ctx;
+} ad7708_wire_sink;
+
+/*! @name Register configuration carried by CONFIG frames */
+typedef struct
+{
+    uint8_t version;
+    uint8_t mode;        // MODE_REG
+    uint8_t control;     // CONTROL_REG
+    uint8_t filter;      // FILTER_REG
+    uint8_t ioControl;   // IO_CONTROL_REG
+    uint32_t deviceTag;  // Caller defined, e.g. bus slot or serial number
+} ad7708_wire_config;
+
+/*! @name Encoder state */
+typedef struct
+{
+    ad7708_wire_sink sink;
+    ad7708_wire_config config;
+    uint16_t seq;
+    uint8_t count;           // Samples waiting in raw
+    uint8_t sinceConfig;     // Frames since the last CONFIG frame
+    uint32_t first;          // Number of the first waiting sample
+    uint8_t raw[AD7708_WIRE_MAX_RAW];
+    uint8_t frame[AD7708_WIRE_MAX_FRAME];
+    uint32_t samples;
+    uint32_t frames;
+    uint32_t bytes;          // Encoded bytes handed to the sink
+    uint32_t errors;         // Frames the sink refused
+} ad7708_wire_encoder;
+
+/*!
+ * @brief Open a stream and send its first CONFIG frame
+ * @param[in] enc - Pointer to the encoder
+ * @param[in] sink - Frame sink, copied
+ * @param[in] dev - Device whose register shadow is sent
+ * @param[in] deviceTag - Caller defined tag carried in CONFIG frames
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_wire_open(ad7708_wire_encoder* enc, const ad7708_wire_sink* sink, const ad7708_dev* dev, uint32_t deviceTag);
+
+/*!
+ * @brief Send a configuration change, flushing waiting samples first
+ * @param[in] enc - Pointer to the encoder
+ * @param[in] dev - Device whose register shadow is sent
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_wire_config_update(ad7708_wire_encoder* enc, const ad7708_dev* dev);
+
+/*!
+ * @brief Append one sample, a full frame is sent at once
+ * @param[in] enc - Pointer to the encoder
+ * @param[in] sample - Tagged sample
+ * @return 0: case of success, error code if a frame could not be sent
+ */
+StatusTypeDef ad7708_wire_append(ad7708_wire_encoder* enc, const ad7708_sample* sample);
+
+/*!
+ * @brief Append a block of samples
+ * @param[in] enc - Pointer to the encoder
+ * @param[in] samples - Tagged samples
+ * @param[in] n - Number of samples
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_wire_appendBlock(ad7708_wire_encoder* enc, const ad7708_sample* samples, uint32_t n);
+
+/*!
+ * @brief Send the waiting samples as a short frame
+ * @param[in] enc - Pointer to the encoder
+ * @return 0: case of success, error code otherwise.
+ */
+StatusTypeDef ad7708_wire_flush(ad7708_wire_encoder* enc);
+
+/*!
+ * @brief Per-result hook forwarding every result to an encoder
+ * @param[in] arg - Pointer to the encoder
+ * @param[in] sample - Result
+ * @return void
+ * @note Install as dev->onSample with dev->onSampleArg = encoder, the sink then runs in the acquisition context
+ */
+void ad7708_wire_onSample(void* arg, const ad7708_sample* sample);
+
+/*! @brief Decoded samples of one frame, first is the number of samples[0] in the stream */
+typedef void (*ad7708_wire_samples_fptr_t)(void* arg, const ad7708_wire_config* config, uint32_t first, const ad7708_sample* samples, uint8_t count);
+
+/*! @name Decoder state */
+typedef struct
+{
+    ad7708_wire_samples_fptr_t onSamples;
+    void* arg;
+    ad7708_wire_config config;
+    uint8_t haveConfig;
+    uint8_t synced;          // A delimiter was seen, bytes before the first one are not a frame
+    uint8_t haveSeq;
+    uint8_t haveNext;
+    uint16_t seq;            // Sequence number of the last good frame
+    uint32_t next;           // Expected number of the next sample
+    uint16_t len;            // Encoded bytes collected for the current frame
+    uint8_t overflow;        // Current frame is longer than any valid one
+    uint8_t buf[AD7708_WIRE_MAX_FRAME];
+    uint8_t raw[AD7708_WIRE_MAX_FRAME];
+    ad7708_sample samples[AD7708_WIRE_MAX_SAMPLES];
+    uint32_t frames;         // Good frames
+    uint32_t samplesOk;      // Samples delivered
+    uint32_t crcErrors;
+    uint32_t framingErrors;  // Bad COBS, overlong or malformed frames, CONFIG frames of another version
+    uint32_t lostFrames;     // Sequence gaps
+    uint32_t lostSamples;    // Sample number gaps
+    uint32_t bytes;
+} ad7708_wire_decoder;
+
+/*!
+ * @brief Reset a decoder
+ * @param[in] dec - Pointer to the decoder
+ * @param[in] onSamples - Called for every good SAMPLES frame
+ * @param[in] arg - Argument passed to onSamples
+ * @return void
+ */
+void ad7708_wire_decoder_init(ad7708_wire_decoder* dec, ad7708_wire_samples_fptr_t onSamples, void* arg);
+
+/*!
+ * @brief Decode a chunk of the byte stream, any split is allowed
+ * @param[in] dec - Pointer to the decoder
+ * @param[in] data - Received bytes
+ * @param[in] len - Number of bytes
+ * @return Number of samples delivered
+ */
+uint32_t ad7708_wire_decode(ad7708_wire_decoder* dec, const uint8_t* data, uint32_t len);
+
+#ifndef AD7708_WIRE_NO_HOST
+
+/*!
+ * @brief Sink writing frames to a file descriptor: pipe, pseudo-terminal, serial port
+ * @param[out] sink - Sink to fill
+ * @param[in] fd - Open descriptor, stored in the sink context pointer
+ * @return void
+ */
+void ad7708_wire_fdSink(ad7708_wire_sink* sink, int fd);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
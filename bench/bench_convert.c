@@ -0,0 +1,74 @@
+/*
+ * Micro-benchmark of the ad7708_convert kernels.
+ *
+ * Converts a block of randomly tagged samples with every kernel the CPU
+ * supports, checks the output is bit-identical to the scalar kernel and
+ * prints samples/s for volts and Q8.24 output.
+ */
+#define _POSIX_C_SOURCE 199309L
+
+#include "ad7708_convert.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BLOCK 4096
+#define ROUNDS 20000
+
+static double nowSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+    static ad7708_sample in[BLOCK];
+    static float refVolts[BLOCK], volts[BLOCK];
+    static int32_t refQ[BLOCK], q[BLOCK];
+    static const char* names[] = { "auto", "scalar", "sse4.1", "avx2" };
+    uint32_t seed = 1;
+    int failed = 0;
+
+    for (uint32_t i = 0; i < BLOCK; i++)
+    {
+        seed = seed * 1664525U + 1013904223U;
+        in[i].code = (uint16_t)(seed >> 16);
+        in[i].channel = (uint8_t)(seed % 10U);
+        in[i].flags = (uint8_t)((seed >> 8) & 0x0FU);
+    }
+
+    ad7708_convert_setKernel(AD7708_KERNEL_SCALAR);
+    ad7708_convertVolts(in, refVolts, BLOCK);
+    ad7708_convertQ24(in, refQ, BLOCK);
+
+    for (int k = AD7708_KERNEL_SCALAR; k <= AD7708_KERNEL_AVX2; k++)
+    {
+        double t0, tVolts, tQ;
+
+        if (ad7708_convert_setKernel((AD7708_Kernel)k) != AD7708_OK)
+        {
+            printf("%-7s unsupported\n", names[k]);
+            continue;
+        }
+
+        t0 = nowSec();
+        for (int r = 0; r < ROUNDS; r++) { ad7708_convertVolts(in, volts, BLOCK); }
+        tVolts = nowSec() - t0;
+
+        t0 = nowSec();
+        for (int r = 0; r < ROUNDS; r++) { ad7708_convertQ24(in, q, BLOCK); }
+        tQ = nowSec() - t0;
+
+        int same = memcmp(volts, refVolts, sizeof(volts)) == 0 && memcmp(q, refQ, sizeof(q)) == 0;
+        failed |= !same;
+
+        printf("%-7s volts %8.1f Msamples/s  q24 %8.1f Msamples/s  %s\n", names[k], (double)BLOCK * ROUNDS / tVolts / 1e6,
+            (double)BLOCK * ROUNDS / tQ / 1e6, same ? "bit-identical" : "MISMATCH");
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,424 @@
+/*
+ * Driver benchmark against the simulator.
+ *
+ * Runs every public entry point of the core driver plus streaming,
+ * scanning and polled acquisition on a simulated device and reports, per operation:
+ *   ns/op     wall clock on this host, informative only
+ *   bytes/op  SPI bytes clocked
+ *   cs/op     CS-asserted transactions
+ *   sim us/op virtual bus time, i.e. device side latency
+ * The last three are deterministic. With --baseline FILE the run fails if
+ * any of them grows past the recorded value; --update FILE rewrites it.
+ * The driver's own instr.spiBytes and instr.csToggles must match the bytes
+ * and CS assertions the simulator saw, or the run fails.
+ */
+#define _POSIX_C_SOURCE 199309L
+
+#include "ad7708.h"
+#include "ad7708_poll.h"
+#include "ad7708_ring.h"
+#include "ad7708_scan.h"
+#include "ad7708_sim.h"
+#include "ad7708_stream.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_CASES 32
+#define SIM_TOLERANCE 1.001 // Virtual time ratio allowed before a regression is reported
+
+typedef struct
+{
+    ad7708_sim sim;
+    ad7708_dev dev;
+    ad7708_ring ring;
+    ad7708_sample storage[1024];
+    ad7708_stream stream;
+    ad7708_scan scan;
+    ad7708_poll poll;
+} bench_ctx;
+
+typedef struct
+{
+    const char* name;
+    uint32_t iterations;
+    void (*setup)(bench_ctx* ctx);
+    uint32_t (*run)(bench_ctx* ctx, uint32_t iterations); // Returns the number of operations done
+} bench_case;
+
+typedef struct
+{
+    char name[32];
+    double bytes;
+    double cs;
+    double simUs;
+} bench_result;
+
+static double nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/****************** Setups *******************************/
+
+static void setupBare(bench_ctx* ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ad7708_sim_init(&ctx->sim);
+    ad7708_sim_attach(&ctx->sim, &ctx->dev);
+}
+
+static void setupInit(bench_ctx* ctx)
+{
+    setupBare(ctx);
+    ad7708_init(&ctx->dev);
+}
+
+static void setupFast(bench_ctx* ctx)
+{
+    setupInit(ctx);
+    ad7708_sfRateConfig(&ctx->dev, 3);
+}
+
+static void onStreamRdy(void* arg) { ad7708_stream_onRdy((ad7708_stream*)arg); }
+static void onStreamDma(void* arg) { ad7708_stream_dmaComplete((ad7708_stream*)arg); }
+static void onScanRdy(void* arg) { ad7708_scan_onRdy((ad7708_scan*)arg); }
+static void onScanDma(void* arg) { ad7708_scan_dmaComplete((ad7708_scan*)arg); }
+
+/****************** Operations *******************************/
+
+static uint32_t runInit(bench_ctx* ctx, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        ad7708_invalidateShadow(&ctx->dev); // Cold device every time
+        ad7708_init(&ctx->dev);
+    }
+    return n;
+}
+
+static uint32_t runModeConfig(bench_ctx* ctx, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) { ad7708_modeConfig(&ctx->dev, AD7708_Idle, i & 1U, 0, 0, 0, 0); }
+    return n;
+}
+
+static uint32_t runSetMode(bench_ctx* ctx, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) { ad7708_setMode(&ctx->dev, (i & 1U) ? AD7708_Idle : AD7708_PowerDown); }
+    return n;
+}
+
+static uint32_t runChannelConfig(bench_ctx* ctx, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) { ad7708_channelConfig(&ctx->dev, (AD7708_Channel)(i % 8U), AD7708_Range_2p56V, AD7708_Bipolar); }
+    return n;
+}
+
+static uint32_t runChannelConfigCached(bench_ctx* ctx, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) { ad7708_channelConfig(&ctx->dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar); }
+    return n;
+}
+
+static uint32_t runSfRateConfig(bench_ctx* ctx, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) { ad7708_sfRateConfig(&ctx->dev, (uint8_t)(3U + (i & 1U))); }
+    return n;
+}
+
+static uint32_t runIoConfig(bench_ctx* ctx, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) { ad7708_ioConfig(&ctx->dev, i & 1U, AD7708_IOPIN_Output); }
+    return n;
+}
+
+static uint32_t runReadStatus(bench_ctx* ctx, uint32_t n)
+{
+    statusReg status;
+    for (uint32_t i = 0; i < n; i++) { ad7708_readStatus(&ctx->dev, &status); }
+    return n;
+}
+
+static uint32_t runReadConfig(bench_ctx* ctx, uint32_t n)
+{
+    uint8_t value;
+    for (uint32_t i = 0; i < n; i++) { ad7708_readConfig(&ctx->dev, FILTER_REG, &value, 1); }
+    return n;
+}
+
+static uint32_t runReadCalibration(bench_ctx* ctx, uint32_t n)
+{
+    uint16_t offset, gain;
+    for (uint32_t i = 0; i < n; i++) { ad7708_readCalibration(&ctx->dev, &offset, &gain); }
+    return n;
+}
+
+static uint32_t runWriteCalibration(bench_ctx* ctx, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) { ad7708_writeCalibration(&ctx->dev, (uint16_t)(0x8000U + i), 0x5A00U); }
+    return n;
+}
+
+static uint32_t runBatch(bench_ctx* ctx, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        ad7708_op ops[3] = { { FILTER_REG, AD7708_Write, 3U + (i & 1U) }, { CONTROL_REG, AD7708_Write, (i & 7U) << 4 }, { STATUS_REG, AD7708_Read, 0 } };
+        ad7708_batch(&ctx->dev, ops, 3);
+    }
+    return n;
+}
+
+static uint32_t runAreYouThere(bench_ctx* ctx, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) { ad7708_areYouThere(&ctx->dev); }
+    return n;
+}
+
+static uint32_t runReadData(bench_ctx* ctx, uint32_t n)
+{
+    uint16_t data;
+    for (uint32_t i = 0; i < n; i++) { ad7708_readData(&ctx->dev, &data); }
+    return n;
+}
+
+static uint32_t runSingleConversion(bench_ctx* ctx, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        statusReg status;
+        uint16_t data;
+
+        ad7708_setMode(&ctx->dev, AD7708_SingleConversion);
+        do
+        {
+            ad7708_readStatus(&ctx->dev, &status);
+        } while (!status.bits.rdy);
+        ad7708_readData(&ctx->dev, &data);
+    }
+    return n;
+}
+
+static uint32_t runCalibrate(bench_ctx* ctx, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) { ad7708_calibrate(&ctx->dev, (AD7708_Channel)(i % 8U)); }
+    return n;
+}
+
+static uint32_t runStream(bench_ctx* ctx, uint32_t n)
+{
+    ad7708_sample drain[64];
+
+    ad7708_ring_init(&ctx->ring, ctx->storage, 1024);
+    ctx->sim.onRdy = onStreamRdy;
+    ctx->sim.rdyArg = &ctx->stream;
+    ctx->sim.onDmaDone = onStreamDma;
+    ctx->sim.dmaArg = &ctx->stream;
+    ad7708_stream_start(&ctx->stream, &ctx->dev, &ctx->ring);
+
+    // Start-up is part of the cost, amortized over n samples
+    while (ctx->stream.samples < n)
+    {
+        ad7708_sim_advance(&ctx->sim, ad7708_sim_nextEvent(&ctx->sim) - ctx->sim.nowNs);
+        while (ad7708_ring_pop(&ctx->ring, drain, 64) != 0) {}
+    }
+    ad7708_stream_stop(&ctx->stream);
+
+    return ctx->stream.samples;
+}
+
+static uint32_t runScan(bench_ctx* ctx, uint32_t n)
+{
+    static const ad7708_scan_entry entries[4] = {
+        { AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar, 0, 0 },
+        { AD7708_Channel_2, AD7708_Range_2p56V, AD7708_Bipolar, 0, 0 },
+        { AD7708_Channel_3, AD7708_Range_20mV, AD7708_Unipolar, 0, 0 },
+        { AD7708_Channel_4, AD7708_Range_2p56V, AD7708_Bipolar, 0, 0 },
+    };
+    ad7708_sample drain[64];
+
+    ad7708_ring_init(&ctx->ring, ctx->storage, 1024);
+    ad7708_scan_init(&ctx->scan, &ctx->dev, entries, 4, &ctx->ring);
+    ctx->sim.onRdy = onScanRdy;
+    ctx->sim.rdyArg = &ctx->scan;
+    ctx->sim.onDmaDone = onScanDma;
+    ctx->sim.dmaArg = &ctx->scan;
+    ad7708_scan_start(&ctx->scan);
+
+    while (ctx->scan.samples < n)
+    {
+        ad7708_sim_advance(&ctx->sim, ad7708_sim_nextEvent(&ctx->sim) - ctx->sim.nowNs);
+        while (ad7708_ring_pop(&ctx->ring, drain, 64) != 0) {}
+    }
+    ad7708_scan_stop(&ctx->scan);
+
+    return ctx->scan.samples;
+}
+
+static uint32_t runPoll(bench_ctx* ctx, uint32_t n)
+{
+    ad7708_sample drain[64];
+
+    ad7708_ring_init(&ctx->ring, ctx->storage, 1024);
+    ctx->sim.onRdy = NULL;
+    ad7708_poll_start(&ctx->poll, &ctx->dev, &ctx->ring, 0);
+
+    // Sleep until each poll falls due, as a main loop with a timer would
+    while (ctx->poll.samples < n)
+    {
+        ad7708_sim_advance(&ctx->sim, (uint64_t)ad7708_poll_dueIn(&ctx->poll) * 1000U);
+        ad7708_poll_service(&ctx->poll);
+        while (ad7708_ring_pop(&ctx->ring, drain, 64) != 0) {}
+    }
+    ad7708_poll_stop(&ctx->poll);
+
+    return ctx->poll.samples;
+}
+
+static const bench_case cases[] = {
+    { "init", 10000, setupBare, runInit },
+    { "modeConfig", 100000, setupInit, runModeConfig },
+    { "setMode", 100000, setupInit, runSetMode },
+    { "channelConfig", 100000, setupInit, runChannelConfig },
+    { "channelConfig.cached", 100000, setupInit, runChannelConfigCached },
+    { "sfRateConfig", 100000, setupInit, runSfRateConfig },
+    { "ioConfig", 100000, setupInit, runIoConfig },
+    { "readStatus", 100000, setupInit, runReadStatus },
+    { "readConfig", 100000, setupInit, runReadConfig },
+    { "readCalibration", 100000, setupInit, runReadCalibration },
+    { "writeCalibration", 100000, setupInit, runWriteCalibration },
+    { "batch3", 100000, setupInit, runBatch },
+    { "areYouThere", 100000, setupInit, runAreYouThere },
+    { "readData", 100000, setupInit, runReadData },
+    { "singleConversion", 200, setupFast, runSingleConversion },
+    { "calibrate", 8, setupInit, runCalibrate },
+    { "stream.sample", 2000, setupFast, runStream },
+    { "scan.sample", 2000, setupFast, runScan },
+    { "poll.sample", 2000, setupFast, runPoll },
+};
+
+/****************** Baseline *******************************/
+
+static int loadBaseline(const char* path, bench_result* base, int max)
+{
+    FILE* f = fopen(path, "r");
+    char line[128];
+    int n = 0;
+
+    if (f == NULL) { return -1; }
+    while (n < max && fgets(line, sizeof(line), f) != NULL)
+    {
+        if (line[0] == '#' || line[0] == '\n') { continue; }
+        if (sscanf(line, "%31s %lf %lf %lf", base[n].name, &base[n].bytes, &base[n].cs, &base[n].simUs) == 4) { n++; }
+    }
+    fclose(f);
+
+    return n;
+}
+
+static int saveBaseline(const char* path, const bench_result* res, int n)
+{
+    FILE* f = fopen(path, "w");
+
+    if (f == NULL) { return -1; }
+    fprintf(f, "# name bytes/op cs/op sim_us/op, regenerate with bench_driver --update\n");
+    for (int i = 0; i < n; i++) { fprintf(f, "%s %.3f %.3f %.3f\n", res[i].name, res[i].bytes, res[i].cs, res[i].simUs); }
+    fclose(f);
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    static bench_ctx ctx;
+    bench_result results[MAX_CASES], base[MAX_CASES];
+    const char* baselinePath = NULL;
+    const char* updatePath = NULL;
+    int count = (int)(sizeof(cases) / sizeof(cases[0]));
+    int baseCount = 0;
+    int failed = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--baseline") == 0) { baselinePath = argv[i + 1]; }
+        else if (strcmp(argv[i], "--update") == 0) { updatePath = argv[i + 1]; }
+    }
+    if (baselinePath != NULL)
+    {
+        baseCount = loadBaseline(baselinePath, base, MAX_CASES);
+        if (baseCount < 0)
+        {
+            printf("cannot read baseline %s\n", baselinePath);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("%-22s %10s %9s %7s %11s\n", "operation", "ns/op", "bytes/op", "cs/op", "sim us/op");
+
+    for (int c = 0; c < count; c++)
+    {
+        bench_result* r = &results[c];
+        uint32_t bytes, cs, ops;
+#if AD7708_INSTRUMENT
+        uint32_t instrBytes, instrCs;
+#endif
+        uint64_t simNs;
+        double t0, wall;
+
+        cases[c].setup(&ctx);
+        bytes = ctx.sim.bytes;
+        cs = ctx.sim.csCycles;
+        simNs = ctx.sim.nowNs;
+#if AD7708_INSTRUMENT
+        instrBytes = ctx.dev.instr.spiBytes;
+        instrCs = ctx.dev.instr.csToggles;
+#endif
+
+        t0 = nowNs();
+        ops = cases[c].run(&ctx, cases[c].iterations);
+        wall = nowNs() - t0;
+
+        snprintf(r->name, sizeof(r->name), "%s", cases[c].name);
+        r->bytes = (double)(ctx.sim.bytes - bytes) / ops;
+        r->cs = (double)(ctx.sim.csCycles - cs) / ops;
+        r->simUs = (double)(ctx.sim.nowNs - simNs) / 1000.0 / ops;
+
+        printf("%-22s %10.1f %9.3f %7.3f %11.3f", r->name, wall / ops, r->bytes, r->cs, r->simUs);
+
+#if AD7708_INSTRUMENT
+        // The counters are what firmware reports from the field, they must agree with the wire
+        if (ctx.dev.instr.spiBytes - instrBytes != ctx.sim.bytes - bytes || ctx.dev.instr.csToggles - instrCs != ctx.sim.csCycles - cs)
+        {
+            printf("  INSTR MISMATCH (driver %u bytes %u cs, simulator %u bytes %u cs)", ctx.dev.instr.spiBytes - instrBytes,
+                ctx.dev.instr.csToggles - instrCs, ctx.sim.bytes - bytes, ctx.sim.csCycles - cs);
+            failed = 1;
+        }
+#endif
+
+        for (int b = 0; b < baseCount; b++)
+        {
+            if (strcmp(base[b].name, r->name) != 0) { continue; }
+            // Values are printed with 3 decimals in the file, compare at that resolution
+            if (r->bytes > base[b].bytes + 0.0005 || r->cs > base[b].cs + 0.0005 || r->simUs > base[b].simUs * SIM_TOLERANCE + 0.0005)
+            {
+                printf("  REGRESSION (baseline %.3f %.3f %.3f)", base[b].bytes, base[b].cs, base[b].simUs);
+                failed = 1;
+            }
+            else if (r->bytes < base[b].bytes - 0.0005 || r->cs < base[b].cs - 0.0005) { printf("  improved, update the baseline"); }
+        }
+        printf("\n");
+    }
+
+    if (updatePath != NULL && saveBaseline(updatePath, results, count) != 0)
+    {
+        printf("cannot write baseline %s\n", updatePath);
+        return EXIT_FAILURE;
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,255 @@
+/*
+ * Host ingest engine under load.
+ *
+ * Encodes hundreds of synthetic wire streams, most of them into temporary
+ * files and every eighth one fed live through a socket pair by a writer
+ * thread. Each run ingests all of them with a given number of worker
+ * threads while the main thread drains the channel columns and checks that
+ * every sample arrives exactly once with the right value, mux address and
+ * flags; the streams spread each channel code over all four mux addresses
+ * and clamp some of the samples. Prints samples/s
+ * and the speed-up over one worker, steals, backpressure stalls and the
+ * worst gap between two services of a stream. An optional argument lowers
+ * the samples per stream, for runs under ThreadSanitizer.
+ */
+#define _DEFAULT_SOURCE // socketpair, fileno, nanosleep
+
+#include "ad7708_convert.h"
+#include "ad7708_ingest.h"
+#include "ad7708_wire.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STREAMS 256
+#define PER_STREAM 20000
+#define SOCKET_EVERY 8
+#define COLUMN (1U << 16) // Small enough for backpressure to kick in
+#define TAKE 65536
+
+typedef struct
+{
+    uint8_t* data;
+    uint32_t len;
+} encoded;
+
+typedef struct
+{
+    int fd[STREAMS];
+    const encoded* streams;
+} feeder;
+
+static encoded streams[STREAMS];
+static uint32_t perStream = PER_STREAM;
+
+static double nowSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static ad7708_sample sampleOf(uint32_t s, uint32_t i)
+{
+    uint32_t h = (s * 2654435761U) ^ (i * 2246822519U);
+    ad7708_sample x;
+
+    h ^= h >> 15;
+    h *= 2246822519U;
+    h ^= h >> 13;
+    x.code = (uint16_t)h;
+    x.channel = (uint8_t)((i % 10U + 1U) | ((s + i / 7U) % 4U) << AD7708_SAMPLE_MUX_SHIFT);
+    x.flags = (uint8_t)(((s + i / 10U) & 0x0FU) | (h >> 28 == 0 ? AD7708_SAMPLE_CLAMPED : 0U));
+
+    return x;
+}
+
+static StatusTypeDef memWrite(void* ctx, const uint8_t* data, uint32_t len)
+{
+    encoded* e = (encoded*)ctx;
+
+    e->data = realloc(e->data, e->len + len);
+    if (e->data == NULL) { return AD7708_ERROR; }
+    memcpy(e->data + e->len, data, len);
+    e->len += len;
+
+    return AD7708_OK;
+}
+
+/* Writes the socket streams one after the other, each blocks until the engine drained it */
+static void* feed(void* arg)
+{
+    feeder* f = (feeder*)arg;
+
+    for (uint32_t s = 0; s < STREAMS; s += SOCKET_EVERY)
+    {
+        const uint8_t* p = f->streams[s].data;
+        uint32_t left = f->streams[s].len;
+
+        while (left != 0)
+        {
+            ssize_t n = write(f->fd[s], p, left);
+            if (n <= 0) { break; }
+            p += n;
+            left -= (uint32_t)n;
+        }
+        close(f->fd[s]);
+    }
+
+    return NULL;
+}
+
+static int run(uint8_t threads, double* rate, uint8_t* seen)
+{
+    static float volts[TAKE];
+    static uint16_t stream[TAKE];
+    static uint32_t index[TAKE];
+    static uint8_t mux[TAKE];
+    static uint8_t flags[TAKE];
+    static FILE* files[STREAMS];
+    ad7708_ingest eng;
+    feeder f;
+    pthread_t writer;
+    uint64_t received = 0, steals = 0, gapMax = 0;
+    uint32_t mismatches = 0, stalls = 0, bad = 0;
+    double t0;
+    int ok;
+
+    f.streams = streams;
+    memset(seen, 0, STREAMS * PER_STREAM / 8);
+    if (ad7708_ingest_create(&eng, STREAMS, COLUMN, threads) != AD7708_OK) { return 0; }
+
+    for (uint32_t s = 0; s < STREAMS; s++)
+    {
+        uint16_t id;
+        int fd;
+
+        if (s % SOCKET_EVERY == 0)
+        {
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) { return 0; }
+            f.fd[s] = pair[0];
+            fd = pair[1];
+        }
+        else
+        {
+            files[s] = tmpfile();
+            if (files[s] == NULL || fwrite(streams[s].data, 1, streams[s].len, files[s]) != streams[s].len) { return 0; }
+            fflush(files[s]);
+            fd = fileno(files[s]);
+            lseek(fd, 0, SEEK_SET);
+        }
+        ad7708_ingest_addFd(&eng, fd, s, &id);
+    }
+
+    t0 = nowSec();
+    pthread_create(&writer, NULL, feed, &f);
+    ad7708_ingest_start(&eng);
+
+    for (;;)
+    {
+        // Sample the flag first, whatever was merged before it is in the columns now
+        uint8_t finished = ad7708_ingest_finished(&eng);
+        uint32_t got = 0;
+
+        for (uint8_t c = 0; c < 16; c++)
+        {
+            uint32_t n = ad7708_ingest_take(&eng, c, volts, stream, index, mux, flags, TAKE);
+            for (uint32_t k = 0; k < n; k++)
+            {
+                uint32_t s = eng.streams[stream[k]].tag;
+                ad7708_sample x = sampleOf(s, index[k]);
+                uint32_t bit = s * perStream + index[k];
+                float expect = (float)((int32_t)x.code - ((x.flags & AD7708_SAMPLE_UNIPOLAR) ? 0 : 32768)) * ad7708_convert_lsb(x.flags);
+
+                if (index[k] >= perStream || x.channel != (c | mux[k] << AD7708_SAMPLE_MUX_SHIFT) || x.flags != flags[k] || volts[k] != expect ||
+                    (seen[bit / 8] & (1U << (bit % 8))))
+                {
+                    mismatches++;
+                }
+                else { seen[bit / 8] |= (uint8_t)(1U << (bit % 8)); }
+            }
+            got += n;
+        }
+        received += got;
+        if (finished && got == 0) { break; }
+        if (got < TAKE / 4)
+        {
+            // Let the workers fill the columns instead of spinning on them
+            struct timespec ts = { 0, 200000 };
+            nanosleep(&ts, NULL);
+        }
+    }
+    *rate = received / (nowSec() - t0);
+    pthread_join(writer, NULL);
+
+    // Workers may still be leaving their loop, join them before their descriptors go away
+    ad7708_ingest_stop(&eng);
+
+    for (uint16_t s = 0; s < STREAMS; s++)
+    {
+        ad7708_ingest_stream_stats st;
+        ad7708_ingest_getStream(&eng, s, &st);
+        stalls += st.stalls;
+        bad += st.badFrames + st.lostSamples;
+        if (st.maxGapNs > gapMax) { gapMax = st.maxGapNs; }
+        if (s % SOCKET_EVERY == 0) { close(eng.streams[s].fd); }
+        else { fclose(files[s]); }
+    }
+    for (uint8_t t = 0; t < eng.threads; t++) { steals += eng.workers[t].steals; }
+    ad7708_ingest_destroy(&eng);
+
+    ok = received == (uint64_t)STREAMS * perStream && mismatches == 0 && bad == 0;
+    printf("%7u %12.2f %8llu %8u %10.2f  %s\n", threads, *rate / 1e6, (unsigned long long)steals, stalls, gapMax / 1e6, ok ? "ok" : "FAIL");
+
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    static uint8_t seen[STREAMS * PER_STREAM / 8];
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint8_t counts[] = { 1, 2, 4, 8, 0 };
+    double base = 0.0;
+    int failed = 0;
+
+    if (argc > 1) { perStream = (uint32_t)strtoul(argv[1], NULL, 10); }
+    if (perStream == 0 || perStream > PER_STREAM) { perStream = PER_STREAM; }
+
+    for (uint32_t s = 0; s < STREAMS; s++)
+    {
+        ad7708_wire_encoder enc;
+        ad7708_wire_sink sink = { memWrite, &streams[s] };
+        ad7708_dev dev = { 0 };
+
+        ad7708_wire_open(&enc, &sink, &dev, s);
+        for (uint32_t i = 0; i < perStream; i++)
+        {
+            ad7708_sample x = sampleOf(s, i);
+            ad7708_wire_append(&enc, &x);
+        }
+        ad7708_wire_flush(&enc);
+    }
+
+    printf("%u streams x %u samples, %ld CPUs\n", STREAMS, perStream, cpus);
+    printf("%7s %12s %8s %8s %10s\n", "threads", "MS/s", "steals", "stalls", "gap ms");
+    counts[4] = (uint8_t)(cpus > 255 ? 255 : cpus);
+    for (unsigned k = 0; k < sizeof(counts); k++)
+    {
+        double rate = 0.0;
+
+        if (k == 4 && cpus <= 8) { break; }
+        if (!run(counts[k], &rate, seen)) { failed = 1; }
+        if (k == 0) { base = rate; }
+        else { printf("        speed-up x%.2f\n", rate / base); }
+    }
+
+    for (uint32_t s = 0; s < STREAMS; s++) { free(streams[s].data); }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
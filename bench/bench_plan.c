@@ -0,0 +1,100 @@
+/*
+ * Planner model against the simulator.
+ *
+ * For a set of target rates, scan lengths and chop settings, plans the
+ * filter word, runs the scan sequencer on the simulated bus for twenty seconds
+ * of virtual time and compares measured with predicted aggregate throughput.
+ * Fails if any prediction is off by more than 1 %.
+ */
+#include "ad7708.h"
+#include "ad7708_plan.h"
+#include "ad7708_ring.h"
+#include "ad7708_scan.h"
+#include "ad7708_sim.h"
+
+#include <stdio.h>
+
+#define RUN_NS 20000000000ULL
+#define RING_SIZE 8192
+
+static void onRdy(void* arg)
+{
+    ad7708_scan_onRdy((ad7708_scan*)arg);
+}
+
+static void onDmaDone(void* arg)
+{
+    ad7708_scan_dmaComplete((ad7708_scan*)arg);
+}
+
+int main(void)
+{
+    static ad7708_sample storage[RING_SIZE];
+    static const struct
+    {
+        uint32_t rateMilliHz;
+        uint8_t channels;
+        uint8_t chop;
+    } cases[] = {
+        { 1000000, 1, 0 }, { 100000, 1, 0 }, { 10000, 1, 1 },
+        { 100000, 4, 0 }, { 20000, 4, 1 }, { 50000, 8, 0 },
+        { 5000, 8, 1 }, { 1000, 16, 1 }, { 500000, 4, 0 },
+    };
+    int failed = 0;
+
+    printf("%10s %3s %4s | %3s %10s %10s %10s %8s | %10s %7s\n", "target/ch", "ch", "chop", "sf", "odr Hz", "settle us", "pred S/s", "noise uV", "meas S/s", "err %");
+
+    for (unsigned c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        ad7708_plan_request req = { cases[c].rateMilliHz, cases[c].channels, cases[c].chop, AD7708_Range_2p56V, AD7708_SIM_BYTE_NS };
+        ad7708_plan plan;
+        ad7708_scan_entry entries[16];
+        ad7708_sim sim;
+        ad7708_dev dev = { 0 };
+        ad7708_ring ring;
+        ad7708_scan scan;
+        StatusTypeDef status = ad7708_plan_compute(&req, &plan);
+        double measured, predicted, err;
+
+        ad7708_sim_init(&sim);
+        ad7708_sim_attach(&sim, &dev);
+        ad7708_ring_init(&ring, storage, RING_SIZE);
+        ad7708_init(&dev);
+        ad7708_plan_apply(&dev, &plan);
+
+        for (uint8_t i = 0; i < req.channels && i < 16; i++)
+        {
+            entries[i].channel = (AD7708_Channel)(i % 10U + 1U);
+            entries[i].range = AD7708_Range_2p56V;
+            entries[i].polarity = AD7708_Bipolar;
+            entries[i].discard = 0;
+            entries[i].mux = 0;
+            if (i >= 10) { entries[i].range = AD7708_Range_1p28V; } // Keep consecutive entries distinct
+        }
+        ad7708_scan_init(&scan, &dev, entries, req.channels, &ring);
+        sim.onRdy = onRdy;
+        sim.rdyArg = &scan;
+        sim.onDmaDone = onDmaDone;
+        sim.dmaArg = &scan;
+        ad7708_scan_start(&scan);
+
+        // Skip the first settling so the window only sees steady state
+        ad7708_sim_advance(&sim, plan.settleNs + plan.stepNs);
+        {
+            // Nobody drains the ring, results dropped as full still count as delivered
+            uint32_t start = scan.samples + scan.fullOverruns;
+            ad7708_sim_advance(&sim, RUN_NS);
+            measured = (double)(scan.samples + scan.fullOverruns - start) * 1e9 / (double)RUN_NS;
+        }
+        predicted = plan.aggregateMilliHz / 1000.0;
+        err = (measured - predicted) / predicted * 100.0;
+        if (err < -1.0 || err > 1.0) { failed = 1; }
+
+        printf("%10.2f %3u %4u | %3u %10.3f %10.1f %10.2f %8.2f | %10.2f %+7.2f%s\n", cases[c].rateMilliHz / 1000.0, req.channels, req.chop, plan.sf,
+            plan.odrMilliHz / 1000.0, plan.settleNs / 1000.0, predicted, plan.noiseNv / 1000.0, measured, err, status == AD7708_OK ? "" : "  (infeasible)");
+    }
+
+    if (failed) { printf("FAIL: prediction off by more than 1 %%\n"); }
+
+    return failed;
+}
@@ -0,0 +1,237 @@
+/*
+ * Wire protocol end to end.
+ *
+ * Encodes a block of tagged samples and decodes it on the far side of a pipe
+ * and of a pseudo-terminal, in a forked child, checking every sample. Tags
+ * cover every range/polarity, external mux address and the clamp flag. Then
+ * drops and corrupts bytes of an encoded stream at random and checks that the
+ * decoder delivers only correct samples and accounts for every lost one.
+ * Prints wire bytes per sample and the sample rate each link baud rate
+ * carries, against one printf line per sample.
+ */
+#define _DEFAULT_SOURCE // cfmakeraw
+#define _XOPEN_SOURCE 600 // posix_openpt
+
+#include "ad7708.h"
+#include "ad7708_sim.h"
+#include "ad7708_wire.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SAMPLES 200000
+#define LOSS_PPM 200 // Bytes dropped or flipped per million
+
+typedef struct
+{
+    uint8_t* data;
+    uint32_t len;
+    uint32_t size;
+} membuf;
+
+typedef struct
+{
+    const ad7708_sample* expected;
+    uint32_t mismatches;
+    uint32_t lastEnd;
+    uint32_t muxed;    // Samples decoded with a mux address
+    uint32_t clamped;  // Samples decoded with AD7708_SAMPLE_CLAMPED
+} checker;
+
+static ad7708_sample samples[SAMPLES];
+
+static double nowSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static StatusTypeDef memWrite(void* ctx, const uint8_t* data, uint32_t len)
+{
+    membuf* m = (membuf*)ctx;
+
+    if (m->len + len > m->size) { return AD7708_ERROR; }
+    memcpy(m->data + m->len, data, len);
+    m->len += len;
+
+    return AD7708_OK;
+}
+
+static void onSamples(void* arg, const ad7708_wire_config* config, uint32_t first, const ad7708_sample* s, uint8_t count)
+{
+    checker* c = (checker*)arg;
+
+    (void)config;
+    for (uint8_t k = 0; k < count; k++)
+    {
+        const ad7708_sample* e = &c->expected[first + k];
+        if (first + k >= SAMPLES || s[k].code != e->code || s[k].channel != e->channel || s[k].flags != e->flags) { c->mismatches++; }
+        if (s[k].channel >> AD7708_SAMPLE_MUX_SHIFT) { c->muxed++; }
+        if (s[k].flags & AD7708_SAMPLE_CLAMPED) { c->clamped++; }
+    }
+    c->lastEnd = first + count;
+}
+
+static void encodeAll(const ad7708_wire_sink* sink, const ad7708_dev* dev, ad7708_wire_encoder* enc)
+{
+    ad7708_wire_open(enc, sink, dev, 0x7708);
+    ad7708_wire_appendBlock(enc, samples, SAMPLES);
+    ad7708_wire_flush(enc);
+}
+
+/* Child encodes into wfd, parent decodes from rfd, returns 0 on a clean transfer */
+static int runLink(const char* name, int wfd, int rfd, int closeInChild, const ad7708_dev* dev)
+{
+    int ack[2];
+    pid_t pid;
+    ad7708_wire_decoder dec;
+    checker c = { samples, 0, 0, 0, 0 };
+    uint8_t buf[4096];
+    double t0;
+    int ok;
+
+    if (pipe(ack) != 0) { return 1; }
+    pid = fork();
+    if (pid == 0)
+    {
+        ad7708_wire_encoder enc;
+        ad7708_wire_sink sink;
+        char done;
+
+        close(rfd);
+        close(closeInChild);
+        close(ack[1]);
+        ad7708_wire_fdSink(&sink, wfd);
+        encodeAll(&sink, dev, &enc);
+        // Keep the writing end open until the parent has read everything, a pty drops queued input on hangup
+        (void)read(ack[0], &done, 1);
+        _exit(enc.errors != 0);
+    }
+
+    close(wfd);
+    if (closeInChild != rfd) { close(closeInChild); }
+    close(ack[0]);
+    ad7708_wire_decoder_init(&dec, onSamples, &c);
+    t0 = nowSec();
+    while (dec.samplesOk < SAMPLES)
+    {
+        ssize_t n = read(rfd, buf, sizeof(buf));
+        if (n <= 0) { break; }
+        ad7708_wire_decode(&dec, buf, (uint32_t)n);
+    }
+    t0 = nowSec() - t0;
+    close(ack[1]);
+    close(rfd);
+    waitpid(pid, &ok, 0);
+
+    ok = WIFEXITED(ok) && WEXITSTATUS(ok) == 0 && dec.samplesOk == SAMPLES && c.mismatches == 0 && dec.crcErrors == 0 && dec.framingErrors == 0
+        && dec.lostFrames == 0 && dec.lostSamples == 0 && dec.haveConfig && dec.config.deviceTag == 0x7708
+        && dec.config.version == AD7708_WIRE_VERSION && c.muxed != 0 && c.clamped != 0;
+    printf("%-4s %8u samples %6u frames  %.2f MS/s  crc %u framing %u lost %u  muxed %u clamped %u  %s\n", name, dec.samplesOk, dec.frames,
+        dec.samplesOk / t0 / 1e6, dec.crcErrors, dec.framingErrors, dec.lostSamples, c.muxed, c.clamped, ok ? "ok" : "FAIL");
+
+    return !ok;
+}
+
+int main(void)
+{
+    static uint8_t stream[SAMPLES * 5], damaged[SAMPLES * 5];
+    static const uint32_t bauds[] = { 115200, 460800, 921600, 3000000 };
+    ad7708_sim sim;
+    ad7708_dev dev = { 0 };
+    ad7708_wire_encoder enc;
+    ad7708_wire_decoder dec;
+    ad7708_wire_sink sink;
+    membuf mem = { stream, 0, sizeof(stream) };
+    checker c = { samples, 0, 0, 0, 0 };
+    uint32_t seed = 1, dlen = 0, textBytes = 0;
+    double wireBytes;
+    int failed = 0;
+    int fds[2];
+
+    ad7708_sim_init(&sim);
+    ad7708_sim_attach(&sim, &dev);
+    ad7708_init(&dev);
+
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        char line[32];
+        seed = seed * 1664525U + 1013904223U;
+        samples[i].code = (uint16_t)(seed >> 16);
+        samples[i].channel = (uint8_t)((i % 10U + 1U) | ((seed >> 4) & 0x03U) << AD7708_SAMPLE_MUX_SHIFT);
+        samples[i].flags = (uint8_t)((seed >> 8) & (AD7708_SAMPLE_TAG_MASK | AD7708_SAMPLE_CLAMPED));
+        textBytes += (uint32_t)snprintf(line, sizeof(line), "%u,%u\r\n", samples[i].channel, samples[i].code);
+    }
+
+    // Over a pipe, then over a pseudo-terminal in raw mode
+    if (pipe(fds) == 0) { failed |= runLink("pipe", fds[1], fds[0], fds[0], &dev); }
+    else { failed = 1; }
+    {
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+        int slave = -1;
+        struct termios tio;
+
+        if (master >= 0 && grantpt(master) == 0 && unlockpt(master) == 0) { slave = open(ptsname(master), O_RDWR | O_NOCTTY); }
+        if (slave >= 0 && tcgetattr(slave, &tio) == 0)
+        {
+            cfmakeraw(&tio);
+            tcsetattr(slave, TCSANOW, &tio);
+            failed |= runLink("pty", master, slave, slave, &dev);
+        }
+        else
+        {
+            printf("pty  unavailable, skipped\n");
+        }
+    }
+
+    // Random byte loss and corruption, the last frames stay intact so every gap is visible
+    sink.write = memWrite;
+    sink.ctx = &mem;
+    encodeAll(&sink, &dev, &enc);
+    for (uint32_t i = 0; i < mem.len; i++)
+    {
+        seed = seed * 1664525U + 1013904223U;
+        if (i + 2 * AD7708_WIRE_MAX_FRAME < mem.len && seed % 1000000U < LOSS_PPM)
+        {
+            if (seed & 0x100U) { continue; }
+            damaged[dlen++] = (uint8_t)(stream[i] ^ (1U << (seed >> 28 & 7U)));
+            continue;
+        }
+        damaged[dlen++] = stream[i];
+    }
+    ad7708_wire_decoder_init(&dec, onSamples, &c);
+    for (uint32_t i = 0; i < dlen;)
+    {
+        uint32_t chunk;
+        seed = seed * 1664525U + 1013904223U;
+        chunk = 1U + (seed >> 20) % 700U;
+        if (chunk > dlen - i) { chunk = dlen - i; }
+        ad7708_wire_decode(&dec, damaged + i, chunk);
+        i += chunk;
+    }
+    {
+        int ok = c.mismatches == 0 && dec.samplesOk + dec.lostSamples == SAMPLES && dec.crcErrors + dec.framingErrors != 0;
+        printf("loss %8u samples %6u frames  %u ppm  crc %u framing %u lost frames %u samples %u  %s\n", dec.samplesOk, dec.frames, LOSS_PPM,
+            dec.crcErrors, dec.framingErrors, dec.lostFrames, dec.lostSamples, ok ? "ok" : "FAIL");
+        failed |= !ok;
+    }
+
+    // 8N1 framing, ten bit times per byte
+    wireBytes = (double)enc.bytes / SAMPLES;
+    printf("\n%.3f wire bytes/sample, %.3f as text lines\n", wireBytes, (double)textBytes / SAMPLES);
+    printf("%9s %12s %12s\n", "baud", "wire S/s", "text S/s");
+    for (unsigned b = 0; b < sizeof(bauds) / sizeof(bauds[0]); b++)
+    {
+        printf("%9u %12.0f %12.0f\n", bauds[b], bauds[b] / 10.0 / wireBytes, bauds[b] / 10.0 / ((double)textBytes / SAMPLES));
+    }
+    if (wireBytes > 4.25) { printf("FAIL: more than 4.25 bytes per sample\n"); failed = 1; }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
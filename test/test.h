@@ -0,0 +1,28 @@
+/*
+ * Minimal check harness shared by the host tests.
+ *
+ * Every test is its own executable run by ctest. CHECK records a failure and
+ * carries on so one run reports everything that is off; main() returns
+ * TEST_RESULT().
+ */
+#ifndef __AD7708_TEST_H__
+#define __AD7708_TEST_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int testFailures;
+
+#define CHECK(cond)                                                                                                    \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(cond))                                                                                                   \
+        {                                                                                                              \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);                                            \
+            testFailures++;                                                                                            \
+        }                                                                                                              \
+    } while (0)
+
+#define TEST_RESULT() (testFailures ? EXIT_FAILURE : EXIT_SUCCESS)
+
+#endif
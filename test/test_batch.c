@@ -0,0 +1,58 @@
+/*
+ * ad7708_batch shadow handling against the simulator.
+ */
+#include "ad7708.h"
+#include "ad7708_sim.h"
+#include "test.h"
+
+#include <string.h>
+
+static ad7708_sim sim;
+static ad7708_dev dev;
+
+static void setup(void)
+{
+    memset(&dev, 0, sizeof(dev));
+    ad7708_sim_init(&sim);
+    ad7708_sim_attach(&sim, &dev);
+    ad7708_init(&dev);
+    ad7708_channelConfig(&dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar);
+}
+
+int main(void)
+{
+    uint8_t a;
+    uint32_t skipped, bytes;
+
+    // Writing B then back to A: the second write differs from the frame, not from the old shadow
+    setup();
+    a = dev.controlReg.byte;
+    {
+        ad7708_op ops[2] = { { CONTROL_REG, AD7708_Write, 0x17U }, { CONTROL_REG, AD7708_Write, a } };
+        skipped = dev.writesSkipped;
+        CHECK(ad7708_batch(&dev, ops, 2) == AD7708_OK);
+        CHECK(sim.control == a && dev.controlReg.byte == a);
+        CHECK(dev.writesSkipped == skipped);
+    }
+
+    // A repeated write inside one frame goes out once
+    {
+        ad7708_op ops[3] = { { FILTER_REG, AD7708_Write, 0x10U }, { FILTER_REG, AD7708_Write, 0x10U }, { STATUS_REG, AD7708_Read, 0 } };
+        skipped = dev.writesSkipped;
+        bytes = sim.bytes;
+        CHECK(ad7708_batch(&dev, ops, 3) == AD7708_OK);
+        CHECK(sim.filter == 0x10U);
+        CHECK(sim.bytes - bytes == 4);
+        CHECK(dev.writesSkipped == skipped + 1);
+    }
+
+    // A self-clearing mode is never served from the frame's copy
+    {
+        ad7708_op ops[2] = { { MODE_REG, AD7708_Write, AD7708_SingleConversion }, { MODE_REG, AD7708_Write, AD7708_SingleConversion } };
+        bytes = sim.bytes;
+        CHECK(ad7708_batch(&dev, ops, 2) == AD7708_OK);
+        CHECK(sim.bytes - bytes == 4);
+    }
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,125 @@
+/*
+ * ad7708_bus with 1, 4 and 8 simulated devices sharing one SPI bus.
+ *
+ * Every device scans two channels, so each result costs a full filter
+ * settling time and the devices convert in parallel while the bus serves
+ * them one frame at a time. Throughput must scale with the device count,
+ * the scheduler's utilization must agree with the bus clock and no byte
+ * may ever be clocked with two chip selects asserted.
+ */
+#include "ad7708.h"
+#include "ad7708_bus.h"
+#include "ad7708_plan.h"
+#include "ad7708_sim.h"
+#include "test.h"
+
+#include <string.h>
+
+#define WINDOW_NS 100000000ULL // 100 ms
+#define STEP_NS 1000000ULL
+#define SF 3U
+
+typedef struct
+{
+    ad7708_sim_bus simBus;
+    ad7708_sim sims[AD7708_BUS_MAX];
+    ad7708_dev devs[AD7708_BUS_MAX];
+    ad7708_ring rings[AD7708_BUS_MAX];
+    ad7708_sample storage[AD7708_BUS_MAX][64];
+    ad7708_bus bus;
+} test_ctx;
+
+static const ad7708_scan_entry entries[2] = {
+    { AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar, 0, 0 },
+    { AD7708_Channel_2, AD7708_Range_2p56V, AD7708_Bipolar, 0, 0 },
+};
+
+static void onRdy(void* arg) { ad7708_bus_onRdy((ad7708_bus_slot*)arg); }
+static void onDma(void* arg) { ad7708_bus_dmaComplete((ad7708_bus*)arg); }
+
+static void run(test_ctx* ctx, uint8_t devices)
+{
+    uint32_t perDevice = (uint32_t)(WINDOW_NS / ad7708_plan_settleNs(SF, 0));
+    uint32_t received[AD7708_BUS_MAX] = { 0 };
+    uint32_t total = 0;
+    uint64_t busy0, t0;
+    uint16_t utilization, expected;
+
+    memset(ctx, 0, sizeof(*ctx));
+    ad7708_sim_bus_init(&ctx->simBus);
+    ad7708_bus_init(&ctx->bus);
+    ctx->simBus.onDmaDone = onDma;
+    ctx->simBus.dmaArg = &ctx->bus;
+
+    for (uint8_t i = 0; i < devices; i++)
+    {
+        ad7708_sim_init(&ctx->sims[i]);
+        CHECK(ad7708_sim_bus_add(&ctx->simBus, &ctx->sims[i], &ctx->devs[i]) == AD7708_OK);
+        CHECK(ad7708_init(&ctx->devs[i]) == AD7708_OK);
+        CHECK(ad7708_sfRateConfig(&ctx->devs[i], SF) == AD7708_OK);
+        ad7708_ring_init(&ctx->rings[i], ctx->storage[i], 64);
+        CHECK(ad7708_bus_add(&ctx->bus, &ctx->devs[i], entries, 2, &ctx->rings[i]) == AD7708_OK);
+        ctx->sims[i].onRdy = onRdy;
+        ctx->sims[i].rdyArg = &ctx->bus.slot[i];
+    }
+
+    CHECK(ad7708_bus_start(&ctx->bus) == AD7708_OK);
+    busy0 = ctx->simBus.busyNs;
+    t0 = ctx->simBus.nowNs;
+
+    for (uint64_t t = 0; t < WINDOW_NS; t += STEP_NS)
+    {
+        ad7708_sim_bus_advance(&ctx->simBus, STEP_NS);
+        for (uint8_t i = 0; i < devices; i++)
+        {
+            ad7708_sample out[64];
+            uint32_t n = ad7708_ring_pop(&ctx->rings[i], out, 64);
+
+            for (uint32_t k = 0; k < n; k++) { CHECK(out[k].channel == entries[(received[i] + k) & 1U].channel); }
+            received[i] += n;
+        }
+    }
+    utilization = ad7708_bus_utilization(&ctx->bus);
+    ad7708_bus_stop(&ctx->bus);
+
+    for (uint8_t i = 0; i < devices; i++)
+    {
+        // Every device keeps its own pace whatever the others do
+        CHECK(received[i] + 1 >= perDevice && received[i] <= perDevice + 1);
+        CHECK(ctx->bus.slot[i].missed == 0);
+        CHECK(ctx->bus.slot[i].scan.errors == 0);
+        CHECK(ctx->bus.slot[i].scan.fullOverruns == 0);
+        CHECK(ctx->sims[i].overruns == 0);
+        total += received[i];
+    }
+
+    // The scheduler's own accounting against the simulated bus, in 0.1 %
+    expected = (uint16_t)((ctx->simBus.busyNs - busy0) * 1000U / (ctx->simBus.nowNs - t0));
+    CHECK(utilization + 2 >= expected && utilization <= expected + 2);
+    CHECK(ctx->simBus.collisions == 0);
+
+    printf("%u devices: %u samples in %llu ms, utilization %u.%u %% (bus %u.%u %%), collisions %u\n", devices, total,
+        (unsigned long long)(WINDOW_NS / 1000000ULL), utilization / 10U, utilization % 10U, expected / 10U, expected % 10U,
+        ctx->simBus.collisions);
+}
+
+static void testEmpty(test_ctx* ctx)
+{
+    // Nothing attached yet, the queries must not touch a device
+    ad7708_bus_init(&ctx->bus);
+    CHECK(ad7708_bus_start(&ctx->bus) == AD7708_ERROR);
+    CHECK(ad7708_bus_utilization(&ctx->bus) == 0);
+    CHECK(ad7708_bus_latencyAvg(&ctx->bus, 0) == 0);
+    CHECK(ad7708_bus_latencyAvg(&ctx->bus, AD7708_BUS_MAX) == 0);
+}
+
+int main(void)
+{
+    static test_ctx ctx;
+    static const uint8_t devices[] = { 1, 4, 8 };
+
+    testEmpty(&ctx);
+    for (uint8_t i = 0; i < sizeof(devices); i++) { run(&ctx, devices[i]); }
+
+    return TEST_RESULT();
+}
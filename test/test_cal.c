@@ -0,0 +1,162 @@
+/*
+ * ad7708_calibrateAsync against the simulator: completion, timeout and the
+ * calibration pairs it leaves behind for ad7708_recover.
+ */
+#include "ad7708.h"
+#include "ad7708_cal.h"
+#include "ad7708_sim.h"
+#include "test.h"
+
+#include <string.h>
+
+static ad7708_sim sim;
+static ad7708_dev dev;
+static ad7708_cal cal;
+static uint32_t doneCalls;
+static StatusTypeDef doneStatus;
+
+static const ad7708_cal_entry entries[3] = {
+    { AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar },
+    { AD7708_Channel_4, AD7708_Range_20mV, AD7708_Unipolar },
+    { AD7708_Channel_8, AD7708_Range_1p28V, AD7708_Bipolar },
+};
+
+static void onDone(void* arg, StatusTypeDef status)
+{
+    (void)arg;
+    doneCalls++;
+    doneStatus = status;
+}
+
+static void onRdy(void* arg) { ad7708_cal_onRdy((ad7708_cal*)arg); }
+
+static ad7708_transport transport;
+static uint8_t failMode;       // Mode written in a frame that fails, 0: none
+static uint32_t fullCalWrites; // Frames that reached the sim with a full calibration
+
+static StatusTypeDef modeTransfer(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len)
+{
+    if (len >= 2 && tx[0] == (uint8_t)MODE_REG)
+    {
+        if ((tx[1] & 0x07U) == failMode) { return AD7708_ERROR; }
+        if ((tx[1] & 0x07U) == AD7708_InternalFullCalibration) { fullCalWrites++; }
+    }
+    return ad7708_simTransport.transfer(intf, tx, rx, len);
+}
+
+static void setup(void)
+{
+    memset(&dev, 0, sizeof(dev));
+    ad7708_sim_init(&sim);
+    ad7708_sim_attach(&sim, &dev);
+    sim.offsetError = 0.01;
+    sim.gainError = 0.02;
+    ad7708_init(&dev);
+    sim.onRdy = onRdy;
+    sim.rdyArg = &cal;
+    doneCalls = 0;
+}
+
+static void testComplete(void)
+{
+    StatusTypeDef status = AD7708_BUSY;
+    uint32_t loops = 0;
+    uint64_t t0;
+
+    setup();
+    t0 = sim.nowNs;
+    CHECK(ad7708_calibrateAsync(&cal, &dev, entries, 3, onDone, NULL) == AD7708_OK);
+    CHECK(cal.state == AD7708_CAL_ZERO);
+    cal.pollIntervalMs = 1000; // Only the RDY edges can keep the sequence going at full speed
+
+    while (status == AD7708_BUSY && loops++ < 100000)
+    {
+        ad7708_sim_advance(&sim, 100000); // 100 us main loop tick
+        status = ad7708_cal_poll(&cal);
+    }
+
+    CHECK(status == AD7708_OK);
+    CHECK(cal.state == AD7708_CAL_DONE);
+    CHECK(doneCalls == 1 && doneStatus == AD7708_OK);
+    CHECK(ad7708_cal_poll(&cal) == AD7708_OK && doneCalls == 1);
+
+    // The device holds the simulated errors and the driver recorded exactly that
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        uint8_t ch = entries[i].channel;
+        CHECK(sim.offset[ch] == (uint16_t)(AD7708_SIM_OFFSET_DEFAULT + (int32_t)(0.01 * 32768.0)));
+        CHECK(sim.gain[ch] == (uint16_t)(AD7708_SIM_GAIN_DEFAULT * 1.02 + 0.5));
+        CHECK(dev.calOffset[ch] == sim.offset[ch]);
+        CHECK(dev.calGain[ch] == sim.gain[ch]);
+        CHECK((dev.calKnown >> ch) & 1U);
+        CHECK((dev.calKnown >> (16U + ch)) & 1U);
+    }
+
+    // Two steps of 3 periods per entry, each picked up on the tick after its RDY edge
+    CHECK(sim.nowNs - t0 <= 6 * (3 * ad7708_sim_periodNs(&sim) + 200000));
+    CHECK(cal.polls == 6);
+}
+
+static void testTimeout(void)
+{
+    StatusTypeDef status = AD7708_BUSY;
+    uint32_t loops = 0;
+
+    setup();
+    CHECK(ad7708_calibrateAsync(&cal, &dev, entries, 3, onDone, NULL) == AD7708_OK);
+    cal.timeoutMs = 50;
+    sim.readyAtNs = 0; // The zero-scale step never completes
+
+    while (status == AD7708_BUSY && loops++ < 100000)
+    {
+        ad7708_sim_advance(&sim, 1000000);
+        status = ad7708_cal_poll(&cal);
+    }
+
+    CHECK(status == AD7708_TIMEOUT);
+    CHECK(loops >= 50 && loops <= 50 + AD7708_CAL_POLL_MS);
+    CHECK(cal.state == AD7708_CAL_FAILED && cal.index == 0);
+    CHECK(doneCalls == 1 && doneStatus == AD7708_TIMEOUT);
+    CHECK(ad7708_cal_poll(&cal) == AD7708_ERROR && doneCalls == 1);
+    CHECK(((dev.calKnown >> entries[0].channel) & 1U) == 0);
+}
+
+static void testArguments(void)
+{
+    setup();
+    CHECK(ad7708_calibrateAsync(&cal, &dev, entries, 0, onDone, NULL) == AD7708_ERROR);
+    CHECK(ad7708_calibrateAsync(&cal, &dev, entries, AD7708_CAL_MAX + 1, onDone, NULL) == AD7708_ERROR);
+    CHECK(doneCalls == 0);
+}
+
+static void testBlockingFailure(void)
+{
+    static const uint8_t modes[2] = { AD7708_InternalZeroCalibration, AD7708_InternalFullCalibration };
+
+    // A step that did not reach the part ends the calibration, nothing after it runs
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        setup();
+        transport = ad7708_simTransport;
+        transport.transfer = modeTransfer;
+        transport.transferDMA = NULL;
+        dev.transport = &transport;
+        failMode = modes[i];
+        fullCalWrites = 0;
+
+        CHECK(ad7708_calibrateRange(&dev, AD7708_Channel_2, AD7708_Range_2p56V, AD7708_Bipolar) == AD7708_ERROR);
+        CHECK(fullCalWrites == 0);
+        CHECK(!(dev.calKnown & (1UL << (16U + AD7708_Channel_2))));
+    }
+    failMode = 0;
+}
+
+int main(void)
+{
+    testComplete();
+    testTimeout();
+    testArguments();
+    testBlockingFailure();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,167 @@
+/*
+ * ad7708_calstore with the file backend: round trip through a file,
+ * rejection of damaged files and the staleness limits on restore.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "ad7708.h"
+#include "ad7708_calstore.h"
+#include "ad7708_sim.h"
+#include "test.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+static ad7708_sim sim;
+static ad7708_dev dev;
+static char path[] = "/tmp/ad7708_calstoreXXXXXX";
+
+static void setup(double offsetError, double gainError)
+{
+    memset(&dev, 0, sizeof(dev));
+    ad7708_sim_init(&sim);
+    ad7708_sim_attach(&sim, &dev);
+    sim.offsetError = offsetError;
+    sim.gainError = gainError;
+    ad7708_init(&dev);
+}
+
+/*!
+ * @brief Overwrite bytes of the stored file
+ */
+static void patchFile(long offset, const void* data, size_t len)
+{
+    FILE* f = fopen(path, "r+b");
+
+    CHECK(f != NULL);
+    if (f == NULL) { return; }
+    fseek(f, offset, SEEK_SET);
+    fwrite(data, 1, len, f);
+    fclose(f);
+}
+
+static void testRoundTrip(ad7708_calstore_backend* backend)
+{
+    ad7708_calstore table, loaded;
+
+    setup(0.01, -0.03);
+    ad7708_calstore_init(&table);
+    CHECK(ad7708_calibrateRange(&dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar) == AD7708_OK);
+    CHECK(ad7708_calstore_capture(&table, &dev, 250, 1000) == AD7708_OK);
+    CHECK(ad7708_calibrateRange(&dev, AD7708_Channel_3, AD7708_Range_20mV, AD7708_Unipolar) == AD7708_OK);
+    CHECK(ad7708_calstore_capture(&table, &dev, 260, 1010) == AD7708_OK);
+    CHECK(ad7708_calstore_capture(&table, &dev, 261, 1020) == AD7708_OK); // Same key, replaced
+    CHECK(table.count == 2);
+
+    CHECK(ad7708_calstore_save(&table, backend) == AD7708_OK);
+    memset(&loaded, 0xA5, sizeof(loaded));
+    CHECK(ad7708_calstore_load(&loaded, backend) == AD7708_OK);
+    CHECK(loaded.count == 2);
+    CHECK(memcmp(loaded.entries, table.entries, sizeof(table.entries[0]) * 2) == 0);
+    CHECK(loaded.entries[1].tempC10 == 261 && loaded.entries[1].stamp == 1020);
+
+    // A cold device gets the calibrated pair back without calibrating
+    setup(0.0, 0.0);
+    CHECK(ad7708_calstore_restore(&loaded, &dev, AD7708_Channel_3, AD7708_Range_20mV, AD7708_Unipolar, NULL) == AD7708_OK);
+    CHECK(sim.offset[AD7708_Channel_3] == table.entries[1].offset);
+    CHECK(sim.gain[AD7708_Channel_3] == table.entries[1].gain);
+    CHECK(sim.offset[AD7708_Channel_3] != AD7708_SIM_OFFSET_DEFAULT);
+    CHECK((sim.control >> 4) == AD7708_Channel_3);
+
+    // Nothing stored for this range
+    CHECK(ad7708_calstore_restore(&loaded, &dev, AD7708_Channel_3, AD7708_Range_2p56V, AD7708_Unipolar, NULL) == AD7708_ERROR);
+}
+
+static void testCorruption(ad7708_calstore_backend* backend)
+{
+    ad7708_calstore table, loaded;
+    uint8_t byte;
+    uint16_t version = AD7708_CALSTORE_VERSION + 1;
+
+    setup(0.01, 0.0);
+    ad7708_calstore_init(&table);
+    ad7708_calibrateRange(&dev, AD7708_Channel_2, AD7708_Range_2p56V, AD7708_Bipolar);
+    ad7708_calstore_capture(&table, &dev, 250, 1000);
+
+    // One flipped bit in a coefficient
+    CHECK(ad7708_calstore_save(&table, backend) == AD7708_OK);
+    byte = (uint8_t)(table.entries[0].offset ^ 0x01U);
+    patchFile((long)(offsetof(ad7708_calstore, entries) + offsetof(ad7708_calstore_entry, offset)), &byte, 1);
+    CHECK(ad7708_calstore_load(&loaded, backend) == AD7708_ERROR);
+    CHECK(loaded.count == 0 && loaded.magic == AD7708_CALSTORE_MAGIC); // Left empty and usable
+
+    // Another version, even with a matching CRC
+    table.version = version;
+    CHECK(ad7708_calstore_save(&table, backend) == AD7708_OK);
+    CHECK(ad7708_calstore_load(&loaded, backend) == AD7708_ERROR);
+    table.version = AD7708_CALSTORE_VERSION;
+
+    // Truncated file
+    CHECK(ad7708_calstore_save(&table, backend) == AD7708_OK);
+    CHECK(truncate(path, sizeof(table) / 2) == 0);
+    CHECK(ad7708_calstore_load(&loaded, backend) == AD7708_ERROR);
+
+    // Missing file
+    unlink(path);
+    CHECK(ad7708_calstore_load(&loaded, backend) == AD7708_ERROR);
+
+    // Intact again
+    CHECK(ad7708_calstore_save(&table, backend) == AD7708_OK);
+    CHECK(ad7708_calstore_load(&loaded, backend) == AD7708_OK && loaded.count == 1);
+}
+
+static void testLimits(void)
+{
+    ad7708_calstore table;
+    ad7708_calstore_limits limits = { 250, 1000, 50, 3600 };
+
+    setup(0.01, 0.0);
+    ad7708_calstore_init(&table);
+    ad7708_calibrateRange(&dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar);
+    ad7708_calstore_capture(&table, &dev, 250, 1000);
+
+    // Temperature: within +-5.0 degC of the calibration
+    limits.tempC10 = 300;
+    CHECK(ad7708_calstore_restore(&table, &dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar, &limits) == AD7708_OK);
+    limits.tempC10 = 200;
+    CHECK(ad7708_calstore_restore(&table, &dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar, &limits) == AD7708_OK);
+    limits.tempC10 = 301;
+    CHECK(ad7708_calstore_restore(&table, &dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar, &limits) == AD7708_ERROR);
+    limits.tempC10 = 199;
+    CHECK(ad7708_calstore_restore(&table, &dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar, &limits) == AD7708_ERROR);
+    limits.tempC10 = 250;
+
+    // Age: at most maxAge after the calibration
+    limits.stamp = 1000 + 3600;
+    CHECK(ad7708_calstore_restore(&table, &dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar, &limits) == AD7708_OK);
+    limits.stamp = 1000 + 3601;
+    CHECK(ad7708_calstore_restore(&table, &dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar, &limits) == AD7708_ERROR);
+    limits.maxAge = 0; // Never expires
+    CHECK(ad7708_calstore_restore(&table, &dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar, &limits) == AD7708_OK);
+
+    // Stamps that wrapped still count the right age
+    table.entries[0].stamp = 0xFFFFFF00UL;
+    limits.maxAge = 3600;
+    limits.stamp = 0x00000100UL;
+    CHECK(ad7708_calstore_restore(&table, &dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar, &limits) == AD7708_OK);
+}
+
+int main(void)
+{
+    ad7708_calstore_backend backend;
+    int fd = mkstemp(path);
+
+    CHECK(fd >= 0);
+    if (fd < 0) { return TEST_RESULT(); }
+    close(fd);
+    ad7708_calstore_fileBackend(&backend, path);
+
+    testRoundTrip(&backend);
+    testCorruption(&backend);
+    testLimits();
+
+    unlink(path);
+
+    return TEST_RESULT();
+}
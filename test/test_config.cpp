@@ -0,0 +1,71 @@
+/*
+ * ad7708_config.hpp, built as C++11.
+ *
+ * The valid configurations are checked at compile time and the init frame
+ * is sent to the simulator. Built with -DAD7708_CONFIG_REJECT=n the file
+ * instead instantiates the n-th invalid configuration, which must stop at
+ * its static_assert; CMakeLists.txt runs those as compile-only tests.
+ */
+#include "ad7708_config.hpp"
+#include "ad7708_sim.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+using Thermo = ad7708::Config<ad7708::Layout::Ch10, 0x45, true>;
+using Fast = ad7708::Config<ad7708::Layout::Ch8, 0x03, false, 1, false, false, AD7708_IOPIN_Output, AD7708_IOPIN_Input>;
+
+#if !defined(AD7708_CONFIG_REJECT)
+
+static_assert(ad7708::channelCode(ad7708::Layout::Ch8, ad7708::Input::AIN3) == 0x02, "AIN1..AIN8 map 1:1");
+static_assert(ad7708::channelCode(ad7708::Layout::Ch10, ad7708::Input::AIN9) == 0x0E, "AIN9 in the 10 channel layout");
+static_assert(ad7708::channelCode(ad7708::Layout::Ch8, ad7708::Input::AIN9) == ad7708::kNoChannel, "AIN9 needs 10 channels");
+static_assert(ad7708::channelCode(ad7708::Layout::Ch10, ad7708::Input::REFIN) == ad7708::kNoChannel, "REFIN needs 8 channels");
+static_assert(Thermo::mode(AD7708_ContinuousConversion) == (0x80 | 0x10 | AD7708_ContinuousConversion), "CHOP and CHCON bits");
+static_assert(Fast::mode(AD7708_Idle) == (0x20 | AD7708_Idle), "REFSEL bit");
+static_assert(Fast::ioControl == 0x10, "P1 output");
+static_assert(Fast::outputRateMilliHz == 1365333UL, "f_MOD / (8 * 3)");
+static_assert(Thermo::control<ad7708::Input::AIN9, AD7708_Range_20mV, AD7708_Bipolar>() == 0xE0, "Control byte");
+
+int main()
+{
+    ad7708_sim sim;
+    int failures = 0;
+
+    ad7708_sim_init(&sim);
+    ad7708::Device<Thermo, ad7708::Input::AIN9, AD7708_Range_20mV, AD7708_Unipolar> tc(&ad7708_simTransport, &sim);
+
+    if (tc.init() != AD7708_OK || sim.filter != 0x45 || sim.control != 0xE8 || sim.mode != Thermo::mode(AD7708_Idle) || sim.csCycles != 1)
+    {
+        std::printf("init frame not applied\n");
+        failures++;
+    }
+    if (tc.select<ad7708::Input::AIN1_AIN2, AD7708_Range_2p56V, AD7708_Bipolar>() != AD7708_OK || sim.control != 0x87)
+    {
+        std::printf("select not applied\n");
+        failures++;
+    }
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#elif AD7708_CONFIG_REJECT == 1
+// SF word below the minimum for this chop setting
+template struct ad7708::Config<ad7708::Layout::Ch8, 0x0C, true>;
+#elif AD7708_CONFIG_REJECT == 2
+// RefSel is 0 (REFIN1) or 1 (REFIN2)
+template struct ad7708::Config<ad7708::Layout::Ch8, 0x45, false, 2>;
+#elif AD7708_CONFIG_REJECT == 3
+// REFIN2 shares pins with AIN9/AIN10 in the 10 channel layout
+template struct ad7708::Config<ad7708::Layout::Ch10, 0x45, false, 1>;
+#elif AD7708_CONFIG_REJECT == 4
+// Pin directions are AD7708_IOPIN_Input or AD7708_IOPIN_Output
+template struct ad7708::Config<ad7708::Layout::Ch8, 0x45, false, 0, false, false, 2>;
+#elif AD7708_CONFIG_REJECT == 5
+// Input not available with this channel layout
+constexpr uint8_t kControl = Fast::control<ad7708::Input::AIN9, AD7708_Range_20mV, AD7708_Bipolar>();
+#elif AD7708_CONFIG_REJECT == 6
+// Input not available with this channel layout
+ad7708::Device<Thermo, ad7708::Input::REFIN, AD7708_Range_20mV, AD7708_Bipolar>* device;
+int touch() { return device->init(); }
+#endif
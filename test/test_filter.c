@@ -0,0 +1,211 @@
+/*
+ * CIC stage of ad7708_filter on long full-scale runs.
+ *
+ * The order 3 integrators pass 2^63 after ~19000 full-scale samples. The
+ * output must still match a reference built from three boxcars of length
+ * decim at the input rate, whose sums stay small, for millions of samples.
+ * Tags must survive: the mux address of a filtered channel and every field
+ * of samples of channels without a chain. Inputs of one channel code behind
+ * different mux addresses keep apart chains, and every output carries the
+ * scale of its own inputs and their clamp flag.
+ */
+#include "ad7708_filter.h"
+#include "test.h"
+
+#include <string.h>
+
+#define DECIM 256U
+#define ORDER 3U
+#define SAMPLES 4000000UL
+
+typedef struct
+{
+    int64_t sum[ORDER];
+    int64_t hist[ORDER][DECIM];
+    uint32_t pos;
+} reference;
+
+/*!
+ * @brief One input of the boxcar cascade, returns the output of the last stage
+ */
+static int64_t referenceStep(reference* ref, int64_t x)
+{
+    for (uint8_t k = 0; k < ORDER; k++)
+    {
+        ref->sum[k] += x - ref->hist[k][ref->pos];
+        ref->hist[k][ref->pos] = x;
+        x = ref->sum[k];
+    }
+    ref->pos = (ref->pos + 1) % DECIM;
+
+    return x;
+}
+
+/*!
+ * @brief Input code for sample i: long runs at either rail, then random codes
+ */
+static uint16_t inputCode(uint32_t i, uint32_t* rng)
+{
+    uint32_t segment = i / 500000UL;
+
+    if (segment % 3 == 0) { return 0xFFFFU; }
+    if (segment % 3 == 1) { return 0x0000U; }
+    *rng = *rng * 1664525UL + 1013904223UL;
+    return (*rng >> 24) & 1U ? (uint16_t)(*rng >> 8) : (uint16_t)((*rng >> 9) & 1U ? 0xFFFFU : 0x0000U);
+}
+
+static void run(uint8_t flags)
+{
+    static ad7708_filter f;
+    static reference ref;
+    ad7708_filter_stage cic;
+    ad7708_sample in[AD7708_FILTER_BLOCK], out[AD7708_FILTER_BLOCK];
+    int32_t zero = (flags & AD7708_SAMPLE_UNIPOLAR) ? 0 : 32768;
+    int64_t gain = (int64_t)DECIM * DECIM * DECIM;
+    uint32_t rng = 1, outputs = 0, mismatches = 0;
+
+    memset(&ref, 0, sizeof(ref));
+    ad7708_filter_init(&f);
+    CHECK(ad7708_filter_cic(&cic, ORDER, DECIM) == AD7708_OK);
+    CHECK(ad7708_filter_addStage(&f, 1, &cic) == AD7708_OK);
+
+    for (uint32_t i = 0; i < SAMPLES; i += AD7708_FILTER_BLOCK)
+    {
+        uint32_t n;
+
+        for (uint32_t k = 0; k < AD7708_FILTER_BLOCK; k++)
+        {
+            in[k].code = inputCode(i + k, &rng);
+            in[k].channel = 1;
+            in[k].flags = flags;
+        }
+        n = ad7708_filter_process(&f, in, AD7708_FILTER_BLOCK, out);
+
+        for (uint32_t k = 0, o = 0; k < AD7708_FILTER_BLOCK; k++)
+        {
+            int64_t y = referenceStep(&ref, ((int64_t)in[k].code - zero) * 256);
+            if ((i + k) % DECIM != DECIM - 1) { continue; }
+
+            {
+                int64_t q = (y + (y < 0 ? -gain / 2 : gain / 2)) / gain;
+                int64_t code = ((q + 128) >> 8) + zero;
+                if (code < 0) { code = 0; }
+                if (code > 0xFFFF) { code = 0xFFFF; }
+
+                if (o >= n || out[o].code != code) { mismatches++; }
+                if (o < n) { CHECK(out[o].channel == 1 && out[o].flags == flags); }
+            }
+            o++;
+            outputs++;
+        }
+    }
+
+    CHECK(outputs == SAMPLES / DECIM);
+    CHECK(mismatches == 0);
+    CHECK(f.samplesIn == SAMPLES && f.samplesOut == outputs);
+    if (mismatches != 0) { printf("flags 0x%02X: %u of %u outputs differ from the reference\n", flags, mismatches, outputs); }
+
+}
+
+static void testTags(void)
+{
+    static ad7708_filter f;
+    ad7708_filter_stage cic;
+    ad7708_sample in[AD7708_FILTER_BLOCK], out[AD7708_FILTER_BLOCK];
+    uint32_t n, through = 0;
+
+    // Channel 1 behind mux address 2 is decimated by 4, channel 3 passes through
+    ad7708_filter_init(&f);
+    CHECK(ad7708_filter_cic(&cic, 1, 4) == AD7708_OK);
+    CHECK(ad7708_filter_addStage(&f, (uint8_t)(1U | 2U << AD7708_SAMPLE_MUX_SHIFT), &cic) == AD7708_OK);
+    for (uint32_t k = 0; k < AD7708_FILTER_BLOCK; k++)
+    {
+        in[k].code = (uint16_t)(30000U + 7U * k);
+        if (k % 2 == 0)
+        {
+            in[k].channel = (uint8_t)(1U | 2U << AD7708_SAMPLE_MUX_SHIFT);
+            in[k].flags = AD7708_Range_2p56V;
+        }
+        else
+        {
+            in[k].channel = (uint8_t)(3U | (k / 2U % 4U) << AD7708_SAMPLE_MUX_SHIFT);
+            in[k].flags = (uint8_t)(AD7708_Range_1p28V | ((k % 3U == 0) ? AD7708_SAMPLE_CLAMPED : 0U));
+        }
+    }
+    n = ad7708_filter_process(&f, in, AD7708_FILTER_BLOCK, out);
+    CHECK(n == AD7708_FILTER_BLOCK / 8U + AD7708_FILTER_BLOCK / 2U);
+
+    // Outputs are grouped by chain: the decimated run, then the untouched one
+    for (uint32_t o = 0; o < n; o++)
+    {
+        if (o < AD7708_FILTER_BLOCK / 8U)
+        {
+            CHECK(out[o].channel == (uint8_t)(1U | 2U << AD7708_SAMPLE_MUX_SHIFT));
+            CHECK(out[o].flags == AD7708_Range_2p56V);
+        }
+        else
+        {
+            const ad7708_sample* s = &in[2U * through++ + 1U];
+            CHECK(out[o].code == s->code && out[o].channel == s->channel && out[o].flags == s->flags);
+        }
+    }
+    CHECK(through == AD7708_FILTER_BLOCK / 2U);
+}
+
+static void testMux(void)
+{
+    static ad7708_filter f;
+    static const uint8_t flags[3] = { AD7708_Range_2p56V, AD7708_Range_1p28V | AD7708_SAMPLE_UNIPOLAR, AD7708_Range_20mV };
+    static const uint16_t level[3] = { 20000U, 50000U, 40000U };
+    ad7708_filter_stage cic;
+    ad7708_sample in[AD7708_FILTER_BLOCK], out[AD7708_FILTER_BLOCK];
+    uint32_t n, seen[3] = { 0 };
+
+    // Channel 2 behind mux addresses 0 and 1 gets two boxcars of 4, behind address 2 it has no chain
+    ad7708_filter_init(&f);
+    CHECK(ad7708_filter_cic(&cic, 1, 4) == AD7708_OK);
+    CHECK(ad7708_filter_addStage(&f, 2, &cic) == AD7708_OK);
+    CHECK(ad7708_filter_addStage(&f, (uint8_t)(2U | 1U << AD7708_SAMPLE_MUX_SHIFT), &cic) == AD7708_OK);
+    CHECK(f.chains == 2);
+    CHECK(ad7708_filter_addStage(&f, 64, &cic) == AD7708_ERROR);
+
+    // Two passes: the clamp on the third input of address 1 flags its first output only
+    for (uint8_t pass = 0; pass < 2; pass++)
+    {
+        for (uint32_t k = 0; k < 24U; k++)
+        {
+            uint8_t mux = (uint8_t)(k % 3U);
+
+            in[k].code = level[mux];
+            in[k].channel = (uint8_t)(2U | mux << AD7708_SAMPLE_MUX_SHIFT);
+            in[k].flags = flags[mux];
+            if (pass == 0 && k == 7U) { in[k].flags |= AD7708_SAMPLE_CLAMPED; }
+        }
+        n = ad7708_filter_process(&f, in, 24U, out);
+        CHECK(n == 2U + 2U + 8U);
+
+        for (uint32_t o = 0; o < n; o++)
+        {
+            uint8_t mux = (uint8_t)((out[o].channel >> AD7708_SAMPLE_MUX_SHIFT) & 0x03U);
+            uint8_t clamped = pass == 0 && mux == 1U && seen[1] == 0U ? AD7708_SAMPLE_CLAMPED : 0U;
+
+            // Neither the state nor the tag of one mux input leaks into another
+            CHECK(mux < 3U && (out[o].channel & 0x0FU) == 2U);
+            if (mux >= 3U) { continue; }
+            CHECK(out[o].code == level[mux]);
+            CHECK(out[o].flags == (uint8_t)(flags[mux] | clamped));
+            seen[mux]++;
+        }
+    }
+    CHECK(seen[0] == 4U && seen[1] == 4U && seen[2] == 16U);
+}
+
+int main(void)
+{
+    run(AD7708_Range_2p56V);
+    run(AD7708_Range_20mV | AD7708_SAMPLE_UNIPOLAR);
+    testTags();
+    testMux();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,153 @@
+/*
+ * ad7708_oversample against the simulator's conversion noise.
+ *
+ * A constant input with triangular noise of 12 LSB peak (4.9 LSB RMS) is
+ * streamed through the engine at ratios 4, 16 and 64. The spread of the
+ * results around their mean has to fall by sqrt(ratio) within 10 %, and the
+ * engine's own report has to agree with it. A group never mixes inputs of
+ * different external mux addresses.
+ */
+#include "ad7708.h"
+#include "ad7708_oversample.h"
+#include "ad7708_ring.h"
+#include "ad7708_sim.h"
+#include "ad7708_stream.h"
+#include "test.h"
+
+#include <math.h>
+#include <string.h>
+
+#define RING_SIZE 256U
+#define RESULTS 1500U
+#define INPUT_V 0.3
+
+typedef struct
+{
+    ad7708_sim sim;
+    ad7708_dev dev;
+    ad7708_ring ring;
+    ad7708_sample storage[RING_SIZE];
+    ad7708_stream stream;
+    ad7708_oversample os;
+} test_ctx;
+
+static void onRdy(void* arg) { ad7708_stream_onRdy((ad7708_stream*)arg); }
+static void onDma(void* arg) { ad7708_stream_dmaComplete((ad7708_stream*)arg); }
+
+static double constant(void* arg, uint8_t channel, uint64_t timeNs)
+{
+    (void)arg;
+    (void)channel;
+    (void)timeNs;
+    return INPUT_V;
+}
+
+/*!
+ * @brief Stream until RESULTS results of the given ratio came out
+ * @return RMS deviation of the results from their mean, LSB
+ */
+static double runRatio(test_ctx* ctx, uint16_t ratio)
+{
+    static ad7708_oversample_result out[RING_SIZE];
+    double sum = 0.0, sumSq = 0.0;
+    uint32_t results = 0;
+
+    memset(ctx, 0, sizeof(*ctx));
+    ad7708_sim_init(&ctx->sim);
+    ad7708_sim_attach(&ctx->sim, &ctx->dev);
+    ctx->sim.input = constant;
+    ctx->sim.noiseCodes = 12.0;
+    ad7708_init(&ctx->dev);
+    ad7708_sfRateConfig(&ctx->dev, 3);
+    ad7708_channelConfig(&ctx->dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar);
+    ad7708_ring_init(&ctx->ring, ctx->storage, RING_SIZE);
+    ctx->sim.onRdy = onRdy;
+    ctx->sim.rdyArg = &ctx->stream;
+    ctx->sim.onDmaDone = onDma;
+    ctx->sim.dmaArg = &ctx->stream;
+
+    ad7708_oversample_init(&ctx->os);
+    CHECK(ad7708_oversample_setRatio(&ctx->os, AD7708_Channel_1, ratio) == AD7708_OK);
+    CHECK(ad7708_stream_start(&ctx->stream, &ctx->dev, &ctx->ring) == AD7708_OK);
+
+    while (results < RESULTS)
+    {
+        uint32_t n;
+
+        ad7708_sim_advance(&ctx->sim, ad7708_sim_nextEvent(&ctx->sim) - ctx->sim.nowNs);
+        n = ad7708_oversample_drain(&ctx->os, &ctx->ring, out, RING_SIZE);
+        for (uint32_t i = 0; i < n && results < RESULTS; i++, results++)
+        {
+            double v = (double)out[i].value / (double)(1 << AD7708_OVERSAMPLE_FRAC);
+
+            CHECK(out[i].channel == AD7708_Channel_1);
+            sum += v;
+            sumSq += v * v;
+        }
+    }
+    ad7708_stream_stop(&ctx->stream);
+    CHECK(ctx->stream.fullOverruns == 0 && ctx->stream.errors == 0);
+
+    // The mean stays on the input, averaging only removes noise
+    sum /= RESULTS;
+    CHECK(fabs(sum - INPUT_V / 2.56 * 32768.0) < 1.0);
+
+    return sqrt(sumSq / RESULTS - sum * sum);
+}
+
+static void testNoiseReduction(test_ctx* ctx)
+{
+    static const uint16_t ratios[] = {4, 16, 64};
+    double raw = 12.0 / sqrt(6.0); // RMS of the triangular noise, quantization adds 1/12 LSB^2
+    ad7708_oversample_report report;
+
+    raw = sqrt(raw * raw + 1.0 / 12.0);
+    for (uint32_t i = 0; i < sizeof(ratios) / sizeof(ratios[0]); i++)
+    {
+        double std = runRatio(ctx, ratios[i]);
+        double gain = raw / std;
+        double ideal = sqrt((double)ratios[i]);
+
+        printf("ratio %2u: %.3f LSB RMS, reduction %.2f, ideal %.2f\n", ratios[i], std, gain, ideal);
+        CHECK(gain > ideal * 0.9 && gain < ideal * 1.1);
+
+        CHECK(ad7708_oversample_getReport(&ctx->os, AD7708_Channel_1, &report) == AD7708_OK);
+        CHECK(report.idealX100 == (uint32_t)(ideal * 100.0 + 0.5));
+        CHECK(fabs(report.noiseRawX100 / 100.0 - raw) < raw * 0.1);
+        CHECK(report.reductionX100 > report.idealX100 * 9U / 10U && report.reductionX100 < report.idealX100 * 11U / 10U);
+        CHECK(report.bits == 16U + (i + 1U));
+    }
+}
+
+static void testMux(void)
+{
+    static const uint8_t mux[10] = { 1, 1, 1, 1, 2, 2, 3, 3, 3, 3 };
+    ad7708_oversample os;
+    ad7708_sample in[10];
+    ad7708_oversample_result out[10];
+
+    ad7708_oversample_init(&os);
+    CHECK(ad7708_oversample_setRatio(&os, AD7708_Channel_3, 4) == AD7708_OK);
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        in[i].code = (uint16_t)(32768U + 100U * mux[i]);
+        in[i].channel = (uint8_t)(AD7708_Channel_3 | mux[i] << AD7708_SAMPLE_MUX_SHIFT);
+        in[i].flags = AD7708_Range_2p56V;
+    }
+
+    // The two address 2 conversions are dropped rather than averaged with address 3
+    CHECK(ad7708_oversample_process(&os, in, 10, out) == 2);
+    CHECK(out[0].channel == in[0].channel && out[0].value == 100 << AD7708_OVERSAMPLE_FRAC);
+    CHECK(out[1].channel == in[9].channel && out[1].value == 300 << AD7708_OVERSAMPLE_FRAC);
+    CHECK(os.ch[AD7708_Channel_3].dropped == 1);
+}
+
+int main(void)
+{
+    static test_ctx ctx;
+
+    testNoiseReduction(&ctx);
+    testMux();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,188 @@
+/*
+ * ad7708_poll against the simulator, which reports the true time of every
+ * RDY edge.
+ *
+ * The MCU sleeps for ad7708_poll_dueIn() between polls. Every result is read
+ * within period / div of its edge plus one frame, the stamp pushed with it
+ * is the edge to within a retry step, and an edge that jumps either way is
+ * found again within a few cycles: a late one by the misses it causes, an
+ * early one by the probes. Most results cost a single 5 byte frame.
+ */
+#include "ad7708.h"
+#include "ad7708_plan.h"
+#include "ad7708_poll.h"
+#include "ad7708_sim.h"
+#include "test.h"
+
+#include <string.h>
+
+#define RING_SIZE 64U
+#define MARGIN_US 20U // One 5 byte frame and the us truncation of the clocks
+
+typedef struct
+{
+    ad7708_sim sim;
+    ad7708_dev dev;
+    ad7708_ring ring;
+    ad7708_sample storage[RING_SIZE];
+    uint32_t stamps[RING_SIZE];
+    ad7708_poll poll;
+    uint64_t edgeNs; // Last RDY edge of the sim
+
+    /* What the samples of the last run showed */
+    uint32_t samples;
+    uint32_t latencyMaxUs; // True edge to read
+    uint32_t stampErrMaxUs;
+    uint32_t bytes;
+} test_ctx;
+
+static void onRdy(void* arg)
+{
+    test_ctx* ctx = (test_ctx*)arg;
+    ctx->edgeNs = ctx->sim.nowNs;
+}
+
+static void setup(test_ctx* ctx, uint8_t sf, uint8_t chop)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ad7708_sim_init(&ctx->sim);
+    ad7708_sim_attach(&ctx->sim, &ctx->dev);
+    ctx->sim.onRdy = onRdy;
+    ctx->sim.rdyArg = ctx;
+    ctx->sim.ain[AD7708_Channel_2] = 0.005;
+    CHECK(ad7708_init(&ctx->dev) == AD7708_OK);
+    CHECK(ad7708_modeConfig(&ctx->dev, AD7708_Idle, AD7708_CHCON, AD7708_REFSEL, chop, AD7708_NEGBUF, 0) == AD7708_OK);
+    CHECK(ad7708_sfRateConfig(&ctx->dev, sf) == AD7708_OK);
+    ad7708_ring_init(&ctx->ring, ctx->storage, RING_SIZE);
+    ad7708_ring_setStamps(&ctx->ring, ctx->stamps);
+    CHECK(ad7708_poll_start(&ctx->poll, &ctx->dev, &ctx->ring, 0) == AD7708_OK);
+}
+
+/*!
+ * @brief Sleep and poll until n more samples were read
+ */
+static void run(test_ctx* ctx, uint32_t n)
+{
+    ad7708_sample out[RING_SIZE];
+    uint32_t stamps[RING_SIZE];
+    uint32_t bytes = ctx->sim.bytes;
+
+    ctx->samples = 0;
+    ctx->latencyMaxUs = 0;
+    ctx->stampErrMaxUs = 0;
+
+    while (ctx->samples < n)
+    {
+        uint32_t latency;
+        int32_t err;
+
+        ad7708_sim_advance(&ctx->sim, (uint64_t)ad7708_poll_dueIn(&ctx->poll) * 1000U);
+        if (ad7708_poll_service(&ctx->poll) != AD7708_OK) { continue; }
+
+        // Exactly one sample per successful poll, stamped with the edge of the result just read
+        CHECK(ad7708_ring_popStamped(&ctx->ring, out, stamps, RING_SIZE) == 1);
+        latency = (uint32_t)((ctx->sim.nowNs - ctx->edgeNs) / 1000U);
+        err = (int32_t)(stamps[0] - (uint32_t)(ctx->edgeNs / 1000U));
+        if (err < 0) { err = -err; }
+        if (latency > ctx->latencyMaxUs) { ctx->latencyMaxUs = latency; }
+        if ((uint32_t)err > ctx->stampErrMaxUs) { ctx->stampErrMaxUs = (uint32_t)err; }
+        ctx->samples++;
+    }
+    ctx->bytes = ctx->sim.bytes - bytes;
+}
+
+static void testBytesPerSample(test_ctx* ctx)
+{
+    static const struct
+    {
+        uint8_t sf;
+        uint8_t chop;
+    } settings[] = { { 3, 0 }, { 45, 0 }, { 255, 0 }, { 13, 1 }, { 69, 1 } };
+
+    for (uint8_t i = 0; i < sizeof(settings) / sizeof(settings[0]); i++)
+    {
+        ad7708_poll* p = &ctx->poll;
+
+        setup(ctx, settings[i].sf, settings[i].chop);
+        CHECK(p->periodUs == ad7708_sim_periodNs(&ctx->sim) / 1000U);
+        run(ctx, 8); // Past the settling time of the start
+        p->latencyMaxUs = 0;
+        run(ctx, 200);
+
+        // One 5 byte frame per result, a 2 byte miss per probe and little else
+        CHECK(ctx->bytes <= 200U * 5U + 2U * (200U / AD7708_POLL_PROBE + 2U) + 2U * 8U);
+        CHECK(ctx->latencyMaxUs <= p->stepUs + MARGIN_US);
+        CHECK(p->latencyMaxUs <= p->stepUs + MARGIN_US);
+        CHECK(ctx->stampErrMaxUs <= p->stepUs);
+        CHECK(p->fullOverruns == 0 && p->errors == 0 && ctx->sim.overruns == 0);
+
+        printf("sf %3u chop %u: period %6u us, %.2f bytes/sample, latency max %u us (step %u us)\n", settings[i].sf, settings[i].chop,
+            p->periodUs, ctx->bytes / 200.0, ctx->latencyMaxUs, p->stepUs);
+    }
+}
+
+static void testEdgeJumps(test_ctx* ctx)
+{
+    ad7708_poll* p;
+    uint64_t shiftNs;
+
+    setup(ctx, 3, 0);
+    p = &ctx->poll;
+    run(ctx, 40);
+    shiftNs = ad7708_sim_periodNs(&ctx->sim) / 3U;
+
+    // Edges move later: the next poll misses and the estimate follows at once
+    ctx->sim.readyAtNs += shiftNs;
+    run(ctx, 2);
+    run(ctx, 20);
+    CHECK(ctx->latencyMaxUs <= p->stepUs + MARGIN_US && ctx->stampErrMaxUs <= p->stepUs);
+
+    // Edges move earlier: reads stay on time, the stamps are late until the probes walk the estimate back
+    ctx->sim.readyAtNs -= 2U * shiftNs;
+    run(ctx, AD7708_POLL_PROBE + (uint32_t)(shiftNs / 1000U / (p->stepUs * 3U / 4U)) + 2U);
+    run(ctx, 20);
+    CHECK(ctx->latencyMaxUs <= p->stepUs + MARGIN_US && ctx->stampErrMaxUs <= p->stepUs);
+
+    // A main loop that was busy for a while: the first read is late, then the edge is found again
+    ad7708_sim_advance(&ctx->sim, 10U * ad7708_sim_periodNs(&ctx->sim) + shiftNs);
+    run(ctx, 3);
+    run(ctx, 20);
+    CHECK(ctx->latencyMaxUs <= p->stepUs + MARGIN_US && ctx->stampErrMaxUs <= p->stepUs);
+    CHECK(p->errors == 0 && p->fullOverruns == 0);
+}
+
+static void testRestart(test_ctx* ctx)
+{
+    ad7708_poll* p;
+
+    setup(ctx, 45, 0);
+    p = &ctx->poll;
+    run(ctx, 20);
+
+    // Stopped, the part keeps converting and nothing is read
+    ad7708_poll_stop(p);
+    CHECK(ad7708_poll_service(p) == AD7708_ERROR);
+    ad7708_sim_advance(&ctx->sim, 50000000ULL);
+    CHECK(ad7708_poll_service(p) == AD7708_ERROR && ad7708_ring_count(&ctx->ring) == 0);
+
+    // A restart times polls from the new start, not from the edges before the stop
+    CHECK(ad7708_poll_start(p, &ctx->dev, &ctx->ring, 0) == AD7708_OK);
+    CHECK(p->samples == 0 && p->running == 1);
+    run(ctx, 4);
+    p->latencyMaxUs = 0;
+    run(ctx, 50);
+    CHECK(ctx->latencyMaxUs <= p->stepUs + MARGIN_US && ctx->stampErrMaxUs <= p->stepUs);
+    CHECK(p->latencyMaxUs <= p->stepUs + MARGIN_US);
+    CHECK(p->errors == 0 && p->samples == 54);
+}
+
+int main(void)
+{
+    static test_ctx ctx;
+
+    testBytesPerSample(&ctx);
+    testEdgeJumps(&ctx);
+    testRestart(&ctx);
+
+    return TEST_RESULT();
+}
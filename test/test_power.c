@@ -0,0 +1,217 @@
+/*
+ * ad7708_power against the simulator, with the oscillator kept running and
+ * stopped in power-down.
+ *
+ * The MCU sleeps for ad7708_power_dueIn() between steps, so every SPI byte
+ * the sim sees belongs to a step the scheduler chose to take. The part must
+ * be powered down whenever the scheduler sleeps between scans, scans must
+ * start on the interval grid, and the cost each scan reports must agree with
+ * what the sim counted on its side of the bus.
+ */
+#include "ad7708.h"
+#include "ad7708_power.h"
+#include "ad7708_sim.h"
+#include "test.h"
+
+#include <math.h>
+#include <string.h>
+
+#define RING_SIZE 64U
+#define SF 3U
+#define INTERVAL_MS 1000U
+#define OSC_START_NS 300000000U
+
+typedef struct
+{
+    ad7708_sim sim;
+    ad7708_dev dev;
+    ad7708_ring ring;
+    ad7708_sample storage[RING_SIZE];
+    uint32_t stamps[RING_SIZE];
+    ad7708_power power;
+
+    /* Sim counters at the start of the scan in progress */
+    uint32_t bytesAt;
+    uint32_t csAt;
+    uint64_t activeNsAt;
+
+    /* What the scans of the last run showed */
+    uint32_t locking;    // Steps taken in AD7708_POWER_LOCKING
+    uint32_t awakeSleep; // Sleeps with the part not powered down
+    uint32_t offGrid;    // Scans not starting on the interval grid
+    uint32_t costOff;    // Scans whose reported cost disagrees with the sim
+    uint32_t badSamples;
+} test_ctx;
+
+static const ad7708_scan_entry entries[2] = {
+    { AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar, 0, 0 },
+    { AD7708_Channel_3, AD7708_Range_2p56V, AD7708_Bipolar, 1, 0 }, // One settling conversion thrown away
+};
+
+static void setup(test_ctx* ctx, uint8_t oscOff)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ad7708_sim_init(&ctx->sim);
+    ad7708_sim_attach(&ctx->sim, &ctx->dev);
+    ctx->sim.oscStartNs = OSC_START_NS;
+    ctx->sim.ain[AD7708_Channel_1] = 1.0;
+    ctx->sim.ain[AD7708_Channel_3] = -0.5;
+    CHECK(ad7708_init(&ctx->dev) == AD7708_OK);
+    CHECK(ad7708_modeConfig(&ctx->dev, AD7708_Idle, AD7708_CHCON, AD7708_REFSEL, 0, AD7708_NEGBUF, 0) == AD7708_OK);
+    CHECK(ad7708_sfRateConfig(&ctx->dev, SF) == AD7708_OK);
+    ad7708_ring_init(&ctx->ring, ctx->storage, RING_SIZE);
+    ad7708_ring_setStamps(&ctx->ring, ctx->stamps);
+
+    CHECK(ad7708_power_start(&ctx->power, &ctx->dev, entries, 2, &ctx->ring, INTERVAL_MS, oscOff) == AD7708_OK);
+    CHECK((ctx->sim.mode & 0x07U) == AD7708_PowerDown);
+    CHECK(((ctx->sim.mode >> 3) & 0x01U) == oscOff);
+}
+
+static void checkSamples(test_ctx* ctx)
+{
+    ad7708_sample out[RING_SIZE];
+    uint32_t n = ad7708_ring_pop(&ctx->ring, out, RING_SIZE);
+
+    // Exactly one result per entry, the discarded conversion never reaches the ring
+    if (n != 2) { ctx->badSamples++; }
+    for (uint32_t i = 0; i < n && i < 2; i++)
+    {
+        double volts = ((int32_t)out[i].code - 32768) / 32768.0 * 2.56;
+
+        if (out[i].channel != entries[i].channel || (out[i].flags & AD7708_SAMPLE_RANGE_MASK) != entries[i].range) { ctx->badSamples++; }
+        if (fabs(volts - ctx->sim.ain[entries[i].channel]) > 0.01) { ctx->badSamples++; }
+    }
+}
+
+/*!
+ * @brief Sleep and service until the given number of scans has ended
+ * @return Status of the last completed scan
+ */
+static StatusTypeDef run(test_ctx* ctx, uint32_t scans)
+{
+    ad7708_power* p = &ctx->power;
+    uint32_t end = p->scans + scans;
+    StatusTypeDef result = AD7708_OK;
+
+    ctx->locking = 0;
+    ctx->awakeSleep = 0;
+    ctx->offGrid = 0;
+    ctx->costOff = 0;
+    ctx->badSamples = 0;
+
+    while (p->scans < end)
+    {
+        AD7708_PowerState state = p->state;
+        uint32_t startUs = p->scanStartUs;
+        StatusTypeDef status;
+
+        ad7708_sim_advance(&ctx->sim, (uint64_t)ad7708_power_dueIn(p) * 1000U);
+        if (state == AD7708_POWER_SLEEP)
+        {
+            ctx->bytesAt = ctx->sim.bytes;
+            ctx->csAt = ctx->sim.csCycles;
+            ctx->activeNsAt = ctx->sim.activeNs;
+        }
+        if (state == AD7708_POWER_LOCKING) { ctx->locking++; }
+
+        status = ad7708_power_service(p);
+        if (state == AD7708_POWER_SLEEP && p->scans != 0 && p->scanStartUs - startUs != p->intervalUs) { ctx->offGrid++; }
+        if (status == AD7708_BUSY) { continue; }
+
+        // A scan ended: the part is down again and the report matches the sim's side
+        result = status;
+        if ((ctx->sim.mode & 0x07U) != AD7708_PowerDown || ((ctx->sim.mode >> 3) & 0x01U) != p->oscOff) { ctx->awakeSleep++; }
+        if (p->last.spiBytes != ctx->sim.bytes - ctx->bytesAt || p->last.csCycles != ctx->sim.csCycles - ctx->csAt) { ctx->costOff++; }
+        if (fabs((double)p->last.activeUs - (double)(ctx->sim.activeNs - ctx->activeNsAt) / 1000.0) > 20.0) { ctx->costOff++; }
+        if (status == AD7708_OK) { checkSamples(ctx); }
+    }
+
+    return result;
+}
+
+static void testOscRunning(test_ctx* ctx)
+{
+    ad7708_power* p = &ctx->power;
+    uint32_t wakeups;
+
+    setup(ctx, 0);
+    wakeups = ctx->sim.wakeups;
+    CHECK(run(ctx, 5) == AD7708_OK);
+
+    // Straight into the first conversion, no lock wait and no early polls
+    CHECK(ctx->locking == 0 && p->last.lockUs == 0);
+    CHECK(p->last.conversions == 3 && p->last.polls == 0);
+    CHECK(p->samples == 10 && p->errors == 0 && ctx->badSamples == 0);
+    CHECK(ctx->awakeSleep == 0 && ctx->offGrid == 0 && ctx->costOff == 0);
+    CHECK(ctx->sim.wakeups - wakeups == 5);
+    CHECK(p->last.activeUs < 3U * (p->convUs + 100U));
+    CHECK(p->last.spiBytes > 0 && p->last.csCycles > 0);
+
+    printf("oscillator running: %u us, %u bytes, %u frames per scan\n", p->last.activeUs, p->last.spiBytes, p->last.csCycles);
+}
+
+static void testOscStopped(test_ctx* ctx)
+{
+    ad7708_power* p = &ctx->power;
+    uint32_t firstPolls, firstActiveUs;
+
+    setup(ctx, 1);
+
+    // The first scan polls for LOCK from early on and learns how long it takes
+    CHECK(run(ctx, 1) == AD7708_OK);
+    CHECK(ctx->locking > 100);
+    CHECK(p->last.lockUs >= OSC_START_NS / 1000U && p->last.lockUs <= OSC_START_NS / 1000U + AD7708_POWER_LOCK_POLL_US);
+    CHECK(p->lockEstUs == p->last.lockUs - AD7708_POWER_LOCK_POLL_US);
+    firstPolls = p->last.polls;
+    firstActiveUs = p->last.activeUs;
+
+    // Later scans poll just before the learnt time
+    CHECK(run(ctx, 4) == AD7708_OK);
+    CHECK(ctx->locking <= 2U * 4U);
+    CHECK(p->last.polls <= 1 && p->last.polls < firstPolls);
+    CHECK(p->last.lockUs >= OSC_START_NS / 1000U && p->last.lockUs <= OSC_START_NS / 1000U + AD7708_POWER_LOCK_POLL_US);
+    CHECK(p->last.activeUs >= p->last.lockUs + 3U * p->convUs && p->last.activeUs <= firstActiveUs);
+    CHECK(p->last.conversions == 3 && p->samples == 10 && p->errors == 0 && ctx->badSamples == 0);
+    CHECK(ctx->awakeSleep == 0 && ctx->offGrid == 0 && ctx->costOff == 0);
+
+    printf("oscillator stopped: %u us (lock %u us), %u bytes, %u frames per scan, first scan %u polls\n", p->last.activeUs,
+        p->last.lockUs, p->last.spiBytes, p->last.csCycles, firstPolls);
+}
+
+static void testLockTimeout(test_ctx* ctx)
+{
+    ad7708_power* p = &ctx->power;
+    uint32_t startUs;
+
+    // The oscillator never starts within the limit: the scan gives up and the part goes back down
+    setup(ctx, 1);
+    ctx->sim.oscStartNs = AD7708_POWER_LOCK_TIMEOUT_US * 1000U + 500000000U;
+    CHECK(run(ctx, 1) == AD7708_TIMEOUT);
+    CHECK(p->lockTimeouts == 1 && p->errors == 1 && p->samples == 0);
+    CHECK(p->last.conversions == 0 && p->last.activeUs >= AD7708_POWER_LOCK_TIMEOUT_US);
+    CHECK(ctx->awakeSleep == 0 && ctx->costOff == 0);
+    CHECK(ad7708_ring_count(&ctx->ring) == 0);
+
+    // It overran its slot, so the next scan starts at once and succeeds with a working oscillator
+    CHECK(ad7708_power_dueIn(p) == 0);
+    ctx->sim.oscStartNs = OSC_START_NS;
+    startUs = ad7708_nowUs(&ctx->dev);
+    CHECK(run(ctx, 1) == AD7708_OK);
+    CHECK(p->scanStartUs == startUs && p->lockTimeouts == 1 && p->samples == 2 && ctx->badSamples == 0);
+
+    // Stopped, it stays down and refuses to run
+    CHECK(ad7708_power_stop(p) == AD7708_OK);
+    CHECK((ctx->sim.mode & 0x07U) == AD7708_PowerDown);
+    CHECK(ad7708_power_service(p) == AD7708_ERROR);
+}
+
+int main(void)
+{
+    static test_ctx ctx;
+
+    testOscRunning(&ctx);
+    testOscStopped(&ctx);
+    testLockTimeout(&ctx);
+
+    return TEST_RESULT();
+}
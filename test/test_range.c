@@ -0,0 +1,335 @@
+/*
+ * ad7708_range driven through ad7708_poll against the simulator.
+ *
+ * The input is a ramp or a series of steps on one channel. Every sample is
+ * decoded with the range in its tag and compared with the input at its
+ * stamp, so a result tagged with the wrong range is off by a factor of two
+ * and shows. The calibration table holds a different pair for every range,
+ * so the pair the part ends up with tells which one was restored.
+ */
+#include "ad7708.h"
+#include "ad7708_calstore.h"
+#include "ad7708_poll.h"
+#include "ad7708_range.h"
+#include "ad7708_sim.h"
+#include "test.h"
+
+#include <math.h>
+#include <string.h>
+
+#define RING_SIZE 256U
+#define SF 3U
+#define TEMP_C10 250
+
+typedef struct
+{
+    double from;      // Input before atNs
+    double to;        // Final input
+    uint64_t atNs;
+    double voltsPerS; // 0: step
+} test_wave;
+
+typedef struct
+{
+    ad7708_sim sim;
+    ad7708_dev dev;
+    ad7708_ring ring;
+    ad7708_sample storage[RING_SIZE];
+    uint32_t stamps[RING_SIZE];
+    ad7708_calstore table;
+    ad7708_ranger ranger;
+    ad7708_poll poll;
+    test_wave wave;
+
+    /* What the samples of the last run showed */
+    uint32_t perRange[8];
+    uint32_t clamped;
+    uint32_t mistagged;
+    uint32_t descents; // Samples tagged with a lower range than the one before
+    uint8_t lastRange;
+    uint8_t maxRange;
+} test_ctx;
+
+static double waveAt(const test_wave* w, uint64_t timeNs)
+{
+    double v;
+
+    if (timeNs < w->atNs) { return w->from; }
+    if (w->voltsPerS == 0.0) { return w->to; }
+
+    v = w->from + w->voltsPerS * (double)(timeNs - w->atNs) * 1e-9;
+    return (w->voltsPerS > 0.0) ? fmin(v, w->to) : fmax(v, w->to);
+}
+
+static double input(void* arg, uint8_t channel, uint64_t timeNs)
+{
+    (void)channel;
+    return waveAt(&((test_ctx*)arg)->wave, timeNs);
+}
+
+static double fullScale(uint8_t range) { return 0.020 * (double)(1U << range); }
+
+static void setup(test_ctx* ctx, AD7708_Channel channel, AD7708_Range range, AD7708_Polarity polarity)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ad7708_sim_init(&ctx->sim);
+    ad7708_sim_attach(&ctx->sim, &ctx->dev);
+    CHECK(ad7708_init(&ctx->dev) == AD7708_OK);
+    CHECK(ad7708_modeConfig(&ctx->dev, AD7708_Idle, AD7708_CHCON, AD7708_REFSEL, 0, AD7708_NEGBUF, 0) == AD7708_OK);
+    CHECK(ad7708_sfRateConfig(&ctx->dev, SF) == AD7708_OK);
+
+    // A distinct pair per range, small enough not to move the decoded volts much
+    ad7708_calstore_init(&ctx->table);
+    for (uint8_t r = AD7708_Range_20mV; r <= AD7708_Range_2p56V; r++)
+    {
+        ctx->sim.offsetError = 0.0005 * (r + 1);
+        ctx->sim.gainError = 0.001 * (r + 1);
+        CHECK(ad7708_calibrateRange(&ctx->dev, channel, (AD7708_Range)r, polarity) == AD7708_OK);
+        CHECK(ad7708_calstore_capture(&ctx->table, &ctx->dev, TEMP_C10, 0) == AD7708_OK);
+    }
+    ctx->sim.offsetError = 0.0;
+    ctx->sim.gainError = 0.0;
+    ctx->sim.input = input;
+    ctx->sim.inputArg = ctx;
+
+    CHECK(ad7708_channelConfig(&ctx->dev, channel, range, polarity) == AD7708_OK);
+    ad7708_ring_init(&ctx->ring, ctx->storage, RING_SIZE);
+    ad7708_ring_setStamps(&ctx->ring, ctx->stamps);
+    ad7708_range_init(&ctx->ranger, &ctx->dev, &ctx->table, NULL);
+    CHECK(ad7708_range_enable(&ctx->ranger, channel, range, polarity) == AD7708_OK);
+    CHECK(ad7708_poll_start(&ctx->poll, &ctx->dev, &ctx->ring, 0) == AD7708_OK);
+    ad7708_poll_setRanger(&ctx->poll, &ctx->ranger);
+    ctx->lastRange = (uint8_t)range;
+}
+
+static void check(test_ctx* ctx, const ad7708_sample* s, uint32_t stampUs)
+{
+    uint8_t range = s->flags & AD7708_SAMPLE_RANGE_MASK;
+    uint64_t atNs = (uint64_t)stampUs * 1000U;
+    uint64_t guardNs = 2U * ad7708_sim_periodNs(&ctx->sim);
+    double fs = fullScale(range);
+    double volts, expected, slope;
+
+    ctx->perRange[range]++;
+    if (range < ctx->lastRange) { ctx->descents++; }
+    if (range > ctx->maxRange) { ctx->maxRange = range; }
+    ctx->lastRange = range;
+
+    if (s->flags & AD7708_SAMPLE_CLAMPED)
+    {
+        ctx->clamped++;
+        return;
+    }
+
+    // Too close to a step to know which side the conversion saw
+    if (ctx->wave.voltsPerS == 0.0 && atNs + guardNs > ctx->wave.atNs && atNs < ctx->wave.atNs + guardNs) { return; }
+
+    if (s->flags & AD7708_SAMPLE_UNIPOLAR) { volts = s->code / 65536.0 * fs; }
+    else { volts = ((int32_t)s->code - 32768) / 32768.0 * fs; }
+
+    // The stamp is the poll's edge estimate, the conversion may be up to two periods off it
+    expected = waveAt(&ctx->wave, atNs);
+    slope = fabs(ctx->wave.voltsPerS) * (double)guardNs * 1e-9;
+    if (fabs(volts - expected) > 0.03 * fs + slope) { ctx->mistagged++; }
+}
+
+static void run(test_ctx* ctx, uint64_t ns)
+{
+    uint64_t end = ctx->sim.nowNs + ns;
+    ad7708_sample out[64];
+    uint32_t stamps[64];
+    uint32_t n;
+
+    memset(ctx->perRange, 0, sizeof(ctx->perRange));
+    ctx->clamped = 0;
+    ctx->mistagged = 0;
+    ctx->descents = 0;
+    ctx->maxRange = 0;
+
+    // Sleep until each poll falls due, as a main loop with a timer would
+    while (ctx->sim.nowNs < end)
+    {
+        ad7708_sim_advance(&ctx->sim, (uint64_t)ad7708_poll_dueIn(&ctx->poll) * 1000U);
+        ad7708_poll_service(&ctx->poll);
+        while ((n = ad7708_ring_popStamped(&ctx->ring, out, stamps, 64)) != 0)
+        {
+            for (uint32_t i = 0; i < n; i++) { check(ctx, &out[i], stamps[i]); }
+        }
+    }
+}
+
+/*!
+ * @brief The part holds the pair cached for the channel's current range
+ */
+static uint8_t holdsPair(test_ctx* ctx, AD7708_Channel channel, uint8_t range, AD7708_Polarity polarity)
+{
+    const ad7708_calstore_entry* e = ad7708_calstore_find(&ctx->table, AD7708_CALSTORE_KEY(channel, range, polarity, 0));
+
+    return e != NULL && ctx->sim.offset[channel] == e->offset && ctx->sim.gain[channel] == e->gain;
+}
+
+static void testRampUp(test_ctx* ctx)
+{
+    const ad7708_range_channel* ch = &ctx->ranger.ch[AD7708_Channel_1];
+
+    // 0 to 2.2 V in 2 s: every range on the way, one step at a time, nothing clamped
+    setup(ctx, AD7708_Channel_1, AD7708_Range_20mV, AD7708_Bipolar);
+    ctx->wave = (test_wave){ 0.0, 2.2, ctx->sim.nowNs, 1.1 };
+    run(ctx, 2200000000ULL);
+
+    CHECK(ch->ups == 7 && ch->downs == 0 && ch->range == AD7708_Range_2p56V);
+    CHECK(ctx->ranger.switches == 7 && ctx->ranger.errors == 0);
+    CHECK(ctx->clamped == 0 && ch->clamps == 0);
+    CHECK(ctx->mistagged == 0 && ctx->descents == 0);
+    for (uint8_t r = 0; r < 8; r++) { CHECK(ctx->perRange[r] > 0); }
+    CHECK(ch->uncalibrated == 0);
+    CHECK(holdsPair(ctx, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar));
+
+    printf("ramp up: samples per range %u %u %u %u %u %u %u %u\n", ctx->perRange[0], ctx->perRange[1], ctx->perRange[2],
+        ctx->perRange[3], ctx->perRange[4], ctx->perRange[5], ctx->perRange[6], ctx->perRange[7]);
+}
+
+static void testHysteresis(test_ctx* ctx)
+{
+    // Each level is held long enough for several quiet windows; the expected range depends on where it came from
+    static const struct
+    {
+        double volts;
+        uint8_t range;
+        uint32_t switches;
+    } levels[] = {
+        { 0.010, AD7708_Range_20mV, 1 }, // 7 steps down in one switch
+        { 0.017, AD7708_Range_20mV, 0 }, // Below 15/16 of 20 mV
+        { 0.019, AD7708_Range_40mV, 1 },
+        { 0.017, AD7708_Range_40mV, 0 }, // Above 3/8 of 40 mV, no way back down
+        { 0.011, AD7708_Range_20mV, 1 },
+    };
+    const ad7708_range_channel* ch = &ctx->ranger.ch[AD7708_Channel_1];
+
+    setup(ctx, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar);
+    for (uint8_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++)
+    {
+        uint32_t before = ctx->ranger.switches;
+
+        ctx->wave = (test_wave){ i ? levels[i - 1].volts : levels[0].volts, levels[i].volts, ctx->sim.nowNs, 0.0 };
+        run(ctx, 200000000ULL);
+
+        CHECK(ch->range == levels[i].range);
+        CHECK(ctx->ranger.switches - before == levels[i].switches);
+        CHECK(ctx->mistagged == 0 && ctx->clamped == 0);
+        CHECK(holdsPair(ctx, AD7708_Channel_1, ch->range, AD7708_Bipolar));
+
+        // Stepping down waits for a full quiet window in the old range
+        if (i == 0) { CHECK(ctx->perRange[AD7708_Range_2p56V] == ctx->ranger.hold); }
+    }
+    CHECK(ch->ups == 1 && ch->downs == 2);
+}
+
+static void testClampToMax(test_ctx* ctx)
+{
+    const ad7708_range_channel* ch = &ctx->ranger.ch[AD7708_Channel_1];
+
+    // A step far past the largest allowed range: one switch straight to it, then clamped results
+    setup(ctx, AD7708_Channel_1, AD7708_Range_20mV, AD7708_Bipolar);
+    ctx->ranger.maxRange = AD7708_Range_640mV;
+    ctx->wave = (test_wave){ 0.005, 2.0, ctx->sim.nowNs + 50000000ULL, 0.0 };
+    run(ctx, 200000000ULL);
+
+    CHECK(ch->ups == 1 && ctx->ranger.switches == 1);
+    CHECK(ch->range == AD7708_Range_640mV && ctx->maxRange == AD7708_Range_640mV);
+    CHECK(ctx->perRange[AD7708_Range_640mV] > 0 && ctx->clamped >= ctx->perRange[AD7708_Range_640mV]);
+    CHECK(ch->clamps == ctx->clamped && ctx->poll.clamped == ctx->clamped);
+    CHECK(holdsPair(ctx, AD7708_Channel_1, AD7708_Range_640mV, AD7708_Bipolar));
+
+    // Above the step up threshold of the largest range but in it: nowhere to go
+    ctx->wave = (test_wave){ 2.0, 0.62, ctx->sim.nowNs, 0.0 };
+    run(ctx, 100000000ULL);
+    CHECK(ctx->ranger.switches == 1 && ch->range == AD7708_Range_640mV && ctx->maxRange == AD7708_Range_640mV);
+    CHECK(ctx->clamped <= 1 && ctx->mistagged == 0);
+}
+
+static void testUnipolarZero(test_ctx* ctx)
+{
+    const ad7708_range_channel* ch = &ctx->ranger.ch[AD7708_Channel_2];
+
+    // A negative input clamps a unipolar channel at zero, no range helps with that
+    setup(ctx, AD7708_Channel_2, AD7708_Range_160mV, AD7708_Unipolar);
+    ctx->wave = (test_wave){ -0.050, -0.050, 0, 0.0 };
+    run(ctx, 100000000ULL);
+
+    CHECK(ctx->clamped > 0 && ch->clamps == ctx->clamped);
+    CHECK(ctx->ranger.switches == 0 && ch->range == AD7708_Range_160mV);
+
+    // Clamped at the top it does move, straight to the largest range
+    ctx->wave = (test_wave){ -0.050, 1.0, ctx->sim.nowNs, 0.0 };
+    run(ctx, 100000000ULL);
+    CHECK(ctx->ranger.switches == 1 && ch->range == AD7708_Range_2p56V);
+    CHECK(holdsPair(ctx, AD7708_Channel_2, AD7708_Range_2p56V, AD7708_Unipolar));
+}
+
+static void testUncalibrated(test_ctx* ctx)
+{
+    const ad7708_range_channel* ch = &ctx->ranger.ch[AD7708_Channel_1];
+    ad7708_calstore_limits limits = { TEMP_C10 + 300, 0, 50, 0 };
+    uint16_t offset, gain;
+
+    // Every cached entry is 30 degC off: the switches still happen, the part keeps its pair
+    setup(ctx, AD7708_Channel_1, AD7708_Range_20mV, AD7708_Bipolar);
+    ctx->ranger.limits = &limits;
+    offset = ctx->sim.offset[AD7708_Channel_1];
+    gain = ctx->sim.gain[AD7708_Channel_1];
+    ctx->wave = (test_wave){ 0.0, 0.1, ctx->sim.nowNs, 1.0 };
+    run(ctx, 150000000ULL);
+
+    CHECK(ch->ups == 3 && ch->range == AD7708_Range_160mV);
+    CHECK(ch->uncalibrated == ch->ups);
+    CHECK(ctx->sim.offset[AD7708_Channel_1] == offset && ctx->sim.gain[AD7708_Channel_1] == gain);
+
+    // Back within limits the next switch restores again
+    limits.tempC10 = TEMP_C10;
+    ctx->wave = (test_wave){ 0.1, 0.28, ctx->sim.nowNs, 1.0 };
+    run(ctx, 250000000ULL);
+    CHECK(ch->range == AD7708_Range_320mV && ch->uncalibrated == 3);
+    CHECK(holdsPair(ctx, AD7708_Channel_1, AD7708_Range_320mV, AD7708_Bipolar));
+}
+
+static void testInFlight(test_ctx* ctx)
+{
+    ad7708_range_channel* ch = &ctx->ranger.ch[AD7708_Channel_1];
+    ad7708_range_channel before;
+    ad7708_sample s;
+    uint8_t switched = 1;
+
+    setup(ctx, AD7708_Channel_1, AD7708_Range_20mV, AD7708_Bipolar);
+    ctx->wave = (test_wave){ 0.005, 0.019, ctx->sim.nowNs + 10000000ULL, 0.0 };
+    run(ctx, 50000000ULL);
+    CHECK(ch->range == AD7708_Range_40mV);
+
+    // A full-scale result converted before the switch says nothing about the new range
+    before = *ch;
+    s.code = 0xFFFFU;
+    s.channel = AD7708_Channel_1;
+    s.flags = AD7708_Range_20mV;
+    CHECK(ad7708_range_update(&ctx->ranger, &s, 1, &switched) == AD7708_OK);
+    CHECK(switched == 0 && (s.flags & AD7708_SAMPLE_CLAMPED));
+    CHECK(memcmp(&before, ch, sizeof(before)) == 0 && ctx->ranger.switches == 1);
+
+    // The same result tagged with the current range does switch
+    s.flags = AD7708_Range_40mV;
+    CHECK(ad7708_range_update(&ctx->ranger, &s, 1, &switched) == AD7708_OK);
+    CHECK(switched == 1 && ch->range == ctx->ranger.maxRange && ch->clamps == before.clamps + 1);
+}
+
+int main(void)
+{
+    static test_ctx ctx;
+
+    testRampUp(&ctx);
+    testHysteresis(&ctx);
+    testClampToMax(&ctx);
+    testUnipolarZero(&ctx);
+    testUncalibrated(&ctx);
+    testInFlight(&ctx);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,259 @@
+/*
+ * ad7708_record round trip: write a record through the file sink, map it
+ * and read it back with seek and iteration.
+ *
+ * The record changes configuration halfway and has a gap longer than 32
+ * bits of ticks. Samples carry mux addresses and the clamp flag. A copy with
+ * one damaged block must lose exactly that block, a copy whose second
+ * configuration claims the old layout version everything after it.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "ad7708_crc.h"
+#include "ad7708_record.h"
+#include "test.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define SAMPLES 3000U
+#define CONFIG_AT 1200U // Index of the first sample after the configuration change
+#define GAP_AT 2100U    // Index of the first sample after the long gap
+#define GAP_TICKS 5000000000ULL
+#define T_START 7ULL
+
+typedef struct
+{
+    uint64_t t;
+    ad7708_sample s;
+} written;
+
+static written ref[SAMPLES];
+static char path[] = "/tmp/ad7708_recordXXXXXX";
+
+/*!
+ * @brief Reference sample i: irregular spacing, every channel, mux address, range and clamp
+ */
+static void makeSamples(void)
+{
+    uint64_t t = T_START;
+    uint32_t rng = 12345;
+
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        rng = rng * 1664525UL + 1013904223UL;
+        if (i == GAP_AT) { t += GAP_TICKS; }
+        else if (i != 0) { t += 1U + (rng >> 20) % 3000U; } // 1..3000 ticks, one to two varint bytes
+        ref[i].t = t;
+        ref[i].s.code = (uint16_t)(rng >> 8);
+        ref[i].s.channel = (uint8_t)(i % 16U | ((rng >> 12) & 0x03U) << AD7708_SAMPLE_MUX_SHIFT);
+        ref[i].s.flags = (uint8_t)((rng >> 4) & (AD7708_SAMPLE_TAG_MASK | AD7708_SAMPLE_CLAMPED));
+    }
+}
+
+static void writeRecord(void)
+{
+    ad7708_record_writer* w = (ad7708_record_writer*)calloc(1, sizeof(*w));
+    ad7708_record_sink sink;
+    ad7708_dev dev;
+    FILE* f = fopen(path, "wb");
+
+    CHECK(f != NULL && w != NULL);
+    if (f == NULL || w == NULL) { return; }
+
+    memset(&dev, 0, sizeof(dev));
+    dev.filterReg.byte = 0x45U;
+    dev.controlReg.byte = 0x07U;
+    ad7708_record_fileSink(&sink, f);
+    CHECK(ad7708_record_open(w, &sink, &dev, 1000000U, 0) == AD7708_OK);
+
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        if (i == CONFIG_AT)
+        {
+            dev.filterReg.byte = 0x0DU;
+            dev.modeReg.bits.chop = 1;
+            CHECK(ad7708_record_config_update(w, &dev, ref[i].t) == AD7708_OK);
+        }
+        CHECK(ad7708_record_append(w, &ref[i].s, ref[i].t) == AD7708_OK);
+    }
+    CHECK(ad7708_record_flush(w) == AD7708_OK);
+    CHECK(w->samples == SAMPLES && w->errors == 0);
+
+    fclose(f);
+    free(w);
+}
+
+/*!
+ * @brief Iterate from a cursor and compare with the reference from index first
+ * @return Number of samples matched
+ */
+static uint32_t compareFrom(ad7708_record_iter* it, uint32_t first, uint32_t skipFrom, uint32_t skipTo)
+{
+    ad7708_record_item item;
+    uint32_t i = first, matched = 0;
+
+    while (ad7708_record_next(it, &item) == AD7708_OK)
+    {
+        if (i == skipFrom) { i = skipTo; }
+        if (i >= SAMPLES) { break; }
+
+        CHECK(item.t == ref[i].t);
+        CHECK(item.code == ref[i].s.code);
+        CHECK(item.channel == ref[i].s.channel);
+        CHECK(item.flags == ref[i].s.flags);
+        CHECK(it->view.config->filter == (i < CONFIG_AT ? 0x45U : 0x0DU));
+        CHECK(it->view.config->tickHz == 1000000U);
+        if (i == GAP_AT) { CHECK(it->view.hdr->t0 == ref[i].t && it->i == 1); } // The gap opens a block
+        i++;
+        matched++;
+    }
+
+    return matched;
+}
+
+static void testRead(void)
+{
+    ad7708_record_reader r;
+    ad7708_record_iter it;
+    ad7708_record_item item;
+
+    CHECK(ad7708_record_map(&r, path) == AD7708_OK);
+    CHECK(r.badBlocks == 0);
+    CHECK(r.blocks >= SAMPLES * 5U / AD7708_RECORD_BLOCK_BYTES);
+
+    // Whole record
+    CHECK(ad7708_record_seek(&r, &it, 0) == AD7708_OK);
+    CHECK(compareFrom(&it, 0, SAMPLES, SAMPLES) == SAMPLES);
+
+    // Exact hit, between two samples, across the configuration change and the gap
+    static const uint32_t targets[] = { 1, 517, CONFIG_AT - 1, CONFIG_AT, GAP_AT - 1, GAP_AT, SAMPLES - 1 };
+    for (uint32_t k = 0; k < sizeof(targets) / sizeof(targets[0]); k++)
+    {
+        uint32_t i = targets[k];
+
+        CHECK(ad7708_record_seek(&r, &it, ref[i].t) == AD7708_OK);
+        CHECK(ad7708_record_next(&it, &item) == AD7708_OK && item.t == ref[i].t && item.code == ref[i].s.code);
+        CHECK(ad7708_record_seek(&r, &it, ref[i - 1].t + 1) == AD7708_OK);
+        CHECK(ad7708_record_next(&it, &item) == AD7708_OK && item.t == ref[i].t);
+    }
+    CHECK(ad7708_record_seek(&r, &it, ref[SAMPLES - 1].t + 1) == AD7708_ERROR);
+
+    ad7708_record_close(&r);
+}
+
+/*!
+ * @brief Read the whole record file into memory
+ * @return Malloc'd copy, NULL on failure
+ */
+static uint8_t* loadRecord(long* size)
+{
+    uint8_t* data;
+    FILE* f = fopen(path, "rb");
+
+    CHECK(f != NULL);
+    if (f == NULL) { return NULL; }
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    rewind(f);
+    data = (uint8_t*)malloc((size_t)*size);
+    CHECK(fread(data, 1, (size_t)*size, f) == (size_t)*size);
+    fclose(f);
+
+    return data;
+}
+
+static void testCorrupted(void)
+{
+    ad7708_record_reader r;
+    ad7708_record_iter it;
+    ad7708_record_view view;
+    long size;
+    uint8_t* data = loadRecord(&size);
+    uint32_t blocks, lost, first = 0;
+
+    if (data == NULL) { return; }
+
+    // Damage one payload byte of the third DATA block
+    CHECK(ad7708_record_attach(&r, data, (size_t)size) == AD7708_OK);
+    blocks = r.blocks;
+    CHECK(ad7708_record_block(&r, 2, &view) == AD7708_OK);
+    lost = view.hdr->count;
+    for (uint32_t b = 0; b < 2; b++)
+    {
+        CHECK(ad7708_record_block(&r, b, &view) == AD7708_OK);
+        first += view.hdr->count;
+    }
+    data[(size_t)r.index[2].block * AD7708_RECORD_BLOCK_BYTES + 100U] ^= 0x40U;
+    ad7708_record_close(&r);
+
+    CHECK(ad7708_record_attach(&r, data, (size_t)size) == AD7708_OK);
+    CHECK(r.badBlocks == 1);
+    CHECK(r.blocks == blocks - 1);
+    CHECK(ad7708_record_seek(&r, &it, 0) == AD7708_OK);
+    CHECK(compareFrom(&it, 0, first, first + lost) == SAMPLES - lost);
+    ad7708_record_close(&r);
+
+    free(data);
+}
+
+static void testVersion(void)
+{
+    ad7708_record_reader r;
+    ad7708_record_iter it;
+    long size;
+    uint8_t* data = loadRecord(&size);
+    uint32_t configs = 0, before = 0, after = 0;
+
+    if (data == NULL) { return; }
+
+    // Rewrite the configuration block of the change as version 1 with a valid CRC
+    for (long b = 0; b < size / (long)AD7708_RECORD_BLOCK_BYTES; b++)
+    {
+        uint8_t* block = data + b * AD7708_RECORD_BLOCK_BYTES;
+        ad7708_record_block_hdr* hdr = (ad7708_record_block_hdr*)block;
+        ad7708_record_config* cfg = (ad7708_record_config*)(block + sizeof(*hdr));
+
+        if (hdr->type == AD7708_RECORD_CONFIG && ++configs == 2)
+        {
+            CHECK(cfg->version == AD7708_RECORD_VERSION);
+            cfg->version = 1;
+            hdr->crc = 0;
+            hdr->crc = ad7708_crc16(AD7708_CRC16_INIT, block, AD7708_RECORD_BLOCK_BYTES);
+        }
+        else if (hdr->type == AD7708_RECORD_DATA)
+        {
+            if (configs < 2) { before++; }
+            else { after++; }
+        }
+    }
+    CHECK(configs == 2 && before != 0 && after != 0);
+
+    // The old layout is not misread, its data is dropped and counted
+    CHECK(ad7708_record_attach(&r, data, (size_t)size) == AD7708_OK);
+    CHECK(r.blocks == before && r.badBlocks == after);
+    CHECK(ad7708_record_seek(&r, &it, 0) == AD7708_OK);
+    CHECK(compareFrom(&it, 0, SAMPLES, SAMPLES) == CONFIG_AT);
+    ad7708_record_close(&r);
+
+    free(data);
+}
+
+int main(void)
+{
+    int fd = mkstemp(path);
+
+    CHECK(fd >= 0);
+    if (fd < 0) { return TEST_RESULT(); }
+    close(fd);
+
+    makeSamples();
+    writeRecord();
+    testRead();
+    testCorrupted();
+    testVersion();
+
+    unlink(path);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,123 @@
+/*
+ * ad7708_checkLink and ad7708_recover against a simulator knocked out of
+ * step in the middle of a frame.
+ *
+ * A frame cut after the comm byte and one of two gain bytes leaves the part
+ * waiting for the second data byte; the next frame is then parsed shifted by
+ * one byte and clobbers the selected channel's gain. checkLink has to see
+ * that, and recover has to put back mode, filter, IO, control and the
+ * calibration pairs within a few hundred us of bus time.
+ */
+#include "ad7708.h"
+#include "ad7708_sim.h"
+#include "test.h"
+
+#include <string.h>
+
+#define RECOVER_MAX_NS 300000U // 4 MHz SCLK, two frames and the link check
+
+static ad7708_sim sim;
+static ad7708_dev dev;
+
+static void setup(void)
+{
+    memset(&dev, 0, sizeof(dev));
+    ad7708_sim_init(&sim);
+    ad7708_sim_attach(&sim, &dev);
+    sim.offsetError = 0.01;
+    sim.gainError = 0.02;
+    CHECK(ad7708_init(&dev) == AD7708_OK);
+
+    CHECK(ad7708_calibrateRange(&dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar) == AD7708_OK);
+    CHECK(ad7708_calibrateRange(&dev, AD7708_Channel_5, AD7708_Range_1p28V, AD7708_Unipolar) == AD7708_OK);
+    CHECK(ad7708_sfRateConfig(&dev, 45) == AD7708_OK);
+    CHECK(ad7708_ioConfig(&dev, 0, 0) == AD7708_OK); // Both pins outputs
+    CHECK(ad7708_ioWrite(&dev, 1, 0) == AD7708_OK);
+    CHECK(ad7708_channelConfig(&dev, AD7708_Channel_5, AD7708_Range_1p28V, AD7708_Unipolar) == AD7708_OK);
+    CHECK(ad7708_checkLink(&dev) == AD7708_OK);
+}
+
+/*!
+ * @brief Clock a frame that stops after the first of two gain data bytes
+ */
+static void cutFrame(void)
+{
+    sim.cs = 0;
+    ad7708_sim_exchange(&sim, AD7708_Write | GAIN_REG);
+    ad7708_sim_exchange(&sim, 0x12U);
+    sim.cs = 1;
+    CHECK(sim.phaseLeft == 1);
+}
+
+/*!
+ * @brief Every register the driver knows matches the part
+ */
+static void checkRestored(void)
+{
+    CHECK(sim.mode == dev.modeReg.byte);
+    CHECK(sim.filter == dev.filterReg.byte);
+    CHECK(sim.ioControl == dev.ioControlReg.byte);
+    CHECK(sim.control == dev.controlReg.byte);
+    for (uint8_t ch = 0; ch < 16; ch++)
+    {
+        if ((dev.calKnown >> ch) & 1U) { CHECK(sim.offset[ch] == dev.calOffset[ch]); }
+        if ((dev.calKnown >> (16U + ch)) & 1U) { CHECK(sim.gain[ch] == dev.calGain[ch]); }
+    }
+}
+
+static void testContinuous(void)
+{
+    uint16_t gain5;
+    uint64_t t0;
+
+    setup();
+    CHECK(ad7708_setMode(&dev, AD7708_ContinuousConversion) == AD7708_OK);
+    gain5 = sim.gain[AD7708_Channel_5];
+    CHECK(gain5 == (uint16_t)(AD7708_SIM_GAIN_DEFAULT * 1.02 + 0.5));
+    CHECK(dev.calKnown == 0x00110011UL);
+
+    // The shifted frame writes the link check's first byte into the gain and reads garbage
+    cutFrame();
+    CHECK(ad7708_checkLink(&dev) == AD7708_ERROR);
+    CHECK(sim.gain[AD7708_Channel_5] != gain5);
+
+    // Garbage clocked in by the glitch can land anywhere
+    sim.filter = 0x7FU;
+    sim.ioControl = 0x00U;
+    sim.control = 0x0FU;
+    sim.mode = 0x01U;
+    sim.offset[AD7708_Channel_1] ^= 0x0100U;
+
+    t0 = sim.nowNs;
+    CHECK(ad7708_recover(&dev) == AD7708_OK);
+    printf("recovery took %u us\n", (unsigned)((sim.nowNs - t0) / 1000U));
+    CHECK(sim.nowNs - t0 < RECOVER_MAX_NS);
+    CHECK(dev.recoveries == 1);
+
+    checkRestored();
+    CHECK(sim.gain[AD7708_Channel_5] == gain5);
+    CHECK(dev.modeReg.merged.mode == AD7708_ContinuousConversion);
+    CHECK(ad7708_checkLink(&dev) == AD7708_OK);
+}
+
+static void testSingleInFlight(void)
+{
+    setup();
+    CHECK(ad7708_setMode(&dev, AD7708_SingleConversion) == AD7708_OK);
+
+    // A single conversion cannot be resumed, the part is left idle
+    cutFrame();
+    CHECK(ad7708_checkLink(&dev) == AD7708_ERROR);
+    CHECK(ad7708_recover(&dev) == AD7708_OK);
+    CHECK(dev.modeReg.merged.mode == AD7708_Idle);
+    checkRestored();
+    CHECK(ad7708_checkLink(&dev) == AD7708_OK);
+}
+
+int main(void)
+{
+    testContinuous();
+    testSingleInFlight();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,251 @@
+/*
+ * ad7708_resample on a three channel scan whose clock runs 3.7 % slow
+ * against the 1 ms grid, stamps starting just before the 32 bit wrap.
+ *
+ * Ramps are straight lines, so both interpolations are only off by the code
+ * quantization: 0.5 LSB for linear, 0.625 LSB for Catmull-Rom whose weights
+ * add up to 1.25 at most, plus the rounding of the output. For a sine of
+ * amplitude A sampled every h the linear error is bounded by A (w h)^2 / 8,
+ * the Catmull-Rom one by A (w h)^3 / 32. A drain from a ring holding far
+ * more than the history must fill small blocks without skipping a tick. The
+ * last part lets the frame block sit full while the history overruns and
+ * checks the skipped ticks. The
+ * scanned channels are 1, 4 and channel 4 again behind mux address 1.
+ */
+#include "ad7708_resample.h"
+#include "ad7708_ring.h"
+#include "test.h"
+
+#include <math.h>
+#include <string.h>
+
+#define CHANNELS 3U
+#define STEP_US 1037U              // Time between conversions of the scan
+#define PASS_US (CHANNELS * STEP_US)
+#define PERIOD_US 1000U            // Grid
+#define T0_US 0xFFFF0000UL         // Stamp of the first conversion, wraps after 65 ms
+#define SAMPLES 6000U
+#define CAPACITY 16U
+#define AMPLITUDE 20000.0
+#define PI 3.14159265358979323846
+
+static const uint8_t channels[CHANNELS] = { 1, 4, 4 | 1 << AD7708_SAMPLE_MUX_SHIFT };
+static const double slope[CHANNELS] = { 0.004, -0.005, 0.0021 }; // LSB per us
+static const double freq[CHANNELS] = { 10.0, 7.0, 13.0 };        // Hz
+
+typedef double (*signal_fptr_t)(uint8_t column, double tUs);
+
+static double ramp(uint8_t column, double tUs) { return slope[column] * tUs; }
+static double sine(uint8_t column, double tUs) { return AMPLITUDE * sin(2.0 * PI * freq[column] * tUs * 1e-6 + column); }
+
+/*!
+ * @brief Conversion i of the scan, its stamp and its time since the first one
+ */
+static void conversion(uint32_t i, signal_fptr_t signal, ad7708_sample* s, uint32_t* stamp)
+{
+    uint8_t column = (uint8_t)(i % CHANNELS);
+    uint32_t r = (i / CHANNELS) * PASS_US + column * STEP_US;
+
+    s->channel = channels[column];
+    s->flags = AD7708_Range_2p56V;
+    s->code = (uint16_t)lround(32768.0 + signal(column, r));
+    *stamp = (uint32_t)(T0_US + r);
+}
+
+/*!
+ * @brief Check every value of a full or final block against the signal
+ * @return Largest error, LSB
+ */
+static double checkFrames(const ad7708_frames* f, signal_fptr_t signal, uint32_t* nextTick)
+{
+    double worst = 0.0;
+
+    CHECK(f->count == 0 || f->t0Us == *nextTick);
+    CHECK(f->count == 0 || f->periodUs == PERIOD_US);
+    for (uint16_t k = 0; k < f->count; k++)
+    {
+        uint32_t r = f->t0Us + k * PERIOD_US - (uint32_t)T0_US;
+
+        for (uint8_t c = 0; c < CHANNELS; c++)
+        {
+            double err = fabs(AD7708_FRAMES_COLUMN(f, c)[k] / (double)(1 << AD7708_RESAMPLE_FRAC) - signal(c, r));
+            if (err > worst) { worst = err; }
+        }
+    }
+    if (f->count != 0) { *nextTick = f->t0Us + f->count * PERIOD_US; }
+
+    return worst;
+}
+
+/*!
+ * @brief Resample SAMPLES conversions of a signal
+ * @return Largest error, LSB
+ */
+static double run(signal_fptr_t signal, AD7708_Interp interp)
+{
+    static int32_t data[CHANNELS * CAPACITY];
+    ad7708_resample rs;
+    ad7708_frames frames;
+    uint32_t produced = 0, nextTick = 0;
+    uint32_t need = interp == AD7708_INTERP_CUBIC ? 2U : 1U; // Samples needed on each side of a tick
+    uint32_t span = (SAMPLES / CHANNELS - 2U * need + 1U) * PASS_US - (CHANNELS - 1U) * STEP_US;
+    double worst = 0.0;
+
+    CHECK(ad7708_resample_init(&rs, channels, CHANNELS, PERIOD_US, interp) == AD7708_OK);
+    ad7708_frames_init(&frames, data, CHANNELS, CAPACITY);
+
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        ad7708_sample s;
+        uint32_t stamp;
+
+        conversion(i, signal, &s, &stamp);
+        produced += ad7708_resample_process(&rs, &s, &stamp, 1, &frames);
+        if (frames.count == CAPACITY)
+        {
+            if (nextTick == 0) { nextTick = frames.t0Us; }
+            worst = fmax(worst, checkFrames(&frames, signal, &nextTick));
+            frames.count = 0;
+        }
+    }
+    worst = fmax(worst, checkFrames(&frames, signal, &nextTick));
+
+    // Every tick between the first and the last one all channels can serve came out, none was skipped
+    CHECK(rs.skipped == 0);
+    CHECK(rs.frames == produced);
+    CHECK(produced >= span / PERIOD_US && produced <= span / PERIOD_US + 1U);
+
+    return worst;
+}
+
+static void testAccuracy(void)
+{
+    double wh[CHANNELS], linearBound = 0.0, cubicBound = 0.0;
+    double err;
+
+    for (uint8_t c = 0; c < CHANNELS; c++)
+    {
+        wh[c] = 2.0 * PI * freq[c] * PASS_US * 1e-6;
+        linearBound = fmax(linearBound, AMPLITUDE * wh[c] * wh[c] / 8.0 + 0.51);
+        cubicBound = fmax(cubicBound, AMPLITUDE * wh[c] * wh[c] * wh[c] / 32.0 + 0.63);
+    }
+
+    err = run(ramp, AD7708_INTERP_LINEAR);
+    printf("ramp linear: %.3f LSB\n", err);
+    CHECK(err <= 0.51);
+    err = run(ramp, AD7708_INTERP_CUBIC);
+    printf("ramp cubic: %.3f LSB\n", err);
+    CHECK(err <= 0.63);
+    err = run(sine, AD7708_INTERP_LINEAR);
+    printf("sine linear: %.3f LSB, bound %.3f\n", err, linearBound);
+    CHECK(err <= linearBound);
+    err = run(sine, AD7708_INTERP_CUBIC);
+    printf("sine cubic: %.3f LSB, bound %.3f\n", err, cubicBound);
+    CHECK(err <= cubicBound);
+}
+
+static void testOverrun(void)
+{
+    static int32_t data[CHANNELS * 4];
+    ad7708_resample rs;
+    ad7708_frames frames;
+    ad7708_sample s;
+    uint32_t stamp, stamps[CHANNELS], waiting, oldest = 0, nextTick;
+    uint32_t i = 0, expected;
+
+    CHECK(ad7708_resample_init(&rs, channels, CHANNELS, PERIOD_US, AD7708_INTERP_LINEAR) == AD7708_OK);
+    ad7708_frames_init(&frames, data, CHANNELS, 4);
+
+    // Fill the block and leave it full
+    while (frames.count < 4)
+    {
+        conversion(i++, ramp, &s, &stamp);
+        ad7708_resample_process(&rs, &s, &stamp, 1, &frames);
+    }
+    waiting = rs.nextUs;
+    nextTick = frames.t0Us;
+    checkFrames(&frames, ramp, &nextTick);
+    CHECK(nextTick == waiting);
+
+    // Three times the history goes by, nothing comes out and nothing is skipped yet
+    for (uint32_t k = 0; k < 3U * AD7708_RESAMPLE_HISTORY * CHANNELS; k++, i++)
+    {
+        conversion(i, ramp, &s, &stamp);
+        CHECK(ad7708_resample_process(&rs, &s, &stamp, 1, &frames) == 0);
+        stamps[i % CHANNELS] = stamp;
+    }
+    CHECK(rs.skipped == 0 && rs.nextUs == waiting);
+
+    // The next conversion pushes out one more sample; the oldest kept per channel is HISTORY - 1 passes before its newest
+    conversion(i++, ramp, &s, &stamp);
+    stamps[(i - 1U) % CHANNELS] = stamp;
+    for (uint8_t c = 0; c < CHANNELS; c++)
+    {
+        uint32_t t = stamps[c] - (AD7708_RESAMPLE_HISTORY - 1U) * PASS_US;
+        if (c == 0 || (int32_t)(t - oldest) > 0) { oldest = t; }
+    }
+    expected = (oldest - waiting + PERIOD_US - 1U) / PERIOD_US;
+
+    // Emptying the block skips the ticks whose samples are gone and resumes right after them
+    frames.count = 0;
+    ad7708_resample_process(&rs, &s, &stamp, 1, &frames);
+    printf("skipped %u ticks\n", (unsigned)rs.skipped);
+    CHECK(rs.skipped == expected);
+    CHECK(frames.count != 0 && frames.t0Us == waiting + expected * PERIOD_US);
+    nextTick = frames.t0Us;
+    CHECK(checkFrames(&frames, ramp, &nextTick) <= 0.51);
+    CHECK(rs.frames + rs.skipped == (rs.nextUs - (waiting - 4U * PERIOD_US)) / PERIOD_US);
+}
+
+static void testDrain(void)
+{
+    static int32_t data[CHANNELS * 4];
+    static ad7708_sample storage[64];
+    static uint32_t ringStamps[64];
+    ad7708_ring ring;
+    ad7708_resample rs;
+    ad7708_frames frames;
+    uint32_t i = 0, produced = 0, nextTick = 0, drains = 0;
+    double worst = 0.0;
+
+    CHECK(ad7708_resample_init(&rs, channels, CHANNELS, PERIOD_US, AD7708_INTERP_LINEAR) == AD7708_OK);
+    ad7708_frames_init(&frames, data, CHANNELS, 4);
+    CHECK(ad7708_ring_init(&ring, storage, 64) == AD7708_OK);
+    ad7708_ring_setStamps(&ring, ringStamps);
+
+    // The ring is refilled with 60 conversions, five times the history, and drained a 4 frame block at a time
+    while (i < 1200U)
+    {
+        while (i < 1200U && ad7708_ring_count(&ring) < 60U)
+        {
+            ad7708_sample s;
+            uint32_t stamp;
+
+            conversion(i++, ramp, &s, &stamp);
+            CHECK(ad7708_ring_pushStamped(&ring, &s, stamp) == AD7708_OK);
+        }
+        while (ad7708_ring_count(&ring) != 0 || frames.count != 0)
+        {
+            produced += ad7708_resample_drain(&rs, &ring, &frames, 64);
+            if (frames.count == 0) { break; }
+            if (nextTick == 0) { nextTick = frames.t0Us; }
+            worst = fmax(worst, checkFrames(&frames, ramp, &nextTick));
+            frames.count = 0;
+            drains++;
+        }
+    }
+
+    printf("drain: %u frames in %u blocks, %.3f LSB\n", (unsigned)produced, (unsigned)drains, worst);
+    CHECK(rs.skipped == 0 && rs.frames == produced);
+    CHECK(produced >= (1200U / CHANNELS - 2U) * PASS_US / PERIOD_US);
+    CHECK(worst <= 0.51);
+}
+
+int main(void)
+{
+    testAccuracy();
+    testDrain();
+    testOverrun();
+
+    return TEST_RESULT();
+}
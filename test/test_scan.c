@@ -0,0 +1,223 @@
+/*
+ * ad7708_scan against the simulator, with transfers failing mid-scan.
+ *
+ * Each channel sees its own input level, so the code of every sample tells
+ * which channel the device really converted, whatever the sample is tagged.
+ */
+#include "ad7708.h"
+#include "ad7708_ring.h"
+#include "ad7708_scan.h"
+#include "ad7708_sim.h"
+#include "test.h"
+
+#include <string.h>
+
+#define RING_SIZE 256U
+#define FAIL_EVERY 5U
+
+typedef struct
+{
+    ad7708_sim sim;
+    ad7708_dev dev;
+    ad7708_ring ring;
+    ad7708_sample storage[RING_SIZE];
+    ad7708_scan scan;
+    ad7708_transport transport;
+} test_ctx;
+
+static const ad7708_scan_entry entries[4] = {
+    { AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar, 0, 0 },
+    { AD7708_Channel_2, AD7708_Range_2p56V, AD7708_Bipolar, 0, 1 },
+    { AD7708_Channel_3, AD7708_Range_2p56V, AD7708_Bipolar, 1, 2 },
+    { AD7708_Channel_4, AD7708_Range_2p56V, AD7708_Bipolar, 0, 3 },
+};
+
+static uint32_t transfers;
+static uint8_t clockOnFail; // 1: the failed frame still reached the device
+
+static void onRdy(void* arg) { ad7708_scan_onRdy((ad7708_scan*)arg); }
+static void onDma(void* arg) { ad7708_scan_dmaComplete((ad7708_scan*)arg); }
+
+static double level(void* arg, uint8_t channel, uint64_t timeNs)
+{
+    (void)arg;
+    (void)timeNs;
+    return 0.25 * channel;
+}
+
+static StatusTypeDef faultyTransfer(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len)
+{
+    if (++transfers % FAIL_EVERY == 0)
+    {
+        if (clockOnFail) { ad7708_simTransport.transfer(intf, tx, rx, len); }
+        return AD7708_ERROR;
+    }
+
+    return ad7708_simTransport.transfer(intf, tx, rx, len);
+}
+
+// Rejects every frame that writes the mode register, everything else reaches the sim
+static StatusTypeDef modeFailTransfer(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len)
+{
+    transfers++;
+    if (tx[0] == (uint8_t)MODE_REG) { return AD7708_ERROR; }
+    return ad7708_simTransport.transfer(intf, tx, rx, len);
+}
+
+static void setup(test_ctx* ctx, uint8_t faulty)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ad7708_sim_init(&ctx->sim);
+    ad7708_sim_attach(&ctx->sim, &ctx->dev);
+    ctx->sim.input = level;
+    ad7708_init(&ctx->dev);
+    ad7708_sfRateConfig(&ctx->dev, 3);
+
+    if (faulty)
+    {
+        ctx->transport = ad7708_simTransport;
+        ctx->transport.transfer = faultyTransfer;
+        ctx->transport.transferDMA = NULL;
+        ctx->dev.transport = &ctx->transport;
+    }
+
+    ad7708_ring_init(&ctx->ring, ctx->storage, RING_SIZE);
+    ad7708_scan_init(&ctx->scan, &ctx->dev, entries, 4, &ctx->ring);
+    ctx->sim.onRdy = onRdy;
+    ctx->sim.rdyArg = &ctx->scan;
+    ctx->sim.onDmaDone = onDma;
+    ctx->sim.dmaArg = &ctx->scan;
+}
+
+/*!
+ * @brief Drain the ring, checking tags against the channel the code came from
+ * @return Number of samples drained
+ */
+static uint32_t drainAndCheck(test_ctx* ctx, uint32_t* perChannel)
+{
+    ad7708_sample out[32];
+    uint32_t n, total = 0;
+
+    while ((n = ad7708_ring_pop(&ctx->ring, out, 32)) != 0)
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            uint8_t channel = out[i].channel & 0x0FU;
+            double expected = 32768.0 + 0.25 * channel / 2.56 * 32768.0;
+            double diff = (double)out[i].code - expected;
+
+            CHECK(channel < 4);
+            CHECK(diff > -1.5 && diff < 1.5);
+            if (ctx->scan.muxed) { CHECK(out[i].channel >> AD7708_SAMPLE_MUX_SHIFT == entries[channel & 3U].mux); }
+            perChannel[channel & 3U]++;
+        }
+        total += n;
+    }
+
+    return total;
+}
+
+static void run(test_ctx* ctx, uint32_t rdys, uint32_t* perChannel)
+{
+    for (uint32_t i = 0; i < rdys; i++)
+    {
+        ad7708_sim_advance(&ctx->sim, ad7708_sim_nextEvent(&ctx->sim) - ctx->sim.nowNs);
+        drainAndCheck(ctx, perChannel);
+    }
+}
+
+static void testClean(test_ctx* ctx)
+{
+    uint32_t perChannel[4] = { 0 };
+
+    setup(ctx, 0);
+    CHECK(ad7708_scan_start(&ctx->scan) == AD7708_OK);
+    run(ctx, 500, perChannel);
+    ad7708_scan_stop(&ctx->scan);
+
+    // 5 RDYs per pass, one of them the discard of entry 3
+    CHECK(ctx->scan.passes == 100);
+    CHECK(ctx->scan.discarded == 100);
+    for (uint8_t i = 0; i < 4; i++) { CHECK(perChannel[i] == 100); }
+    CHECK(ctx->scan.errors == 0);
+}
+
+static void testTransferFailures(test_ctx* ctx, uint8_t clocked, uint8_t muxed)
+{
+    uint32_t perChannel[4] = { 0 };
+    uint8_t control;
+
+    setup(ctx, 1);
+    clockOnFail = clocked;
+    if (muxed)
+    {
+        ad7708_ioConfig(&ctx->dev, AD7708_IOPIN_Output, AD7708_IOPIN_Output);
+        ad7708_scan_setMux(&ctx->scan, 0);
+    }
+    CHECK(ad7708_scan_start(&ctx->scan) == AD7708_OK);
+    transfers = 0;
+    run(ctx, 2001, perChannel); // Ends on a good frame after the last failure
+    ad7708_scan_stop(&ctx->scan);
+
+    CHECK(ctx->scan.errors == 2000 / FAIL_EVERY);
+    CHECK(ctx->scan.samples + ctx->scan.discarded + ctx->scan.errors == 2001);
+    CHECK(ctx->scan.passes > 250);
+    for (uint8_t i = 0; i < 4; i++) { CHECK(perChannel[i] > 250); }
+
+    // After the scan settles the shadow agrees with the device again
+    CHECK(ctx->scan.resync == 0);
+    CHECK((ctx->dev.regDirty & (1U << CONTROL_REG)) == 0);
+    CHECK(ctx->dev.controlReg.byte == ctx->sim.control);
+    if (muxed) { CHECK(ctx->dev.ioControlReg.byte == ctx->sim.ioControl); }
+    CHECK(ad7708_readConfig(&ctx->dev, CONTROL_REG, &control, 0) == AD7708_OK && control == ctx->sim.control);
+}
+
+static void testDirtyOnFailure(test_ctx* ctx)
+{
+    uint32_t perChannel[4] = { 0 };
+    uint8_t control;
+
+    // Fail the very frame that switches from entry 0 to entry 1, after it reached the device
+    setup(ctx, 1);
+    clockOnFail = 1;
+    CHECK(ad7708_scan_start(&ctx->scan) == AD7708_OK);
+    transfers = FAIL_EVERY - 1;
+    run(ctx, 1, perChannel);
+
+    CHECK(ctx->scan.index == 0 && ctx->scan.samples == 0);
+    CHECK(ctx->scan.resync == 1);
+    CHECK(ctx->dev.regDirty & (1U << CONTROL_REG));
+    CHECK(ctx->sim.control != ctx->dev.controlReg.byte); // The device did move
+
+    // Reading a dirty register writes the pending shadow first, device and shadow agree again
+    CHECK(ad7708_readConfig(&ctx->dev, CONTROL_REG, &control, 0) == AD7708_OK);
+    CHECK(control == ctx->dev.controlReg.byte && control == ctx->sim.control);
+    CHECK(!(ctx->dev.regDirty & (1U << CONTROL_REG)));
+    ad7708_scan_stop(&ctx->scan);
+}
+
+static void testStartFailure(test_ctx* ctx)
+{
+    // Nothing reached the part, RDY must not run the sequencer against it
+    setup(ctx, 1);
+    ctx->transport.transfer = modeFailTransfer;
+    CHECK(ad7708_scan_start(&ctx->scan) != AD7708_OK);
+    CHECK(ctx->scan.running == 0);
+    transfers = 0;
+    ad7708_scan_onRdy(&ctx->scan);
+    CHECK(transfers == 0 && ctx->scan.samples == 0 && ctx->scan.errors == 0);
+}
+
+int main(void)
+{
+    static test_ctx ctx;
+
+    testClean(&ctx);
+    testTransferFailures(&ctx, 0, 0);
+    testTransferFailures(&ctx, 1, 0);
+    testTransferFailures(&ctx, 1, 1);
+    testDirtyOnFailure(&ctx);
+    testStartFailure(&ctx);
+
+    return TEST_RESULT();
+}
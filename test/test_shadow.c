@@ -0,0 +1,128 @@
+/*
+ * Shadow register cache against the simulator.
+ *
+ * Clean registers are served without touching the bus, a write that did not
+ * reach the part stays pending until it does, and input pin levels read back
+ * from IO_CONTROL_REG never become levels the driver later drives.
+ */
+#include "ad7708.h"
+#include "ad7708_sim.h"
+#include "test.h"
+
+#include <string.h>
+
+static ad7708_sim sim;
+static ad7708_dev dev;
+static ad7708_transport transport;
+static uint8_t failing; // 1: every frame fails without reaching the sim
+
+static StatusTypeDef switchedTransfer(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len)
+{
+    if (failing) { return AD7708_ERROR; }
+    return ad7708_simTransport.transfer(intf, tx, rx, len);
+}
+
+static void setup(void)
+{
+    memset(&dev, 0, sizeof(dev));
+    ad7708_sim_init(&sim);
+    ad7708_sim_attach(&sim, &dev);
+    transport = ad7708_simTransport;
+    transport.transfer = switchedTransfer;
+    transport.transferDMA = NULL;
+    dev.transport = &transport;
+    failing = 0;
+    ad7708_init(&dev);
+    ad7708_channelConfig(&dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar);
+}
+
+static void testCached(void)
+{
+    uint8_t value;
+    uint32_t bytes, cached, skipped;
+
+    setup();
+    bytes = sim.bytes;
+    cached = dev.readsCached;
+    CHECK(ad7708_readConfig(&dev, CONTROL_REG, &value, 0) == AD7708_OK);
+    CHECK(value == sim.control && sim.bytes == bytes && dev.readsCached == cached + 1);
+
+    // The same value again is not clocked out
+    skipped = dev.writesSkipped;
+    CHECK(ad7708_channelConfig(&dev, AD7708_Channel_1, AD7708_Range_2p56V, AD7708_Bipolar) == AD7708_OK);
+    CHECK(sim.bytes == bytes && dev.writesSkipped == skipped + 1);
+
+    // A refresh and a forgotten shadow both go to the part
+    CHECK(ad7708_readConfig(&dev, CONTROL_REG, &value, 1) == AD7708_OK && value == sim.control);
+    CHECK(sim.bytes == bytes + 2);
+    ad7708_invalidateShadow(&dev);
+    CHECK(ad7708_readConfig(&dev, CONTROL_REG, &value, 0) == AD7708_OK && value == sim.control);
+    CHECK(sim.bytes == bytes + 4);
+}
+
+static void testPending(void)
+{
+    uint8_t before, wanted, value;
+
+    setup();
+    before = sim.control;
+
+    // The write never reaches the part, the shadow holds it as pending
+    failing = 1;
+    CHECK(ad7708_channelConfig(&dev, AD7708_Channel_3, AD7708_Range_1p28V, AD7708_Unipolar) != AD7708_OK);
+    wanted = dev.controlReg.byte;
+    CHECK(wanted != before && sim.control == before);
+    CHECK(dev.regDirty & (1U << CONTROL_REG));
+
+    // Still failing: the read reports it and loses nothing
+    CHECK(ad7708_readConfig(&dev, CONTROL_REG, &value, 1) != AD7708_OK);
+    CHECK(dev.controlReg.byte == wanted && (dev.regDirty & (1U << CONTROL_REG)));
+
+    // Both a cached and a refreshing read deliver the pending value to the part first
+    failing = 0;
+    CHECK(ad7708_readConfig(&dev, CONTROL_REG, &value, 0) == AD7708_OK);
+    CHECK(value == wanted && sim.control == wanted && !(dev.regDirty & (1U << CONTROL_REG)));
+
+    failing = 1;
+    CHECK(ad7708_sfRateConfig(&dev, 0x20U) != AD7708_OK);
+    failing = 0;
+    CHECK(ad7708_readConfig(&dev, FILTER_REG, &value, 1) == AD7708_OK);
+    CHECK(value == 0x20U && sim.filter == 0x20U && dev.filterReg.byte == 0x20U);
+    CHECK(!(dev.regDirty & (1U << FILTER_REG)));
+}
+
+static void testInputPins(void)
+{
+    uint8_t value, written;
+
+    // P1 drives high, P2 is an input held high from outside
+    setup();
+    CHECK(ad7708_ioConfig(&dev, 1, 0) == AD7708_OK);
+    CHECK(ad7708_ioWrite(&dev, 1, 0) == AD7708_OK);
+    written = dev.ioControlReg.byte;
+    sim.pinIn[1] = 1;
+
+    CHECK(ad7708_readConfig(&dev, IO_CONTROL_REG, &value, 1) == AD7708_OK);
+    CHECK((value & 0x03U) == 0x03U);         // The caller sees the pin levels
+    CHECK(dev.ioControlReg.byte == written); // The shadow keeps what was written
+
+    // Turning P2 into an output drives the written level, not the one it read
+    CHECK(ad7708_ioConfig(&dev, 1, 1) == AD7708_OK);
+    CHECK((sim.ioControl & 0x03U) == 0x01U);
+
+    // Without a known shadow the input data bits start from zero
+    CHECK(ad7708_ioConfig(&dev, 0, 0) == AD7708_OK);
+    sim.pinIn[0] = 1;
+    ad7708_invalidateShadow(&dev);
+    CHECK(ad7708_readConfig(&dev, IO_CONTROL_REG, &value, 0) == AD7708_OK);
+    CHECK((value & 0x03U) == 0x03U && (dev.ioControlReg.byte & 0x03U) == 0);
+}
+
+int main(void)
+{
+    testCached();
+    testPending();
+    testInputPins();
+
+    return TEST_RESULT();
+}
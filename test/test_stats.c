@@ -0,0 +1,169 @@
+/*
+ * ad7708_stats: Welford mean and deviation against a two-pass reference, and
+ * the sequence counter against a writer on another thread.
+ *
+ * The reference streams sit near the top of the code range with a spread of a
+ * few LSB, where a naive sum of squares would cancel. Every snapshot taken
+ * while the writer runs must be a state the writer actually passed through:
+ * histogram total, clamp count and extremes all agree with the count.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "ad7708_stats.h"
+#include "test.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#define SAMPLES 200000U
+#define WRITES 1000000U
+#define CHANNEL 2U
+
+static ad7708_stats stats;
+static volatile uint32_t writerDone;
+
+/*!
+ * @brief Code i of a noisy reference stream around center
+ */
+static uint16_t noisyCode(uint32_t* rng, uint16_t center, uint16_t spread)
+{
+    *rng = *rng * 1664525UL + 1013904223UL;
+
+    return (uint16_t)(center - spread + (*rng >> 16) % (2U * spread + 1U));
+}
+
+static void checkWelford(uint16_t center, uint16_t spread, uint8_t flags)
+{
+    static uint16_t codes[SAMPLES];
+    ad7708_stats_channel snap;
+    ad7708_stats_summary summary;
+    ad7708_sample s;
+    double mean = 0.0, m2 = 0.0, zero = AD7708_SAMPLE_ZERO_CODE(flags);
+    uint32_t rng = center, total = 0;
+
+    ad7708_stats_init(&stats, 1U << CHANNEL);
+    s.channel = CHANNEL;
+    s.flags = flags;
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        codes[i] = noisyCode(&rng, center, spread);
+        s.code = codes[i];
+        ad7708_stats_update(&stats, &s);
+        mean += codes[i];
+    }
+
+    // Two passes in double as the reference
+    mean /= SAMPLES;
+    for (uint32_t i = 0; i < SAMPLES; i++) { m2 += (codes[i] - mean) * (codes[i] - mean); }
+
+    CHECK(ad7708_stats_snapshot(&stats, CHANNEL, &snap) == AD7708_OK);
+    ad7708_stats_summarize(&snap, &summary);
+    for (uint32_t b = 0; b < AD7708_STATS_BINS; b++) { total += snap.hist[b]; }
+
+    printf("center %u: mean %.4f / %.2f, std %.4f / %.2f\n", center, mean, summary.meanX100 / 100.0,
+        sqrt(m2 / (SAMPLES - 1)), summary.stdX100 / 100.0);
+    CHECK(summary.count == SAMPLES && total == SAMPLES);
+    CHECK(summary.min == center - spread && summary.max == center + spread);
+    CHECK(fabs(summary.meanX100 / 100.0 - mean) <= 0.01);
+    CHECK(fabs(summary.stdX100 / 100.0 - sqrt(m2 / (SAMPLES - 1))) <= 0.01);
+    CHECK(fabs(summary.rmsX100 / 100.0 - sqrt(m2 / SAMPLES + (mean - zero) * (mean - zero))) <= 0.01);
+}
+
+static void testWelford(void)
+{
+    checkWelford(65000, 3, AD7708_Range_2p56V | AD7708_SAMPLE_UNIPOLAR);
+    checkWelford(32768, 200, AD7708_Range_2p56V);
+    checkWelford(1200, 1, AD7708_Range_20mV);
+}
+
+static void testRestart(void)
+{
+    ad7708_stats_channel snap;
+    ad7708_sample s = { 40000, CHANNEL, AD7708_Range_2p56V };
+
+    ad7708_stats_init(&stats, 1U << CHANNEL);
+    ad7708_stats_update(&stats, &s);
+    s.flags |= AD7708_SAMPLE_CLAMPED;
+    ad7708_stats_update(&stats, &s);
+    CHECK(ad7708_stats_snapshot(&stats, CHANNEL, &snap) == AD7708_OK && snap.count == 2 && snap.clamped == 1);
+
+    // A range change and a reader reset both start over, disabled channels are ignored
+    s.flags = AD7708_Range_1p28V;
+    ad7708_stats_update(&stats, &s);
+    CHECK(ad7708_stats_snapshot(&stats, CHANNEL, &snap) == AD7708_OK && snap.count == 1 && snap.clamped == 0);
+    ad7708_stats_reset(&stats, CHANNEL);
+    CHECK(ad7708_stats_snapshot(&stats, CHANNEL, &snap) == AD7708_OK && snap.count == 1);
+    ad7708_stats_update(&stats, &s);
+    CHECK(ad7708_stats_snapshot(&stats, CHANNEL, &snap) == AD7708_OK && snap.count == 1);
+    s.channel = CHANNEL + 1U;
+    ad7708_stats_update(&stats, &s);
+    CHECK(ad7708_stats_snapshot(&stats, CHANNEL + 1U, &snap) == AD7708_OK && snap.count == 0);
+    CHECK(ad7708_stats_snapshot(&stats, 16, &snap) == AD7708_ERROR);
+}
+
+/*!
+ * @brief Writer side: code k is k mod 4096, odd results are clamped
+ */
+static void* writer(void* arg)
+{
+    ad7708_sample s;
+
+    (void)arg;
+    s.channel = CHANNEL;
+    for (uint32_t k = 0; k < WRITES; k++)
+    {
+        s.code = (uint16_t)(k % 4096U);
+        s.flags = (uint8_t)(AD7708_Range_2p56V | ((k & 1U) ? AD7708_SAMPLE_CLAMPED : 0U));
+        ad7708_stats_update(&stats, &s);
+        if (k % 256U == 255U) { sched_yield(); } // Leave the reader gaps between updates
+    }
+    __atomic_store_n(&writerDone, 1, __ATOMIC_RELEASE);
+
+    return NULL;
+}
+
+static void testConcurrent(void)
+{
+    static ad7708_stats_channel snap;
+    pthread_t thread;
+    uint32_t good = 0, busy = 0, torn = 0, partial = 0, last = 0;
+
+    ad7708_stats_init(&stats, 1U << CHANNEL);
+    CHECK(pthread_create(&thread, NULL, writer, NULL) == 0);
+
+    while (!__atomic_load_n(&writerDone, __ATOMIC_ACQUIRE))
+    {
+        uint32_t total = 0;
+
+        if (ad7708_stats_snapshot(&stats, CHANNEL, &snap) != AD7708_OK)
+        {
+            busy++;
+            continue;
+        }
+        good++;
+        for (uint32_t b = 0; b < AD7708_STATS_BINS; b++) { total += snap.hist[b]; }
+
+        // Everything in the copy belongs to the same count, and counts only grow
+        if (total != snap.count || snap.clamped != snap.count / 2U || (snap.seq & 1U) || snap.count < last) { torn++; }
+        if (snap.count != 0 && (snap.min != 0 || snap.max != (snap.count < 4096U ? snap.count - 1U : 4095U))) { torn++; }
+        if (snap.count != 0 && snap.count != WRITES) { partial++; }
+        last = snap.count;
+    }
+    pthread_join(thread, NULL);
+
+    printf("snapshots: %u complete, %u busy, %u taken mid-run\n", good, busy, partial);
+    CHECK(torn == 0);
+    CHECK(partial != 0); // The reader did run against the writer
+    CHECK(ad7708_stats_snapshot(&stats, CHANNEL, &snap) == AD7708_OK && snap.count == WRITES && snap.clamped == WRITES / 2U);
+}
+
+int main(void)
+{
+    testWelford();
+    testRestart();
+    testConcurrent();
+
+    return TEST_RESULT();
+}
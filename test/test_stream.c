@@ -0,0 +1,211 @@
+/*
+ * ad7708_stream against the simulator as RDY source.
+ *
+ * The input is a 1 V/s ramp so every code tells the time it was converted
+ * at and a sample pushed with the wrong data shows up against its stamp.
+ */
+#include "ad7708.h"
+#include "ad7708_ring.h"
+#include "ad7708_sim.h"
+#include "ad7708_stream.h"
+#include "test.h"
+
+#include <string.h>
+
+#define RING_SIZE 256U
+#define FAIL_EVERY 7U // Inline transfers failing without clocking a byte
+
+typedef struct
+{
+    ad7708_sim sim;
+    ad7708_dev dev;
+    ad7708_ring ring;
+    ad7708_sample storage[RING_SIZE];
+    uint32_t stamps[RING_SIZE];
+    ad7708_stream stream;
+    ad7708_transport transport;
+} test_ctx;
+
+static uint32_t transfers;
+
+static void onRdy(void* arg) { ad7708_stream_onRdy((ad7708_stream*)arg); }
+static void onDma(void* arg) { ad7708_stream_dmaComplete((ad7708_stream*)arg); }
+
+static double ramp(void* arg, uint8_t channel, uint64_t timeNs)
+{
+    (void)arg;
+    (void)channel;
+    return (double)timeNs * 1e-9;
+}
+
+static StatusTypeDef faultyTransfer(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len)
+{
+    if (++transfers % FAIL_EVERY == 0) { return AD7708_ERROR; }
+
+    return ad7708_simTransport.transfer(intf, tx, rx, len);
+}
+
+// Rejects every frame that writes the mode register, everything else reaches the sim
+static StatusTypeDef modeFailTransfer(void* intf, uint8_t* tx, uint8_t* rx, uint16_t len)
+{
+    transfers++;
+    if (tx[0] == (uint8_t)MODE_REG) { return AD7708_ERROR; }
+    return ad7708_simTransport.transfer(intf, tx, rx, len);
+}
+
+static void setup(test_ctx* ctx, uint32_t ringSize)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ad7708_sim_init(&ctx->sim);
+    ad7708_sim_attach(&ctx->sim, &ctx->dev);
+    ctx->sim.input = ramp;
+    ad7708_init(&ctx->dev);
+    ad7708_sfRateConfig(&ctx->dev, 3);
+    ad7708_channelConfig(&ctx->dev, AD7708_Channel_2, AD7708_Range_2p56V, AD7708_Bipolar);
+
+    ad7708_ring_init(&ctx->ring, ctx->storage, ringSize);
+    ad7708_ring_setStamps(&ctx->ring, ctx->stamps);
+    ctx->sim.onRdy = onRdy;
+    ctx->sim.rdyArg = &ctx->stream;
+    ctx->sim.onDmaDone = onDma;
+    ctx->sim.dmaArg = &ctx->stream;
+}
+
+static void nextRdy(test_ctx* ctx)
+{
+    ad7708_sim_advance(&ctx->sim, ad7708_sim_nextEvent(&ctx->sim) - ctx->sim.nowNs);
+}
+
+/*!
+ * @brief Drain the ring and check every sample against the ramp value at its stamp
+ * @return Number of samples drained
+ */
+static uint32_t drainAndCheck(test_ctx* ctx, uint32_t* lastUs)
+{
+    ad7708_sample out[32];
+    uint32_t timeUs[32];
+    uint32_t n, total = 0;
+
+    while ((n = ad7708_ring_popStamped(&ctx->ring, out, timeUs, 32)) != 0)
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            double expected = 32768.0 + (double)timeUs[i] * 1e-6 / 2.56 * 32768.0;
+            double diff = (double)out[i].code - expected;
+
+            CHECK(out[i].channel == AD7708_Channel_2);
+            CHECK(out[i].flags == AD7708_Range_2p56V);
+            CHECK(diff > -1.5 && diff < 1.5);
+            CHECK(*lastUs == 0 || timeUs[i] > *lastUs);
+            *lastUs = timeUs[i];
+        }
+        total += n;
+    }
+
+    return total;
+}
+
+static void testDma(test_ctx* ctx)
+{
+    uint32_t lastUs = 0, drained = 0;
+
+    setup(ctx, RING_SIZE);
+    CHECK(ad7708_stream_start(&ctx->stream, &ctx->dev, &ctx->ring) == AD7708_OK);
+    while (ctx->stream.samples < 1000)
+    {
+        nextRdy(ctx);
+        drained += drainAndCheck(ctx, &lastUs);
+    }
+    ad7708_stream_stop(&ctx->stream);
+
+    CHECK(drained == 1000);
+    CHECK(ctx->stream.errors == 0 && ctx->stream.busyOverruns == 0 && ctx->stream.fullOverruns == 0);
+    CHECK(ctx->sim.overruns == 0); // Every result was read before the next one landed
+}
+
+static void testInlineFailures(test_ctx* ctx)
+{
+    uint32_t lastUs = 0, drained = 0;
+    uint32_t rdys = 0;
+
+    setup(ctx, RING_SIZE);
+    ctx->transport = ad7708_simTransport;
+    ctx->transport.transfer = faultyTransfer;
+    ctx->transport.transferDMA = NULL;
+    ctx->dev.transport = &ctx->transport;
+    transfers = 0;
+
+    CHECK(ad7708_stream_start(&ctx->stream, &ctx->dev, &ctx->ring) == AD7708_OK);
+    transfers = 0; // Count from the first RDY
+    while (rdys < 700)
+    {
+        nextRdy(ctx);
+        rdys++;
+        drained += drainAndCheck(ctx, &lastUs);
+    }
+    ad7708_stream_stop(&ctx->stream);
+
+    // A failed frame pushes nothing, in particular not the previous frame's code with a new stamp
+    CHECK(ctx->stream.errors == rdys / FAIL_EVERY);
+    CHECK(ctx->stream.samples == rdys - rdys / FAIL_EVERY);
+    CHECK(drained == ctx->stream.samples);
+    CHECK(ctx->stream.dmaBusy == 0);
+}
+
+static void testOverruns(test_ctx* ctx)
+{
+    uint32_t lastUs = 0;
+
+    // A DMA completion that has not come in yet turns the next RDY into a busy overrun
+    setup(ctx, RING_SIZE);
+    ctx->sim.onDmaDone = NULL;
+    ad7708_stream_start(&ctx->stream, &ctx->dev, &ctx->ring);
+    nextRdy(ctx);
+    CHECK(ctx->stream.dmaBusy == 1);
+    nextRdy(ctx);
+    CHECK(ctx->stream.busyOverruns == 1);
+    ad7708_stream_dmaComplete(&ctx->stream);
+    CHECK(ctx->stream.samples == 1 && ctx->stream.dmaBusy == 0);
+    CHECK(drainAndCheck(ctx, &lastUs) == 1);
+    ad7708_stream_stop(&ctx->stream);
+
+    // A consumer that never drains loses everything past the ring size
+    setup(ctx, 8);
+    ad7708_stream_start(&ctx->stream, &ctx->dev, &ctx->ring);
+    for (uint32_t i = 0; i < 20; i++) { nextRdy(ctx); }
+    ad7708_stream_stop(&ctx->stream);
+    CHECK(ctx->stream.samples == 8 && ctx->stream.fullOverruns == 12);
+    CHECK(ad7708_ring_count(&ctx->ring) == 8);
+
+    // Stopped streams ignore RDY
+    nextRdy(ctx);
+    CHECK(ctx->stream.samples == 8 && ctx->stream.fullOverruns == 12);
+}
+
+static void testStartFailure(test_ctx* ctx)
+{
+    // A part that never got the mode write is not converting, RDY must not read it
+    setup(ctx, RING_SIZE);
+    ctx->transport = ad7708_simTransport;
+    ctx->transport.transfer = modeFailTransfer;
+    ctx->transport.transferDMA = NULL;
+    ctx->dev.transport = &ctx->transport;
+
+    CHECK(ad7708_stream_start(&ctx->stream, &ctx->dev, &ctx->ring) != AD7708_OK);
+    CHECK(ctx->stream.running == 0);
+    transfers = 0;
+    ad7708_stream_onRdy(&ctx->stream);
+    CHECK(transfers == 0 && ctx->stream.samples == 0 && ctx->stream.errors == 0);
+}
+
+int main(void)
+{
+    static test_ctx ctx;
+
+    testDma(&ctx);
+    testInlineFailures(&ctx);
+    testOverruns(&ctx);
+    testStartFailure(&ctx);
+
+    return TEST_RESULT();
+}